@@ -11,6 +11,9 @@
 #include <iostream>
 #include <thread>
 
+#include "system_discovery.h"
+#include "telemetry_waiter.h"
+
 using namespace mavsdk;
 using namespace std::this_thread;
 using namespace std::chrono;
@@ -41,7 +44,6 @@ int main(int argc, char** argv)
     std::string connection_url;
     ConnectionResult connection_result;
 
-    bool discovered_system = false;
     if (argc == 2) {
         connection_url = argv[1];
         connection_result = mavsdk.add_any_connection(connection_url);
@@ -57,26 +59,20 @@ int main(int argc, char** argv)
     }
 
     std::cout << "Waiting to discover system..." << std::endl;
-    mavsdk.subscribe_on_new_system([&mavsdk, &discovered_system]() {
-        const auto system = mavsdk.systems().at(0);
-
-        if (system->is_connected()) {
-            std::cout << "Discovered system" << std::endl;
-            discovered_system = true;
-        }
-    });
-
-    // We usually receive heartbeats at 1Hz, therefore we should find a system after around 2
-    // seconds.
-    sleep_for(seconds(2));
+    SystemDiscovery discovery(mavsdk);
 
-    if (!discovered_system) {
+    // Returns as soon as the system is connected instead of always waiting a fixed time.
+    if (!discovery.wait_for_systems(1, SystemDiscovery::default_timeout)) {
         std::cout << ERROR_CONSOLE_TEXT << "No system found, exiting." << NORMAL_CONSOLE_TEXT
                   << std::endl;
         return 1;
     }
 
-    const auto system = mavsdk.systems().at(0);
+    const auto discovered = discovery.discovered_systems().at(0);
+    std::cout << "Discovered system after " << discovered.time_to_discovery.count() << " ms"
+              << std::endl;
+
+    const auto system = discovered.system;
 
     // Register a callback so we get told when components (camera, gimbal) etc
     // are found.
@@ -93,19 +89,26 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    TelemetryWaiter waiter(telemetry);
+
     // Set up callback to monitor altitude while the vehicle is in flight
-    telemetry->subscribe_position([](Telemetry::Position position) {
+    waiter.subscribe_position([](Telemetry::Position position) {
         std::cout << TELEMETRY_CONSOLE_TEXT // set to blue
                   << "Altitude: " << position.relative_altitude_m << " m"
                   << NORMAL_CONSOLE_TEXT // set to default color again
                   << std::endl;
     });
 
-    // Check if vehicle is ready to arm
-    while (telemetry->health_all_ok() != true) {
-        std::cout << "Vehicle is getting ready to arm" << std::endl;
-        sleep_for(seconds(1));
+    // Check if vehicle is ready to arm, woken up by the health update itself.
+    std::cout << "Vehicle is getting ready to arm" << std::endl;
+    const auto health_result = waiter.wait_for_health_all_ok();
+    if (!health_result.satisfied) {
+        std::cout << ERROR_CONSOLE_TEXT << "Vehicle did not get ready to arm, "
+                  << TelemetryWaiter::to_string(health_result) << NORMAL_CONSOLE_TEXT << std::endl;
+        return 1;
     }
+    std::cout << "Vehicle is ready to arm " << TelemetryWaiter::to_string(health_result)
+              << std::endl;
 
     // Arm vehicle
     std::cout << "Arming..." << std::endl;
@@ -0,0 +1,164 @@
+#include "async_telemetry_logger.h"
+#include <algorithm>
+
+namespace {
+
+// Records copied out of a ring per write call.
+constexpr size_t batch_size = 256;
+
+// How long the writer sleeps when all rings were empty.
+constexpr std::chrono::milliseconds idle_interval{10};
+
+} // namespace
+
+constexpr size_t AsyncTelemetryLogger::default_capacity;
+constexpr std::chrono::milliseconds AsyncTelemetryLogger::default_flush_interval;
+
+bool AsyncTelemetryLogger::Channel::push(const TelemetryRecord& record)
+{
+    pushed_.fetch_add(1, std::memory_order_relaxed);
+
+    if (!ring_.push(record)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Only the producer writes the high water mark, so no CAS loop is needed.
+    const size_t size = ring_.size();
+    if (size > high_water_mark_.load(std::memory_order_relaxed)) {
+        high_water_mark_.store(size, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+AsyncTelemetryLogger::Stats AsyncTelemetryLogger::Channel::stats() const
+{
+    Stats stats{};
+    stats.pushed = pushed_.load(std::memory_order_relaxed);
+    stats.written = written_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.queue_high_water_mark = high_water_mark_.load(std::memory_order_relaxed);
+    stats.queue_capacity = ring_.capacity();
+    stats.max_write_latency_ns = latency_max_ns_.load(std::memory_order_relaxed);
+    stats.mean_write_latency_ns =
+        stats.written > 0 ? latency_sum_ns_.load(std::memory_order_relaxed) / stats.written : 0;
+    stats.flushes = flushes_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+AsyncTelemetryLogger::AsyncTelemetryLogger(std::chrono::milliseconds flush_interval) :
+    flush_interval_(flush_interval)
+{
+    thread_ = std::thread(&AsyncTelemetryLogger::run, this);
+}
+
+AsyncTelemetryLogger::~AsyncTelemetryLogger()
+{
+    should_exit_ = true;
+    thread_.join();
+}
+
+AsyncTelemetryLogger::Channel*
+AsyncTelemetryLogger::open_channel(const std::string& path, size_t capacity)
+{
+    std::unique_ptr<Channel> channel(new Channel(capacity));
+    if (!channel->writer_.open(path)) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(channels_mutex_);
+    channels_.push_back(std::move(channel));
+    return channels_.back().get();
+}
+
+AsyncTelemetryLogger::Stats AsyncTelemetryLogger::stats() const
+{
+    Stats total{};
+    uint64_t latency_sum_ns = 0;
+
+    std::lock_guard<std::mutex> lock(channels_mutex_);
+    for (const auto& channel : channels_) {
+        const Stats stats = channel->stats();
+        total.pushed += stats.pushed;
+        total.written += stats.written;
+        total.dropped += stats.dropped;
+        total.queue_high_water_mark =
+            std::max(total.queue_high_water_mark, stats.queue_high_water_mark);
+        total.queue_capacity = std::max(total.queue_capacity, stats.queue_capacity);
+        total.max_write_latency_ns =
+            std::max(total.max_write_latency_ns, stats.max_write_latency_ns);
+        latency_sum_ns += stats.mean_write_latency_ns * stats.written;
+        total.flushes += stats.flushes;
+    }
+    total.mean_write_latency_ns = total.written > 0 ? latency_sum_ns / total.written : 0;
+    return total;
+}
+
+void AsyncTelemetryLogger::run()
+{
+    auto next_flush = std::chrono::steady_clock::now() + flush_interval_;
+
+    while (true) {
+        // Read the flag first so that everything pushed before the destructor ran
+        // is still written in the last round.
+        const bool exiting = should_exit_;
+
+        const bool wrote_something = drain_channels();
+
+        const auto now = std::chrono::steady_clock::now();
+        if (exiting || now >= next_flush) {
+            flush_channels();
+            next_flush = now + flush_interval_;
+        }
+
+        if (exiting) {
+            break;
+        }
+
+        if (!wrote_something) {
+            std::this_thread::sleep_for(idle_interval);
+        }
+    }
+}
+
+bool AsyncTelemetryLogger::drain_channels()
+{
+    TelemetryRecord batch[batch_size];
+    bool wrote_something = false;
+
+    std::lock_guard<std::mutex> lock(channels_mutex_);
+    for (auto& channel : channels_) {
+        size_t count;
+        while ((count = channel->ring_.pop(batch, batch_size)) > 0) {
+            channel->writer_.write(batch, count);
+            channel->dirty_ = true;
+            wrote_something = true;
+
+            const uint64_t now_ns = telemetry_log_now_ns();
+            uint64_t latency_sum_ns = 0;
+            uint64_t latency_max_ns = channel->latency_max_ns_.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < count; ++i) {
+                const uint64_t latency_ns =
+                    now_ns > batch[i].monotonic_ns ? now_ns - batch[i].monotonic_ns : 0;
+                latency_sum_ns += latency_ns;
+                latency_max_ns = std::max(latency_max_ns, latency_ns);
+            }
+            channel->latency_sum_ns_.fetch_add(latency_sum_ns, std::memory_order_relaxed);
+            channel->latency_max_ns_.store(latency_max_ns, std::memory_order_relaxed);
+            channel->written_.fetch_add(count, std::memory_order_relaxed);
+        }
+    }
+    return wrote_something;
+}
+
+void AsyncTelemetryLogger::flush_channels()
+{
+    std::lock_guard<std::mutex> lock(channels_mutex_);
+    for (auto& channel : channels_) {
+        if (channel->dirty_) {
+            channel->writer_.flush();
+            channel->dirty_ = false;
+            channel->flushes_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.h"
+#include "telemetry_log.h"
+
+/**
+ * @brief The AsyncTelemetryLogger class
+ * Moves telemetry log I/O off the MAVSDK callback threads. Every vehicle gets a channel
+ * with its own lock-free ring and log file; callbacks only copy a record into the ring,
+ * and a single writer thread drains all rings and writes and flushes them in batches.
+ *
+ * If the writer can't keep up, records are dropped instead of blocking the callback.
+ */
+class AsyncTelemetryLogger {
+public:
+    struct Stats {
+        uint64_t pushed{0};
+        uint64_t written{0};
+        uint64_t dropped{0};
+        size_t queue_high_water_mark{0};
+        size_t queue_capacity{0};
+        // Time from the record timestamp until it was handed to the OS.
+        uint64_t max_write_latency_ns{0};
+        uint64_t mean_write_latency_ns{0};
+        uint64_t flushes{0};
+    };
+
+    class Channel {
+    public:
+        // Called from one producer thread only, typically the telemetry callback.
+        // Returns false if the record was dropped because the ring is full.
+        bool push(const TelemetryRecord& record);
+
+        Stats stats() const;
+
+    private:
+        friend class AsyncTelemetryLogger;
+
+        explicit Channel(size_t capacity) : ring_(capacity) {}
+
+        SpscRing<TelemetryRecord> ring_;
+        TelemetryLogWriter writer_{};
+
+        // Written by the producer.
+        std::atomic<uint64_t> pushed_{0};
+        std::atomic<uint64_t> dropped_{0};
+        std::atomic<size_t> high_water_mark_{0};
+
+        // Written by the writer thread.
+        std::atomic<uint64_t> written_{0};
+        std::atomic<uint64_t> latency_sum_ns_{0};
+        std::atomic<uint64_t> latency_max_ns_{0};
+        std::atomic<uint64_t> flushes_{0};
+        bool dirty_{false};
+    };
+
+    // 1 s worth of records at 50 Hz with plenty of margin for slow disks.
+    static constexpr size_t default_capacity = 4096;
+    static constexpr std::chrono::milliseconds default_flush_interval{200};
+
+    explicit AsyncTelemetryLogger(
+        std::chrono::milliseconds flush_interval = default_flush_interval);
+
+    // Stops the writer thread after writing everything still queued.
+    ~AsyncTelemetryLogger();
+
+    AsyncTelemetryLogger(const AsyncTelemetryLogger&) = delete;
+    AsyncTelemetryLogger& operator=(const AsyncTelemetryLogger&) = delete;
+
+    // Creates a log file and returns the channel to push records to, or nullptr if the
+    // file could not be opened. The channel stays valid as long as the logger exists.
+    Channel* open_channel(const std::string& path, size_t capacity = default_capacity);
+
+    // Sum over all channels, the high water mark is the maximum of all channels.
+    Stats stats() const;
+
+private:
+    void run();
+    bool drain_channels();
+    void flush_channels();
+
+    const std::chrono::milliseconds flush_interval_;
+
+    mutable std::mutex channels_mutex_{};
+    std::vector<std::unique_ptr<Channel>> channels_{};
+
+    std::atomic<bool> should_exit_{false};
+    std::thread thread_{};
+};
@@ -0,0 +1,297 @@
+#include "clock_sync.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+using namespace mavsdk;
+using std::chrono::steady_clock;
+
+constexpr std::chrono::milliseconds ClockSync::default_interval;
+constexpr std::chrono::milliseconds ClockSync::converge_interval;
+constexpr size_t ClockSync::window_size;
+constexpr size_t ClockSync::pending_size;
+constexpr size_t ClockSync::min_samples;
+constexpr int64_t ClockSync::reset_threshold_ns;
+
+namespace {
+
+// Same clock as telemetry_log_now_ns().
+int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Samples with a longer round trip than this are not used, the margin keeps a few
+// samples on links where the round trip is always short.
+int64_t rtt_threshold_ns(int64_t rtt_min_ns)
+{
+    return 2 * rtt_min_ns + 1000000;
+}
+
+// A drift needs samples spread over some time to be more than noise.
+constexpr int64_t min_drift_span_ns = 5000000000;
+
+// Crystal oscillators are within a few 100 ppm, anything more is a bad fit.
+constexpr double max_drift = 1e-3;
+
+} // namespace
+
+ClockSync::ClockSync(
+    std::shared_ptr<MavlinkPassthrough> mavlink_passthrough, std::chrono::milliseconds interval) :
+    mavlink_passthrough_(mavlink_passthrough),
+    interval_(interval)
+{
+    stats_.rtt_min_ns = -1;
+    stats_.rtt_last_ns = -1;
+
+    mavlink_passthrough_->subscribe_message_async(
+        MAVLINK_MSG_ID_TIMESYNC,
+        [this](const mavlink_message_t& message) { handle_timesync(message); });
+
+    thread_ = std::thread(&ClockSync::run_sender, this);
+}
+
+ClockSync::~ClockSync()
+{
+    mavlink_passthrough_->subscribe_message_async(MAVLINK_MSG_ID_TIMESYNC, nullptr);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        should_exit_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+uint64_t ClockSync::vehicle_to_host_ns(uint64_t vehicle_boot_ns) const
+{
+    const Model model = model_.load();
+    if (!model.valid) {
+        return 0;
+    }
+
+    // Solves the model for the host time, the drift applies to the time since the reference.
+    const double since_reference_ns =
+        static_cast<double>(
+            static_cast<int64_t>(vehicle_boot_ns) - model.offset_ns - model.reference_host_ns) /
+        (1.0 + model.drift);
+    const int64_t host_ns = model.reference_host_ns + std::llround(since_reference_ns);
+    return host_ns > 0 ? static_cast<uint64_t>(host_ns) : 0;
+}
+
+ClockSync::Stats ClockSync::stats() const
+{
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats = stats_;
+    }
+
+    const Model model = model_.load();
+    stats.synced = model.valid;
+    if (model.valid) {
+        stats.offset_ns = offset_at(model, now_ns());
+        stats.drift_ppm = model.drift * 1e6;
+    }
+    return stats;
+}
+
+std::string ClockSync::to_string(const Stats& stats)
+{
+    std::stringstream ss;
+    ss << std::fixed;
+    if (stats.synced) {
+        ss << "offset " << std::setprecision(3) << stats.offset_ns / 1e6 << " ms, drift "
+           << std::setprecision(1) << stats.drift_ppm << " ppm, ";
+    } else {
+        ss << "not synced, ";
+    }
+    if (stats.rtt_min_ns >= 0) {
+        ss << "rtt " << std::setprecision(2) << stats.rtt_min_ns / 1e6 << " ms min / "
+           << stats.rtt_last_ns / 1e6 << " ms last, residual " << stats.residual_ns / 1000
+           << " us, ";
+    }
+    ss << stats.accepted << "/" << stats.received << " replies used of " << stats.sent
+       << " requests, " << stats.resets << " resets";
+    return ss.str();
+}
+
+int64_t ClockSync::offset_at(const Model& model, int64_t host_ns)
+{
+    return model.offset_ns +
+           std::llround(model.drift * static_cast<double>(host_ns - model.reference_host_ns));
+}
+
+void ClockSync::run_sender()
+{
+    auto next_request = steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!should_exit_) {
+        lock.unlock();
+        send_request();
+        const bool synced = model_.load().valid;
+        lock.lock();
+
+        next_request += synced ? interval_ : converge_interval;
+        // Requests which are late are not worth catching up on.
+        const auto now = steady_clock::now();
+        if (next_request < now) {
+            next_request = now;
+        }
+        cv_.wait_until(lock, next_request, [this]() { return should_exit_; });
+    }
+}
+
+void ClockSync::send_request()
+{
+    mavlink_timesync_t timesync{};
+    timesync.tc1 = 0;
+    timesync.ts1 = now_ns();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_[next_pending_] = timesync.ts1;
+        next_pending_ = (next_pending_ + 1) % pending_size;
+        ++stats_.sent;
+    }
+
+    mavlink_message_t message;
+    mavlink_msg_timesync_encode(
+        mavlink_passthrough_->get_our_sysid(),
+        mavlink_passthrough_->get_our_compid(),
+        &message,
+        &timesync);
+    mavlink_passthrough_->send_message(message);
+}
+
+void ClockSync::handle_timesync(const mavlink_message_t& message)
+{
+    const int64_t receive_ns = now_ns();
+
+    mavlink_timesync_t timesync;
+    mavlink_msg_timesync_decode(&message, &timesync);
+
+    // Requests from the vehicle have tc1 0, MAVSDK answers those.
+    if (timesync.tc1 == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t* const pending = std::find(pending_, pending_ + pending_size, timesync.ts1);
+    if (timesync.ts1 == 0 || pending == pending_ + pending_size) {
+        // A reply to someone else's request, or to one of ours that is long gone.
+        return;
+    }
+    *pending = 0;
+    ++stats_.received;
+
+    const int64_t rtt_ns = receive_ns - timesync.ts1;
+    if (rtt_ns < 0) {
+        return;
+    }
+    stats_.rtt_last_ns = rtt_ns;
+
+    const int64_t host_ns = timesync.ts1 + rtt_ns / 2;
+    add_sample(Sample{host_ns, timesync.tc1 - host_ns, rtt_ns});
+}
+
+void ClockSync::add_sample(const Sample& sample)
+{
+    // Only a reply which is fast enough to be used can tell that the vehicle clock jumped,
+    // the offset of a late one is off by up to its round trip time. With a valid model the
+    // window isn't empty, so rtt_min_ns is set.
+    const Model model = model_.load();
+    if (model.valid && sample.rtt_ns <= rtt_threshold_ns(stats_.rtt_min_ns) &&
+        std::llabs(sample.offset_ns - offset_at(model, sample.host_ns)) > reset_threshold_ns) {
+        window_.clear();
+        model_.store(Model{});
+        ++stats_.resets;
+    }
+
+    window_.push_back(sample);
+    if (window_.size() > window_size) {
+        window_.pop_front();
+    }
+    fit();
+}
+
+void ClockSync::fit()
+{
+    int64_t rtt_min_ns = window_.front().rtt_ns;
+    for (const auto& sample : window_) {
+        rtt_min_ns = std::min(rtt_min_ns, sample.rtt_ns);
+    }
+    stats_.rtt_min_ns = rtt_min_ns;
+
+    const int64_t threshold_ns = rtt_threshold_ns(rtt_min_ns);
+    if (window_.back().rtt_ns <= threshold_ns) {
+        ++stats_.accepted;
+    }
+
+    // Relative to the first used sample to keep the sums small enough for doubles.
+    bool has_reference = false;
+    int64_t reference_host_ns = 0;
+    int64_t reference_offset_ns = 0;
+    size_t count = 0;
+    double sum_x = 0.0;
+    double sum_y = 0.0;
+    for (const auto& sample : window_) {
+        if (sample.rtt_ns > threshold_ns) {
+            continue;
+        }
+        if (!has_reference) {
+            has_reference = true;
+            reference_host_ns = sample.host_ns;
+            reference_offset_ns = sample.offset_ns;
+        }
+        sum_x += static_cast<double>(sample.host_ns - reference_host_ns);
+        sum_y += static_cast<double>(sample.offset_ns - reference_offset_ns);
+        ++count;
+    }
+
+    const double mean_x = sum_x / count;
+    const double mean_y = sum_y / count;
+    double sxx = 0.0;
+    double sxy = 0.0;
+    int64_t last_host_ns = reference_host_ns;
+    for (const auto& sample : window_) {
+        if (sample.rtt_ns > threshold_ns) {
+            continue;
+        }
+        const double dx = static_cast<double>(sample.host_ns - reference_host_ns) - mean_x;
+        const double dy = static_cast<double>(sample.offset_ns - reference_offset_ns) - mean_y;
+        sxx += dx * dx;
+        sxy += dx * dy;
+        last_host_ns = sample.host_ns;
+    }
+
+    double drift = 0.0;
+    if (count >= min_samples && last_host_ns - reference_host_ns >= min_drift_span_ns) {
+        drift = std::max(-max_drift, std::min(max_drift, sxy / sxx));
+    }
+
+    // The line goes through the mean of the samples.
+    const double offset_at_reference = mean_y - drift * mean_x;
+
+    double squared_residual_sum = 0.0;
+    for (const auto& sample : window_) {
+        if (sample.rtt_ns > threshold_ns) {
+            continue;
+        }
+        const double x = static_cast<double>(sample.host_ns - reference_host_ns);
+        const double y = static_cast<double>(sample.offset_ns - reference_offset_ns);
+        const double residual = y - (offset_at_reference + drift * x);
+        squared_residual_sum += residual * residual;
+    }
+    stats_.residual_ns = std::llround(std::sqrt(squared_residual_sum / count));
+
+    Model model{};
+    model.valid = count >= min_samples;
+    model.reference_host_ns = reference_host_ns;
+    model.offset_ns = reference_offset_ns + std::llround(offset_at_reference);
+    model.drift = drift;
+    model_.store(model);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <mavsdk/plugins/mavlink_passthrough/mavlink_passthrough.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "seqlock.h"
+
+/**
+ * @brief The ClockSync class
+ * Estimates the offset between the clock of one vehicle and the host with TIMESYNC round
+ * trips, so vehicle timestamps (e.g. time_boot_ms) can be mapped to the host steady clock,
+ * the clock telemetry_log_now_ns() uses.
+ *
+ * Each reply gives an offset sample, assuming the request and the reply took the same
+ * time. Replies with a round trip much longer than the shortest recent one are dropped,
+ * their offset error can be up to half the round trip. A line fitted through the
+ * remaining samples gives the offset and how fast the vehicle clock drifts against ours.
+ *
+ * Takes over the TIMESYNC subscription of the passthrough while it exists.
+ */
+class ClockSync {
+public:
+    struct Stats {
+        unsigned sent;
+        // Replies to our requests, and how many of them were used for the estimate.
+        unsigned received;
+        unsigned accepted;
+        // The estimate starts over if the vehicle clock jumps, e.g. after a reboot.
+        unsigned resets;
+        bool synced;
+        // Vehicle time minus host time right now.
+        int64_t offset_ns;
+        // Positive if the vehicle clock runs faster than ours.
+        double drift_ppm;
+        int64_t rtt_min_ns;
+        int64_t rtt_last_ns;
+        // RMS distance of the used samples from the fitted line, a measure of the jitter.
+        int64_t residual_ns;
+    };
+
+    // Until synced, requests go out at a faster rate to converge quickly.
+    static constexpr std::chrono::milliseconds default_interval{1000};
+    static constexpr std::chrono::milliseconds converge_interval{100};
+
+    explicit ClockSync(
+        std::shared_ptr<mavsdk::MavlinkPassthrough> mavlink_passthrough,
+        std::chrono::milliseconds interval = default_interval);
+
+    ~ClockSync();
+
+    ClockSync(const ClockSync&) = delete;
+    ClockSync& operator=(const ClockSync&) = delete;
+
+    bool synced() const { return model_.load().valid; }
+
+    // Host steady clock time in ns of a vehicle time since boot, 0 while not synced.
+    // Lock-free, meant to be called from telemetry callbacks.
+    uint64_t vehicle_to_host_ns(uint64_t vehicle_boot_ns) const;
+
+    Stats stats() const;
+
+    // E.g. "offset -8123.456 ms, drift 12.3 ppm, rtt 0.41 ms min / 0.52 ms last, ..."
+    static std::string to_string(const Stats& stats);
+
+private:
+    // vehicle_ns = host_ns + offset_ns + drift * (host_ns - reference_host_ns)
+    struct Model {
+        bool valid;
+        int64_t reference_host_ns;
+        int64_t offset_ns;
+        double drift;
+    };
+
+    struct Sample {
+        int64_t host_ns; // middle of the round trip
+        int64_t offset_ns;
+        int64_t rtt_ns;
+    };
+
+    static constexpr size_t window_size = 64;
+    static constexpr size_t pending_size = 8;
+    static constexpr size_t min_samples = 4;
+    // Offsets further off than this from the estimate mean the vehicle clock jumped.
+    static constexpr int64_t reset_threshold_ns = 1000000000;
+
+    static int64_t offset_at(const Model& model, int64_t host_ns);
+
+    void run_sender();
+    void send_request();
+    void handle_timesync(const mavlink_message_t& message);
+    void add_sample(const Sample& sample);
+    void fit();
+
+    std::shared_ptr<mavsdk::MavlinkPassthrough> mavlink_passthrough_;
+    const std::chrono::milliseconds interval_;
+
+    Seqlock<Model> model_{};
+
+    mutable std::mutex mutex_{};
+    std::condition_variable cv_{};
+    bool should_exit_{false};
+    // ts1 of the latest requests, to tell our replies apart from other TIMESYNC traffic.
+    int64_t pending_[pending_size]{};
+    size_t next_pending_{0};
+    std::deque<Sample> window_{};
+    Stats stats_{};
+
+    std::thread thread_{};
+};
@@ -0,0 +1,288 @@
+#include "console_renderer.h"
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+using std::chrono::steady_clock;
+
+constexpr double ConsoleRenderer::default_rate_hz;
+constexpr size_t ConsoleRenderer::text_size;
+
+namespace {
+
+const char* const error_text = "\033[31m"; // Turn text on console red
+const char* const telemetry_text = "\033[34m"; // Turn text on console blue
+const char* const normal_text = "\033[0m"; // Restore normal console colour
+
+// Lines of the table must not wrap, otherwise moving the cursor by a number of lines
+// ends up in the wrong place.
+constexpr size_t max_line_length = 79;
+
+// Columns of format_row(), which stays within max_line_length.
+const char* const header = "sys  status                alt m    latitude   longitude  detail";
+
+void copy_text(char* destination, size_t size, const std::string& text)
+{
+    const size_t len = std::min(text.size(), size - 1);
+    memcpy(destination, text.data(), len);
+    destination[len] = '\0';
+}
+
+} // namespace
+
+ConsoleRenderer::ConsoleRenderer(double rate_hz, std::FILE* out) :
+    out_(out),
+    is_terminal_(isatty(fileno(out)) != 0),
+    period_(std::chrono::nanoseconds(
+        static_cast<int64_t>(1e9 / std::max(1.0, std::min(60.0, rate_hz)))))
+{
+    for (auto& used : used_) {
+        used.store(false, std::memory_order_relaxed);
+    }
+    drawn_rows_.resize(256);
+    thread_ = std::thread(&ConsoleRenderer::run_renderer, this);
+}
+
+ConsoleRenderer::~ConsoleRenderer()
+{
+    stop();
+}
+
+template<typename F> void ConsoleRenderer::change_row(uint8_t system_id, F change_function)
+{
+    rows_[system_id].modify(change_function);
+    used_[system_id].store(true, std::memory_order_release);
+}
+
+void ConsoleRenderer::set_status(uint8_t system_id, const std::string& status)
+{
+    change_row(system_id, [&status](Row& row) {
+        copy_text(row.status, sizeof(row.status), status);
+    });
+}
+
+void ConsoleRenderer::set_detail(uint8_t system_id, const std::string& detail)
+{
+    change_row(system_id, [&detail](Row& row) {
+        copy_text(row.detail, sizeof(row.detail), detail);
+    });
+}
+
+void ConsoleRenderer::set_position(
+    uint8_t system_id, double latitude_deg, double longitude_deg, float relative_altitude_m)
+{
+    change_row(system_id, [=](Row& row) {
+        row.latitude_deg = latitude_deg;
+        row.longitude_deg = longitude_deg;
+        row.relative_altitude_m = relative_altitude_m;
+        row.has_position = true;
+    });
+}
+
+void ConsoleRenderer::set_summary(const std::string& summary)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    summary_ = summary;
+}
+
+void ConsoleRenderer::log(const std::string& text, bool is_error)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopped_) {
+        std::FILE* const out = is_error ? stderr : out_;
+        fprintf(out, "%s\n", text.c_str());
+        return;
+    }
+    log_lines_.push_back(LogLine{text, is_error});
+}
+
+void ConsoleRenderer::stop()
+{
+    // Any thread may stop it, e.g. to exit on an error, but only one may join.
+    std::lock_guard<std::mutex> stop_lock(stop_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        should_exit_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    // Lines logged after the last frame was drawn go below it.
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+    for (const auto& line : log_lines_) {
+        fprintf(line.is_error ? stderr : out_, "%s\n", line.text.c_str());
+    }
+    log_lines_.clear();
+}
+
+ConsoleRenderer::Stats ConsoleRenderer::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void ConsoleRenderer::run_renderer()
+{
+    auto next_frame = steady_clock::now() + period_;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        cv_.wait_until(lock, next_frame, [this]() { return should_exit_; });
+        const bool exiting = should_exit_;
+
+        lock.unlock();
+        render();
+        lock.lock();
+
+        if (exiting) {
+            break;
+        }
+        // Frames which are late are skipped, the next one shows the latest state anyway.
+        next_frame += period_;
+        const auto now = steady_clock::now();
+        if (next_frame < now) {
+            next_frame = now + period_;
+        }
+    }
+}
+
+void ConsoleRenderer::render()
+{
+    std::vector<LogLine> log_lines;
+    std::string summary;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        log_lines.swap(log_lines_);
+        summary = summary_;
+    }
+
+    std::vector<uint8_t> system_ids;
+    std::vector<std::string> rows;
+    for (unsigned id = 0; id < 256; ++id) {
+        if (used_[id].load(std::memory_order_acquire)) {
+            system_ids.push_back(static_cast<uint8_t>(id));
+            rows.push_back(format_row(static_cast<uint8_t>(id), rows_[id].load()));
+        }
+    }
+
+    frame_.clear();
+    uint64_t lines_written = 0;
+
+    if (is_terminal_) {
+        if (summary.size() > max_line_length) {
+            summary.resize(max_line_length);
+        }
+        // The table is the header, the rows and the summary, with the cursor below it.
+        // Vehicles are only ever added, so with the same number of rows every row is still
+        // on the line it was drawn on last time.
+        if (!log_lines.empty() || rows.size() != drawn_count_) {
+            if (drawn_count_ > 0) {
+                // Back to the header, and clear everything from there on.
+                frame_ += "\033[" + std::to_string(drawn_count_ + 2) + "A";
+            }
+            frame_ += "\r\033[J";
+            for (const auto& line : log_lines) {
+                if (line.is_error) {
+                    frame_ += error_text;
+                }
+                frame_ += line.text;
+                if (line.is_error) {
+                    frame_ += normal_text;
+                }
+                frame_ += '\n';
+            }
+            // No table until there is a vehicle to show.
+            if (!rows.empty()) {
+                frame_ += header;
+                frame_ += '\n';
+                for (const auto& row : rows) {
+                    frame_ += telemetry_text + row + normal_text + '\n';
+                }
+                frame_ += summary + '\n';
+                lines_written = rows.size() + 2;
+            }
+        } else if (!rows.empty()) {
+            if (summary != drawn_summary_) {
+                frame_ += "\033[1A\r\033[2K" + summary + "\033[1B\r";
+                ++lines_written;
+            }
+            for (size_t i = 0; i < rows.size(); ++i) {
+                if (rows[i] == drawn_rows_[system_ids[i]]) {
+                    continue;
+                }
+                // Up to the line, rewrite it and back down to below the table.
+                const std::string distance = std::to_string(rows.size() - i + 1);
+                frame_ += "\033[" + distance + "A\r\033[2K";
+                frame_ += telemetry_text + rows[i] + normal_text;
+                frame_ += "\033[" + distance + "B\r";
+                ++lines_written;
+            }
+        }
+    } else {
+        for (const auto& line : log_lines) {
+            frame_ += line.text + '\n';
+        }
+        if (drawn_count_ == 0 && !rows.empty()) {
+            frame_ += header;
+            frame_ += '\n';
+        }
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (rows[i] != drawn_rows_[system_ids[i]]) {
+                frame_ += rows[i] + '\n';
+                ++lines_written;
+            }
+        }
+        if (!summary.empty() && summary != drawn_summary_) {
+            frame_ += summary + '\n';
+            ++lines_written;
+        }
+    }
+
+    for (size_t i = 0; i < rows.size(); ++i) {
+        drawn_rows_[system_ids[i]] = rows[i];
+    }
+    drawn_count_ = rows.size();
+    drawn_summary_ = summary;
+
+    if (!frame_.empty()) {
+        fwrite(frame_.data(), 1, frame_.size(), out_);
+        fflush(out_);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.frames;
+    stats_.lines_written += lines_written;
+    stats_.bytes_written += frame_.size();
+}
+
+std::string ConsoleRenderer::format_row(uint8_t system_id, const Row& row) const
+{
+    char line[160];
+    if (row.has_position) {
+        snprintf(
+            line,
+            sizeof(line),
+            "%3d  %-20s %7.1f %11.6f %11.6f  %s",
+            int(system_id),
+            row.status,
+            static_cast<double>(row.relative_altitude_m),
+            row.latitude_deg,
+            row.longitude_deg,
+            row.detail);
+    } else {
+        snprintf(
+            line,
+            sizeof(line),
+            "%3d  %-20s %7s %11s %11s  %s",
+            int(system_id),
+            row.status,
+            "-",
+            "-",
+            "-",
+            row.detail);
+    }
+    return line;
+}
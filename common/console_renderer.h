@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "seqlock.h"
+
+/**
+ * @brief The ConsoleRenderer class
+ * Shows a table with one line per vehicle, redrawn at a fixed rate by its own thread.
+ * Telemetry callbacks only store the latest values, so no console output (and no flush)
+ * happens on their threads and lines of different vehicles don't get interleaved.
+ *
+ * On a terminal only the lines which changed since the last frame are rewritten, with
+ * messages from log() scrolling above the table. If the output is not a terminal, e.g.
+ * piped into a file, changed lines are appended instead, still at most once per frame.
+ */
+class ConsoleRenderer {
+public:
+    struct Stats {
+        uint64_t frames;
+        // Table lines written, a full redraw counts every line.
+        uint64_t lines_written;
+        uint64_t bytes_written;
+    };
+
+    static constexpr double default_rate_hz = 10.0;
+
+    explicit ConsoleRenderer(double rate_hz = default_rate_hz, std::FILE* out = stdout);
+
+    // Draws the last frame.
+    ~ConsoleRenderer();
+
+    ConsoleRenderer(const ConsoleRenderer&) = delete;
+    ConsoleRenderer& operator=(const ConsoleRenderer&) = delete;
+
+    // Short text about what the vehicle is doing, e.g. "Taking off".
+    void set_status(uint8_t system_id, const std::string& status);
+
+    // Anything else worth showing, e.g. the mission progress.
+    void set_detail(uint8_t system_id, const std::string& detail);
+
+    void set_position(
+        uint8_t system_id, double latitude_deg, double longitude_deg, float relative_altitude_m);
+
+    // One line below the table about the whole fleet, e.g. the closest vehicles.
+    void set_summary(const std::string& summary);
+
+    // A message that is kept, printed above the table with the next frame.
+    void log(const std::string& text, bool is_error = false);
+
+    // Draws the last frame and stops the thread. Afterwards, output goes to the console
+    // directly again. Any thread may call it, more than once.
+    void stop();
+
+    Stats stats() const;
+
+private:
+    // Longer texts are cut off.
+    static constexpr size_t text_size = 21;
+
+    struct Row {
+        char status[text_size];
+        char detail[text_size];
+        double latitude_deg;
+        double longitude_deg;
+        float relative_altitude_m;
+        bool has_position;
+    };
+
+    struct LogLine {
+        std::string text;
+        bool is_error;
+    };
+
+    template<typename F> void change_row(uint8_t system_id, F change_function);
+    void run_renderer();
+    void render();
+    std::string format_row(uint8_t system_id, const Row& row) const;
+
+    std::FILE* const out_;
+    const bool is_terminal_;
+    const std::chrono::nanoseconds period_;
+
+    Seqlock<Row> rows_[256];
+    std::atomic<bool> used_[256];
+
+    std::mutex stop_mutex_{};
+    mutable std::mutex mutex_{};
+    std::condition_variable cv_{};
+    bool should_exit_{false};
+    bool stopped_{false};
+    std::vector<LogLine> log_lines_{};
+    std::string summary_{};
+    Stats stats_{};
+
+    // Only used by the renderer thread. Rows as last drawn, by system id.
+    std::vector<std::string> drawn_rows_{};
+    size_t drawn_count_{0};
+    std::string drawn_summary_{};
+    std::string frame_{};
+
+    std::thread thread_{};
+};
@@ -0,0 +1,132 @@
+#include "fleet_executor.h"
+#include <algorithm>
+
+size_t FleetExecutor::default_worker_count()
+{
+    const size_t cores = std::thread::hardware_concurrency();
+    return std::max<size_t>(1, std::min<size_t>(cores, 4));
+}
+
+FleetExecutor::FleetExecutor(size_t worker_count)
+{
+    workers_.reserve(worker_count);
+    for (size_t i = 0; i < std::max<size_t>(1, worker_count); ++i) {
+        workers_.emplace_back(&FleetExecutor::run_worker, this);
+    }
+}
+
+FleetExecutor::~FleetExecutor()
+{
+    stop();
+}
+
+void FleetExecutor::post(task_t task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+}
+
+void FleetExecutor::post_after(std::chrono::milliseconds delay, task_t task)
+{
+    post_at(std::chrono::steady_clock::now() + delay, std::move(task));
+}
+
+void FleetExecutor::post_at(time_point deadline, task_t task)
+{
+    bool is_earliest;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_earliest = timers_.empty() || deadline < timers_.top().deadline;
+        timers_.push(Timer{deadline, next_sequence_++, std::move(task)});
+    }
+    // Only a new earliest timer changes how long the workers have to sleep.
+    if (is_earliest) {
+        cv_.notify_one();
+    }
+}
+
+void FleetExecutor::post_when(
+    std::function<bool()> predicate,
+    std::function<void(bool)> continuation,
+    std::chrono::milliseconds poll_interval,
+    std::chrono::milliseconds timeout)
+{
+    const time_point deadline = std::chrono::steady_clock::now() + timeout;
+    post([this, predicate, continuation, poll_interval, deadline]() {
+        poll(predicate, continuation, poll_interval, deadline);
+    });
+}
+
+void FleetExecutor::poll(
+    std::function<bool()> predicate,
+    std::function<void(bool)> continuation,
+    std::chrono::milliseconds poll_interval,
+    time_point deadline)
+{
+    if (predicate()) {
+        continuation(true);
+        return;
+    }
+    if (std::chrono::steady_clock::now() + poll_interval > deadline) {
+        continuation(false);
+        return;
+    }
+    post_after(poll_interval, [this, predicate, continuation, poll_interval, deadline]() {
+        poll(predicate, continuation, poll_interval, deadline);
+    });
+}
+
+void FleetExecutor::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        should_exit_ = true;
+    }
+    cv_.notify_all();
+
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+void FleetExecutor::run_worker()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (!should_exit_) {
+        // Move timers which are due to the ready queue, they keep their order.
+        const auto now = std::chrono::steady_clock::now();
+        while (!timers_.empty() && timers_.top().deadline <= now) {
+            ready_.push_back(std::move(const_cast<Timer&>(timers_.top()).task));
+            timers_.pop();
+        }
+
+        if (ready_.empty()) {
+            if (timers_.empty()) {
+                cv_.wait(lock);
+            } else {
+                // Copy, the timer storage can change while we are waiting.
+                const time_point deadline = timers_.top().deadline;
+                cv_.wait_until(lock, deadline);
+            }
+            continue;
+        }
+
+        task_t task = std::move(ready_.front());
+        ready_.pop_front();
+
+        // Wake another worker if there is more to do.
+        if (!ready_.empty()) {
+            cv_.notify_one();
+        }
+
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The FleetExecutor class
+ * Small fixed pool of worker threads with timers, used to run per-vehicle scripts for
+ * many vehicles without a thread per vehicle.
+ *
+ * Scripts are written as a chain of short tasks: instead of sleeping, a task schedules
+ * the next step with post_after(), or a telemetry/action callback calls post() when
+ * the event it waits for has happened. Tasks must not block.
+ */
+class FleetExecutor {
+public:
+    typedef std::function<void()> task_t;
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    // One worker per core, but never more than a few: tasks are short.
+    static size_t default_worker_count();
+
+    explicit FleetExecutor(size_t worker_count = default_worker_count());
+
+    // Stops the workers, pending timers are discarded.
+    ~FleetExecutor();
+
+    FleetExecutor(const FleetExecutor&) = delete;
+    FleetExecutor& operator=(const FleetExecutor&) = delete;
+
+    // Runs the task on a worker as soon as possible. Safe to call from any thread,
+    // including MAVSDK callbacks and tasks.
+    void post(task_t task);
+
+    void post_after(std::chrono::milliseconds delay, task_t task);
+
+    void post_at(time_point deadline, task_t task);
+
+    // Checks the predicate every poll_interval until it returns true or the timeout has
+    // passed, then runs the continuation with the result. For state which is only
+    // available by polling, e.g. Telemetry::health_all_ok().
+    void post_when(
+        std::function<bool()> predicate,
+        std::function<void(bool)> continuation,
+        std::chrono::milliseconds poll_interval,
+        std::chrono::milliseconds timeout);
+
+    size_t worker_count() const { return workers_.size(); }
+
+    // Waits for the workers to finish the task they are running and ends them.
+    void stop();
+
+private:
+    struct Timer {
+        time_point deadline;
+        // Keeps timers with the same deadline in the order they were added.
+        uint64_t sequence;
+        task_t task;
+    };
+
+    struct TimerIsLater {
+        bool operator()(const Timer& lhs, const Timer& rhs) const
+        {
+            return lhs.deadline > rhs.deadline ||
+                   (lhs.deadline == rhs.deadline && lhs.sequence > rhs.sequence);
+        }
+    };
+
+    void run_worker();
+    void poll(
+        std::function<bool()> predicate,
+        std::function<void(bool)> continuation,
+        std::chrono::milliseconds poll_interval,
+        time_point deadline);
+
+    std::mutex mutex_{};
+    std::condition_variable cv_{};
+    std::deque<task_t> ready_{};
+    std::priority_queue<Timer, std::vector<Timer>, TimerIsLater> timers_{};
+    uint64_t next_sequence_{0};
+    bool should_exit_{false};
+
+    std::vector<std::thread> workers_{};
+};
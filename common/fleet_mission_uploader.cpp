@@ -0,0 +1,136 @@
+#include "fleet_mission_uploader.h"
+#include <algorithm>
+#include <sstream>
+#include <utility>
+
+using namespace mavsdk;
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+constexpr size_t FleetMissionUploader::default_max_in_flight;
+
+FleetMissionUploader::FleetMissionUploader(size_t max_in_flight) :
+    max_in_flight_(std::max<size_t>(1, max_in_flight))
+{}
+
+FleetMissionUploader::Report
+FleetMissionUploader::upload(std::vector<Upload> uploads, progress_callback_t on_progress)
+{
+    size_t first_uploads;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uploads_ = std::move(uploads);
+        results_.assign(uploads_.size(), UploadResult{});
+        for (size_t i = 0; i < uploads_.size(); ++i) {
+            results_[i].system_id = uploads_[i].system_id;
+            results_[i].result = Mission::Result::Unknown;
+        }
+        on_progress_ = std::move(on_progress);
+        progress_ = Progress{};
+        progress_.total = uploads_.size();
+        first_uploads = std::min(max_in_flight_, uploads_.size());
+        progress_.in_flight = first_uploads;
+        next_upload_ = first_uploads;
+        starting_ = first_uploads;
+        start_time_ = steady_clock::now();
+    }
+
+    for (size_t i = 0; i < first_uploads; ++i) {
+        start_upload(i);
+    }
+
+    Report report{};
+    {
+        // An upload which failed right away can finish before start_upload() returned,
+        // the upload functions must not be destroyed until then.
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() {
+            return progress_.succeeded + progress_.failed == progress_.total && starting_ == 0;
+        });
+        report.results = std::move(results_);
+        report.failed = progress_.failed;
+        uploads_.clear();
+        on_progress_ = nullptr;
+    }
+
+    report.total_time = duration_cast<milliseconds>(steady_clock::now() - start_time_);
+    for (const auto& result : report.results) {
+        report.max_upload_time = std::max(report.max_upload_time, result.upload_time);
+    }
+    return report;
+}
+
+FleetMissionUploader::Upload FleetMissionUploader::mission_upload(
+    uint8_t system_id, std::shared_ptr<Mission> mission, Mission::MissionPlan mission_plan)
+{
+    auto shared_plan = std::make_shared<Mission::MissionPlan>(std::move(mission_plan));
+    return Upload{system_id, [mission, shared_plan](result_callback_t callback) {
+                      mission->upload_mission_async(*shared_plan, callback);
+                  }};
+}
+
+std::string FleetMissionUploader::to_string(const Progress& progress)
+{
+    std::stringstream ss;
+    ss << "Uploads: " << progress.succeeded << "/" << progress.total << " done, "
+       << progress.in_flight << " in flight, " << progress.failed << " failed";
+    return ss.str();
+}
+
+void FleetMissionUploader::start_upload(size_t index)
+{
+    const auto upload_start_time = steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        results_[index].queued_time =
+            duration_cast<milliseconds>(upload_start_time - start_time_);
+    }
+
+    uploads_[index].start([this, index, upload_start_time](Mission::Result result) {
+        finish_upload(index, result, upload_start_time);
+    });
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    --starting_;
+    cv_.notify_all();
+}
+
+void FleetMissionUploader::finish_upload(
+    size_t index, Mission::Result result, steady_clock::time_point upload_start_time)
+{
+    bool start_next = false;
+    size_t next_index = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        UploadResult& upload_result = results_[index];
+        upload_result.result = result;
+        upload_result.upload_time =
+            duration_cast<milliseconds>(steady_clock::now() - upload_start_time);
+
+        --progress_.in_flight;
+        if (result == Mission::Result::Success) {
+            ++progress_.succeeded;
+        } else {
+            ++progress_.failed;
+        }
+
+        // The slot goes to the next vehicle right away.
+        if (next_upload_ < uploads_.size()) {
+            start_next = true;
+            next_index = next_upload_++;
+            ++progress_.in_flight;
+            ++starting_;
+        }
+
+        if (on_progress_) {
+            on_progress_(upload_result, progress_);
+        }
+        cv_.notify_all();
+    }
+
+    // Not under the lock, the result callback may come before the upload function returns.
+    if (start_next) {
+        start_upload(next_index);
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <mavsdk/plugins/mission/mission.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The FleetMissionUploader class
+ * Uploads the missions of a whole fleet at once instead of one vehicle after the other.
+ * At most max_in_flight uploads run at the same time and the next one starts as soon as
+ * one has finished, so the time until all vehicles are ready depends on how much the
+ * link can carry and not on a fixed delay between vehicles.
+ *
+ * Each upload is an asynchronous function, e.g. Mission::upload_mission_async() (see
+ * mission_upload()) or MissionItemUploader::upload_async(). There is no thread per
+ * vehicle.
+ */
+class FleetMissionUploader {
+public:
+    typedef std::function<void(mavsdk::Mission::Result)> result_callback_t;
+    typedef std::function<void(result_callback_t)> upload_function_t;
+
+    struct Upload {
+        uint8_t system_id;
+        // Starts the upload and calls the callback once when it has finished.
+        upload_function_t start;
+    };
+
+    struct UploadResult {
+        uint8_t system_id;
+        mavsdk::Mission::Result result;
+        // Waiting for a free upload slot, then the upload itself.
+        std::chrono::milliseconds queued_time;
+        std::chrono::milliseconds upload_time;
+    };
+
+    struct Progress {
+        size_t total;
+        size_t in_flight;
+        size_t succeeded;
+        size_t failed;
+    };
+
+    struct Report {
+        // In the order of the uploads.
+        std::vector<UploadResult> results;
+        size_t failed;
+        std::chrono::milliseconds total_time;
+        std::chrono::milliseconds max_upload_time;
+    };
+
+    // Called after every finished upload, one call at a time.
+    typedef std::function<void(const UploadResult&, const Progress&)> progress_callback_t;
+
+    // Enough to keep a link busy, few enough that one vehicle's upload doesn't time out
+    // because all the others share the link with it.
+    static constexpr size_t default_max_in_flight = 8;
+
+    explicit FleetMissionUploader(size_t max_in_flight = default_max_in_flight);
+
+    FleetMissionUploader(const FleetMissionUploader&) = delete;
+    FleetMissionUploader& operator=(const FleetMissionUploader&) = delete;
+
+    // Blocks until every upload has finished, successful or not.
+    Report upload(std::vector<Upload> uploads, progress_callback_t on_progress = nullptr);
+
+    // An upload with the Mission plugin.
+    static Upload mission_upload(
+        uint8_t system_id,
+        std::shared_ptr<mavsdk::Mission> mission,
+        mavsdk::Mission::MissionPlan mission_plan);
+
+    static std::string to_string(const Progress& progress);
+
+private:
+    void start_upload(size_t index);
+    void finish_upload(
+        size_t index,
+        mavsdk::Mission::Result result,
+        std::chrono::steady_clock::time_point upload_start_time);
+
+    const size_t max_in_flight_;
+
+    std::mutex mutex_{};
+    std::condition_variable cv_{};
+    std::vector<Upload> uploads_{};
+    std::vector<UploadResult> results_{};
+    progress_callback_t on_progress_{};
+    Progress progress_{};
+    size_t next_upload_{0};
+    // Uploads in start_upload(), which still uses its upload function.
+    size_t starting_{0};
+    std::chrono::steady_clock::time_point start_time_{};
+};
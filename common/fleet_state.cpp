@@ -0,0 +1,259 @@
+#include "fleet_state.h"
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+using namespace mavsdk;
+
+constexpr size_t FleetState::no_slot;
+
+namespace {
+
+constexpr double earth_radius_m = 6371000.0;
+constexpr double degrees_to_radians = M_PI / 180.0;
+
+// Same as in Seqlock, a writer preempted in the middle of an update must not keep
+// the readers spinning for a whole time slice.
+constexpr unsigned spins_before_yield = 64;
+
+void back_off(unsigned attempt)
+{
+    if (attempt % spins_before_yield == 0) {
+        std::this_thread::yield();
+    }
+}
+
+uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace
+
+void FleetSnapshot::resize(size_t new_size)
+{
+    size = new_size;
+    system_id.resize(new_size);
+    update_time_ns.resize(new_size);
+    latitude_deg.resize(new_size);
+    longitude_deg.resize(new_size);
+    absolute_altitude_m.resize(new_size);
+    relative_altitude_m.resize(new_size);
+    north_m_s.resize(new_size);
+    east_m_s.resize(new_size);
+    down_m_s.resize(new_size);
+    roll_deg.resize(new_size);
+    pitch_deg.resize(new_size);
+    yaw_deg.resize(new_size);
+    battery_voltage_v.resize(new_size);
+    battery_remaining_percent.resize(new_size);
+}
+
+template<typename T>
+FleetState::Column<T> FleetState::make_column(size_t capacity, T initial_value)
+{
+    Column<T> column(new std::atomic<T>[capacity]);
+    for (size_t i = 0; i < capacity; ++i) {
+        column[i].store(initial_value, std::memory_order_relaxed);
+    }
+    return column;
+}
+
+FleetState::FleetState(size_t capacity) :
+    capacity_(capacity),
+    sequence_(make_column<uint32_t>(capacity, 0)),
+    system_id_(make_column<uint8_t>(capacity, 0)),
+    update_time_ns_(make_column<uint64_t>(capacity, 0)),
+    latitude_deg_(make_column<double>(capacity, NAN)),
+    longitude_deg_(make_column<double>(capacity, NAN)),
+    absolute_altitude_m_(make_column<float>(capacity, NAN)),
+    relative_altitude_m_(make_column<float>(capacity, NAN)),
+    north_m_s_(make_column<float>(capacity, NAN)),
+    east_m_s_(make_column<float>(capacity, NAN)),
+    down_m_s_(make_column<float>(capacity, NAN)),
+    roll_deg_(make_column<float>(capacity, NAN)),
+    pitch_deg_(make_column<float>(capacity, NAN)),
+    yaw_deg_(make_column<float>(capacity, NAN)),
+    battery_voltage_v_(make_column<float>(capacity, NAN)),
+    battery_remaining_percent_(make_column<float>(capacity, NAN))
+{}
+
+size_t FleetState::add_system(uint8_t system_id)
+{
+    std::lock_guard<std::mutex> lock(add_mutex_);
+
+    const size_t size = size_.load(std::memory_order_relaxed);
+    for (size_t slot = 0; slot < size; ++slot) {
+        if (system_id_[slot].load(std::memory_order_relaxed) == system_id) {
+            return slot;
+        }
+    }
+    if (size == capacity_) {
+        return no_slot;
+    }
+
+    system_id_[size].store(system_id, std::memory_order_relaxed);
+    // Publishes the system id together with the slot.
+    size_.store(size + 1, std::memory_order_release);
+    return size;
+}
+
+void FleetState::update_position(size_t slot, const Telemetry::Position& position)
+{
+    const uint32_t sequence = begin_write(slot);
+    latitude_deg_[slot].store(position.latitude_deg, std::memory_order_relaxed);
+    longitude_deg_[slot].store(position.longitude_deg, std::memory_order_relaxed);
+    absolute_altitude_m_[slot].store(position.absolute_altitude_m, std::memory_order_relaxed);
+    relative_altitude_m_[slot].store(position.relative_altitude_m, std::memory_order_relaxed);
+    end_write(slot, sequence);
+}
+
+void FleetState::update_velocity(size_t slot, const Telemetry::VelocityNed& velocity)
+{
+    const uint32_t sequence = begin_write(slot);
+    north_m_s_[slot].store(velocity.north_m_s, std::memory_order_relaxed);
+    east_m_s_[slot].store(velocity.east_m_s, std::memory_order_relaxed);
+    down_m_s_[slot].store(velocity.down_m_s, std::memory_order_relaxed);
+    end_write(slot, sequence);
+}
+
+void FleetState::update_attitude(size_t slot, const Telemetry::EulerAngle& attitude)
+{
+    const uint32_t sequence = begin_write(slot);
+    roll_deg_[slot].store(attitude.roll_deg, std::memory_order_relaxed);
+    pitch_deg_[slot].store(attitude.pitch_deg, std::memory_order_relaxed);
+    yaw_deg_[slot].store(attitude.yaw_deg, std::memory_order_relaxed);
+    end_write(slot, sequence);
+}
+
+void FleetState::update_battery(size_t slot, const Telemetry::Battery& battery)
+{
+    const uint32_t sequence = begin_write(slot);
+    battery_voltage_v_[slot].store(battery.voltage_v, std::memory_order_relaxed);
+    battery_remaining_percent_[slot].store(battery.remaining_percent, std::memory_order_relaxed);
+    end_write(slot, sequence);
+}
+
+void FleetState::snapshot(FleetSnapshot& snapshot) const
+{
+    const size_t size = size_.load(std::memory_order_acquire);
+    snapshot.resize(size);
+
+    for (size_t i = 0; i < size; ++i) {
+        for (unsigned attempt = 1;; ++attempt) {
+            const uint32_t before = sequence_[i].load(std::memory_order_acquire);
+            if ((before & 1) != 0) {
+                back_off(attempt);
+                continue;
+            }
+
+            snapshot.system_id[i] = system_id_[i].load(std::memory_order_relaxed);
+            snapshot.update_time_ns[i] = update_time_ns_[i].load(std::memory_order_relaxed);
+            snapshot.latitude_deg[i] = latitude_deg_[i].load(std::memory_order_relaxed);
+            snapshot.longitude_deg[i] = longitude_deg_[i].load(std::memory_order_relaxed);
+            snapshot.absolute_altitude_m[i] =
+                absolute_altitude_m_[i].load(std::memory_order_relaxed);
+            snapshot.relative_altitude_m[i] =
+                relative_altitude_m_[i].load(std::memory_order_relaxed);
+            snapshot.north_m_s[i] = north_m_s_[i].load(std::memory_order_relaxed);
+            snapshot.east_m_s[i] = east_m_s_[i].load(std::memory_order_relaxed);
+            snapshot.down_m_s[i] = down_m_s_[i].load(std::memory_order_relaxed);
+            snapshot.roll_deg[i] = roll_deg_[i].load(std::memory_order_relaxed);
+            snapshot.pitch_deg[i] = pitch_deg_[i].load(std::memory_order_relaxed);
+            snapshot.yaw_deg[i] = yaw_deg_[i].load(std::memory_order_relaxed);
+            snapshot.battery_voltage_v[i] = battery_voltage_v_[i].load(std::memory_order_relaxed);
+            snapshot.battery_remaining_percent[i] =
+                battery_remaining_percent_[i].load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_[i].load(std::memory_order_relaxed) == before) {
+                break;
+            }
+        }
+    }
+}
+
+uint32_t FleetState::begin_write(size_t slot)
+{
+    // Position, velocity and so on of one vehicle can arrive on different threads.
+    uint32_t sequence = sequence_[slot].load(std::memory_order_relaxed);
+    for (unsigned attempt = 1;; ++attempt) {
+        if ((sequence & 1) == 0 &&
+            sequence_[slot].compare_exchange_weak(
+                sequence, sequence + 1, std::memory_order_acquire)) {
+            std::atomic_thread_fence(std::memory_order_release);
+            return sequence + 1;
+        }
+        back_off(attempt);
+        sequence = sequence_[slot].load(std::memory_order_relaxed);
+    }
+}
+
+void FleetState::end_write(size_t slot, uint32_t sequence)
+{
+    update_time_ns_[slot].store(now_ns(), std::memory_order_relaxed);
+    sequence_[slot].store(sequence + 1, std::memory_order_release);
+}
+
+ClosestPair find_closest_pair(const FleetSnapshot& snapshot)
+{
+    ClosestPair result{FleetState::no_slot, FleetState::no_slot, NAN, NAN, NAN};
+
+    const size_t size = snapshot.size;
+    size_t reference = 0;
+    while (reference < size && !std::isfinite(snapshot.latitude_deg[reference])) {
+        ++reference;
+    }
+    if (reference == size) {
+        return result;
+    }
+
+    // Local coordinates first, so the pairwise loop below is plain float arithmetic over
+    // contiguous arrays. Vehicles without a position end up as NAN and never match.
+    const double latitude_0 = snapshot.latitude_deg[reference];
+    const double longitude_0 = snapshot.longitude_deg[reference];
+    const double east_scale = degrees_to_radians * earth_radius_m *
+                              std::cos(latitude_0 * degrees_to_radians);
+    const double north_scale = degrees_to_radians * earth_radius_m;
+
+    std::vector<float> north_m(size);
+    std::vector<float> east_m(size);
+    std::vector<float> up_m(size);
+    for (size_t i = 0; i < size; ++i) {
+        north_m[i] = static_cast<float>((snapshot.latitude_deg[i] - latitude_0) * north_scale);
+        east_m[i] = static_cast<float>((snapshot.longitude_deg[i] - longitude_0) * east_scale);
+        up_m[i] = snapshot.absolute_altitude_m[i];
+    }
+
+    std::vector<float> squared_distance_m2(size);
+    float best = INFINITY;
+    for (size_t i = 0; i + 1 < size; ++i) {
+        const float north_i = north_m[i];
+        const float east_i = east_m[i];
+        const float up_i = up_m[i];
+        for (size_t j = i + 1; j < size; ++j) {
+            const float dn = north_m[j] - north_i;
+            const float de = east_m[j] - east_i;
+            const float du = up_m[j] - up_i;
+            squared_distance_m2[j] = dn * dn + de * de + du * du;
+        }
+        for (size_t j = i + 1; j < size; ++j) {
+            if (squared_distance_m2[j] < best) {
+                best = squared_distance_m2[j];
+                result.first = i;
+                result.second = j;
+            }
+        }
+    }
+
+    if (result.first != FleetState::no_slot) {
+        const float dn = north_m[result.second] - north_m[result.first];
+        const float de = east_m[result.second] - east_m[result.first];
+        result.horizontal_distance_m = std::sqrt(dn * dn + de * de);
+        result.vertical_distance_m = std::fabs(up_m[result.second] - up_m[result.first]);
+        result.distance_m = std::sqrt(best);
+    }
+    return result;
+}
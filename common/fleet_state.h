@@ -0,0 +1,117 @@
+#pragma once
+
+#include <mavsdk/plugins/telemetry/telemetry.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Copy of the whole fleet at one point in time, one array per value.
+ * Index i of every array belongs to the same vehicle. Values which were never reported
+ * are NAN, so comparisons against them are false.
+ */
+struct FleetSnapshot {
+    size_t size{0};
+    std::vector<uint8_t> system_id{};
+    // Steady clock time of the latest update of any value, 0 if there was none yet.
+    std::vector<uint64_t> update_time_ns{};
+    std::vector<double> latitude_deg{};
+    std::vector<double> longitude_deg{};
+    std::vector<float> absolute_altitude_m{};
+    std::vector<float> relative_altitude_m{};
+    std::vector<float> north_m_s{};
+    std::vector<float> east_m_s{};
+    std::vector<float> down_m_s{};
+    std::vector<float> roll_deg{};
+    std::vector<float> pitch_deg{};
+    std::vector<float> yaw_deg{};
+    std::vector<float> battery_voltage_v{};
+    std::vector<float> battery_remaining_percent{};
+
+    void resize(size_t new_size);
+};
+
+/**
+ * @brief The FleetState class
+ * Latest position, velocity, attitude and battery of every vehicle in a fleet, kept as
+ * one array per value instead of one struct per vehicle. Fleet-wide checks like the
+ * separation between vehicles then run over contiguous arrays.
+ *
+ * Updates come from the telemetry callbacks and never block. Each vehicle has its own
+ * sequence number, the same protocol as Seqlock, so snapshot() copies every vehicle
+ * consistently: no vehicle has the latitude of one update and the longitude of the next.
+ *
+ * The capacity is fixed so the arrays never move while callbacks write to them.
+ */
+class FleetState {
+public:
+    static constexpr size_t no_slot = SIZE_MAX;
+
+    explicit FleetState(size_t capacity);
+
+    FleetState(const FleetState&) = delete;
+    FleetState& operator=(const FleetState&) = delete;
+
+    // Slot of the vehicle for the update functions, added if it is new. no_slot if full.
+    size_t add_system(uint8_t system_id);
+
+    size_t size() const { return size_.load(std::memory_order_acquire); }
+    size_t capacity() const { return capacity_; }
+
+    void update_position(size_t slot, const mavsdk::Telemetry::Position& position);
+    void update_velocity(size_t slot, const mavsdk::Telemetry::VelocityNed& velocity);
+    void update_attitude(size_t slot, const mavsdk::Telemetry::EulerAngle& attitude);
+    void update_battery(size_t slot, const mavsdk::Telemetry::Battery& battery);
+
+    // Copies all vehicles into the snapshot, reusing its memory.
+    void snapshot(FleetSnapshot& snapshot) const;
+
+private:
+    template<typename T> using Column = std::unique_ptr<std::atomic<T>[]>;
+
+    template<typename T> static Column<T> make_column(size_t capacity, T initial_value);
+
+    // Returns the odd sequence number to pass to end_write().
+    uint32_t begin_write(size_t slot);
+    void end_write(size_t slot, uint32_t sequence);
+
+    const size_t capacity_;
+    std::atomic<size_t> size_{0};
+    // Only taken to add vehicles.
+    std::mutex add_mutex_{};
+
+    Column<uint32_t> sequence_;
+    Column<uint8_t> system_id_;
+    Column<uint64_t> update_time_ns_;
+    Column<double> latitude_deg_;
+    Column<double> longitude_deg_;
+    Column<float> absolute_altitude_m_;
+    Column<float> relative_altitude_m_;
+    Column<float> north_m_s_;
+    Column<float> east_m_s_;
+    Column<float> down_m_s_;
+    Column<float> roll_deg_;
+    Column<float> pitch_deg_;
+    Column<float> yaw_deg_;
+    Column<float> battery_voltage_v_;
+    Column<float> battery_remaining_percent_;
+};
+
+/**
+ * @brief The two vehicles closest to each other in a snapshot.
+ * Both indices are no_slot and the distance NAN if fewer than two vehicles have a position.
+ */
+struct ClosestPair {
+    size_t first;
+    size_t second;
+    float horizontal_distance_m;
+    float vertical_distance_m;
+    float distance_m;
+};
+
+// Checks all pairs, positions are projected onto a plane around the first vehicle which is
+// accurate enough over the few km a fleet spans.
+ClosestPair find_closest_pair(const FleetSnapshot& snapshot);
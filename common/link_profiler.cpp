@@ -0,0 +1,326 @@
+#include "link_profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using std::chrono::steady_clock;
+
+constexpr size_t LinkProfiler::bucket_count;
+
+namespace {
+
+// Histogram buckets per power of two of the interval in us.
+constexpr unsigned sub_bucket_bits = 3;
+constexpr unsigned sub_buckets = 1u << sub_bucket_bits;
+
+uint64_t message_key(bool outgoing, uint8_t system_id, uint8_t component_id, uint32_t message_id)
+{
+    return (uint64_t(outgoing) << 48) | (uint64_t(system_id) << 40) |
+           (uint64_t(component_id) << 32) | message_id;
+}
+
+uint32_t source_key(bool outgoing, uint8_t system_id, uint8_t component_id)
+{
+    return (uint32_t(outgoing) << 16) | (uint32_t(system_id) << 8) | component_id;
+}
+
+// Size of the message on the wire.
+size_t frame_length(const mavlink_message_t& message)
+{
+    if (message.magic == MAVLINK_STX_MAVLINK1) {
+        return MAVLINK_NUM_NON_PAYLOAD_BYTES - 4 + message.len;
+    }
+    size_t length = MAVLINK_NUM_NON_PAYLOAD_BYTES + message.len;
+    if ((message.incompat_flags & MAVLINK_IFLAG_SIGNED) != 0) {
+        length += MAVLINK_SIGNATURE_BLOCK_LEN;
+    }
+    return length;
+}
+
+const char* direction(bool outgoing)
+{
+    return outgoing ? "out" : "in";
+}
+
+} // namespace
+
+LinkProfiler::LinkProfiler() : start_time_(steady_clock::now()), window_start_time_(start_time_)
+{}
+
+void LinkProfiler::profile(const mavlink_message_t& message, bool outgoing)
+{
+    const uint64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                steady_clock::now().time_since_epoch())
+                                .count();
+    const size_t length = frame_length(message);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto found = messages_.find(
+        message_key(outgoing, message.sysid, message.compid, message.msgid));
+    if (found == messages_.end()) {
+        Message new_message;
+        memset(&new_message, 0, sizeof(new_message));
+        found = messages_
+                    .emplace(
+                        message_key(outgoing, message.sysid, message.compid, message.msgid),
+                        new_message)
+                    .first;
+    }
+    Message& stats = found->second;
+    if (stats.total.count > 0) {
+        const size_t index = bucket((now_ns - stats.last_time_ns) / 1000);
+        ++stats.total.interval_histogram[index];
+        ++stats.window.interval_histogram[index];
+    }
+    stats.last_time_ns = now_ns;
+    ++stats.total.count;
+    ++stats.window.count;
+    stats.total.bytes += length;
+    stats.window.bytes += length;
+
+    // The sequence number counts all messages of a system and component, whatever their id.
+    const uint32_t key = source_key(outgoing, message.sysid, message.compid);
+    auto source = sources_.find(key);
+    if (source == sources_.end()) {
+        source = sources_.emplace(key, Source{message.seq, 0, 0, 0, 0}).first;
+    } else {
+        const uint8_t gap = static_cast<uint8_t>(message.seq - source->second.last_sequence - 1);
+        // A large gap is much more likely a duplicate or a message out of order.
+        if (gap < 128) {
+            source->second.lost_total += gap;
+            source->second.lost_window += gap;
+        }
+        source->second.last_sequence = message.seq;
+    }
+    ++source->second.received_total;
+    ++source->second.received_window;
+}
+
+LinkProfiler::Report LinkProfiler::report()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Report result = make_report(true, window_start_time_);
+
+    for (auto& message : messages_) {
+        memset(&message.second.window, 0, sizeof(message.second.window));
+    }
+    for (auto& source : sources_) {
+        source.second.received_window = 0;
+        source.second.lost_window = 0;
+    }
+    window_start_time_ = steady_clock::now();
+    return result;
+}
+
+LinkProfiler::Report LinkProfiler::totals() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return make_report(false, start_time_);
+}
+
+LinkProfiler::Report
+LinkProfiler::make_report(bool window, steady_clock::time_point since) const
+{
+    Report result{};
+    result.duration_s = std::chrono::duration<double>(steady_clock::now() - since).count();
+
+    for (const auto& entry : messages_) {
+        const Counters& counters = window ? entry.second.window : entry.second.total;
+        if (counters.count == 0) {
+            continue;
+        }
+        MessageStats stats{};
+        stats.outgoing = (entry.first >> 48) != 0;
+        stats.system_id = static_cast<uint8_t>(entry.first >> 40);
+        stats.component_id = static_cast<uint8_t>(entry.first >> 32);
+        stats.message_id = static_cast<uint32_t>(entry.first);
+        stats.count = counters.count;
+        stats.bytes = counters.bytes;
+        if (result.duration_s > 0.0) {
+            stats.rate_hz = counters.count / result.duration_s;
+            stats.bytes_per_s = counters.bytes / result.duration_s;
+        }
+        stats.p50_interval_ms = percentile_ms(counters, 0.5);
+        stats.p99_interval_ms = percentile_ms(counters, 0.99);
+        result.messages.push_back(stats);
+    }
+
+    for (const auto& entry : sources_) {
+        SourceStats stats{};
+        stats.outgoing = (entry.first >> 16) != 0;
+        stats.system_id = static_cast<uint8_t>(entry.first >> 8);
+        stats.component_id = static_cast<uint8_t>(entry.first);
+        stats.received = window ? entry.second.received_window : entry.second.received_total;
+        stats.lost = window ? entry.second.lost_window : entry.second.lost_total;
+        if (stats.received == 0) {
+            continue;
+        }
+        stats.loss_percent = 100.0 * stats.lost / (stats.received + stats.lost);
+        result.sources.push_back(stats);
+    }
+
+    // Hash map order is useless for reading, sort like the keys.
+    std::sort(
+        result.messages.begin(),
+        result.messages.end(),
+        [](const MessageStats& lhs, const MessageStats& rhs) {
+            return message_key(lhs.outgoing, lhs.system_id, lhs.component_id, lhs.message_id) <
+                   message_key(rhs.outgoing, rhs.system_id, rhs.component_id, rhs.message_id);
+        });
+    std::sort(
+        result.sources.begin(),
+        result.sources.end(),
+        [](const SourceStats& lhs, const SourceStats& rhs) {
+            return source_key(lhs.outgoing, lhs.system_id, lhs.component_id) <
+                   source_key(rhs.outgoing, rhs.system_id, rhs.component_id);
+        });
+    return result;
+}
+
+size_t LinkProfiler::bucket(uint64_t interval_us)
+{
+    if (interval_us < sub_buckets) {
+        return static_cast<size_t>(interval_us);
+    }
+    unsigned exponent = 0;
+    while ((interval_us >> exponent) >= 2 * sub_buckets) {
+        ++exponent;
+    }
+    // The top bits below the leading one select the bucket within the power of two.
+    const size_t index = (exponent + 1) * sub_buckets + ((interval_us >> exponent) - sub_buckets);
+    return std::min(index, bucket_count - 1);
+}
+
+double LinkProfiler::bucket_value_us(size_t index)
+{
+    if (index < sub_buckets) {
+        return static_cast<double>(index);
+    }
+    const unsigned exponent = static_cast<unsigned>(index / sub_buckets) - 1;
+    const double lower = static_cast<double>((sub_buckets + index % sub_buckets) << exponent);
+    // The middle of the bucket.
+    return lower + static_cast<double>(1ull << exponent) / 2.0;
+}
+
+double LinkProfiler::percentile_ms(const Counters& counters, double fraction)
+{
+    uint64_t intervals = 0;
+    for (size_t i = 0; i < bucket_count; ++i) {
+        intervals += counters.interval_histogram[i];
+    }
+    if (intervals == 0) {
+        return NAN;
+    }
+
+    const uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * intervals));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucket_count; ++i) {
+        seen += counters.interval_histogram[i];
+        if (seen >= rank) {
+            return bucket_value_us(i) / 1000.0;
+        }
+    }
+    return bucket_value_us(bucket_count - 1) / 1000.0;
+}
+
+std::string LinkProfiler::to_string(const Report& report)
+{
+    std::string result;
+    char line[160];
+
+    snprintf(
+        line,
+        sizeof(line),
+        "Link over %.1f s\n%-4s %4s %5s %7s %8s %8s %10s %9s %9s\n",
+        report.duration_s,
+        "dir",
+        "sys",
+        "comp",
+        "msgid",
+        "count",
+        "Hz",
+        "bytes/s",
+        "p50 ms",
+        "p99 ms");
+    result += line;
+    for (const auto& stats : report.messages) {
+        snprintf(
+            line,
+            sizeof(line),
+            "%-4s %4d %5d %7u %8llu %8.1f %10.1f %9.2f %9.2f\n",
+            direction(stats.outgoing),
+            int(stats.system_id),
+            int(stats.component_id),
+            stats.message_id,
+            static_cast<unsigned long long>(stats.count),
+            stats.rate_hz,
+            stats.bytes_per_s,
+            stats.p50_interval_ms,
+            stats.p99_interval_ms);
+        result += line;
+    }
+    for (const auto& stats : report.sources) {
+        snprintf(
+            line,
+            sizeof(line),
+            "%-4s %4d %5d lost %llu of %llu (%.2f %%)\n",
+            direction(stats.outgoing),
+            int(stats.system_id),
+            int(stats.component_id),
+            static_cast<unsigned long long>(stats.lost),
+            static_cast<unsigned long long>(stats.lost + stats.received),
+            stats.loss_percent);
+        result += line;
+    }
+    return result;
+}
+
+std::string LinkProfiler::to_json(const Report& report)
+{
+    // NAN is not valid JSON.
+    auto number = [](double value) {
+        char buffer[32];
+        if (std::isfinite(value)) {
+            snprintf(buffer, sizeof(buffer), "%.3f", value);
+        } else {
+            snprintf(buffer, sizeof(buffer), "null");
+        }
+        return std::string(buffer);
+    };
+
+    std::string result = "{\n  \"duration_s\": " + number(report.duration_s) + ",\n";
+
+    result += "  \"messages\": [";
+    for (size_t i = 0; i < report.messages.size(); ++i) {
+        const MessageStats& stats = report.messages[i];
+        result += (i == 0) ? "\n" : ",\n";
+        result += std::string("    {\"direction\": \"") + direction(stats.outgoing) + "\"" +
+                  ", \"system_id\": " + std::to_string(stats.system_id) +
+                  ", \"component_id\": " + std::to_string(stats.component_id) +
+                  ", \"message_id\": " + std::to_string(stats.message_id) +
+                  ", \"count\": " + std::to_string(stats.count) +
+                  ", \"bytes\": " + std::to_string(stats.bytes) +
+                  ", \"rate_hz\": " + number(stats.rate_hz) +
+                  ", \"bytes_per_s\": " + number(stats.bytes_per_s) +
+                  ", \"p50_interval_ms\": " + number(stats.p50_interval_ms) +
+                  ", \"p99_interval_ms\": " + number(stats.p99_interval_ms) + "}";
+    }
+    result += "\n  ],\n";
+
+    result += "  \"sources\": [";
+    for (size_t i = 0; i < report.sources.size(); ++i) {
+        const SourceStats& stats = report.sources[i];
+        result += (i == 0) ? "\n" : ",\n";
+        result += std::string("    {\"direction\": \"") + direction(stats.outgoing) + "\"" +
+                  ", \"system_id\": " + std::to_string(stats.system_id) +
+                  ", \"component_id\": " + std::to_string(stats.component_id) +
+                  ", \"received\": " + std::to_string(stats.received) +
+                  ", \"lost\": " + std::to_string(stats.lost) +
+                  ", \"loss_percent\": " + number(stats.loss_percent) + "}";
+    }
+    result += "\n  ]\n}\n";
+    return result;
+}
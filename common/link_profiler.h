@@ -0,0 +1,105 @@
+#pragma once
+
+#include <mavsdk/plugins/mavlink_passthrough/mavlink_passthrough.h>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief The LinkProfiler class
+ * Live statistics of the MAVLink traffic per direction, system, component and message id:
+ * counts, bytes/s and the median and 99th percentile of the time between messages. Lost
+ * messages are counted from gaps in the sequence numbers of every system and component.
+ * Feed it every message with a MavlinkTap.
+ *
+ * Intervals are kept in histograms with 8 buckets per power of two, so percentiles are
+ * accurate to about 6 % and the memory does not grow with the traffic.
+ */
+class LinkProfiler {
+public:
+    struct MessageStats {
+        bool outgoing;
+        uint8_t system_id;
+        uint8_t component_id;
+        uint32_t message_id;
+        uint64_t count;
+        uint64_t bytes;
+        double rate_hz;
+        double bytes_per_s;
+        // NAN with fewer than two messages.
+        double p50_interval_ms;
+        double p99_interval_ms;
+    };
+
+    struct SourceStats {
+        bool outgoing;
+        uint8_t system_id;
+        uint8_t component_id;
+        uint64_t received;
+        uint64_t lost;
+        double loss_percent;
+    };
+
+    struct Report {
+        double duration_s;
+        std::vector<MessageStats> messages;
+        std::vector<SourceStats> sources;
+    };
+
+    LinkProfiler();
+
+    LinkProfiler(const LinkProfiler&) = delete;
+    LinkProfiler& operator=(const LinkProfiler&) = delete;
+
+    // Thread safe.
+    void profile(const mavlink_message_t& message, bool outgoing);
+
+    // Since the last call of report(), or since the start for the first one.
+    Report report();
+
+    // Since the start.
+    Report totals() const;
+
+    static std::string to_string(const Report& report);
+
+    static std::string to_json(const Report& report);
+
+private:
+    static constexpr size_t bucket_count = 272;
+
+    struct Counters {
+        uint64_t count;
+        uint64_t bytes;
+        uint32_t interval_histogram[bucket_count];
+    };
+
+    struct Message {
+        uint64_t last_time_ns;
+        Counters total;
+        Counters window;
+    };
+
+    struct Source {
+        uint8_t last_sequence;
+        uint64_t received_total;
+        uint64_t lost_total;
+        uint64_t received_window;
+        uint64_t lost_window;
+    };
+
+    static size_t bucket(uint64_t interval_us);
+    static double bucket_value_us(size_t bucket);
+    static double percentile_ms(const Counters& counters, double fraction);
+
+    Report make_report(bool window, std::chrono::steady_clock::time_point since) const;
+
+    const std::chrono::steady_clock::time_point start_time_;
+
+    mutable std::mutex mutex_{};
+    std::unordered_map<uint64_t, Message> messages_{};
+    std::unordered_map<uint32_t, Source> sources_{};
+    std::chrono::steady_clock::time_point window_start_time_;
+};
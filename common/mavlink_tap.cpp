@@ -0,0 +1,32 @@
+#include "mavlink_tap.h"
+#include <utility>
+
+using namespace mavsdk;
+
+MavlinkTap::MavlinkTap(MavlinkPassthrough& mavlink_passthrough, std::vector<observer_t> observers) :
+    mavlink_passthrough_(mavlink_passthrough),
+    observers_(std::move(observers))
+{
+    // Returning true lets the message pass on as usual.
+    mavlink_passthrough_.intercept_incoming_messages_async([this](mavlink_message_t& message) {
+        notify(message, false);
+        return true;
+    });
+    mavlink_passthrough_.intercept_outgoing_messages_async([this](mavlink_message_t& message) {
+        notify(message, true);
+        return true;
+    });
+}
+
+MavlinkTap::~MavlinkTap()
+{
+    mavlink_passthrough_.intercept_incoming_messages_async(nullptr);
+    mavlink_passthrough_.intercept_outgoing_messages_async(nullptr);
+}
+
+void MavlinkTap::notify(const mavlink_message_t& message, bool outgoing) const
+{
+    for (const auto& observer : observers_) {
+        observer(message, outgoing);
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <mavsdk/plugins/mavlink_passthrough/mavlink_passthrough.h>
+#include <functional>
+#include <vector>
+
+/**
+ * @brief The MavlinkTap class
+ * Shows every MAVLink message MAVSDK receives or sends to a list of observers, e.g. a
+ * TlogCapture and a LinkProfiler at the same time. The passthrough only takes one
+ * intercept callback per direction, so they can't each install their own.
+ *
+ * Observers are called on the MAVSDK threads and must be quick. Takes over the incoming
+ * and outgoing message intercepts of the passthrough while it exists.
+ */
+class MavlinkTap {
+public:
+    typedef std::function<void(const mavlink_message_t& message, bool outgoing)> observer_t;
+
+    // The observers are fixed so the callbacks can run through them without locking.
+    MavlinkTap(mavsdk::MavlinkPassthrough& mavlink_passthrough, std::vector<observer_t> observers);
+
+    ~MavlinkTap();
+
+    MavlinkTap(const MavlinkTap&) = delete;
+    MavlinkTap& operator=(const MavlinkTap&) = delete;
+
+private:
+    void notify(const mavlink_message_t& message, bool outgoing) const;
+
+    mavsdk::MavlinkPassthrough& mavlink_passthrough_;
+    const std::vector<observer_t> observers_;
+};
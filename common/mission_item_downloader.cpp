@@ -0,0 +1,252 @@
+#include "mission_item_downloader.h"
+#include <utility>
+
+using namespace mavsdk;
+using std::chrono::steady_clock;
+
+constexpr std::chrono::milliseconds MissionItemDownloader::default_timeout;
+constexpr unsigned MissionItemDownloader::default_max_retries;
+
+MissionItemDownloader::MissionItemDownloader(
+    FleetExecutor& executor,
+    std::shared_ptr<MavlinkPassthrough> mavlink_passthrough,
+    std::chrono::milliseconds timeout,
+    unsigned max_retries) :
+    executor_(executor),
+    mavlink_passthrough_(mavlink_passthrough),
+    timeout_(timeout),
+    max_retries_(max_retries)
+{
+    mavlink_passthrough_->subscribe_message_async(
+        MAVLINK_MSG_ID_MISSION_COUNT,
+        [this](const mavlink_message_t& message) { handle_count(message); });
+    mavlink_passthrough_->subscribe_message_async(
+        MAVLINK_MSG_ID_MISSION_ITEM_INT,
+        [this](const mavlink_message_t& message) { handle_item(message); });
+}
+
+MissionItemDownloader::~MissionItemDownloader()
+{
+    mavlink_passthrough_->subscribe_message_async(MAVLINK_MSG_ID_MISSION_COUNT, nullptr);
+    mavlink_passthrough_->subscribe_message_async(MAVLINK_MSG_ID_MISSION_ITEM_INT, nullptr);
+}
+
+void MissionItemDownloader::download_async(items_callback_t callback)
+{
+    start(std::move(callback), nullptr);
+}
+
+void MissionItemDownloader::download_count_async(count_callback_t callback)
+{
+    start(nullptr, std::move(callback));
+}
+
+MissionItemDownloader::Stats MissionItemDownloader::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void MissionItemDownloader::start(items_callback_t items_callback, count_callback_t count_callback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (active_) {
+        executor_.post([items_callback, count_callback]() {
+            if (items_callback) {
+                items_callback(Mission::Result::Busy, {});
+            } else {
+                count_callback(Mission::Result::Busy, 0);
+            }
+        });
+        return;
+    }
+
+    active_ = true;
+    items_callback_ = std::move(items_callback);
+    count_callback_ = std::move(count_callback);
+    count_ = -1;
+    items_.clear();
+    ++stats_.downloads;
+
+    send_request_list();
+    restart_timeout();
+}
+
+void MissionItemDownloader::handle_count(const mavlink_message_t& message)
+{
+    mavlink_mission_count_t count;
+    mavlink_msg_mission_count_decode(&message, &count);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!active_ || count_ >= 0 || message.sysid != mavlink_passthrough_->get_target_sysid() ||
+        count.target_system != mavlink_passthrough_->get_our_sysid() ||
+        count.mission_type != MAV_MISSION_TYPE_MISSION) {
+        return;
+    }
+
+    count_ = count.count;
+    if (count_callback_) {
+        // The vehicle waits for the first request otherwise, until it times out.
+        send_ack(MAV_MISSION_OPERATION_CANCELLED);
+        finish(Mission::Result::Success);
+        return;
+    }
+    if (count_ == 0) {
+        send_ack(MAV_MISSION_ACCEPTED);
+        finish(Mission::Result::Success);
+        return;
+    }
+
+    items_.reserve(count.count);
+    send_request(0);
+    restart_timeout();
+}
+
+void MissionItemDownloader::handle_item(const mavlink_message_t& message)
+{
+    mavlink_mission_item_int_t item;
+    mavlink_msg_mission_item_int_decode(&message, &item);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Duplicates of an item we already have are answers to a repeated request.
+    if (!active_ || count_ < 0 || message.sysid != mavlink_passthrough_->get_target_sysid() ||
+        item.target_system != mavlink_passthrough_->get_our_sysid() ||
+        item.mission_type != MAV_MISSION_TYPE_MISSION || item.seq != items_.size()) {
+        return;
+    }
+
+    items_.push_back(item);
+    ++stats_.items_received;
+    if (items_.size() == static_cast<size_t>(count_)) {
+        send_ack(MAV_MISSION_ACCEPTED);
+        finish(Mission::Result::Success);
+        return;
+    }
+
+    send_request(static_cast<uint16_t>(items_.size()));
+    restart_timeout();
+}
+
+void MissionItemDownloader::on_timer()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    timer_pending_ = false;
+    if (!active_) {
+        return;
+    }
+
+    // Every answer of the vehicle moves the deadline, the timer only follows it.
+    const auto now = steady_clock::now();
+    if (now < deadline_) {
+        timer_pending_ = true;
+        auto self = shared_from_this();
+        executor_.post_at(deadline_, [self]() { self->on_timer(); });
+        return;
+    }
+
+    if (retries_left_ == 0) {
+        finish(Mission::Result::Timeout);
+        return;
+    }
+    --retries_left_;
+    deadline_ = now + timeout_;
+
+    ++stats_.retransmissions;
+    if (count_ < 0) {
+        send_request_list();
+    } else {
+        send_request(static_cast<uint16_t>(items_.size()));
+    }
+
+    timer_pending_ = true;
+    auto self = shared_from_this();
+    executor_.post_at(deadline_, [self]() { self->on_timer(); });
+}
+
+void MissionItemDownloader::send_request_list()
+{
+    mavlink_mission_request_list_t request_list{};
+    request_list.target_system = mavlink_passthrough_->get_target_sysid();
+    request_list.target_component = mavlink_passthrough_->get_target_compid();
+    request_list.mission_type = MAV_MISSION_TYPE_MISSION;
+
+    mavlink_message_t message;
+    mavlink_msg_mission_request_list_encode(
+        mavlink_passthrough_->get_our_sysid(),
+        mavlink_passthrough_->get_our_compid(),
+        &message,
+        &request_list);
+    mavlink_passthrough_->send_message(message);
+}
+
+void MissionItemDownloader::send_request(uint16_t seq)
+{
+    mavlink_mission_request_int_t request{};
+    request.seq = seq;
+    request.target_system = mavlink_passthrough_->get_target_sysid();
+    request.target_component = mavlink_passthrough_->get_target_compid();
+    request.mission_type = MAV_MISSION_TYPE_MISSION;
+
+    mavlink_message_t message;
+    mavlink_msg_mission_request_int_encode(
+        mavlink_passthrough_->get_our_sysid(),
+        mavlink_passthrough_->get_our_compid(),
+        &message,
+        &request);
+    mavlink_passthrough_->send_message(message);
+}
+
+void MissionItemDownloader::send_ack(uint8_t type)
+{
+    mavlink_mission_ack_t ack{};
+    ack.target_system = mavlink_passthrough_->get_target_sysid();
+    ack.target_component = mavlink_passthrough_->get_target_compid();
+    ack.type = type;
+    ack.mission_type = MAV_MISSION_TYPE_MISSION;
+
+    mavlink_message_t message;
+    mavlink_msg_mission_ack_encode(
+        mavlink_passthrough_->get_our_sysid(),
+        mavlink_passthrough_->get_our_compid(),
+        &message,
+        &ack);
+    mavlink_passthrough_->send_message(message);
+}
+
+void MissionItemDownloader::restart_timeout()
+{
+    retries_left_ = max_retries_;
+    deadline_ = steady_clock::now() + timeout_;
+    if (!timer_pending_) {
+        timer_pending_ = true;
+        auto self = shared_from_this();
+        executor_.post_at(deadline_, [self]() { self->on_timer(); });
+    }
+}
+
+void MissionItemDownloader::finish(Mission::Result result)
+{
+    active_ = false;
+
+    // Not from the MAVSDK callback thread, like the uploader.
+    if (count_callback_) {
+        count_callback_t callback;
+        std::swap(callback, count_callback_);
+        const uint16_t count = static_cast<uint16_t>(count_ < 0 ? 0 : count_);
+        executor_.post([callback, result, count]() { callback(result, count); });
+        return;
+    }
+
+    items_callback_t callback;
+    std::swap(callback, items_callback_);
+    std::vector<mavlink_mission_item_int_t> items;
+    if (result == Mission::Result::Success) {
+        std::swap(items, items_);
+    }
+    items_.clear();
+    // Moved into the task, C++11 lambdas can only copy.
+    auto shared_items =
+        std::make_shared<std::vector<mavlink_mission_item_int_t>>(std::move(items));
+    executor_.post(
+        [callback, result, shared_items]() { callback(result, std::move(*shared_items)); });
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <mavsdk/plugins/mavlink_passthrough/mavlink_passthrough.h>
+#include <mavsdk/plugins/mission/mission.h>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "fleet_executor.h"
+
+/**
+ * @brief The MissionItemDownloader class
+ * Downloads the mission of one vehicle as raw MISSION_ITEM_INT items through the
+ * passthrough, the counterpart of MissionItemUploader. The items are not converted to
+ * Mission::MissionItem, so they can be compared with an EncodedMission as they are.
+ *
+ * Timeouts run on a FleetExecutor. Create it with std::make_shared, a pending timeout
+ * keeps it alive.
+ *
+ * Takes over the MISSION_COUNT and MISSION_ITEM_INT subscriptions of the passthrough
+ * while it exists. It can share the passthrough with a MissionItemUploader.
+ */
+class MissionItemDownloader : public std::enable_shared_from_this<MissionItemDownloader> {
+public:
+    typedef std::function<void(mavsdk::Mission::Result, std::vector<mavlink_mission_item_int_t>)>
+        items_callback_t;
+    typedef std::function<void(mavsdk::Mission::Result, uint16_t)> count_callback_t;
+
+    struct Stats {
+        unsigned downloads;
+        unsigned items_received;
+        // Requests sent again after a timeout.
+        unsigned retransmissions;
+    };
+
+    static constexpr std::chrono::milliseconds default_timeout{1000};
+    static constexpr unsigned default_max_retries = 5;
+
+    MissionItemDownloader(
+        FleetExecutor& executor,
+        std::shared_ptr<mavsdk::MavlinkPassthrough> mavlink_passthrough,
+        std::chrono::milliseconds timeout = default_timeout,
+        unsigned max_retries = default_max_retries);
+
+    ~MissionItemDownloader();
+
+    MissionItemDownloader(const MissionItemDownloader&) = delete;
+    MissionItemDownloader& operator=(const MissionItemDownloader&) = delete;
+
+    // The callbacks are called on an executor thread. Busy if a download is still running.
+    void download_async(items_callback_t callback);
+
+    // Only asks for the number of items and cancels the transfer then, one round trip.
+    void download_count_async(count_callback_t callback);
+
+    Stats stats() const;
+
+private:
+    // Exactly one of the callbacks is set.
+    void start(items_callback_t items_callback, count_callback_t count_callback);
+    void handle_count(const mavlink_message_t& message);
+    void handle_item(const mavlink_message_t& message);
+    void on_timer();
+
+    // The functions below are called with the mutex locked.
+    void send_request_list();
+    void send_request(uint16_t seq);
+    void send_ack(uint8_t type);
+    void restart_timeout();
+    void finish(mavsdk::Mission::Result result);
+
+    FleetExecutor& executor_;
+    std::shared_ptr<mavsdk::MavlinkPassthrough> mavlink_passthrough_;
+    const std::chrono::milliseconds timeout_;
+    const unsigned max_retries_;
+
+    mutable std::mutex mutex_{};
+    bool active_{false};
+    items_callback_t items_callback_{};
+    count_callback_t count_callback_{};
+    // -1 until the vehicle sent the count.
+    int32_t count_{-1};
+    std::vector<mavlink_mission_item_int_t> items_{};
+    unsigned retries_left_{0};
+    FleetExecutor::time_point deadline_{};
+    bool timer_pending_{false};
+    Stats stats_{};
+};
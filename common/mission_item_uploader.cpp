@@ -0,0 +1,349 @@
+#include "mission_item_uploader.h"
+#include <algorithm>
+#include <utility>
+
+using namespace mavsdk;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+constexpr std::chrono::milliseconds MissionItemUploader::default_timeout;
+constexpr unsigned MissionItemUploader::default_max_retries;
+constexpr std::chrono::milliseconds MissionItemUploader::min_timeout;
+constexpr std::chrono::milliseconds MissionItemUploader::max_timeout;
+
+MissionItemUploader::MissionItemUploader(
+    FleetExecutor& executor,
+    std::shared_ptr<MavlinkPassthrough> mavlink_passthrough,
+    std::chrono::milliseconds timeout,
+    unsigned max_retries) :
+    executor_(executor),
+    mavlink_passthrough_(mavlink_passthrough),
+    timeout_(timeout),
+    max_retries_(max_retries),
+    current_timeout_(timeout)
+{
+    mavlink_passthrough_->subscribe_message_async(
+        MAVLINK_MSG_ID_MISSION_REQUEST_INT,
+        [this](const mavlink_message_t& message) { handle_request(message, true); });
+    mavlink_passthrough_->subscribe_message_async(
+        MAVLINK_MSG_ID_MISSION_REQUEST,
+        [this](const mavlink_message_t& message) { handle_request(message, false); });
+    mavlink_passthrough_->subscribe_message_async(
+        MAVLINK_MSG_ID_MISSION_ACK,
+        [this](const mavlink_message_t& message) { handle_ack(message); });
+}
+
+MissionItemUploader::~MissionItemUploader()
+{
+    mavlink_passthrough_->subscribe_message_async(MAVLINK_MSG_ID_MISSION_REQUEST_INT, nullptr);
+    mavlink_passthrough_->subscribe_message_async(MAVLINK_MSG_ID_MISSION_REQUEST, nullptr);
+    mavlink_passthrough_->subscribe_message_async(MAVLINK_MSG_ID_MISSION_ACK, nullptr);
+}
+
+void MissionItemUploader::upload_async(
+    std::shared_ptr<const EncodedMission> mission, result_callback_t callback)
+{
+    const uint16_t last_seq =
+        mission->items.empty() ? 0 : static_cast<uint16_t>(mission->items.size() - 1);
+    start(std::move(mission), 0, last_seq, false, std::move(callback));
+}
+
+void MissionItemUploader::upload_partial_async(
+    std::shared_ptr<const EncodedMission> mission,
+    uint16_t first_seq,
+    uint16_t last_seq,
+    result_callback_t callback)
+{
+    if (first_seq > last_seq || last_seq >= mission->items.size()) {
+        executor_.post([callback]() { callback(Mission::Result::InvalidArgument); });
+        return;
+    }
+    start(std::move(mission), first_seq, last_seq, true, std::move(callback));
+}
+
+MissionItemUploader::Stats MissionItemUploader::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.smoothed_rtt = smoothed_rtt_;
+    stats.timeout = duration_cast<std::chrono::milliseconds>(current_timeout_);
+    return stats;
+}
+
+void MissionItemUploader::set_adaptive_timeout(bool adaptive)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    adaptive_ = adaptive;
+    if (!adaptive_) {
+        current_timeout_ = timeout_;
+    }
+}
+
+MavlinkPassthrough::Result
+MissionItemUploader::start_mission(MavlinkPassthrough& mavlink_passthrough)
+{
+    MavlinkPassthrough::CommandLong command{};
+    command.target_sysid = mavlink_passthrough.get_target_sysid();
+    command.target_compid = mavlink_passthrough.get_target_compid();
+    command.command = MAV_CMD_MISSION_START;
+    return mavlink_passthrough.send_command_long(command);
+}
+
+void MissionItemUploader::start(
+    std::shared_ptr<const EncodedMission> mission,
+    uint16_t first_seq,
+    uint16_t last_seq,
+    bool partial,
+    result_callback_t callback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (active_) {
+        executor_.post([callback]() { callback(Mission::Result::Busy); });
+        return;
+    }
+
+    active_ = true;
+    mission_ = std::move(mission);
+    callback_ = std::move(callback);
+    partial_ = partial;
+    first_seq_ = first_seq;
+    last_seq_ = last_seq;
+    last_requested_seq_ = -1;
+    highest_sent_seq_ = -1;
+    // The count of a new upload is no repetition of whatever the last one sent.
+    measuring_ = false;
+    ambiguous_answer_seq_ = -1;
+    ++stats_.uploads;
+
+    send_count();
+    restart_timeout();
+}
+
+void MissionItemUploader::handle_request(const mavlink_message_t& message, bool is_int)
+{
+    // MISSION_REQUEST and MISSION_REQUEST_INT share the same fields. Either way the item
+    // goes out as MISSION_ITEM_INT, which is all the cache has.
+    mavlink_mission_request_int_t request;
+    if (is_int) {
+        mavlink_msg_mission_request_int_decode(&message, &request);
+    } else {
+        mavlink_mission_request_t request_float;
+        mavlink_msg_mission_request_decode(&message, &request_float);
+        request.seq = request_float.seq;
+        request.target_system = request_float.target_system;
+        request.target_component = request_float.target_component;
+        request.mission_type = request_float.mission_type;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!active_ || message.sysid != mavlink_passthrough_->get_target_sysid() ||
+        request.target_system != mavlink_passthrough_->get_our_sysid() ||
+        request.mission_type != MAV_MISSION_TYPE_MISSION ||
+        request.seq >= mission_->items.size() || request.seq < first_seq_ ||
+        request.seq > last_seq_) {
+        return;
+    }
+
+    finish_rtt_measurement(request.seq);
+    last_requested_seq_ = request.seq;
+    send_item(request.seq);
+    restart_timeout();
+}
+
+void MissionItemUploader::handle_ack(const mavlink_message_t& message)
+{
+    mavlink_mission_ack_t ack;
+    mavlink_msg_mission_ack_decode(&message, &ack);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!active_ || message.sysid != mavlink_passthrough_->get_target_sysid() ||
+        ack.target_system != mavlink_passthrough_->get_our_sysid() ||
+        ack.mission_type != MAV_MISSION_TYPE_MISSION) {
+        return;
+    }
+
+    switch (ack.type) {
+        case MAV_MISSION_ACCEPTED:
+            finish_rtt_measurement(last_seq_ + 1);
+            finish(Mission::Result::Success);
+            break;
+        case MAV_MISSION_NO_SPACE:
+            finish(Mission::Result::TooManyMissionItems);
+            break;
+        case MAV_MISSION_UNSUPPORTED:
+            finish(Mission::Result::Unsupported);
+            break;
+        case MAV_MISSION_OPERATION_CANCELLED:
+            finish(Mission::Result::TransferCancelled);
+            break;
+        default:
+            finish(Mission::Result::Error);
+            break;
+    }
+}
+
+void MissionItemUploader::on_timer()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    timer_pending_ = false;
+    if (!active_) {
+        return;
+    }
+
+    // Every answer of the vehicle moves the deadline, the timer only follows it.
+    const auto now = steady_clock::now();
+    if (now < deadline_) {
+        timer_pending_ = true;
+        auto self = shared_from_this();
+        executor_.post_at(deadline_, [self]() { self->on_timer(); });
+        return;
+    }
+
+    if (retries_left_ == 0) {
+        finish(Mission::Result::Timeout);
+        return;
+    }
+    --retries_left_;
+    ++stats_.timeouts;
+    if (adaptive_) {
+        current_timeout_ = std::min<microseconds>(2 * current_timeout_, max_timeout);
+    }
+    deadline_ = now + current_timeout_;
+
+    // Until the first request, the vehicle might not have the count.
+    if (last_requested_seq_ < 0) {
+        send_count();
+        ++stats_.retransmissions;
+    } else {
+        send_item(static_cast<uint16_t>(last_requested_seq_));
+    }
+
+    timer_pending_ = true;
+    auto self = shared_from_this();
+    executor_.post_at(deadline_, [self]() { self->on_timer(); });
+}
+
+void MissionItemUploader::send_count()
+{
+    start_rtt_measurement(first_seq_);
+
+    mavlink_message_t message;
+    if (partial_) {
+        mavlink_mission_write_partial_list_t write_partial_list{};
+        write_partial_list.start_index = static_cast<int16_t>(first_seq_);
+        write_partial_list.end_index = static_cast<int16_t>(last_seq_);
+        write_partial_list.target_system = mavlink_passthrough_->get_target_sysid();
+        write_partial_list.target_component = mavlink_passthrough_->get_target_compid();
+        write_partial_list.mission_type = MAV_MISSION_TYPE_MISSION;
+        mavlink_msg_mission_write_partial_list_encode(
+            mavlink_passthrough_->get_our_sysid(),
+            mavlink_passthrough_->get_our_compid(),
+            &message,
+            &write_partial_list);
+        mavlink_passthrough_->send_message(message);
+        return;
+    }
+
+    mavlink_mission_count_t count{};
+    count.count = static_cast<uint16_t>(mission_->items.size());
+    count.target_system = mavlink_passthrough_->get_target_sysid();
+    count.target_component = mavlink_passthrough_->get_target_compid();
+    count.mission_type = MAV_MISSION_TYPE_MISSION;
+    mavlink_msg_mission_count_encode(
+        mavlink_passthrough_->get_our_sysid(),
+        mavlink_passthrough_->get_our_compid(),
+        &message,
+        &count);
+    mavlink_passthrough_->send_message(message);
+}
+
+void MissionItemUploader::send_item(uint16_t seq)
+{
+    start_rtt_measurement(seq + 1);
+
+    mavlink_message_t message;
+    MissionPacketCache::address_item(
+        mission_->items[seq],
+        mavlink_passthrough_->get_our_sysid(),
+        mavlink_passthrough_->get_our_compid(),
+        mavlink_passthrough_->get_target_sysid(),
+        mavlink_passthrough_->get_target_compid(),
+        message);
+    mavlink_passthrough_->send_message(message);
+
+    ++stats_.items_sent;
+    if (static_cast<int32_t>(seq) <= highest_sent_seq_) {
+        ++stats_.retransmissions;
+    } else {
+        highest_sent_seq_ = seq;
+    }
+}
+
+void MissionItemUploader::start_rtt_measurement(int32_t answer_seq)
+{
+    // Karn's algorithm: when a message is sent again, its answer can't be assigned to
+    // any of the copies, however often it is repeated.
+    if (answer_seq == ambiguous_answer_seq_) {
+        return;
+    }
+    if (measuring_ && answer_seq == expected_answer_seq_) {
+        measuring_ = false;
+        ambiguous_answer_seq_ = answer_seq;
+        return;
+    }
+    ambiguous_answer_seq_ = -1;
+    expected_answer_seq_ = answer_seq;
+    measurement_start_ = steady_clock::now();
+    measuring_ = true;
+}
+
+void MissionItemUploader::finish_rtt_measurement(int32_t answer_seq)
+{
+    if (!measuring_ || answer_seq != expected_answer_seq_ ||
+        answer_seq == ambiguous_answer_seq_) {
+        return;
+    }
+    measuring_ = false;
+
+    const microseconds rtt = duration_cast<microseconds>(steady_clock::now() - measurement_start_);
+    if (smoothed_rtt_.count() == 0) {
+        smoothed_rtt_ = rtt;
+        rtt_variation_ = rtt / 2;
+    } else {
+        const microseconds deviation =
+            (rtt > smoothed_rtt_) ? rtt - smoothed_rtt_ : smoothed_rtt_ - rtt;
+        rtt_variation_ = (3 * rtt_variation_ + deviation) / 4;
+        smoothed_rtt_ = (7 * smoothed_rtt_ + rtt) / 8;
+    }
+
+    if (adaptive_) {
+        // On a steady link the variation goes to zero, and every late answer would be a
+        // timeout. Like the clock granularity in RFC 6298, the margin has a minimum.
+        const microseconds margin = std::max<microseconds>(4 * rtt_variation_, smoothed_rtt_ / 2);
+        current_timeout_ = std::min<microseconds>(
+            std::max<microseconds>(smoothed_rtt_ + margin, min_timeout), max_timeout);
+    }
+}
+
+void MissionItemUploader::restart_timeout()
+{
+    retries_left_ = max_retries_;
+    deadline_ = steady_clock::now() + current_timeout_;
+    if (!timer_pending_) {
+        timer_pending_ = true;
+        auto self = shared_from_this();
+        executor_.post_at(deadline_, [self]() { self->on_timer(); });
+    }
+}
+
+void MissionItemUploader::finish(Mission::Result result)
+{
+    active_ = false;
+    mission_.reset();
+
+    // Not from the MAVSDK callback thread: the callback may well start the next upload.
+    result_callback_t callback;
+    std::swap(callback, callback_);
+    executor_.post([callback, result]() { callback(result); });
+}
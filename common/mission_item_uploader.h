@@ -0,0 +1,147 @@
+#pragma once
+
+#include <mavsdk/plugins/mavlink_passthrough/mavlink_passthrough.h>
+#include <mavsdk/plugins/mission/mission.h>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "fleet_executor.h"
+#include "mission_packet_cache.h"
+
+/**
+ * @brief The MissionItemUploader class
+ * Uploads an EncodedMission to one vehicle with the MAVLink mission protocol, through the
+ * passthrough instead of the Mission plugin: the vehicle requests the items one by one
+ * and every item is only addressed to the vehicle before it is sent.
+ *
+ * Timeouts run on a FleetExecutor, there is no thread per vehicle. Create it with
+ * std::make_shared, a pending timeout keeps it alive.
+ *
+ * After a timeout only what the vehicle is missing is sent again: the count until the
+ * first request, then the last requested item. The transfer is never started over, PX4
+ * would drop the items it already has on a new count. The timeout follows the round trip
+ * time like the TCP retransmission timer (RFC 6298): the smoothed round trip time plus
+ * four times its variation, or at least half of it again, doubled with every timeout in
+ * a row. Only answers to messages which were sent once are measured, the time of a
+ * repeated one is ambiguous.
+ *
+ * The Mission plugin doesn't know about missions uploaded this way, so its mission
+ * progress and is_mission_finished() can't be used for them. MISSION_CURRENT and
+ * MISSION_ITEM_REACHED give the same information, see
+ * EncodedMission::mission_item_indices.
+ *
+ * Takes over the MISSION_REQUEST, MISSION_REQUEST_INT and MISSION_ACK subscriptions of
+ * the passthrough while it exists.
+ */
+class MissionItemUploader : public std::enable_shared_from_this<MissionItemUploader> {
+public:
+    typedef std::function<void(mavsdk::Mission::Result)> result_callback_t;
+
+    struct Stats {
+        unsigned uploads;
+        unsigned items_sent;
+        // Counts and items sent again, after a timeout or because the vehicle asked twice.
+        unsigned retransmissions;
+        unsigned timeouts;
+        // Zero until the first answer was measured.
+        std::chrono::microseconds smoothed_rtt;
+        std::chrono::milliseconds timeout;
+    };
+
+    // Without an answer from the vehicle, the last message is sent again after the
+    // timeout, at most max_retries times in a row. The timeout given to the constructor
+    // is only used until the round trip time is measured.
+    static constexpr std::chrono::milliseconds default_timeout{1000};
+    static constexpr unsigned default_max_retries = 5;
+    static constexpr std::chrono::milliseconds min_timeout{100};
+    static constexpr std::chrono::milliseconds max_timeout{10000};
+
+    MissionItemUploader(
+        FleetExecutor& executor,
+        std::shared_ptr<mavsdk::MavlinkPassthrough> mavlink_passthrough,
+        std::chrono::milliseconds timeout = default_timeout,
+        unsigned max_retries = default_max_retries);
+
+    ~MissionItemUploader();
+
+    MissionItemUploader(const MissionItemUploader&) = delete;
+    MissionItemUploader& operator=(const MissionItemUploader&) = delete;
+
+    // The callback is called on an executor thread. Busy if an upload is still running.
+    void upload_async(std::shared_ptr<const EncodedMission> mission, result_callback_t callback);
+
+    // Only replaces the items first_seq to last_seq of a mission with the same number of
+    // items on the vehicle, with MISSION_WRITE_PARTIAL_LIST. Not every autopilot supports
+    // that, PX4 doesn't answer at all and the upload ends with a timeout.
+    void upload_partial_async(
+        std::shared_ptr<const EncodedMission> mission,
+        uint16_t first_seq,
+        uint16_t last_seq,
+        result_callback_t callback);
+
+    Stats stats() const;
+
+    // On by default. Without it, every timeout is the one given to the constructor, the
+    // same as before the round trip time was measured, e.g. for comparisons.
+    void set_adaptive_timeout(bool adaptive);
+
+    // Starts a mission uploaded this way, or by MissionSync, with MAV_CMD_MISSION_START.
+    // Mission::start_mission() is for missions the plugin uploaded.
+    static mavsdk::MavlinkPassthrough::Result
+    start_mission(mavsdk::MavlinkPassthrough& mavlink_passthrough);
+
+private:
+    void start(
+        std::shared_ptr<const EncodedMission> mission,
+        uint16_t first_seq,
+        uint16_t last_seq,
+        bool partial,
+        result_callback_t callback);
+    void handle_request(const mavlink_message_t& message, bool is_int);
+    void handle_ack(const mavlink_message_t& message);
+    void on_timer();
+
+    // The functions below are called with the mutex locked.
+    // MISSION_COUNT, or MISSION_WRITE_PARTIAL_LIST for a partial upload.
+    void send_count();
+    void send_item(uint16_t seq);
+    // The answer to a message is the request for the next item, or the ACK after the last.
+    void start_rtt_measurement(int32_t answer_seq);
+    void finish_rtt_measurement(int32_t answer_seq);
+    void restart_timeout();
+    void finish(mavsdk::Mission::Result result);
+
+    FleetExecutor& executor_;
+    std::shared_ptr<mavsdk::MavlinkPassthrough> mavlink_passthrough_;
+    const std::chrono::milliseconds timeout_;
+    const unsigned max_retries_;
+
+    mutable std::mutex mutex_{};
+    bool active_{false};
+    std::shared_ptr<const EncodedMission> mission_{};
+    result_callback_t callback_{};
+    bool partial_{false};
+    uint16_t first_seq_{0};
+    uint16_t last_seq_{0};
+    // The vehicle may ask for an item again, e.g. if our item got lost.
+    int32_t last_requested_seq_{-1};
+    int32_t highest_sent_seq_{-1};
+    unsigned retries_left_{0};
+    FleetExecutor::time_point deadline_{};
+    bool timer_pending_{false};
+    Stats stats_{};
+
+    // The round trip time is kept from one upload to the next, it belongs to the link.
+    bool adaptive_{true};
+    std::chrono::microseconds smoothed_rtt_{0};
+    std::chrono::microseconds rtt_variation_{0};
+    std::chrono::microseconds current_timeout_;
+    int32_t expected_answer_seq_{-1};
+    // Answer to a message which was sent more than once, until a different one is sent.
+    int32_t ambiguous_answer_seq_{-1};
+    FleetExecutor::time_point measurement_start_{};
+    bool measuring_{false};
+};
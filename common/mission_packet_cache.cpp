@@ -0,0 +1,237 @@
+#include "mission_packet_cache.h"
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace mavsdk;
+
+namespace {
+
+// Hold time at waypoints which are not flown through, the same as the Mission plugin.
+constexpr float hold_time_s = 0.5f;
+constexpr float acceptance_radius_m = 1.0f;
+
+// Uploads to several vehicles address items at the same time, from the executor and from
+// MAVSDK's threads. The channel status with the sequence number is shared by all of them.
+std::mutex channel_mutex;
+
+class ItemEncoder {
+public:
+    explicit ItemEncoder(EncodedMission& encoded) : encoded_(encoded) {}
+
+    void add(
+        uint16_t mission_item_index,
+        uint16_t command,
+        uint8_t frame,
+        float param1,
+        float param2 = 0.0f,
+        float param3 = 0.0f,
+        float param4 = 0.0f,
+        int32_t x = 0,
+        int32_t y = 0,
+        float z = 0.0f)
+    {
+        mavlink_mission_item_int_t item{};
+        item.param1 = param1;
+        item.param2 = param2;
+        item.param3 = param3;
+        item.param4 = param4;
+        item.x = x;
+        item.y = y;
+        item.z = z;
+        item.seq = static_cast<uint16_t>(encoded_.items.size());
+        item.command = command;
+        item.frame = frame;
+        item.current = (item.seq == 0) ? 1 : 0;
+        item.autocontinue = 1;
+        item.mission_type = MAV_MISSION_TYPE_MISSION;
+
+        // The same as mavlink_msg_mission_item_int_encode() with aligned fields, but
+        // without finalizing: header and checksum depend on the vehicle.
+        mavlink_message_t message{};
+        message.msgid = MAVLINK_MSG_ID_MISSION_ITEM_INT;
+        memcpy(_MAV_PAYLOAD_NON_CONST(&message), &item, MAVLINK_MSG_ID_MISSION_ITEM_INT_LEN);
+        encoded_.items.push_back(message);
+        encoded_.mission_item_indices.push_back(mission_item_index);
+    }
+
+private:
+    EncodedMission& encoded_;
+};
+
+} // namespace
+
+constexpr uint8_t MissionPacketCache::channel;
+
+std::pair<Mission::Result, std::shared_ptr<const EncodedMission>>
+MissionPacketCache::load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        std::cerr << "Could not open " << path << std::endl;
+        return std::make_pair(Mission::Result::FailedToOpenQgcPlan, nullptr);
+    }
+    std::string data(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    if (!file.read(&data[0], data.size())) {
+        std::cerr << "Could not read " << path << std::endl;
+        return std::make_pair(Mission::Result::FailedToOpenQgcPlan, nullptr);
+    }
+
+    const uint64_t hash = content_hash(data.data(), data.size());
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.loads;
+        const auto found = missions_.find(hash);
+        if (found != missions_.end()) {
+            return std::make_pair(Mission::Result::Success, found->second);
+        }
+    }
+
+    // Not under the lock, other plans can be loaded meanwhile. If the same plan is loaded
+    // twice at the same time, the first one to finish is kept.
+    std::pair<Mission::Result, QgcPlan> parsed = QgcPlanParser::parse(data.data(), data.size());
+    if (parsed.first != Mission::Result::Success) {
+        return std::make_pair(parsed.first, nullptr);
+    }
+    auto encoded = std::make_shared<EncodedMission>();
+    encoded->content_hash = hash;
+    encoded->plan = std::move(parsed.second);
+    encode(encoded->plan.mission_plan, *encoded);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.parses;
+    const auto inserted = missions_.emplace(hash, std::move(encoded));
+    stats_.missions = missions_.size();
+    return std::make_pair(Mission::Result::Success, inserted.first->second);
+}
+
+MissionPacketCache::Stats MissionPacketCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+uint64_t MissionPacketCache::content_hash(const char* data, size_t len)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+void MissionPacketCache::encode(const Mission::MissionPlan& mission_plan, EncodedMission& encoded)
+{
+    encoded.items.clear();
+    encoded.mission_item_indices.clear();
+    ItemEncoder encoder(encoded);
+
+    float last_speed_m_s = NAN;
+    for (size_t i = 0; i < mission_plan.mission_items.size(); ++i) {
+        const Mission::MissionItem& item = mission_plan.mission_items[i];
+        const uint16_t index = static_cast<uint16_t>(i);
+
+        if (std::isfinite(item.latitude_deg) && std::isfinite(item.longitude_deg)) {
+            encoder.add(
+                index,
+                MAV_CMD_NAV_WAYPOINT,
+                MAV_FRAME_GLOBAL_RELATIVE_ALT_INT,
+                item.is_fly_through ? 0.0f : hold_time_s,
+                acceptance_radius_m,
+                0.0f,
+                NAN,
+                static_cast<int32_t>(std::round(item.latitude_deg * 1e7)),
+                static_cast<int32_t>(std::round(item.longitude_deg * 1e7)),
+                item.relative_altitude_m);
+        }
+
+        // Speed changes stay in effect, so they are only sent when the speed changes.
+        if (std::isfinite(item.speed_m_s) && item.speed_m_s > 0.0f &&
+            item.speed_m_s != last_speed_m_s) {
+            encoder.add(
+                index, MAV_CMD_DO_CHANGE_SPEED, MAV_FRAME_MISSION, 1.0f, item.speed_m_s, -1.0f);
+            last_speed_m_s = item.speed_m_s;
+        }
+
+        if (std::isfinite(item.gimbal_pitch_deg) || std::isfinite(item.gimbal_yaw_deg)) {
+            encoder.add(
+                index,
+                MAV_CMD_DO_MOUNT_CONTROL,
+                MAV_FRAME_MISSION,
+                std::isfinite(item.gimbal_pitch_deg) ? item.gimbal_pitch_deg : 0.0f,
+                0.0f,
+                std::isfinite(item.gimbal_yaw_deg) ? item.gimbal_yaw_deg : 0.0f,
+                0.0f,
+                0,
+                0,
+                MAV_MOUNT_MODE_MAVLINK_TARGETING);
+        }
+
+        if (std::isfinite(item.loiter_time_s) && item.loiter_time_s > 0.0f) {
+            encoder.add(
+                index,
+                MAV_CMD_NAV_DELAY,
+                MAV_FRAME_MISSION,
+                static_cast<float>(item.loiter_time_s),
+                -1.0f,
+                -1.0f,
+                -1.0f);
+        }
+
+        switch (item.camera_action) {
+            case Mission::MissionItem::CameraAction::TakePhoto:
+                encoder.add(
+                    index, MAV_CMD_IMAGE_START_CAPTURE, MAV_FRAME_MISSION, 0.0f, 0.0f, 1.0f);
+                break;
+            case Mission::MissionItem::CameraAction::StartPhotoInterval:
+                encoder.add(
+                    index,
+                    MAV_CMD_IMAGE_START_CAPTURE,
+                    MAV_FRAME_MISSION,
+                    0.0f,
+                    static_cast<float>(item.camera_photo_interval_s),
+                    0.0f);
+                break;
+            case Mission::MissionItem::CameraAction::StopPhotoInterval:
+                encoder.add(index, MAV_CMD_IMAGE_STOP_CAPTURE, MAV_FRAME_MISSION, 0.0f);
+                break;
+            case Mission::MissionItem::CameraAction::StartVideo:
+                encoder.add(index, MAV_CMD_VIDEO_START_CAPTURE, MAV_FRAME_MISSION, 0.0f);
+                break;
+            case Mission::MissionItem::CameraAction::StopVideo:
+                encoder.add(index, MAV_CMD_VIDEO_STOP_CAPTURE, MAV_FRAME_MISSION, 0.0f);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void MissionPacketCache::address_item(
+    const mavlink_message_t& item,
+    uint8_t our_sysid,
+    uint8_t our_compid,
+    uint8_t target_sysid,
+    uint8_t target_compid,
+    mavlink_message_t& message)
+{
+    message = item;
+    char* payload = _MAV_PAYLOAD_NON_CONST(&message);
+    payload[offsetof(mavlink_mission_item_int_t, target_system)] = static_cast<char>(target_sysid);
+    payload[offsetof(mavlink_mission_item_int_t, target_component)] =
+        static_cast<char>(target_compid);
+
+    std::lock_guard<std::mutex> lock(channel_mutex);
+    mavlink_finalize_message_chan(
+        &message,
+        our_sysid,
+        our_compid,
+        channel,
+        MAVLINK_MSG_ID_MISSION_ITEM_INT_MIN_LEN,
+        MAVLINK_MSG_ID_MISSION_ITEM_INT_LEN,
+        MAVLINK_MSG_ID_MISSION_ITEM_INT_CRC);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <mavsdk/plugins/mavlink_passthrough/mavlink_passthrough.h>
+#include <mavsdk/plugins/mission/mission.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "qgc_plan_parser.h"
+
+/**
+ * @brief A plan with its mission already encoded as MISSION_ITEM_INT payloads.
+ * Shared by every vehicle flying it and never changed after it was built.
+ */
+struct EncodedMission {
+    // FNV-1a of the .plan file content.
+    uint64_t content_hash;
+    QgcPlan plan;
+    // Payload and message id only, without header and checksum, see
+    // MissionPacketCache::address_item().
+    std::vector<mavlink_message_t> items;
+    // Index into plan.mission_plan.mission_items for every MAVLink item, to map the
+    // sequence numbers in MISSION_CURRENT back to mission items.
+    std::vector<uint16_t> mission_item_indices;
+};
+
+/**
+ * @brief The MissionPacketCache class
+ * Parses and encodes every distinct plan only once, however many vehicles fly it. Files
+ * are keyed by a hash of their content, so ten vehicles loading copies of the same
+ * survey share one EncodedMission.
+ *
+ * An upload then only writes the target ids, header and checksum of each item (see
+ * address_item()), instead of converting mission items to MAVLink for every vehicle.
+ */
+class MissionPacketCache {
+public:
+    struct Stats {
+        uint64_t loads;
+        // Plans parsed and encoded, the other loads found the plan in the cache.
+        uint64_t parses;
+        size_t missions;
+    };
+
+    // Thread safe.
+    std::pair<mavsdk::Mission::Result, std::shared_ptr<const EncodedMission>>
+    load(const std::string& path);
+
+    Stats stats() const;
+
+    static uint64_t content_hash(const char* data, size_t len);
+
+    // The MAVLink items of a mission, the way the Mission plugin uploads them.
+    static void encode(const mavsdk::Mission::MissionPlan& mission_plan, EncodedMission& encoded);
+
+    // The MAVLink channel whose sequence numbers address_item() uses, the last but one.
+    // MAVSDK takes channels from the first, the in-process mock vehicles the last.
+    static constexpr uint8_t channel = MAVLINK_COMM_NUM_BUFFERS - 2;
+
+    // Copies an item of an EncodedMission for one vehicle. Only the target ids are written
+    // into the payload, then header and checksum are added like for any other message.
+    // Thread safe.
+    static void address_item(
+        const mavlink_message_t& item,
+        uint8_t our_sysid,
+        uint8_t our_compid,
+        uint8_t target_sysid,
+        uint8_t target_compid,
+        mavlink_message_t& message);
+
+private:
+    mutable std::mutex mutex_{};
+    std::unordered_map<uint64_t, std::shared_ptr<const EncodedMission>> missions_{};
+    Stats stats_{};
+};
@@ -0,0 +1,284 @@
+#include "mission_sync.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+using namespace mavsdk;
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+// All NaNs compare equal, e.g. the yaw of a waypoint.
+float canonical(float value)
+{
+    return std::isnan(value) ? NAN : value;
+}
+
+std::string read_file_lines_except(const std::string& path, uint8_t system_id)
+{
+    std::ifstream file(path);
+    std::string kept;
+    std::string line;
+    while (std::getline(file, line)) {
+        unsigned line_system_id = 0;
+        std::istringstream(line) >> line_system_id;
+        if (line_system_id != system_id) {
+            kept += line + "\n";
+        }
+    }
+    return kept;
+}
+
+} // namespace
+
+MissionSync::MissionSync(
+    FleetExecutor& executor,
+    std::shared_ptr<MavlinkPassthrough> mavlink_passthrough,
+    std::string sync_file_path) :
+    mavlink_passthrough_(mavlink_passthrough),
+    sync_file_path_(std::move(sync_file_path)),
+    uploader_(std::make_shared<MissionItemUploader>(executor, mavlink_passthrough)),
+    downloader_(std::make_shared<MissionItemDownloader>(executor, mavlink_passthrough))
+{}
+
+MissionSync::Report MissionSync::sync(std::shared_ptr<const EncodedMission> mission)
+{
+    const auto start_time = steady_clock::now();
+    const uint8_t system_id = mavlink_passthrough_->get_target_sysid();
+    const unsigned items_sent_before = uploader_->stats().items_sent;
+
+    Report report{};
+    report.transfer = Transfer::None;
+
+    std::vector<uint64_t> wanted;
+    wanted.reserve(mission->items.size());
+    for (const auto& message : mission->items) {
+        mavlink_mission_item_int_t item{};
+        memcpy(&item, _MAV_PAYLOAD(&message), MAVLINK_MSG_ID_MISSION_ITEM_INT_LEN);
+        wanted.push_back(item_hash(item));
+    }
+
+    // One round trip, and enough to know that a full upload is needed.
+    uint16_t count = 0;
+    report.result = download_count(count);
+    if (report.result != Mission::Result::Success) {
+        report.time = duration_cast<milliseconds>(steady_clock::now() - start_time);
+        return report;
+    }
+
+    VehicleState state{true, {}};
+    bool known = load_state(system_id, state) && state.item_hashes.size() == count;
+    report.remembered = known;
+    if (!known) {
+        state.item_hashes.clear();
+    }
+    if (!known && count == wanted.size() && count > 0) {
+        report.result = download_hashes(state.item_hashes);
+        if (report.result != Mission::Result::Success) {
+            report.time = duration_cast<milliseconds>(steady_clock::now() - start_time);
+            return report;
+        }
+        report.items_downloaded = count;
+        known = true;
+    }
+
+    if (known && state.item_hashes == wanted) {
+        report.transfer = Transfer::None;
+    } else if (
+        known && state.item_hashes.size() == wanted.size() && state.partial_write_supported) {
+        size_t first = 0;
+        while (state.item_hashes[first] == wanted[first]) {
+            ++first;
+        }
+        size_t last = wanted.size() - 1;
+        while (state.item_hashes[last] == wanted[last]) {
+            --last;
+        }
+        report.transfer = Transfer::Partial;
+        report.result = upload(
+            mission, true, static_cast<uint16_t>(first), static_cast<uint16_t>(last));
+        if (report.result != Mission::Result::Success) {
+            // PX4 doesn't answer MISSION_WRITE_PARTIAL_LIST at all.
+            if (report.result == Mission::Result::Timeout ||
+                report.result == Mission::Result::Unsupported) {
+                state.partial_write_supported = false;
+            }
+            report.transfer = Transfer::Full;
+            report.result = upload(mission, false, 0, 0);
+        }
+    } else {
+        report.transfer = Transfer::Full;
+        report.result = upload(mission, false, 0, 0);
+    }
+
+    if (report.result == Mission::Result::Success) {
+        state.item_hashes = std::move(wanted);
+        save_state(system_id, state);
+    } else {
+        // Whatever the vehicle has now, it has to be compared again.
+        forget_state(system_id);
+    }
+
+    report.items_uploaded = uploader_->stats().items_sent - items_sent_before;
+    report.time = duration_cast<milliseconds>(steady_clock::now() - start_time);
+    return report;
+}
+
+uint64_t MissionSync::item_hash(const mavlink_mission_item_int_t& item)
+{
+    mavlink_mission_item_int_t stored{};
+    stored.param1 = canonical(item.param1);
+    stored.param2 = canonical(item.param2);
+    stored.param3 = canonical(item.param3);
+    stored.param4 = canonical(item.param4);
+    stored.x = item.x;
+    stored.y = item.y;
+    stored.z = canonical(item.z);
+    stored.command = item.command;
+    stored.frame = item.frame;
+    stored.autocontinue = item.autocontinue;
+    return MissionPacketCache::content_hash(
+        reinterpret_cast<const char*>(&stored), sizeof(stored));
+}
+
+std::string MissionSync::to_string(const Report& report)
+{
+    std::stringstream ss;
+    if (report.result != Mission::Result::Success) {
+        ss << "Mission sync failed: " << report.result << ", after " << report.time.count()
+           << " ms";
+        return ss.str();
+    }
+
+    switch (report.transfer) {
+        case Transfer::None:
+            ss << "Vehicle already has the mission";
+            break;
+        case Transfer::Partial:
+            ss << "Uploaded " << report.items_uploaded << " changed items";
+            break;
+        case Transfer::Full:
+            ss << "Uploaded all items (" << report.items_uploaded << " sent)";
+            break;
+    }
+    if (report.remembered) {
+        ss << ", compared with the sync file";
+    } else if (report.items_downloaded > 0) {
+        ss << ", compared with " << report.items_downloaded << " downloaded items";
+    }
+    ss << ", in " << report.time.count() << " ms";
+    return ss.str();
+}
+
+// One line per vehicle: system id, 1 if partial writes work, item count, item hashes.
+bool MissionSync::load_state(uint8_t system_id, VehicleState& state) const
+{
+    if (sync_file_path_.empty()) {
+        return false;
+    }
+
+    std::ifstream file(sync_file_path_);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream in(line);
+        unsigned line_system_id = 0;
+        int partial_write_supported = 1;
+        size_t count = 0;
+        if (!(in >> line_system_id >> partial_write_supported >> count) ||
+            line_system_id != system_id) {
+            continue;
+        }
+
+        state.partial_write_supported = partial_write_supported != 0;
+        state.item_hashes.resize(count);
+        for (auto& hash : state.item_hashes) {
+            in >> std::hex >> hash;
+        }
+        return static_cast<bool>(in);
+    }
+    return false;
+}
+
+void MissionSync::save_state(uint8_t system_id, const VehicleState& state) const
+{
+    if (sync_file_path_.empty()) {
+        return;
+    }
+
+    std::stringstream ss;
+    ss << read_file_lines_except(sync_file_path_, system_id) << int(system_id) << " "
+       << (state.partial_write_supported ? 1 : 0) << " " << state.item_hashes.size()
+       << std::hex;
+    for (const uint64_t hash : state.item_hashes) {
+        ss << " " << hash;
+    }
+    ss << "\n";
+
+    std::ofstream file(sync_file_path_, std::ios::trunc);
+    file << ss.str();
+    if (!file) {
+        std::cerr << "Could not write " << sync_file_path_ << std::endl;
+    }
+}
+
+void MissionSync::forget_state(uint8_t system_id) const
+{
+    if (sync_file_path_.empty()) {
+        return;
+    }
+
+    const std::string kept = read_file_lines_except(sync_file_path_, system_id);
+    std::ofstream file(sync_file_path_, std::ios::trunc);
+    file << kept;
+}
+
+Mission::Result MissionSync::download_count(uint16_t& count)
+{
+    auto prom = std::make_shared<std::promise<std::pair<Mission::Result, uint16_t>>>();
+    auto future_result = prom->get_future();
+    downloader_->download_count_async([prom](Mission::Result result, uint16_t item_count) {
+        prom->set_value(std::make_pair(result, item_count));
+    });
+
+    const auto result = future_result.get();
+    count = result.second;
+    return result.first;
+}
+
+Mission::Result MissionSync::download_hashes(std::vector<uint64_t>& hashes)
+{
+    auto prom = std::make_shared<std::promise<Mission::Result>>();
+    auto future_result = prom->get_future();
+    downloader_->download_async(
+        [prom, &hashes](Mission::Result result, std::vector<mavlink_mission_item_int_t> items) {
+            hashes.clear();
+            for (const auto& item : items) {
+                hashes.push_back(item_hash(item));
+            }
+            prom->set_value(result);
+        });
+    return future_result.get();
+}
+
+Mission::Result MissionSync::upload(
+    std::shared_ptr<const EncodedMission> mission,
+    bool partial,
+    uint16_t first_seq,
+    uint16_t last_seq)
+{
+    auto prom = std::make_shared<std::promise<Mission::Result>>();
+    auto future_result = prom->get_future();
+    auto callback = [prom](Mission::Result result) { prom->set_value(result); };
+    if (partial) {
+        uploader_->upload_partial_async(mission, first_seq, last_seq, callback);
+    } else {
+        uploader_->upload_async(mission, callback);
+    }
+    return future_result.get();
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <mavsdk/plugins/mavlink_passthrough/mavlink_passthrough.h>
+#include <mavsdk/plugins/mission/mission.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fleet_executor.h"
+#include "mission_item_downloader.h"
+#include "mission_item_uploader.h"
+#include "mission_packet_cache.h"
+
+/**
+ * @brief The MissionSync class
+ * Brings the mission on a vehicle up to date with an EncodedMission and sends as little as
+ * possible for it, for slow links where a full upload of a large plan takes minutes.
+ *
+ * The missions are compared item by item, by a hash of what the vehicle stores of an
+ * item. The hashes of the vehicle's mission come from the sync file if the last sync
+ * with the vehicle went through here and it still has as many items. Otherwise the
+ * mission is downloaded, but only if it has as many items as the new one. Then:
+ * - Nothing changed: nothing is sent.
+ * - Same number of items: only the items from the first to the last changed one are
+ *   written, with MISSION_WRITE_PARTIAL_LIST. If the vehicle doesn't take that, the
+ *   whole mission is uploaded and the sync file remembers not to try again.
+ * - Otherwise the whole mission is uploaded.
+ *
+ * The sync file can't tell if someone else replaced the mission with one of the same
+ * length meanwhile. Without a sync file (an empty path), the mission is always
+ * downloaded to compare.
+ *
+ * Takes over the mission subscriptions of the passthrough, see MissionItemUploader and
+ * MissionItemDownloader.
+ */
+class MissionSync {
+public:
+    enum class Transfer { None, Partial, Full };
+
+    struct Report {
+        mavsdk::Mission::Result result;
+        Transfer transfer;
+        // The vehicle's mission was known from the sync file, not downloaded.
+        bool remembered;
+        size_t items_downloaded;
+        size_t items_uploaded;
+        std::chrono::milliseconds time;
+    };
+
+    MissionSync(
+        FleetExecutor& executor,
+        std::shared_ptr<mavsdk::MavlinkPassthrough> mavlink_passthrough,
+        std::string sync_file_path);
+
+    MissionSync(const MissionSync&) = delete;
+    MissionSync& operator=(const MissionSync&) = delete;
+
+    // Blocks until the vehicle has the mission or the sync failed.
+    Report sync(std::shared_ptr<const EncodedMission> mission);
+
+    // Only the fields the vehicle stores: not the addressing, the sequence number or
+    // whether the item is the current one.
+    static uint64_t item_hash(const mavlink_mission_item_int_t& item);
+
+    // E.g. "Uploaded 3 of 500 items, compared with the sync file, in 850 ms"
+    static std::string to_string(const Report& report);
+
+private:
+    struct VehicleState {
+        bool partial_write_supported;
+        std::vector<uint64_t> item_hashes;
+    };
+
+    // False if the file has nothing for the vehicle.
+    bool load_state(uint8_t system_id, VehicleState& state) const;
+    void save_state(uint8_t system_id, const VehicleState& state) const;
+    void forget_state(uint8_t system_id) const;
+
+    mavsdk::Mission::Result download_count(uint16_t& count);
+    mavsdk::Mission::Result download_hashes(std::vector<uint64_t>& hashes);
+    mavsdk::Mission::Result upload(
+        std::shared_ptr<const EncodedMission> mission,
+        bool partial,
+        uint16_t first_seq,
+        uint16_t last_seq);
+
+    std::shared_ptr<mavsdk::MavlinkPassthrough> mavlink_passthrough_;
+    const std::string sync_file_path_;
+    std::shared_ptr<MissionItemUploader> uploader_;
+    std::shared_ptr<MissionItemDownloader> downloader_;
+};
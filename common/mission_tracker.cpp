@@ -0,0 +1,182 @@
+#include "mission_tracker.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+using namespace mavsdk;
+
+namespace {
+
+constexpr double earth_radius_m = 6371000.0;
+constexpr double deg_to_rad = M_PI / 180.0;
+
+// MAV_TYPE_FIXED_WING, the parser doesn't depend on MAVLink.
+constexpr int mav_type_fixed_wing = 1;
+
+} // namespace
+
+constexpr float MissionTracker::fallback_speed_m_s;
+
+template<typename F> void MissionTracker::update(F change)
+{
+    Status status;
+    status_callback_t status_callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        change();
+        status = compute_status();
+        status_callback = status_callback_;
+    }
+    cv_.notify_all();
+
+    if (status_callback) {
+        status_callback(status);
+    }
+}
+
+MissionTracker::MissionTracker(const Mission::MissionPlan& mission_plan, float default_speed_m_s)
+{
+    float speed_m_s = (std::isfinite(default_speed_m_s) && default_speed_m_s > 0.0f) ?
+                          default_speed_m_s :
+                          fallback_speed_m_s;
+    Point last_point{};
+    bool has_last_point = false;
+
+    legs_.resize(mission_plan.mission_items.size());
+    for (size_t i = 0; i < legs_.size(); ++i) {
+        const Mission::MissionItem& item = mission_plan.mission_items[i];
+        Leg& leg = legs_[i];
+
+        leg.speed_m_s = speed_m_s;
+        leg.length_m = 0.0;
+        if (std::isfinite(item.latitude_deg) && std::isfinite(item.longitude_deg)) {
+            const Point point{item.latitude_deg, item.longitude_deg, item.relative_altitude_m};
+            if (has_last_point) {
+                leg.length_m = distance_m(last_point, point);
+            }
+            last_point = point;
+            has_last_point = true;
+        }
+        leg.point = last_point;
+        leg.has_point = has_last_point;
+        leg.hold_s = (std::isfinite(item.loiter_time_s) && item.loiter_time_s > 0.0) ?
+                         double(item.loiter_time_s) :
+                         0.0;
+
+        // A speed change at an item applies to the legs after it.
+        if (std::isfinite(item.speed_m_s) && item.speed_m_s > 0.0f) {
+            speed_m_s = item.speed_m_s;
+        }
+    }
+
+    double following_m = 0.0;
+    double following_s = 0.0;
+    for (size_t i = legs_.size(); i-- > 0;) {
+        Leg& leg = legs_[i];
+        leg.following_m = following_m;
+        leg.following_s = following_s;
+        following_m += leg.length_m;
+        following_s += leg.length_m / leg.speed_m_s + leg.hold_s;
+    }
+}
+
+float MissionTracker::plan_speed_m_s(const QgcPlan& plan)
+{
+    const float speed_m_s =
+        (plan.vehicle_type == mav_type_fixed_wing) ? plan.cruise_speed_m_s : plan.hover_speed_m_s;
+    return (std::isfinite(speed_m_s) && speed_m_s > 0.0f) ? speed_m_s : fallback_speed_m_s;
+}
+
+void MissionTracker::subscribe_status(status_callback_t callback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    status_callback_ = std::move(callback);
+}
+
+void MissionTracker::set_progress(int current, int total)
+{
+    update([this, current, total]() {
+        if (total_ > 0 && current_ >= total_) {
+            return;
+        }
+        current_ = current;
+        total_ = total;
+    });
+}
+
+void MissionTracker::set_position(
+    double latitude_deg, double longitude_deg, float relative_altitude_m)
+{
+    update([this, latitude_deg, longitude_deg, relative_altitude_m]() {
+        position_ = Point{latitude_deg, longitude_deg, relative_altitude_m};
+        has_position_ = std::isfinite(latitude_deg) && std::isfinite(longitude_deg);
+    });
+}
+
+MissionTracker::Status MissionTracker::status() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return compute_status();
+}
+
+void MissionTracker::wait_until_finished()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return compute_status().finished; });
+}
+
+bool MissionTracker::wait_until_finished(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cv_.wait_for(lock, timeout, [this]() { return compute_status().finished; });
+}
+
+std::string MissionTracker::to_string(const Status& status)
+{
+    std::stringstream ss;
+    if (status.finished) {
+        ss << "Mission " << status.total << " / " << status.total << ", finished";
+        return ss.str();
+    }
+
+    const long eta_s = std::lround(status.eta_s);
+    ss << "Mission " << status.current << " / " << status.total << ", " << std::fixed
+       << std::setprecision(0) << status.remaining_m << " m left, ETA " << eta_s / 60 << ":"
+       << std::setw(2) << std::setfill('0') << eta_s % 60;
+    return ss.str();
+}
+
+double MissionTracker::distance_m(const Point& from, const Point& to)
+{
+    // Flat earth is good enough for the legs of a mission.
+    const double latitude_rad = 0.5 * (from.latitude_deg + to.latitude_deg) * deg_to_rad;
+    const double north_m = (to.latitude_deg - from.latitude_deg) * deg_to_rad * earth_radius_m;
+    const double east_m = (to.longitude_deg - from.longitude_deg) * deg_to_rad * earth_radius_m *
+                          std::cos(latitude_rad);
+    const double up_m = std::isfinite(from.relative_altitude_m - to.relative_altitude_m) ?
+                            double(to.relative_altitude_m - from.relative_altitude_m) :
+                            0.0;
+    return std::sqrt(north_m * north_m + east_m * east_m + up_m * up_m);
+}
+
+MissionTracker::Status MissionTracker::compute_status() const
+{
+    Status status{current_, total_, 0.0, 0.0, total_ > 0 && current_ >= total_};
+    if (status.finished || legs_.empty()) {
+        return status;
+    }
+
+    // Before the mission starts, the vehicle flies to the first item.
+    const size_t index =
+        static_cast<size_t>(std::min<int>(std::max(current_, 0), int(legs_.size()) - 1));
+    const Leg& leg = legs_[index];
+
+    // Without a position, assume the vehicle is still at the start of the leg.
+    const double to_go_m =
+        (has_position_ && leg.has_point) ? distance_m(position_, leg.point) : leg.length_m;
+
+    status.remaining_m = to_go_m + leg.following_m;
+    status.eta_s = to_go_m / leg.speed_m_s + leg.hold_s + leg.following_s;
+    return status;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <mavsdk/plugins/mission/mission.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "qgc_plan_parser.h"
+
+/**
+ * @brief The MissionTracker class
+ * Follows a running mission and estimates the remaining distance and time from the plan
+ * geometry. The progress comes in with set_progress(), e.g. from the Mission plugin's
+ * mission progress or from MISSION_CURRENT, and the vehicle position with set_position().
+ * Every update calls the status callback, and the mission counts as finished the moment
+ * the progress reaches the end, so there is no need to poll is_mission_finished().
+ *
+ * Legs are flown at the speed of the mission item before them, or at the default speed if
+ * no item sets one. Acceleration and turns are ignored, so the ETA is a lower bound.
+ */
+class MissionTracker {
+public:
+    struct Status {
+        // Index of the mission item the vehicle flies to, total if the mission is finished.
+        int current;
+        int total;
+        double remaining_m;
+        double eta_s;
+        bool finished;
+    };
+
+    typedef std::function<void(const Status&)> status_callback_t;
+
+    // For plans without any speed, the PX4 default mission speed of a multicopter.
+    static constexpr float fallback_speed_m_s = 5.0f;
+
+    MissionTracker(const mavsdk::Mission::MissionPlan& mission_plan, float default_speed_m_s);
+
+    MissionTracker(const MissionTracker&) = delete;
+    MissionTracker& operator=(const MissionTracker&) = delete;
+
+    // The speed QGroundControl estimates the plan with: the cruise speed for fixed wing,
+    // the hover speed otherwise.
+    static float plan_speed_m_s(const QgcPlan& plan);
+
+    // The callback runs on the thread of the update and must not block.
+    void subscribe_status(status_callback_t callback);
+
+    // Same meaning as Mission::MissionProgress: current == total once the last item is
+    // reached. A finished mission stays finished, later updates are ignored.
+    void set_progress(int current, int total);
+    void set_position(double latitude_deg, double longitude_deg, float relative_altitude_m);
+
+    Status status() const;
+
+    void wait_until_finished();
+    // False if the mission didn't finish before the timeout.
+    bool wait_until_finished(std::chrono::milliseconds timeout);
+
+    // E.g. "Mission 3 / 12, 1250 m left, ETA 2:05"
+    static std::string to_string(const Status& status);
+
+private:
+    struct Point {
+        double latitude_deg;
+        double longitude_deg;
+        float relative_altitude_m;
+    };
+
+    // Per mission item, for the leg which ends at it.
+    struct Leg {
+        // Where the vehicle is after the item, the previous point for items without one.
+        Point point;
+        bool has_point;
+        float speed_m_s;
+        // Loiter time at the item.
+        double hold_s;
+        double length_m;
+        // Length and time of all legs after this one.
+        double following_m;
+        double following_s;
+    };
+
+    static double distance_m(const Point& from, const Point& to);
+
+    template<typename F> void update(F change);
+
+    // Called with the mutex locked.
+    Status compute_status() const;
+
+    std::vector<Leg> legs_{};
+
+    mutable std::mutex mutex_{};
+    std::condition_variable cv_{};
+    int current_{0};
+    int total_{0};
+    Point position_{};
+    bool has_position_{false};
+    status_callback_t status_callback_{};
+};
@@ -0,0 +1,286 @@
+#include "offboard_streamer.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+using namespace mavsdk;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+constexpr double OffboardStreamer::min_rate_hz;
+constexpr double OffboardStreamer::max_rate_hz;
+
+OffboardSetpoint OffboardSetpoint::velocity_body(const Offboard::VelocityBodyYawspeed& velocity)
+{
+    OffboardSetpoint setpoint;
+    setpoint.type = Type::VelocityBody;
+    setpoint.velocity_body_yawspeed = velocity;
+    return setpoint;
+}
+
+OffboardSetpoint OffboardSetpoint::velocity_ned(const Offboard::VelocityNedYaw& velocity)
+{
+    OffboardSetpoint setpoint;
+    setpoint.type = Type::VelocityNed;
+    setpoint.velocity_ned_yaw = velocity;
+    return setpoint;
+}
+
+OffboardSetpoint OffboardSetpoint::position_ned(const Offboard::PositionNedYaw& position)
+{
+    OffboardSetpoint setpoint;
+    setpoint.type = Type::PositionNed;
+    setpoint.position_ned_yaw = position;
+    return setpoint;
+}
+
+OffboardSetpoint OffboardSetpoint::attitude(const Offboard::Attitude& attitude)
+{
+    OffboardSetpoint setpoint;
+    setpoint.type = Type::Attitude;
+    setpoint.attitude_target = attitude;
+    return setpoint;
+}
+
+OffboardTimeline& OffboardTimeline::add(
+    const std::string& name, const OffboardSetpoint& setpoint, std::chrono::milliseconds duration)
+{
+    segments_.push_back(Segment{name, setpoint, duration});
+    return *this;
+}
+
+std::chrono::milliseconds OffboardTimeline::total_duration() const
+{
+    std::chrono::milliseconds total{0};
+    for (const auto& segment : segments_) {
+        total += segment.duration;
+    }
+    return total;
+}
+
+OffboardStreamer::OffboardStreamer(std::shared_ptr<Offboard> offboard, double rate_hz) :
+    offboard_(offboard),
+    period_(std::chrono::nanoseconds(static_cast<int64_t>(
+        1e9 / std::max(min_rate_hz, std::min(max_rate_hz, rate_hz)))))
+{}
+
+OffboardStreamer::~OffboardStreamer()
+{
+    stop();
+}
+
+bool OffboardStreamer::start(const OffboardSetpoint& initial_setpoint)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (thread_.joinable()) {
+        return true;
+    }
+
+    // Sent right away, so Offboard::start() can follow without waiting for the thread.
+    if (!send(initial_setpoint)) {
+        return false;
+    }
+
+    should_exit_ = false;
+    setpoint_ = initial_setpoint;
+    thread_ = std::thread(&OffboardStreamer::run_streamer, this);
+    return true;
+}
+
+void OffboardStreamer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        should_exit_ = true;
+        timeline_ = nullptr;
+    }
+    cv_.notify_all();
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void OffboardStreamer::set_setpoint(const OffboardSetpoint& setpoint)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    setpoint_ = setpoint;
+}
+
+void OffboardStreamer::run(const OffboardTimeline& timeline, segment_callback_t on_segment)
+{
+    const auto& segments = timeline.segments();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (segments.empty() || !thread_.joinable() || should_exit_) {
+        return;
+    }
+
+    timeline_ = &timeline;
+    segment_index_ = 0;
+    segment_end_ = steady_clock::now() + segments.front().duration;
+    setpoint_ = segments.front().setpoint;
+
+    size_t next_to_report = 0;
+    while (true) {
+        // Report every segment that started, even if it was shorter than a tick.
+        const bool finished = (timeline_ != &timeline);
+        const size_t started = finished ? segments.size() : segment_index_ + 1;
+        while (next_to_report < started) {
+            const size_t index = next_to_report++;
+            if (on_segment) {
+                lock.unlock();
+                on_segment(segments[index]);
+                lock.lock();
+            }
+        }
+
+        if (finished) {
+            return;
+        }
+
+        cv_.wait(lock, [this, &timeline, next_to_report]() {
+            return timeline_ != &timeline || segment_index_ + 1 != next_to_report;
+        });
+    }
+}
+
+OffboardStreamer::Stats OffboardStreamer::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Stats stats{};
+    stats.rate_hz = 1e9 / period_.count();
+    stats.ticks = ticks_;
+    stats.overruns = overruns_;
+    stats.missed_ticks = missed_ticks_;
+    stats.send_failures = send_failures_;
+
+    const time_point end = (stats_end_ > stats_start_) ? stats_end_ : steady_clock::now();
+    const double elapsed_s = duration<double>(end - stats_start_).count();
+    stats.achieved_rate_hz = (ticks_ > 0 && elapsed_s > 0.0) ? ticks_ / elapsed_s : 0.0;
+    stats.mean_lateness_us = lateness_mean_s_ * 1e6;
+    stats.jitter_us = ticks_ > 1 ? std::sqrt(lateness_m2_ / (ticks_ - 1)) * 1e6 : 0.0;
+    stats.max_lateness_us = lateness_max_s_ * 1e6;
+    stats.max_send_us = send_max_s_ * 1e6;
+    return stats;
+}
+
+void OffboardStreamer::reset_stats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_start_ = steady_clock::now();
+    stats_end_ = time_point{};
+    ticks_ = 0;
+    overruns_ = 0;
+    missed_ticks_ = 0;
+    send_failures_ = 0;
+    lateness_mean_s_ = 0.0;
+    lateness_m2_ = 0.0;
+    lateness_max_s_ = 0.0;
+    send_max_s_ = 0.0;
+}
+
+void OffboardStreamer::print_stats(const Stats& stats)
+{
+    std::cout << std::fixed << std::setprecision(1) << "Setpoints: " << stats.ticks << " at "
+              << stats.achieved_rate_hz << " Hz (requested " << stats.rate_hz << " Hz), "
+              << stats.overruns << " overruns, " << stats.missed_ticks << " missed, "
+              << stats.send_failures << " failed" << std::endl
+              << "Lateness: mean " << stats.mean_lateness_us << " us, jitter " << stats.jitter_us
+              << " us, max " << stats.max_lateness_us << " us, max send "
+              << stats.max_send_us << " us" << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+}
+
+void OffboardStreamer::run_streamer()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    const time_point start = steady_clock::now();
+    stats_start_ = start;
+    stats_end_ = time_point{};
+    uint64_t tick = 0;
+
+    while (true) {
+        const time_point deadline = start + period_ * tick;
+        // Only stop() wakes us up early.
+        if (cv_.wait_until(lock, deadline, [this]() { return should_exit_; })) {
+            break;
+        }
+        const time_point wake_up = steady_clock::now();
+
+        // Segment boundaries are checked against the deadline, not the wake up time, so
+        // a late tick doesn't shorten the next segment.
+        if (timeline_ != nullptr && deadline >= segment_end_) {
+            const auto& segments = timeline_->segments();
+            while (segment_index_ + 1 < segments.size() && deadline >= segment_end_) {
+                ++segment_index_;
+                segment_end_ += segments[segment_index_].duration;
+            }
+            if (deadline >= segment_end_) {
+                // The last setpoint stays active until it is changed.
+                timeline_ = nullptr;
+            } else {
+                setpoint_ = segments[segment_index_].setpoint;
+            }
+            cv_.notify_all();
+        }
+
+        const OffboardSetpoint setpoint = setpoint_;
+        lock.unlock();
+        const bool sent = send(setpoint);
+        const time_point sent_time = steady_clock::now();
+        lock.lock();
+
+        // Deadlines that already passed are skipped, the schedule stays aligned to start.
+        const uint64_t next_tick = std::max<uint64_t>(tick + 1, (sent_time - start) / period_ + 1);
+        add_tick(
+            duration<double>(wake_up - deadline).count(),
+            duration<double>(sent_time - wake_up).count(),
+            sent,
+            next_tick - tick - 1);
+        tick = next_tick;
+    }
+
+    stats_end_ = steady_clock::now();
+}
+
+bool OffboardStreamer::send(const OffboardSetpoint& setpoint)
+{
+    Offboard::Result result = Offboard::Result::Unknown;
+    switch (setpoint.type) {
+        case OffboardSetpoint::Type::VelocityBody:
+            result = offboard_->set_velocity_body(setpoint.velocity_body_yawspeed);
+            break;
+        case OffboardSetpoint::Type::VelocityNed:
+            result = offboard_->set_velocity_ned(setpoint.velocity_ned_yaw);
+            break;
+        case OffboardSetpoint::Type::PositionNed:
+            result = offboard_->set_position_ned(setpoint.position_ned_yaw);
+            break;
+        case OffboardSetpoint::Type::Attitude:
+            result = offboard_->set_attitude(setpoint.attitude_target);
+            break;
+    }
+    return result == Offboard::Result::Success;
+}
+
+void OffboardStreamer::add_tick(double lateness_s, double send_s, bool sent, uint64_t missed)
+{
+    ++ticks_;
+    const double delta = lateness_s - lateness_mean_s_;
+    lateness_mean_s_ += delta / ticks_;
+    lateness_m2_ += delta * (lateness_s - lateness_mean_s_);
+    lateness_max_s_ = std::max(lateness_max_s_, lateness_s);
+    send_max_s_ = std::max(send_max_s_, send_s);
+
+    if (lateness_s > duration<double>(period_).count()) {
+        ++overruns_;
+    }
+    missed_ticks_ += missed;
+    if (!sent) {
+        ++send_failures_;
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <mavsdk/plugins/offboard/offboard.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief One offboard setpoint of any of the supported kinds.
+ */
+struct OffboardSetpoint {
+    enum class Type { VelocityBody, VelocityNed, PositionNed, Attitude };
+
+    static OffboardSetpoint velocity_body(const mavsdk::Offboard::VelocityBodyYawspeed& velocity);
+    static OffboardSetpoint velocity_ned(const mavsdk::Offboard::VelocityNedYaw& velocity);
+    static OffboardSetpoint position_ned(const mavsdk::Offboard::PositionNedYaw& position);
+    static OffboardSetpoint attitude(const mavsdk::Offboard::Attitude& attitude);
+
+    Type type{Type::VelocityBody};
+    mavsdk::Offboard::VelocityBodyYawspeed velocity_body_yawspeed{};
+    mavsdk::Offboard::VelocityNedYaw velocity_ned_yaw{};
+    mavsdk::Offboard::PositionNedYaw position_ned_yaw{};
+    mavsdk::Offboard::Attitude attitude_target{};
+};
+
+/**
+ * @brief The OffboardTimeline class
+ * A maneuver as a list of timed segments, each holding one setpoint.
+ */
+class OffboardTimeline {
+public:
+    struct Segment {
+        std::string name;
+        OffboardSetpoint setpoint;
+        std::chrono::milliseconds duration;
+    };
+
+    OffboardTimeline& add(
+        const std::string& name,
+        const OffboardSetpoint& setpoint,
+        std::chrono::milliseconds duration);
+
+    const std::vector<Segment>& segments() const { return segments_; }
+
+    std::chrono::milliseconds total_duration() const;
+
+private:
+    std::vector<Segment> segments_{};
+};
+
+/**
+ * @brief The OffboardStreamer class
+ * Sends the current setpoint from its own thread at a fixed rate. Every tick has an
+ * absolute deadline of start + n * period, so the rate doesn't drift with the time spent
+ * sending. Ticks which are missed entirely are skipped instead of sent in a burst.
+ *
+ * Offboard mode only starts if setpoints are already being received, so call start()
+ * before Offboard::start(). Call stop() before Offboard::stop(): every setpoint sent
+ * re-arms the resending in MAVSDK, which would keep the last one alive otherwise.
+ */
+class OffboardStreamer {
+public:
+    struct Stats {
+        double rate_hz;
+        uint64_t ticks;
+        // Ticks that started later than one period after their deadline.
+        uint64_t overruns;
+        // Ticks skipped to get back on schedule.
+        uint64_t missed_ticks;
+        uint64_t send_failures;
+        double achieved_rate_hz;
+        // Wake up lateness relative to the deadline.
+        double mean_lateness_us;
+        double jitter_us;
+        double max_lateness_us;
+        double max_send_us;
+    };
+
+    typedef std::function<void(const OffboardTimeline::Segment&)> segment_callback_t;
+
+    // The rate is clamped to 50 - 250 Hz.
+    OffboardStreamer(std::shared_ptr<mavsdk::Offboard> offboard, double rate_hz);
+
+    ~OffboardStreamer();
+
+    static constexpr double min_rate_hz = 50.0;
+    static constexpr double max_rate_hz = 250.0;
+
+    // Sends the initial setpoint before it returns, false if that failed.
+    bool start(const OffboardSetpoint& initial_setpoint);
+    void stop();
+
+    // Takes effect at the next tick.
+    void set_setpoint(const OffboardSetpoint& setpoint);
+
+    // Plays the timeline and blocks until its last segment ended. Segments switch on tick
+    // deadlines, the callback is called on the calling thread when a segment starts.
+    void run(const OffboardTimeline& timeline, segment_callback_t on_segment = nullptr);
+
+    Stats stats() const;
+    void reset_stats();
+
+    static void print_stats(const Stats& stats);
+
+private:
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    void run_streamer();
+    bool send(const OffboardSetpoint& setpoint);
+    void add_tick(double lateness_s, double send_s, bool sent, uint64_t missed);
+
+    std::shared_ptr<mavsdk::Offboard> offboard_;
+    const std::chrono::nanoseconds period_;
+
+    mutable std::mutex mutex_{};
+    std::condition_variable cv_{};
+    std::thread thread_{};
+    bool should_exit_{false};
+    OffboardSetpoint setpoint_{};
+
+    // Timeline currently played, switched by the streamer thread.
+    const OffboardTimeline* timeline_{nullptr};
+    size_t segment_index_{0};
+    time_point segment_end_{};
+
+    // Statistics, Welford's algorithm for the lateness in seconds.
+    time_point stats_start_{};
+    // Set when the streamer thread exits, so stats() after stop() has the right rate.
+    time_point stats_end_{};
+    uint64_t ticks_{0};
+    uint64_t overruns_{0};
+    uint64_t missed_ticks_{0};
+    uint64_t send_failures_{0};
+    double lateness_mean_s_{0.0};
+    double lateness_m2_{0.0};
+    double lateness_max_s_{0.0};
+    double send_max_s_{0.0};
+};
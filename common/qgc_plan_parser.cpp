@@ -0,0 +1,662 @@
+#include "qgc_plan_parser.h"
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace mavsdk;
+
+namespace {
+
+// Roughly the size of one pretty printed simple item, used to reserve the mission once.
+constexpr size_t bytes_per_plan_item = 300;
+
+// Nesting is shallow in plan files, anything deeper is not a plan.
+constexpr unsigned max_depth = 32;
+
+struct StringRef {
+    const char* data;
+    size_t len;
+
+    bool operator==(const char* str) const
+    {
+        return std::strlen(str) == len && std::memcmp(data, str, len) == 0;
+    }
+    bool operator!=(const char* str) const { return !(*this == str); }
+};
+
+/**
+ * Minimal pull parser for JSON. Strings are returned as references into the input and
+ * nothing is allocated. Errors are sticky: after the first one every call fails.
+ */
+class JsonReader {
+public:
+    JsonReader(const char* data, size_t len) : pos_(data), end_(data + len) {}
+
+    bool ok() const { return ok_; }
+
+    bool begin_object() { return expect('{'); }
+
+    // Returns false at the end of the object, consuming the closing brace.
+    bool next_key(StringRef& key)
+    {
+        if (!ok_) {
+            return false;
+        }
+        skip_whitespace();
+        if (pos_ < end_ && *pos_ == '}') {
+            ++pos_;
+            return false;
+        }
+        if (pos_ < end_ && *pos_ == ',') {
+            ++pos_;
+        }
+        return read_string(key) && expect(':');
+    }
+
+    bool begin_array() { return expect('['); }
+
+    // Returns false at the end of the array, consuming the closing bracket.
+    bool next_element()
+    {
+        if (!ok_) {
+            return false;
+        }
+        skip_whitespace();
+        if (pos_ < end_ && *pos_ == ']') {
+            ++pos_;
+            return false;
+        }
+        if (pos_ < end_ && *pos_ == ',') {
+            ++pos_;
+        }
+        return true;
+    }
+
+    bool read_string(StringRef& str)
+    {
+        if (!expect('"')) {
+            return false;
+        }
+        const char* begin = pos_;
+        while (pos_ < end_ && *pos_ != '"') {
+            // Escapes are kept as they are, only the keys and item types are compared.
+            pos_ += (*pos_ == '\\') ? 2 : 1;
+        }
+        if (pos_ >= end_) {
+            return fail();
+        }
+        str = StringRef{begin, static_cast<size_t>(pos_ - begin)};
+        ++pos_;
+        return true;
+    }
+
+    // null is read as NAN, QGC writes it for unused params.
+    bool read_number(double& value)
+    {
+        skip_whitespace();
+        if (match_literal("null")) {
+            value = NAN;
+            return true;
+        }
+
+        // strtod needs a terminated string and the input is not necessarily terminated.
+        char buffer[40];
+        size_t len = 0;
+        while (pos_ + len < end_ && len < sizeof(buffer) - 1 &&
+               (std::isdigit(static_cast<unsigned char>(pos_[len])) || pos_[len] == '-' ||
+                pos_[len] == '+' || pos_[len] == '.' || pos_[len] == 'e' || pos_[len] == 'E')) {
+            buffer[len] = pos_[len];
+            ++len;
+        }
+        buffer[len] = '\0';
+
+        char* number_end = nullptr;
+        value = std::strtod(buffer, &number_end);
+        if (len == 0 || number_end != buffer + len) {
+            return fail();
+        }
+        pos_ += len;
+        return true;
+    }
+
+    bool read_bool(bool& value)
+    {
+        skip_whitespace();
+        if (match_literal("true")) {
+            value = true;
+            return true;
+        }
+        if (match_literal("false")) {
+            value = false;
+            return true;
+        }
+        return fail();
+    }
+
+    bool skip_value(unsigned depth = 0)
+    {
+        if (!ok_ || depth > max_depth) {
+            return fail();
+        }
+        skip_whitespace();
+        if (pos_ >= end_) {
+            return fail();
+        }
+
+        switch (*pos_) {
+            case '{': {
+                begin_object();
+                StringRef key;
+                while (next_key(key)) {
+                    skip_value(depth + 1);
+                }
+                return ok_;
+            }
+            case '[':
+                begin_array();
+                while (next_element()) {
+                    skip_value(depth + 1);
+                }
+                return ok_;
+            case '"': {
+                StringRef str;
+                return read_string(str);
+            }
+            case 't':
+            case 'f': {
+                bool value;
+                return read_bool(value);
+            }
+            default: {
+                double value;
+                return read_number(value);
+            }
+        }
+    }
+
+private:
+    void skip_whitespace()
+    {
+        while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\n' || *pos_ == '\r' || *pos_ == '\t')) {
+            ++pos_;
+        }
+    }
+
+    bool expect(char c)
+    {
+        if (!ok_) {
+            return false;
+        }
+        skip_whitespace();
+        if (pos_ >= end_ || *pos_ != c) {
+            return fail();
+        }
+        ++pos_;
+        return true;
+    }
+
+    bool match_literal(const char* literal)
+    {
+        const size_t len = std::strlen(literal);
+        if (static_cast<size_t>(end_ - pos_) >= len && std::memcmp(pos_, literal, len) == 0) {
+            pos_ += len;
+            return true;
+        }
+        return false;
+    }
+
+    bool fail()
+    {
+        ok_ = false;
+        return false;
+    }
+
+    const char* pos_;
+    const char* const end_;
+    bool ok_{true};
+};
+
+// MAV_FRAME_GLOBAL_RELATIVE_ALT and its _INT variant, the only altitudes the Mission
+// plugin has: relative to home.
+constexpr int frame_global_relative_alt = 3;
+constexpr int frame_global_relative_alt_int = 6;
+
+// One MAVLink item as stored in the plan.
+struct PlanItem {
+    bool has_command{false};
+    uint16_t command{0};
+    int frame{frame_global_relative_alt};
+    double params[7]{NAN, NAN, NAN, NAN, NAN, NAN, NAN};
+};
+
+// A whole number from 0 to max, not null.
+bool is_integer(double value, double max)
+{
+    return value >= 0.0 && value <= max && value == std::floor(value);
+}
+
+/**
+ * Groups MAVLink items into MissionItems while they are read.
+ */
+class MissionBuilder {
+public:
+    explicit MissionBuilder(QgcPlan& plan) : plan_(plan) {}
+
+    // False if the item has a position in a frame other than relative to home.
+    bool add(const PlanItem& item)
+    {
+        ++plan_.plan_item_count;
+        const double* p = item.params;
+
+        const bool has_position = item.command == 16 || item.command == 22 || item.command == 19;
+        if (has_position && item.frame != frame_global_relative_alt &&
+            item.frame != frame_global_relative_alt_int) {
+            return false;
+        }
+
+        switch (item.command) {
+            case 16: // MAV_CMD_NAV_WAYPOINT
+                start_item(p);
+                // A hold time makes the vehicle stop at the waypoint.
+                current_.is_fly_through = !(p[0] > 0.0);
+                break;
+            case 22: // MAV_CMD_NAV_TAKEOFF
+                start_item(p);
+                current_.is_fly_through = false;
+                break;
+            case 19: // MAV_CMD_NAV_LOITER_TIME
+                start_item(p);
+                current_.is_fly_through = false;
+                current_.loiter_time_s = static_cast<float>(p[0]);
+                break;
+            case 93: // MAV_CMD_NAV_DELAY
+                modify_item().loiter_time_s = static_cast<float>(p[0]);
+                break;
+            case 178: // MAV_CMD_DO_CHANGE_SPEED
+                modify_item().speed_m_s = static_cast<float>(p[1]);
+                break;
+            case 205: // MAV_CMD_DO_MOUNT_CONTROL
+                modify_item().gimbal_pitch_deg = static_cast<float>(p[0]);
+                current_.gimbal_yaw_deg = static_cast<float>(p[2]);
+                break;
+            case 1000: // MAV_CMD_DO_GIMBAL_MANAGER_PITCHYAW
+                modify_item().gimbal_pitch_deg = static_cast<float>(p[0]);
+                current_.gimbal_yaw_deg = static_cast<float>(p[1]);
+                break;
+            case 2000: // MAV_CMD_IMAGE_START_CAPTURE
+                if (p[2] == 1.0) {
+                    modify_item().camera_action = Mission::MissionItem::CameraAction::TakePhoto;
+                } else {
+                    modify_item().camera_action =
+                        Mission::MissionItem::CameraAction::StartPhotoInterval;
+                    current_.camera_photo_interval_s = p[1];
+                }
+                break;
+            case 2001: // MAV_CMD_IMAGE_STOP_CAPTURE
+                modify_item().camera_action = Mission::MissionItem::CameraAction::StopPhotoInterval;
+                break;
+            case 2500: // MAV_CMD_VIDEO_START_CAPTURE
+                modify_item().camera_action = Mission::MissionItem::CameraAction::StartVideo;
+                break;
+            case 2501: // MAV_CMD_VIDEO_STOP_CAPTURE
+                modify_item().camera_action = Mission::MissionItem::CameraAction::StopVideo;
+                break;
+            default:
+                ++plan_.skipped_item_count;
+                break;
+        }
+        return true;
+    }
+
+    void finish()
+    {
+        if (has_current_) {
+            plan_.mission_plan.mission_items.push_back(current_);
+            has_current_ = false;
+        }
+    }
+
+private:
+    void start_item(const double* p)
+    {
+        // Commands before the first waypoint are merged into it.
+        if (has_current_ && has_position_) {
+            plan_.mission_plan.mission_items.push_back(current_);
+            current_ = Mission::MissionItem{};
+        }
+        has_current_ = true;
+        has_position_ = true;
+        current_.latitude_deg = p[4];
+        current_.longitude_deg = p[5];
+        current_.relative_altitude_m = static_cast<float>(p[6]);
+    }
+
+    Mission::MissionItem& modify_item()
+    {
+        has_current_ = true;
+        return current_;
+    }
+
+    QgcPlan& plan_;
+    Mission::MissionItem current_{};
+    bool has_current_{false};
+    bool has_position_{false};
+};
+
+class PlanReader {
+public:
+    PlanReader(const char* data, size_t len, QgcPlan& plan) :
+        reader_(data, len),
+        plan_(plan),
+        builder_(plan)
+    {}
+
+    Mission::Result read()
+    {
+        bool is_plan = false;
+
+        StringRef key;
+        reader_.begin_object();
+        while (reader_.next_key(key)) {
+            if (key == "fileType") {
+                StringRef file_type;
+                is_plan = reader_.read_string(file_type) && file_type == "Plan";
+            } else if (key == "mission") {
+                read_mission();
+            } else if (key == "geoFence") {
+                read_geofence();
+            } else if (key == "rallyPoints") {
+                read_rally_points();
+            } else {
+                reader_.skip_value();
+            }
+        }
+        builder_.finish();
+
+        if (!reader_.ok()) {
+            std::cerr << "Failed to parse QGC plan" << std::endl;
+            return Mission::Result::FailedToParseQgcPlan;
+        }
+        if (!is_plan) {
+            std::cerr << "Not a QGC plan file" << std::endl;
+            return Mission::Result::FailedToParseQgcPlan;
+        }
+        if (!error_.empty()) {
+            std::cerr << "Unsupported QGC plan: " << error_ << std::endl;
+            return Mission::Result::FailedToParseQgcPlan;
+        }
+        return Mission::Result::Success;
+    }
+
+private:
+    void read_mission()
+    {
+        StringRef key;
+        reader_.begin_object();
+        while (reader_.next_key(key)) {
+            if (key == "items") {
+                read_items();
+            } else if (key == "plannedHomePosition") {
+                read_point(plan_.planned_home);
+            } else if (key == "cruiseSpeed") {
+                plan_.cruise_speed_m_s = read_float();
+            } else if (key == "hoverSpeed") {
+                plan_.hover_speed_m_s = read_float();
+            } else if (key == "vehicleType") {
+                const float vehicle_type = read_float();
+                plan_.vehicle_type =
+                    std::isfinite(vehicle_type) ? static_cast<int>(vehicle_type) : 0;
+            } else {
+                reader_.skip_value();
+            }
+        }
+    }
+
+    float read_float()
+    {
+        double value = NAN;
+        reader_.read_number(value);
+        return static_cast<float>(value);
+    }
+
+    void read_items()
+    {
+        reader_.begin_array();
+        while (reader_.next_element()) {
+            read_item();
+        }
+    }
+
+    void read_item()
+    {
+        PlanItem item;
+        bool is_simple_item = true;
+
+        StringRef key;
+        reader_.begin_object();
+        while (reader_.next_key(key)) {
+            if (key == "command") {
+                double command = NAN;
+                reader_.read_number(command);
+                item.has_command = is_integer(command, 65535.0);
+                if (item.has_command) {
+                    item.command = static_cast<uint16_t>(command);
+                } else {
+                    set_error("mission item without a valid command");
+                }
+            } else if (key == "frame") {
+                double frame = NAN;
+                reader_.read_number(frame);
+                if (is_integer(frame, 255.0)) {
+                    item.frame = static_cast<int>(frame);
+                } else {
+                    set_error("mission item without a valid frame");
+                }
+            } else if (key == "params") {
+                reader_.begin_array();
+                for (unsigned i = 0; reader_.next_element(); ++i) {
+                    double value;
+                    reader_.read_number(value);
+                    if (i < 7) {
+                        item.params[i] = value;
+                    }
+                }
+            } else if (key == "type") {
+                StringRef type;
+                reader_.read_string(type);
+                is_simple_item = (type == "SimpleItem");
+            } else if (key == "TransectStyleComplexItem") {
+                // Survey and corridor scan, the generated MAVLink items are stored inside.
+                read_transect();
+            } else {
+                reader_.skip_value();
+            }
+        }
+
+        if (reader_.ok() && is_simple_item && item.has_command && !builder_.add(item)) {
+            // E.g. AMSL or terrain altitudes, which would be flown as relative ones.
+            set_error("frame " + std::to_string(item.frame) + " of command " +
+                      std::to_string(item.command) + ", only altitudes relative to home are "
+                      "supported");
+        }
+    }
+
+    // Only the first error is kept, the rest of the file is still read.
+    void set_error(const std::string& error)
+    {
+        if (error_.empty()) {
+            error_ = error;
+        }
+    }
+
+    void read_transect()
+    {
+        StringRef key;
+        reader_.begin_object();
+        while (reader_.next_key(key)) {
+            if (key == "Items") {
+                read_items();
+            } else {
+                reader_.skip_value();
+            }
+        }
+    }
+
+    void read_geofence()
+    {
+        StringRef key;
+        reader_.begin_object();
+        while (reader_.next_key(key)) {
+            if (key == "polygons") {
+                reader_.begin_array();
+                while (reader_.next_element()) {
+                    read_fence_polygon();
+                }
+            } else if (key == "circles") {
+                reader_.begin_array();
+                while (reader_.next_element()) {
+                    read_fence_circle();
+                }
+            } else if (key == "polygon") {
+                // Version 1 only had a single inclusion polygon.
+                QgcPlan::FencePolygon polygon{true, {}};
+                read_points(polygon.vertices);
+                if (!polygon.vertices.empty()) {
+                    plan_.fence_polygons.push_back(std::move(polygon));
+                }
+            } else {
+                reader_.skip_value();
+            }
+        }
+    }
+
+    void read_fence_polygon()
+    {
+        QgcPlan::FencePolygon polygon{true, {}};
+
+        StringRef key;
+        reader_.begin_object();
+        while (reader_.next_key(key)) {
+            if (key == "inclusion") {
+                reader_.read_bool(polygon.inclusion);
+            } else if (key == "polygon") {
+                read_points(polygon.vertices);
+            } else {
+                reader_.skip_value();
+            }
+        }
+        plan_.fence_polygons.push_back(std::move(polygon));
+    }
+
+    void read_fence_circle()
+    {
+        QgcPlan::FenceCircle circle{true, {double(NAN), double(NAN), float(NAN)}, 0.0};
+
+        StringRef key;
+        reader_.begin_object();
+        while (reader_.next_key(key)) {
+            if (key == "inclusion") {
+                reader_.read_bool(circle.inclusion);
+            } else if (key == "circle") {
+                StringRef circle_key;
+                reader_.begin_object();
+                while (reader_.next_key(circle_key)) {
+                    if (circle_key == "center") {
+                        read_point(circle.center);
+                    } else if (circle_key == "radius") {
+                        reader_.read_number(circle.radius_m);
+                    } else {
+                        reader_.skip_value();
+                    }
+                }
+            } else {
+                reader_.skip_value();
+            }
+        }
+        plan_.fence_circles.push_back(circle);
+    }
+
+    void read_rally_points()
+    {
+        StringRef key;
+        reader_.begin_object();
+        while (reader_.next_key(key)) {
+            if (key == "points") {
+                read_points(plan_.rally_points);
+            } else {
+                reader_.skip_value();
+            }
+        }
+    }
+
+    void read_points(std::vector<QgcPlan::GeoPoint>& points)
+    {
+        reader_.begin_array();
+        while (reader_.next_element()) {
+            QgcPlan::GeoPoint point;
+            read_point(point);
+            points.push_back(point);
+        }
+    }
+
+    // [lat, lon] or [lat, lon, alt]
+    void read_point(QgcPlan::GeoPoint& point)
+    {
+        double values[3]{NAN, NAN, NAN};
+        reader_.begin_array();
+        for (unsigned i = 0; reader_.next_element(); ++i) {
+            double value;
+            reader_.read_number(value);
+            if (i < 3) {
+                values[i] = value;
+            }
+        }
+        point.latitude_deg = values[0];
+        point.longitude_deg = values[1];
+        point.altitude_m = static_cast<float>(values[2]);
+    }
+
+    JsonReader reader_;
+    QgcPlan& plan_;
+    MissionBuilder builder_;
+    std::string error_{};
+};
+
+} // namespace
+
+std::pair<Mission::Result, QgcPlan> QgcPlanParser::parse_file(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        std::cerr << "Could not open " << path << std::endl;
+        return std::make_pair(Mission::Result::FailedToOpenQgcPlan, QgcPlan{});
+    }
+
+    // One read of the whole file, the parser then works on the buffer.
+    std::string data(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    if (!file.read(&data[0], data.size())) {
+        std::cerr << "Could not read " << path << std::endl;
+        return std::make_pair(Mission::Result::FailedToOpenQgcPlan, QgcPlan{});
+    }
+
+    return parse(data.data(), data.size());
+}
+
+std::pair<Mission::Result, QgcPlan> QgcPlanParser::parse(const char* data, size_t len)
+{
+    QgcPlan plan;
+    plan.mission_plan.mission_items.reserve(len / bytes_per_plan_item + 1);
+
+    PlanReader reader(data, len, plan);
+    const Mission::Result result = reader.read();
+    if (result != Mission::Result::Success) {
+        return std::make_pair(result, QgcPlan{});
+    }
+
+    plan.mission_plan.mission_items.shrink_to_fit();
+    return std::make_pair(result, std::move(plan));
+}
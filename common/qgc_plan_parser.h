@@ -0,0 +1,72 @@
+#pragma once
+
+#include <mavsdk/plugins/mission/mission.h>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The contents of a QGroundControl .plan file.
+ */
+struct QgcPlan {
+    struct GeoPoint {
+        double latitude_deg;
+        double longitude_deg;
+        float altitude_m;
+    };
+
+    struct FencePolygon {
+        bool inclusion;
+        std::vector<GeoPoint> vertices;
+    };
+
+    struct FenceCircle {
+        bool inclusion;
+        GeoPoint center;
+        double radius_m;
+    };
+
+    mavsdk::Mission::MissionPlan mission_plan{};
+    GeoPoint planned_home{double(NAN), double(NAN), float(NAN)};
+    std::vector<FencePolygon> fence_polygons{};
+    std::vector<FenceCircle> fence_circles{};
+    std::vector<GeoPoint> rally_points{};
+
+    // Speeds QGroundControl plans with, NAN if the file has none. Items with their own
+    // speed override them.
+    float cruise_speed_m_s{NAN};
+    float hover_speed_m_s{NAN};
+    // MAV_TYPE the plan was made for, 0 (generic) if the file has none.
+    int vehicle_type{0};
+
+    // MAVLink items in the file, including those inside survey/corridor scan items.
+    size_t plan_item_count{0};
+    // Items which have no Mission::MissionItem equivalent (e.g. camera trigger distance)
+    // and were skipped.
+    size_t skipped_item_count{0};
+};
+
+/**
+ * @brief The QgcPlanParser class
+ * Single pass parser for QGroundControl .plan files. Instead of building a JSON document
+ * first, it reads the file front to back and converts every mission item into
+ * Mission::MissionItem as soon as it is complete, so memory use is the file plus the
+ * resulting mission.
+ *
+ * MAVLink items are grouped the same way Mission::import_qgroundcontrol_mission() does:
+ * a navigation item starts a new MissionItem, and the camera, gimbal and speed commands
+ * after it are merged into it. Survey and corridor scan items are expanded.
+ *
+ * Mission items only have altitudes relative to home, so a plan with positions in any
+ * other frame (e.g. AMSL or terrain) is rejected instead of being flown at the wrong
+ * height, as is an item with a command that isn't a whole number.
+ */
+class QgcPlanParser {
+public:
+    static std::pair<mavsdk::Mission::Result, QgcPlan> parse_file(const std::string& path);
+
+    // The buffer doesn't need to be null terminated.
+    static std::pair<mavsdk::Mission::Result, QgcPlan> parse(const char* data, size_t len);
+};
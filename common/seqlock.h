@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+/**
+ * @brief The Seqlock class
+ * Holds a small trivially copyable value that is read much more often than written.
+ * Readers never block and never write shared memory: they copy the value and retry if a
+ * writer was active meanwhile. Writers are serialized by spinning on the sequence number,
+ * so keep the work done inside modify() short.
+ *
+ * The value is kept as an array of atomic words so the racy copy is well defined.
+ */
+template<typename T> class Seqlock {
+public:
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock needs a trivially copyable type");
+
+    Seqlock() { store_words(T{}); }
+    explicit Seqlock(const T& value) { store_words(value); }
+
+    Seqlock(const Seqlock&) = delete;
+    Seqlock& operator=(const Seqlock&) = delete;
+
+    T load() const
+    {
+        for (unsigned attempt = 1;; ++attempt) {
+            const uint32_t before = sequence_.load(std::memory_order_acquire);
+            if ((before & 1) != 0) {
+                // A writer is in the middle of an update.
+                back_off(attempt);
+                continue;
+            }
+            const T value = load_words();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == before) {
+                return value;
+            }
+        }
+    }
+
+    void store(const T& value)
+    {
+        const uint32_t sequence = lock();
+        store_words(value);
+        unlock(sequence);
+    }
+
+    // Applies change_function(T&) to the current value. Any callable works, it is
+    // called inline without type erasure.
+    template<typename F> void modify(F&& change_function)
+    {
+        const uint32_t sequence = lock();
+        T value = load_words();
+        change_function(value);
+        store_words(value);
+        unlock(sequence);
+    }
+
+    // Number of completed writes, only meant for statistics.
+    uint32_t version() const { return sequence_.load(std::memory_order_acquire) / 2; }
+
+private:
+    static constexpr unsigned spins_before_yield = 64;
+    static constexpr size_t word_count = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    uint32_t lock()
+    {
+        uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+        for (unsigned attempt = 1;; ++attempt) {
+            if ((sequence & 1) == 0 &&
+                sequence_.compare_exchange_weak(
+                    sequence, sequence + 1, std::memory_order_acquire)) {
+                // Acquire pairs with unlock() of the previous writer for modify(). The fence
+                // keeps the data stores below from becoming visible before the odd sequence.
+                std::atomic_thread_fence(std::memory_order_release);
+                return sequence + 1;
+            }
+            back_off(attempt);
+            sequence = sequence_.load(std::memory_order_relaxed);
+        }
+    }
+
+    // A writer that got preempted while holding the sequence odd would otherwise keep us
+    // spinning for a whole time slice, which matters on single core companion computers.
+    static void back_off(unsigned attempt)
+    {
+        if (attempt % spins_before_yield == 0) {
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock(uint32_t sequence) { sequence_.store(sequence + 1, std::memory_order_release); }
+
+    T load_words() const
+    {
+        uint64_t words[word_count];
+        for (size_t i = 0; i < word_count; ++i) {
+            words[i] = words_[i].load(std::memory_order_relaxed);
+        }
+        T value;
+        std::memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+    void store_words(const T& value)
+    {
+        uint64_t words[word_count]{};
+        std::memcpy(words, &value, sizeof(T));
+        for (size_t i = 0; i < word_count; ++i) {
+            words_[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<uint32_t> sequence_{0};
+    std::atomic<uint64_t> words_[word_count];
+};
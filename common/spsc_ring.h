@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief The SpscRing class
+ * Bounded lock-free queue for exactly one producer thread and one consumer thread.
+ * Neither side ever blocks: push() fails when the ring is full and pop() returns 0 when
+ * it is empty. Meant for trivially copyable records.
+ */
+template<typename T> class SpscRing {
+public:
+    // The capacity is rounded up to the next power of two.
+    explicit SpscRing(size_t capacity) : buffer_(round_up_to_power_of_two(capacity))
+    {
+        mask_ = buffer_.size() - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer only.
+    bool push(const T& item)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head - cached_tail_ > mask_) {
+            // Looks full, check again with the real tail.
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head - cached_tail_ > mask_) {
+                return false;
+            }
+        }
+        buffer_[head & mask_] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Copies up to max_items into items and returns how many were copied.
+    size_t pop(T* items, size_t max_items)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (cached_head_ == tail) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (cached_head_ == tail) {
+                return 0;
+            }
+        }
+
+        size_t count = cached_head_ - tail;
+        if (count > max_items) {
+            count = max_items;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            items[i] = buffer_[(tail + i) & mask_];
+        }
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Approximate when called while the other side is active.
+    size_t size() const
+    {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return buffer_.size(); }
+
+private:
+    static constexpr size_t cache_line_size = 64;
+
+    static size_t round_up_to_power_of_two(size_t value)
+    {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    std::vector<T> buffer_;
+    size_t mask_{0};
+
+    // Producer and consumer state on separate cache lines to avoid false sharing.
+    // Padding instead of alignas, over-aligned types can't be heap allocated before C++17.
+    char padding0_[cache_line_size]{};
+    std::atomic<size_t> head_{0};
+    size_t cached_tail_{0};
+
+    char padding1_[cache_line_size]{};
+    std::atomic<size_t> tail_{0};
+    size_t cached_head_{0};
+
+    char padding2_[cache_line_size]{};
+};
@@ -0,0 +1,68 @@
+#include "system_discovery.h"
+#include <algorithm>
+
+using namespace mavsdk;
+
+constexpr std::chrono::milliseconds SystemDiscovery::default_timeout;
+
+SystemDiscovery::SystemDiscovery(Mavsdk& mavsdk) :
+    mavsdk_(mavsdk),
+    start_time_(std::chrono::steady_clock::now())
+{
+    mavsdk_.subscribe_on_new_system([this]() { check_systems(); });
+
+    // Systems which were discovered before we subscribed don't trigger the callback.
+    check_systems();
+}
+
+SystemDiscovery::~SystemDiscovery()
+{
+    mavsdk_.subscribe_on_new_system(nullptr);
+}
+
+bool SystemDiscovery::wait_for_systems(size_t expected_systems, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cv_.wait_for(lock, timeout, [this, expected_systems]() {
+        return discovered_systems_.size() >= expected_systems;
+    });
+}
+
+std::vector<SystemDiscovery::DiscoveredSystem> SystemDiscovery::discovered_systems() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return discovered_systems_;
+}
+
+void SystemDiscovery::check_systems()
+{
+    const auto now = std::chrono::steady_clock::now();
+    bool found_new = false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& system : mavsdk_.systems()) {
+        if (!system->is_connected()) {
+            continue;
+        }
+
+        const auto it = std::find_if(
+            discovered_systems_.begin(),
+            discovered_systems_.end(),
+            [&system](const DiscoveredSystem& discovered) { return discovered.system == system; });
+        if (it != discovered_systems_.end()) {
+            continue;
+        }
+
+        DiscoveredSystem discovered{};
+        discovered.system = system;
+        discovered.system_id = system->get_system_id();
+        discovered.time_to_discovery =
+            std::chrono::duration_cast<std::chrono::milliseconds>(now - start_time_);
+        discovered_systems_.push_back(discovered);
+        found_new = true;
+    }
+
+    if (found_new) {
+        cv_.notify_all();
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <mavsdk/mavsdk.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief The SystemDiscovery class
+ * Waits for systems to be discovered and connected instead of sleeping for a fixed time.
+ * The wait returns as soon as the expected number of systems is connected, or when the
+ * deadline has passed, whichever comes first.
+ */
+class SystemDiscovery {
+public:
+    struct DiscoveredSystem {
+        std::shared_ptr<mavsdk::System> system;
+        uint8_t system_id;
+        std::chrono::milliseconds time_to_discovery;
+    };
+
+    // Heartbeats usually arrive at 1 Hz, so this leaves plenty of margin for slow links.
+    static constexpr std::chrono::milliseconds default_timeout{10000};
+
+    explicit SystemDiscovery(mavsdk::Mavsdk& mavsdk);
+
+    ~SystemDiscovery();
+
+    // Blocks until at least `expected_systems` systems are connected or `timeout` has passed.
+    // Returns true if enough systems were found in time.
+    bool wait_for_systems(size_t expected_systems, std::chrono::milliseconds timeout);
+
+    // Systems in the order they got connected, with the time since construction.
+    std::vector<DiscoveredSystem> discovered_systems() const;
+
+private:
+    void check_systems();
+
+    mavsdk::Mavsdk& mavsdk_;
+    const std::chrono::steady_clock::time_point start_time_;
+
+    mutable std::mutex mutex_{};
+    std::condition_variable cv_{};
+    std::vector<DiscoveredSystem> discovered_systems_{};
+};
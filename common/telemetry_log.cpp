@@ -0,0 +1,272 @@
+#include "telemetry_log.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Large enough that a flush only happens every couple of thousand records.
+constexpr size_t write_buffer_size = 64 * 1024;
+
+TelemetryFieldDescriptor
+make_field(const char* name, size_t offset, TelemetryFieldType type, double scale)
+{
+    TelemetryFieldDescriptor field{};
+    strncpy(field.name, name, sizeof(field.name) - 1);
+    field.offset = static_cast<uint16_t>(offset);
+    field.type = type;
+    field.scale = scale;
+    return field;
+}
+
+// 0 for types this reader doesn't know.
+size_t field_size(TelemetryFieldType type)
+{
+    switch (type) {
+        case TelemetryFieldType::Uint8:
+            return 1;
+        case TelemetryFieldType::Int32:
+        case TelemetryFieldType::Uint32:
+            return 4;
+        case TelemetryFieldType::Uint64:
+            return 8;
+    }
+    return 0;
+}
+
+// The field descriptors have to fit into the header and every field into a record, the
+// reader trusts them after opening.
+bool layout_valid(const TelemetryLogHeader& header)
+{
+    if (header.field_count > TelemetryLogHeader::max_fields ||
+        header.header_size < offsetof(TelemetryLogHeader, fields) +
+                                 header.field_count * sizeof(TelemetryFieldDescriptor)) {
+        return false;
+    }
+    for (size_t i = 0; i < header.field_count; ++i) {
+        const size_t size = field_size(header.fields[i].type);
+        if (size == 0 || header.fields[i].offset + size > header.record_size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TelemetryLogHeader make_header()
+{
+    TelemetryLogHeader header{};
+    memcpy(header.magic, telemetry_log_magic, sizeof(header.magic));
+    header.version = telemetry_log_version;
+    header.header_size = sizeof(TelemetryLogHeader);
+    header.record_size = sizeof(TelemetryRecord);
+
+    const TelemetryFieldDescriptor fields[] = {
+        make_field(
+            "time_ns", offsetof(TelemetryRecord, monotonic_ns), TelemetryFieldType::Uint64, 1.0),
+        make_field(
+            "system_id", offsetof(TelemetryRecord, system_id), TelemetryFieldType::Uint8, 1.0),
+        make_field(
+            "time_boot_ms",
+            offsetof(TelemetryRecord, time_boot_ms),
+            TelemetryFieldType::Uint32,
+            1.0),
+        make_field(
+            "synced_time_ns",
+            offsetof(TelemetryRecord, synced_monotonic_ns),
+            TelemetryFieldType::Uint64,
+            1.0),
+        make_field(
+            "latitude_deg",
+            offsetof(TelemetryRecord, latitude_e7),
+            TelemetryFieldType::Int32,
+            1e-7),
+        make_field(
+            "longitude_deg",
+            offsetof(TelemetryRecord, longitude_e7),
+            TelemetryFieldType::Int32,
+            1e-7),
+        make_field(
+            "absolute_altitude_m",
+            offsetof(TelemetryRecord, absolute_altitude_mm),
+            TelemetryFieldType::Int32,
+            1e-3),
+        make_field(
+            "relative_altitude_m",
+            offsetof(TelemetryRecord, relative_altitude_mm),
+            TelemetryFieldType::Int32,
+            1e-3),
+    };
+
+    header.field_count = sizeof(fields) / sizeof(fields[0]);
+    for (size_t i = 0; i < header.field_count; ++i) {
+        header.fields[i] = fields[i];
+    }
+
+    header.wall_clock_start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::system_clock::now().time_since_epoch())
+                                     .count();
+    header.monotonic_start_ns = telemetry_log_now_ns();
+    return header;
+}
+
+} // namespace
+
+constexpr size_t TelemetryLogHeader::max_fields;
+
+uint64_t telemetry_log_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+TelemetryLogWriter::~TelemetryLogWriter()
+{
+    close();
+}
+
+bool TelemetryLogWriter::open(const std::string& path)
+{
+    close();
+
+    file_ = std::fopen(path.c_str(), "wb");
+    if (file_ == nullptr) {
+        std::cerr << "Could not open " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    setvbuf(file_, nullptr, _IOFBF, write_buffer_size);
+
+    const TelemetryLogHeader header = make_header();
+    if (std::fwrite(&header, sizeof(header), 1, file_) != 1) {
+        std::cerr << "Could not write header to " << path << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool TelemetryLogWriter::write(const TelemetryRecord* records, size_t count)
+{
+    if (file_ == nullptr) {
+        return false;
+    }
+    return std::fwrite(records, sizeof(TelemetryRecord), count, file_) == count;
+}
+
+bool TelemetryLogWriter::flush()
+{
+    return file_ != nullptr && std::fflush(file_) == 0;
+}
+
+void TelemetryLogWriter::close()
+{
+    if (file_ != nullptr) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+TelemetryLogReader::~TelemetryLogReader()
+{
+    close();
+}
+
+bool TelemetryLogReader::open(const std::string& path)
+{
+    close();
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Could not open " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat file_stat {};
+    if (fstat(fd, &file_stat) != 0 ||
+        static_cast<size_t>(file_stat.st_size) < offsetof(TelemetryLogHeader, fields)) {
+        std::cerr << path << " is too short for a telemetry log" << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    mapping_size_ = static_cast<size_t>(file_stat.st_size);
+    mapping_ = mmap(nullptr, mapping_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after closing the file descriptor.
+    ::close(fd);
+    if (mapping_ == MAP_FAILED) {
+        std::cerr << "Could not map " << path << ": " << strerror(errno) << std::endl;
+        mapping_ = nullptr;
+        return false;
+    }
+    // Records are read front to back.
+    madvise(mapping_, mapping_size_, MADV_SEQUENTIAL);
+
+    header_ = static_cast<const TelemetryLogHeader*>(mapping_);
+    if (memcmp(header_->magic, telemetry_log_magic, sizeof(header_->magic)) != 0) {
+        std::cerr << path << " is not a telemetry log" << std::endl;
+        close();
+        return false;
+    }
+    if (header_->version > telemetry_log_version || header_->record_size == 0 ||
+        header_->header_size > mapping_size_ || !layout_valid(*header_)) {
+        std::cerr << path << " has an unsupported version or layout" << std::endl;
+        close();
+        return false;
+    }
+
+    records_ = static_cast<const uint8_t*>(mapping_) + header_->header_size;
+    record_count_ = (mapping_size_ - header_->header_size) / header_->record_size;
+    return true;
+}
+
+void TelemetryLogReader::close()
+{
+    if (mapping_ != nullptr) {
+        munmap(mapping_, mapping_size_);
+    }
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+    header_ = nullptr;
+    records_ = nullptr;
+    record_count_ = 0;
+}
+
+const TelemetryRecord* TelemetryLogReader::records() const
+{
+    if (header_ == nullptr || header_->record_size != sizeof(TelemetryRecord) ||
+        header_->version != telemetry_log_version) {
+        return nullptr;
+    }
+    return reinterpret_cast<const TelemetryRecord*>(records_);
+}
+
+int64_t
+TelemetryLogReader::field_raw(const TelemetryFieldDescriptor& field, const uint8_t* raw_record)
+{
+    const uint8_t* data = raw_record + field.offset;
+    switch (field.type) {
+        case TelemetryFieldType::Uint8:
+            return *data;
+        case TelemetryFieldType::Int32: {
+            int32_t value;
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        case TelemetryFieldType::Uint32: {
+            uint32_t value;
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        case TelemetryFieldType::Uint64: {
+            uint64_t value;
+            memcpy(&value, data, sizeof(value));
+            return static_cast<int64_t>(value);
+        }
+    }
+    return 0;
+}
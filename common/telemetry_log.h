@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Binary telemetry log: a fixed header which describes the record layout, followed by
+// fixed-size records. Files can be read without parsing by mapping them into memory.
+
+/**
+ * @brief One position sample.
+ * Angles are integers in 1e-7 deg and altitudes in mm, like in MAVLink.
+ */
+struct TelemetryRecord {
+    uint64_t monotonic_ns; // steady clock, see TelemetryLogHeader for the wall clock offset
+    // When the vehicle took the sample, mapped to the same steady clock with ClockSync.
+    // 0 while the clocks are not synced yet.
+    uint64_t synced_monotonic_ns;
+    int32_t latitude_e7;
+    int32_t longitude_e7;
+    int32_t absolute_altitude_mm;
+    int32_t relative_altitude_mm;
+    uint32_t time_boot_ms; // vehicle clock
+    uint8_t system_id;
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(TelemetryRecord) == 40, "TelemetryRecord layout changed");
+
+enum class TelemetryFieldType : uint8_t { Uint8 = 1, Int32 = 2, Uint32 = 3, Uint64 = 4 };
+
+/**
+ * @brief Describes one column of a TelemetryRecord so readers don't need to be rebuilt
+ * when fields are added.
+ */
+struct TelemetryFieldDescriptor {
+    char name[24];
+    uint16_t offset;
+    TelemetryFieldType type;
+    uint8_t reserved[5];
+    double scale; // multiply the raw value by this to get the unit in the name
+};
+
+static_assert(sizeof(TelemetryFieldDescriptor) == 40, "TelemetryFieldDescriptor layout changed");
+
+struct TelemetryLogHeader {
+    static constexpr size_t max_fields = 16;
+
+    char magic[8];
+    uint16_t version;
+    uint16_t header_size;
+    uint16_t record_size;
+    uint16_t field_count;
+    // Both clocks sampled when the log was opened, to map record times to wall clock time.
+    int64_t wall_clock_start_ns;
+    uint64_t monotonic_start_ns;
+    TelemetryFieldDescriptor fields[max_fields];
+};
+
+constexpr char telemetry_log_magic[8] = {'M', 'S', 'D', 'K', 'T', 'L', 'M', '\0'};
+constexpr uint16_t telemetry_log_version = 2;
+
+// Monotonic time in ns to stamp records with.
+uint64_t telemetry_log_now_ns();
+
+/**
+ * @brief The TelemetryLogWriter class
+ * Appends records to a binary telemetry log. Not thread safe, use one writer per thread.
+ */
+class TelemetryLogWriter {
+public:
+    TelemetryLogWriter() = default;
+
+    ~TelemetryLogWriter();
+
+    TelemetryLogWriter(const TelemetryLogWriter&) = delete;
+    TelemetryLogWriter& operator=(const TelemetryLogWriter&) = delete;
+
+    bool open(const std::string& path);
+
+    bool write(const TelemetryRecord& record) { return write(&record, 1); }
+
+    bool write(const TelemetryRecord* records, size_t count);
+
+    bool flush();
+
+    void close();
+
+    bool is_open() const { return file_ != nullptr; }
+
+private:
+    std::FILE* file_{nullptr};
+};
+
+/**
+ * @brief The TelemetryLogReader class
+ * Maps a binary telemetry log into memory and gives direct access to the records.
+ * A partial record at the end (e.g. after a crash) is ignored.
+ */
+class TelemetryLogReader {
+public:
+    TelemetryLogReader() = default;
+
+    ~TelemetryLogReader();
+
+    TelemetryLogReader(const TelemetryLogReader&) = delete;
+    TelemetryLogReader& operator=(const TelemetryLogReader&) = delete;
+
+    bool open(const std::string& path);
+
+    void close();
+
+    const TelemetryLogHeader& header() const { return *header_; }
+
+    size_t size() const { return record_count_; }
+
+    // Raw record, use the field descriptors of the header to decode it if the layout
+    // doesn't match the TelemetryRecord this was compiled with.
+    const uint8_t* raw_record(size_t index) const { return records_ + index * header_->record_size; }
+
+    // Returns nullptr if the file has a different record layout.
+    const TelemetryRecord* records() const;
+
+    // Raw integer value of a field, without scale.
+    static int64_t field_raw(const TelemetryFieldDescriptor& field, const uint8_t* raw_record);
+
+    // Value of a field as double, already multiplied by its scale.
+    static double field_value(const TelemetryFieldDescriptor& field, const uint8_t* raw_record)
+    {
+        return static_cast<double>(field_raw(field, raw_record)) * field.scale;
+    }
+
+private:
+    void* mapping_{nullptr};
+    size_t mapping_size_{0};
+    const TelemetryLogHeader* header_{nullptr};
+    const uint8_t* records_{nullptr};
+    size_t record_count_{0};
+};
@@ -0,0 +1,175 @@
+#include "telemetry_waiter.h"
+#include <sstream>
+
+using namespace mavsdk;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+constexpr milliseconds TelemetryWaiter::default_timeout;
+
+template<typename F> void TelemetryWaiter::update(F change_state)
+{
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        change_state(state_);
+        last_update_time_ = steady_clock::now();
+
+        for (auto it = pending_.begin(); it != pending_.end();) {
+            if (it->predicate(state_)) {
+                ready.push_back(std::move(it->callback));
+                it = pending_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    cv_.notify_all();
+
+    // Outside the lock, callbacks may register new ones.
+    for (auto& callback : ready) {
+        callback();
+    }
+}
+
+TelemetryWaiter::TelemetryWaiter(std::shared_ptr<Telemetry> telemetry) : telemetry_(telemetry)
+{
+    // Start from the current state, the subscriptions only report changes from now on.
+    state_.health_all_ok = telemetry_->health_all_ok();
+    state_.armed = telemetry_->armed();
+    state_.in_air = telemetry_->in_air();
+    state_.landed_state = telemetry_->landed_state();
+    last_update_time_ = steady_clock::now();
+
+    telemetry_->subscribe_health_all_ok([this](bool health_all_ok) {
+        update([health_all_ok](State& state) { state.health_all_ok = health_all_ok; });
+    });
+    telemetry_->subscribe_armed(
+        [this](bool armed) { update([armed](State& state) { state.armed = armed; }); });
+    telemetry_->subscribe_in_air(
+        [this](bool in_air) { update([in_air](State& state) { state.in_air = in_air; }); });
+    telemetry_->subscribe_landed_state([this](Telemetry::LandedState landed_state) {
+        update([landed_state](State& state) { state.landed_state = landed_state; });
+    });
+    telemetry_->subscribe_position([this](Telemetry::Position position) {
+        update([&position](State& state) {
+            state.relative_altitude_m = position.relative_altitude_m;
+        });
+
+        position_callback_t position_callback;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            position_callback = position_callback_;
+        }
+        if (position_callback) {
+            position_callback(position);
+        }
+    });
+}
+
+TelemetryWaiter::~TelemetryWaiter()
+{
+    telemetry_->subscribe_health_all_ok(nullptr);
+    telemetry_->subscribe_armed(nullptr);
+    telemetry_->subscribe_in_air(nullptr);
+    telemetry_->subscribe_landed_state(nullptr);
+    telemetry_->subscribe_position(nullptr);
+}
+
+TelemetryWaiter::State TelemetryWaiter::state() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return state_;
+}
+
+TelemetryWaiter::WaitResult TelemetryWaiter::wait_until(predicate_t predicate, milliseconds timeout)
+{
+    const auto start_time = steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (predicate(state_)) {
+        return WaitResult{true, milliseconds(0), microseconds(0)};
+    }
+
+    const bool satisfied = cv_.wait_until(
+        lock, start_time + timeout, [this, &predicate]() { return predicate(state_); });
+    const auto now = steady_clock::now();
+
+    WaitResult result{};
+    result.satisfied = satisfied;
+    result.waited = duration_cast<milliseconds>(now - start_time);
+    result.wake_up_latency =
+        satisfied ? duration_cast<microseconds>(now - last_update_time_) : microseconds(0);
+    return result;
+}
+
+TelemetryWaiter::WaitResult TelemetryWaiter::wait_for_health_all_ok(milliseconds timeout)
+{
+    return wait_until([](const State& state) { return state.health_all_ok; }, timeout);
+}
+
+TelemetryWaiter::WaitResult
+TelemetryWaiter::wait_for_altitude_above(float altitude_m, milliseconds timeout)
+{
+    return wait_until(
+        [altitude_m](const State& state) { return state.relative_altitude_m > altitude_m; },
+        timeout);
+}
+
+TelemetryWaiter::WaitResult TelemetryWaiter::wait_for_landed(milliseconds timeout)
+{
+    return wait_until(&TelemetryWaiter::is_landed, timeout);
+}
+
+TelemetryWaiter::WaitResult TelemetryWaiter::wait_for_disarmed(milliseconds timeout)
+{
+    return wait_until([](const State& state) { return !state.armed; }, timeout);
+}
+
+void TelemetryWaiter::when(predicate_t predicate, std::function<void()> callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!predicate(state_)) {
+            pending_.push_back(PendingCallback{predicate, callback});
+            return;
+        }
+    }
+    callback();
+}
+
+void TelemetryWaiter::cancel_all()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.clear();
+}
+
+void TelemetryWaiter::subscribe_position(position_callback_t callback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    position_callback_ = callback;
+}
+
+bool TelemetryWaiter::is_landed(const State& state)
+{
+    if (state.landed_state != Telemetry::LandedState::Unknown) {
+        return state.landed_state == Telemetry::LandedState::OnGround;
+    }
+    return !state.in_air;
+}
+
+std::string TelemetryWaiter::to_string(const WaitResult& result)
+{
+    std::stringstream ss;
+    if (!result.satisfied) {
+        ss << "timed out after " << result.waited.count() << " ms";
+    } else if (result.waited.count() == 0 && result.wake_up_latency.count() == 0) {
+        ss << "right away";
+    } else {
+        ss << "after " << result.waited.count() << " ms, woke up "
+           << result.wake_up_latency.count() << " us after the update";
+    }
+    return ss.str();
+}
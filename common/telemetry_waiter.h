@@ -0,0 +1,97 @@
+#pragma once
+
+#include <mavsdk/plugins/telemetry/telemetry.h>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The TelemetryWaiter class
+ * Waits for conditions on the vehicle state, e.g. healthy, above an altitude or landed,
+ * by subscribing to the telemetry updates instead of polling every second. A wait wakes
+ * up on the update that makes the predicate true, or when the timeout has passed.
+ *
+ * Telemetry keeps only one callback per subscription, so while a waiter exists don't
+ * subscribe to health, armed, in-air, landed state or position on the same Telemetry
+ * directly. Use subscribe_position() here to still get the positions.
+ */
+class TelemetryWaiter {
+public:
+    struct State {
+        bool health_all_ok{false};
+        bool armed{false};
+        bool in_air{false};
+        mavsdk::Telemetry::LandedState landed_state{mavsdk::Telemetry::LandedState::Unknown};
+        float relative_altitude_m{NAN};
+    };
+
+    struct WaitResult {
+        bool satisfied;
+        std::chrono::milliseconds waited;
+        // From the telemetry update that satisfied the predicate until the waiting thread
+        // ran again. Zero if the predicate already held when the wait started.
+        std::chrono::microseconds wake_up_latency;
+    };
+
+    typedef std::function<bool(const State&)> predicate_t;
+    typedef std::function<void(mavsdk::Telemetry::Position)> position_callback_t;
+
+    // Long enough for a vehicle to get a GPS fix or to land from a usual test altitude.
+    static constexpr std::chrono::milliseconds default_timeout{120000};
+
+    explicit TelemetryWaiter(std::shared_ptr<mavsdk::Telemetry> telemetry);
+
+    ~TelemetryWaiter();
+
+    TelemetryWaiter(const TelemetryWaiter&) = delete;
+    TelemetryWaiter& operator=(const TelemetryWaiter&) = delete;
+
+    State state() const;
+
+    // Blocks until the predicate holds for the latest state or the timeout has passed.
+    WaitResult wait_until(predicate_t predicate, std::chrono::milliseconds timeout);
+
+    WaitResult wait_for_health_all_ok(std::chrono::milliseconds timeout = default_timeout);
+    WaitResult
+    wait_for_altitude_above(float altitude_m, std::chrono::milliseconds timeout = default_timeout);
+    // On the ground according to the landed state, or not in air if there is no landed state.
+    WaitResult wait_for_landed(std::chrono::milliseconds timeout = default_timeout);
+    WaitResult wait_for_disarmed(std::chrono::milliseconds timeout = default_timeout);
+
+    // Doesn't block: the callback runs once as soon as the predicate holds, either right
+    // away on the calling thread or later on a MAVSDK thread. It must not block either.
+    void when(predicate_t predicate, std::function<void()> callback);
+
+    // Drops all callbacks registered with when() which have not run yet.
+    void cancel_all();
+
+    void subscribe_position(position_callback_t callback);
+
+    static bool is_landed(const State& state);
+
+    // E.g. "after 1520 ms, woke up 80 us after the update" or "timed out after 60000 ms"
+    static std::string to_string(const WaitResult& result);
+
+private:
+    struct PendingCallback {
+        predicate_t predicate;
+        std::function<void()> callback;
+    };
+
+    template<typename F> void update(F change_state);
+
+    std::shared_ptr<mavsdk::Telemetry> telemetry_;
+
+    mutable std::mutex mutex_{};
+    std::condition_variable cv_{};
+    State state_{};
+    std::chrono::steady_clock::time_point last_update_time_{};
+    std::vector<PendingCallback> pending_{};
+    position_callback_t position_callback_{};
+};
@@ -0,0 +1,439 @@
+#include "tlog.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+constexpr size_t timestamp_size = 8;
+
+// MAVLink v2 frames with this incompatibility flag carry a 13 byte signature.
+constexpr uint8_t mavlink_incompat_flag_signed = 0x01;
+
+// Consecutive entries further apart than this are out of sync: garbage that looks like an
+// entry, or another session appended to the same file. The cursor searches again.
+constexpr uint64_t max_time_jump_us = 3600ull * 1000000ull;
+
+// Consecutive entries that have to parse before a position is taken as the start of one.
+constexpr unsigned entries_to_confirm = 4;
+
+// Entries handed to one writev() call, well below IOV_MAX.
+constexpr size_t batch_size = 256;
+
+// How long the writer sleeps when there was nothing to write.
+constexpr std::chrono::milliseconds idle_interval{10};
+
+uint64_t read_big_endian_u64(const uint8_t* data)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+void write_big_endian_u64(uint8_t* data, uint64_t value)
+{
+    for (size_t i = 0; i < 8; ++i) {
+        data[7 - i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+size_t round_up_to_power_of_two(size_t value)
+{
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+// Parses the entry at position, without searching.
+bool parse_entry(
+    const uint8_t* data, size_t size, size_t position, uint64_t last_time_us, TlogEntry& entry)
+{
+    if (position + timestamp_size >= size) {
+        return false;
+    }
+    const uint8_t* const frame = data + position + timestamp_size;
+    const size_t frame_len = mavlink_frame_length(frame, size - position - timestamp_size);
+    if (frame_len == 0) {
+        return false;
+    }
+
+    const uint64_t time_us = read_big_endian_u64(data + position);
+    const uint64_t time_jump_us =
+        time_us > last_time_us ? time_us - last_time_us : last_time_us - time_us;
+    if (last_time_us != 0 && time_jump_us > max_time_jump_us) {
+        return false;
+    }
+
+    entry.time_us = time_us;
+    entry.frame = frame;
+    entry.frame_len = frame_len;
+    return true;
+}
+
+} // namespace
+
+constexpr size_t TlogWriter::default_capacity;
+constexpr std::chrono::milliseconds TlogWriter::default_flush_interval;
+
+size_t mavlink_frame_length(const uint8_t* data, size_t available)
+{
+    if (available < 2) {
+        return 0;
+    }
+
+    size_t len;
+    if (data[0] == mavlink_v1_magic) {
+        // magic, len, seq, sysid, compid, msgid, payload, checksum
+        len = 6 + data[1] + 2;
+    } else if (data[0] == mavlink_v2_magic) {
+        if (available < 3) {
+            return 0;
+        }
+        // magic, len, incompat, compat, seq, sysid, compid, msgid (3), payload, checksum
+        len = 10 + data[1] + 2;
+        if ((data[2] & mavlink_incompat_flag_signed) != 0) {
+            len += 13;
+        }
+    } else {
+        return 0;
+    }
+    return len <= available ? len : 0;
+}
+
+MavlinkFrameHeader mavlink_frame_header(const uint8_t* frame)
+{
+    MavlinkFrameHeader header{};
+    if (frame[0] == mavlink_v1_magic) {
+        header.sequence = frame[2];
+        header.system_id = frame[3];
+        header.component_id = frame[4];
+        header.message_id = frame[5];
+    } else {
+        header.sequence = frame[4];
+        header.system_id = frame[5];
+        header.component_id = frame[6];
+        header.message_id = uint32_t(frame[7]) | (uint32_t(frame[8]) << 8) |
+                            (uint32_t(frame[9]) << 16);
+    }
+    return header;
+}
+
+TlogReader::~TlogReader()
+{
+    close();
+}
+
+bool TlogReader::open(const std::string& path)
+{
+    close();
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Could not open " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat file_stat {};
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        std::cerr << path << " is empty" << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    size_ = static_cast<size_t>(file_stat.st_size);
+    void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Could not map " << path << ": " << strerror(errno) << std::endl;
+        size_ = 0;
+        return false;
+    }
+    madvise(mapping, size_, MADV_SEQUENTIAL);
+
+    data_ = static_cast<const uint8_t*>(mapping);
+    rewind();
+    return true;
+}
+
+void TlogReader::close()
+{
+    if (data_ != nullptr) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    rewind();
+}
+
+TlogCursor::TlogCursor(const uint8_t* data, size_t size, size_t begin, size_t end) :
+    data_(data),
+    size_(size),
+    end_(std::min(end, size)),
+    position_(begin)
+{}
+
+bool TlogCursor::next(TlogEntry& entry)
+{
+    if (position_ >= end_) {
+        return false;
+    }
+
+    // Only an entry right after a confirmed one is trusted on its own. The first one, the
+    // one after garbage and the one after a jump in time have to start a few in a row.
+    if (last_time_us_ == 0 || !parse_entry(data_, size_, position_, last_time_us_, entry)) {
+        const size_t found = std::min(find_entry(data_, size_, position_), end_);
+        skipped_bytes_ += found - position_;
+        position_ = found;
+        if (position_ >= end_ || !parse_entry(data_, size_, position_, 0, entry)) {
+            return false;
+        }
+    }
+
+    position_ += timestamp_size + entry.frame_len;
+    last_time_us_ = entry.time_us;
+    return true;
+}
+
+size_t TlogCursor::find_entry(const uint8_t* data, size_t size, size_t from)
+{
+    for (size_t candidate = from; candidate < size; ++candidate) {
+        size_t position = candidate;
+        uint64_t last_time_us = 0;
+        unsigned parsed = 0;
+        TlogEntry entry;
+        while (parsed < entries_to_confirm &&
+               parse_entry(data, size, position, last_time_us, entry)) {
+            position += timestamp_size + entry.frame_len;
+            last_time_us = entry.time_us;
+            ++parsed;
+        }
+        // Fewer entries are fine if the data ends right after them.
+        if (parsed == entries_to_confirm || (parsed > 0 && position == size)) {
+            return candidate;
+        }
+    }
+    return size;
+}
+
+void TlogReader::rewind()
+{
+    cursor_ = TlogCursor(data_, size_, 0, size_);
+}
+
+TlogWriter::TlogWriter(size_t capacity, std::chrono::milliseconds flush_interval) :
+    capacity_(round_up_to_power_of_two(capacity)),
+    mask_(capacity_ - 1),
+    flush_interval_(flush_interval),
+    slots_(new Slot[capacity_])
+{
+    for (size_t i = 0; i < capacity_; ++i) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+        slots_[i].len = 0;
+    }
+}
+
+TlogWriter::~TlogWriter()
+{
+    close();
+}
+
+bool TlogWriter::open(const std::string& path)
+{
+    close();
+
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Could not open " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    should_exit_ = false;
+    thread_ = std::thread(&TlogWriter::run, this);
+    return true;
+}
+
+void TlogWriter::close()
+{
+    if (thread_.joinable()) {
+        should_exit_ = true;
+        thread_.join();
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool TlogWriter::push(uint64_t time_us, const uint8_t* frame, size_t frame_len)
+{
+    if (frame_len > mavlink_max_frame_length) {
+        return false;
+    }
+    return push(time_us, [frame, frame_len](uint8_t* destination) {
+        memcpy(destination, frame, frame_len);
+        return frame_len;
+    });
+}
+
+TlogWriter::Stats TlogWriter::stats() const
+{
+    Stats stats{};
+    stats.pushed = pushed_.load(std::memory_order_relaxed);
+    stats.written = written_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.bytes_written = bytes_written_.load(std::memory_order_relaxed);
+    stats.writes = writes_.load(std::memory_order_relaxed);
+    stats.write_errors = write_errors_.load(std::memory_order_relaxed);
+    stats.queue_high_water_mark = high_water_mark_.load(std::memory_order_relaxed);
+    stats.queue_capacity = capacity_;
+    return stats;
+}
+
+uint64_t TlogWriter::now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+TlogWriter::Slot* TlogWriter::claim_slot(size_t& position)
+{
+    position = head_.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot& slot = slots_[position & mask_];
+        const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == position) {
+            // Free for this round, try to take it. On failure position is reloaded.
+            if (head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                return &slot;
+            }
+        } else if (sequence < position) {
+            // Still waiting for the writer from the last round.
+            return nullptr;
+        } else {
+            // Someone else took it in the meantime.
+            position = head_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void TlogWriter::publish(Slot* slot, size_t position, uint64_t time_us, size_t frame_len)
+{
+    write_big_endian_u64(slot->entry, time_us);
+    slot->len = frame_len > 0 ? 8 + frame_len : 0;
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+void TlogWriter::run()
+{
+    auto last_write = std::chrono::steady_clock::now();
+
+    while (true) {
+        // Read the flag first so that everything pushed before close() was called
+        // is still written in the last round.
+        const bool exiting = should_exit_;
+
+        // Full batches are written right away, the rest once the flush interval passed.
+        const auto now = std::chrono::steady_clock::now();
+        const size_t min_count = (exiting || now - last_write >= flush_interval_) ? 1 : batch_size;
+
+        bool wrote_something = false;
+        while (write_ready(min_count) > 0) {
+            wrote_something = true;
+        }
+        if (wrote_something) {
+            last_write = now;
+        }
+
+        if (exiting) {
+            break;
+        }
+        if (!wrote_something) {
+            std::this_thread::sleep_for(idle_interval);
+        }
+    }
+}
+
+size_t TlogWriter::write_ready(size_t min_count)
+{
+    const size_t tail = tail_;
+
+    // Slots are filled in the order they were claimed, but published in any order.
+    // Stop at the first one still being filled.
+    size_t count = 0;
+    while (count < batch_size &&
+           slots_[(tail + count) & mask_].sequence.load(std::memory_order_acquire) ==
+               tail + count + 1) {
+        ++count;
+    }
+    if (count == 0 || count < min_count) {
+        return 0;
+    }
+
+    const size_t queued = head_.load(std::memory_order_relaxed) - tail;
+    if (queued > high_water_mark_.load(std::memory_order_relaxed)) {
+        high_water_mark_.store(queued, std::memory_order_relaxed);
+    }
+
+    struct iovec iov[batch_size];
+    int iov_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        Slot& slot = slots_[(tail + i) & mask_];
+        if (slot.len > 0) {
+            iov[iov_count].iov_base = slot.entry;
+            iov[iov_count].iov_len = slot.len;
+            ++iov_count;
+        }
+    }
+
+    struct iovec* current = iov;
+    int remaining = iov_count;
+    uint64_t bytes_written = 0;
+    while (remaining > 0) {
+        ssize_t result = writev(fd_, current, remaining);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            write_errors_.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+        bytes_written += static_cast<uint64_t>(result);
+
+        // Continue after a partial write, possibly in the middle of an entry.
+        size_t done = static_cast<size_t>(result);
+        while (remaining > 0 && done >= current->iov_len) {
+            done -= current->iov_len;
+            ++current;
+            --remaining;
+        }
+        if (remaining > 0) {
+            current->iov_base = static_cast<uint8_t*>(current->iov_base) + done;
+            current->iov_len -= done;
+        }
+    }
+    if (iov_count > 0) {
+        writes_.fetch_add(1, std::memory_order_relaxed);
+    }
+    bytes_written_.fetch_add(bytes_written, std::memory_order_relaxed);
+    written_.fetch_add(static_cast<uint64_t>(iov_count - remaining), std::memory_order_relaxed);
+    dropped_.fetch_add(static_cast<uint64_t>(remaining), std::memory_order_relaxed);
+
+    // Back to the producers, for the next round through the ring.
+    for (size_t i = 0; i < count; ++i) {
+        slots_[(tail + i) & mask_].sequence.store(
+            tail + i + capacity_, std::memory_order_release);
+    }
+    tail_ = tail + count;
+    return count;
+}
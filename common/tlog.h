@@ -0,0 +1,218 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The .tlog format written by QGroundControl and MAVProxy: every MAVLink frame as it was
+// on the wire, preceded by the capture time in us since the Unix epoch, big endian.
+
+constexpr uint8_t mavlink_v1_magic = 0xFE;
+constexpr uint8_t mavlink_v2_magic = 0xFD;
+
+// A signed MAVLink v2 frame with the largest payload.
+constexpr size_t mavlink_max_frame_length = 280;
+
+// Size of the MAVLink v1 or v2 frame starting at data, including checksum and signature.
+// 0 if data doesn't start with a magic byte or the frame is cut off.
+size_t mavlink_frame_length(const uint8_t* data, size_t available);
+
+// The header fields of a frame that mavlink_frame_length() accepted.
+struct MavlinkFrameHeader {
+    uint8_t sequence;
+    uint8_t system_id;
+    uint8_t component_id;
+    uint32_t message_id;
+};
+
+MavlinkFrameHeader mavlink_frame_header(const uint8_t* frame);
+
+struct TlogEntry {
+    uint64_t time_us;
+    const uint8_t* frame;
+    size_t frame_len;
+};
+
+/**
+ * @brief The TlogCursor class
+ * Walks the .tlog entries in a range of memory without copying. Garbage between entries
+ * (e.g. a capture that was cut off mid-write) is skipped by searching for the next
+ * plausible entry, as is a jump in time, e.g. where another session was appended to the
+ * file. Several cursors can walk different parts of the same data in parallel.
+ */
+class TlogCursor {
+public:
+    TlogCursor() = default;
+
+    // Entries start at begin or later and before end, the last one may reach up to size.
+    TlogCursor(const uint8_t* data, size_t size, size_t begin, size_t end);
+
+    // The frame points into the data.
+    bool next(TlogEntry& entry);
+
+    // Where the next entry is searched for.
+    size_t position() const { return position_; }
+
+    uint64_t skipped_bytes() const { return skipped_bytes_; }
+
+    // The first position at or after from where a few entries in a row parse, which
+    // makes it very unlikely that it is in the middle of a frame. size if there is none.
+    static size_t find_entry(const uint8_t* data, size_t size, size_t from);
+
+private:
+    const uint8_t* data_{nullptr};
+    size_t size_{0};
+    size_t end_{0};
+    size_t position_{0};
+    uint64_t last_time_us_{0};
+    uint64_t skipped_bytes_{0};
+};
+
+/**
+ * @brief The TlogReader class
+ * Maps a .tlog into memory and walks it front to back.
+ */
+class TlogReader {
+public:
+    TlogReader() = default;
+
+    ~TlogReader();
+
+    TlogReader(const TlogReader&) = delete;
+    TlogReader& operator=(const TlogReader&) = delete;
+
+    bool open(const std::string& path);
+
+    void close();
+
+    // The frame points into the mapping and stays valid until close().
+    bool next(TlogEntry& entry) { return cursor_.next(entry); }
+
+    void rewind();
+
+    // The whole mapping, e.g. to walk parts of it with separate cursors.
+    const uint8_t* data() const { return data_; }
+
+    size_t size_bytes() const { return size_; }
+
+    uint64_t skipped_bytes() const { return cursor_.skipped_bytes(); }
+
+private:
+    const uint8_t* data_{nullptr};
+    size_t size_{0};
+    TlogCursor cursor_{};
+};
+
+/**
+ * @brief The TlogWriter class
+ * Writes a .tlog from any number of threads without blocking them, e.g. from the MAVLink
+ * receive thread and from every thread that sends.
+ *
+ * Entries go into a preallocated ring of fixed size slots: push() claims a slot with a
+ * single CAS and writes the timestamp and frame right into it. A writer thread hands the
+ * filled slots to the OS in batches with writev(), straight out of the ring, and then
+ * gives them back to the producers. Memory is bounded by the capacity; if the disk can't
+ * keep up, entries are dropped and counted instead of blocking.
+ */
+class TlogWriter {
+public:
+    struct Stats {
+        uint64_t pushed{0};
+        uint64_t written{0};
+        uint64_t dropped{0};
+        uint64_t bytes_written{0};
+        // Calls of writev(), each one a batch of entries.
+        uint64_t writes{0};
+        uint64_t write_errors{0};
+        size_t queue_high_water_mark{0};
+        size_t queue_capacity{0};
+    };
+
+    // 2 s at 4000 frames/s, about 2.4 MB.
+    static constexpr size_t default_capacity = 8192;
+    static constexpr std::chrono::milliseconds default_flush_interval{200};
+
+    // The capacity is rounded up to the next power of two.
+    explicit TlogWriter(
+        size_t capacity = default_capacity,
+        std::chrono::milliseconds flush_interval = default_flush_interval);
+
+    // Writes everything still queued.
+    ~TlogWriter();
+
+    TlogWriter(const TlogWriter&) = delete;
+    TlogWriter& operator=(const TlogWriter&) = delete;
+
+    // Creates or truncates the file and starts the writer thread.
+    bool open(const std::string& path);
+
+    // Writes everything still queued and closes the file.
+    void close();
+
+    // Thread safe. write_frame(uint8_t* frame) writes one frame of at most
+    // mavlink_max_frame_length bytes to frame and returns its length, 0 to skip it.
+    // Returns false if the entry was dropped because the ring is full.
+    template<typename F> bool push(uint64_t time_us, F write_frame);
+
+    bool push(uint64_t time_us, const uint8_t* frame, size_t frame_len);
+
+    Stats stats() const;
+
+    // Wall clock time as used in .tlog files.
+    static uint64_t now_us();
+
+private:
+    struct Slot {
+        // slot index + n * capacity while free, + 1 once filled.
+        std::atomic<size_t> sequence;
+        size_t len;
+        uint8_t entry[8 + mavlink_max_frame_length];
+    };
+
+    // Returns nullptr if the ring is full.
+    Slot* claim_slot(size_t& position);
+    void publish(Slot* slot, size_t position, uint64_t time_us, size_t frame_len);
+    void run();
+    size_t write_ready(size_t min_count);
+
+    const size_t capacity_;
+    const size_t mask_;
+    const std::chrono::milliseconds flush_interval_;
+    std::unique_ptr<Slot[]> slots_;
+
+    int fd_{-1};
+    std::atomic<bool> should_exit_{false};
+    std::thread thread_{};
+
+    std::atomic<size_t> head_{0};
+    // Only used by the writer thread.
+    size_t tail_{0};
+
+    std::atomic<uint64_t> pushed_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> bytes_written_{0};
+    std::atomic<uint64_t> writes_{0};
+    std::atomic<uint64_t> write_errors_{0};
+    std::atomic<size_t> high_water_mark_{0};
+};
+
+template<typename F> bool TlogWriter::push(uint64_t time_us, F write_frame)
+{
+    pushed_.fetch_add(1, std::memory_order_relaxed);
+
+    size_t position;
+    Slot* const slot = claim_slot(position);
+    if (slot == nullptr) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    // A skipped frame still has to be published, as an empty entry.
+    publish(slot, position, time_us, write_frame(slot->entry + 8));
+    return true;
+}
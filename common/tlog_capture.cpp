@@ -0,0 +1,22 @@
+#include "tlog_capture.h"
+
+void TlogCapture::capture(const mavlink_message_t& message, bool outgoing)
+{
+    (outgoing ? outgoing_ : incoming_).fetch_add(1, std::memory_order_relaxed);
+
+    const bool pushed = writer_.push(TlogWriter::now_us(), [&message](uint8_t* frame) {
+        return static_cast<size_t>(mavlink_msg_to_send_buffer(frame, &message));
+    });
+    if (!pushed) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+TlogCapture::Stats TlogCapture::stats() const
+{
+    Stats stats{};
+    stats.incoming = incoming_.load(std::memory_order_relaxed);
+    stats.outgoing = outgoing_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    return stats;
+}
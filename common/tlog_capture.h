@@ -0,0 +1,42 @@
+#pragma once
+
+#include <mavsdk/plugins/mavlink_passthrough/mavlink_passthrough.h>
+#include <atomic>
+#include <cstdint>
+
+#include "tlog.h"
+
+/**
+ * @brief The TlogCapture class
+ * Records MAVLink messages into a TlogWriter, with the time they passed through here.
+ * Messages are serialized straight into the ring of the writer, so the MAVSDK threads
+ * never wait for the disk. Feed it every message with a MavlinkTap.
+ *
+ * The writer has to outlive it.
+ */
+class TlogCapture {
+public:
+    struct Stats {
+        uint64_t incoming;
+        uint64_t outgoing;
+        // Messages the ring of the writer had no room for.
+        uint64_t dropped;
+    };
+
+    explicit TlogCapture(TlogWriter& writer) : writer_(writer) {}
+
+    TlogCapture(const TlogCapture&) = delete;
+    TlogCapture& operator=(const TlogCapture&) = delete;
+
+    // Thread safe.
+    void capture(const mavlink_message_t& message, bool outgoing);
+
+    Stats stats() const;
+
+private:
+    TlogWriter& writer_;
+
+    std::atomic<uint64_t> incoming_{0};
+    std::atomic<uint64_t> outgoing_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
@@ -0,0 +1,211 @@
+#include "tlog_index.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+constexpr size_t TlogIndex::min_chunk_size;
+
+namespace {
+
+uint64_t stream_key(uint8_t system_id, uint32_t message_id)
+{
+    return (uint64_t(system_id) << 32) | message_id;
+}
+
+struct Chunk {
+    size_t begin;
+    size_t end;
+    std::vector<TlogIndex::Stream> streams;
+    uint64_t entries;
+    uint64_t skipped_bytes;
+};
+
+void index_chunk(const uint8_t* data, size_t size, Chunk* chunk)
+{
+    std::unordered_map<uint64_t, size_t> stream_indices;
+
+    TlogCursor cursor(data, size, chunk->begin, chunk->end);
+    TlogEntry entry;
+    while (cursor.next(entry)) {
+        const MavlinkFrameHeader header = mavlink_frame_header(entry.frame);
+        const uint64_t key = stream_key(header.system_id, header.message_id);
+
+        auto found = stream_indices.find(key);
+        if (found == stream_indices.end()) {
+            found = stream_indices.emplace(key, chunk->streams.size()).first;
+            TlogIndex::Stream stream{};
+            stream.system_id = header.system_id;
+            stream.message_id = header.message_id;
+            chunk->streams.push_back(std::move(stream));
+        }
+        TlogIndex::Stream& stream = chunk->streams[found->second];
+        stream.time_us.push_back(entry.time_us);
+        stream.frame_len.push_back(static_cast<uint16_t>(entry.frame_len));
+        ++chunk->entries;
+    }
+    chunk->skipped_bytes = cursor.skipped_bytes();
+}
+
+// Captures are mostly in order already, only frames written by different threads can
+// be slightly out of order.
+void sort_by_time(TlogIndex::Stream& stream)
+{
+    if (std::is_sorted(stream.time_us.begin(), stream.time_us.end())) {
+        return;
+    }
+
+    std::vector<std::pair<uint64_t, uint16_t>> frames(stream.time_us.size());
+    for (size_t i = 0; i < frames.size(); ++i) {
+        frames[i] = std::make_pair(stream.time_us[i], stream.frame_len[i]);
+    }
+    std::stable_sort(
+        frames.begin(),
+        frames.end(),
+        [](const std::pair<uint64_t, uint16_t>& lhs, const std::pair<uint64_t, uint16_t>& rhs) {
+            return lhs.first < rhs.first;
+        });
+    for (size_t i = 0; i < frames.size(); ++i) {
+        stream.time_us[i] = frames[i].first;
+        stream.frame_len[i] = frames[i].second;
+    }
+}
+
+} // namespace
+
+void TlogIndex::build(const TlogReader& reader, unsigned thread_count)
+{
+    streams_.clear();
+    stats_ = Stats{};
+
+    const uint8_t* const data = reader.data();
+    const size_t size = reader.size_bytes();
+
+    const size_t chunk_count = std::max<size_t>(
+        1, std::min<size_t>(std::max(1u, thread_count), size / min_chunk_size));
+    std::vector<Chunk> chunks(chunk_count);
+
+    // Every chunk but the first starts at the next entry after an even split, found in
+    // parallel. The first one starts at 0 so garbage at the start counts as skipped.
+    {
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < chunk_count; ++i) {
+            threads.emplace_back([&chunks, data, size, chunk_count, i]() {
+                chunks[i].begin = TlogCursor::find_entry(data, size, size / chunk_count * i);
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    for (size_t i = 0; i < chunk_count; ++i) {
+        chunks[i].end = (i + 1 < chunk_count) ? chunks[i + 1].begin : size;
+    }
+
+    {
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < chunk_count; ++i) {
+            threads.emplace_back(index_chunk, data, size, &chunks[i]);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    // Chunks are appended in file order, so streams only need sorting if the capture
+    // itself was out of order.
+    std::unordered_map<uint64_t, size_t> stream_indices;
+    for (auto& chunk : chunks) {
+        stats_.entries += chunk.entries;
+        stats_.skipped_bytes += chunk.skipped_bytes;
+
+        for (auto& chunk_stream : chunk.streams) {
+            const uint64_t key = stream_key(chunk_stream.system_id, chunk_stream.message_id);
+            auto found = stream_indices.find(key);
+            if (found == stream_indices.end()) {
+                stream_indices.emplace(key, streams_.size());
+                streams_.push_back(std::move(chunk_stream));
+                continue;
+            }
+            Stream& stream = streams_[found->second];
+            stream.time_us.insert(
+                stream.time_us.end(), chunk_stream.time_us.begin(), chunk_stream.time_us.end());
+            stream.frame_len.insert(
+                stream.frame_len.end(),
+                chunk_stream.frame_len.begin(),
+                chunk_stream.frame_len.end());
+        }
+        chunk.streams.clear();
+    }
+    stats_.chunks = chunk_count;
+
+    std::sort(streams_.begin(), streams_.end(), [](const Stream& lhs, const Stream& rhs) {
+        return stream_key(lhs.system_id, lhs.message_id) <
+               stream_key(rhs.system_id, rhs.message_id);
+    });
+
+    stats_.first_time_us = std::numeric_limits<uint64_t>::max();
+    for (auto& stream : streams_) {
+        sort_by_time(stream);
+        stats_.first_time_us = std::min(stats_.first_time_us, stream.time_us.front());
+        stats_.last_time_us = std::max(stats_.last_time_us, stream.time_us.back());
+    }
+    if (streams_.empty()) {
+        stats_.first_time_us = 0;
+    }
+}
+
+const TlogIndex::Stream* TlogIndex::find(uint8_t system_id, uint32_t message_id) const
+{
+    const uint64_t key = stream_key(system_id, message_id);
+    const auto found = std::lower_bound(
+        streams_.begin(), streams_.end(), key, [](const Stream& stream, uint64_t value) {
+            return stream_key(stream.system_id, stream.message_id) < value;
+        });
+    if (found == streams_.end() || stream_key(found->system_id, found->message_id) != key) {
+        return nullptr;
+    }
+    return &*found;
+}
+
+TlogIndex::QueryResult TlogIndex::query(const Stream& stream, uint64_t begin_us, uint64_t end_us)
+{
+    QueryResult result{};
+
+    const auto first = std::lower_bound(stream.time_us.begin(), stream.time_us.end(), begin_us);
+    const auto last = std::lower_bound(first, stream.time_us.end(), end_us);
+    const size_t begin = first - stream.time_us.begin();
+    const size_t end = last - stream.time_us.begin();
+
+    result.count = end - begin;
+    for (size_t i = begin; i < end; ++i) {
+        result.bytes += stream.frame_len[i];
+    }
+    if (result.count < 2) {
+        return result;
+    }
+
+    double sum_ms = 0.0;
+    double sum_squared_ms2 = 0.0;
+    result.min_interval_ms = std::numeric_limits<double>::infinity();
+    for (size_t i = begin + 1; i < end; ++i) {
+        const double interval_ms = (stream.time_us[i] - stream.time_us[i - 1]) * 1e-3;
+        sum_ms += interval_ms;
+        sum_squared_ms2 += interval_ms * interval_ms;
+        result.min_interval_ms = std::min(result.min_interval_ms, interval_ms);
+        result.max_interval_ms = std::max(result.max_interval_ms, interval_ms);
+    }
+
+    const double intervals = static_cast<double>(result.count - 1);
+    result.duration_s = (stream.time_us[end - 1] - stream.time_us[begin]) * 1e-6;
+    result.mean_interval_ms = sum_ms / intervals;
+    result.jitter_ms = std::sqrt(std::max(
+        0.0, sum_squared_ms2 / intervals - result.mean_interval_ms * result.mean_interval_ms));
+    if (result.duration_s > 0.0) {
+        result.rate_hz = intervals / result.duration_s;
+        result.bytes_per_s = result.bytes / result.duration_s;
+    }
+    return result;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tlog.h"
+
+/**
+ * @brief The TlogIndex class
+ * Times and sizes of every frame in a .tlog, grouped by system id and message id, so
+ * questions like "how often did system 1 send GLOBAL_POSITION_INT between t0 and t1"
+ * are answered from memory instead of reading the capture again.
+ *
+ * The capture is split into chunks which are indexed in parallel. Each chunk starts at
+ * the first position where several entries in a row parse, and ends where the next chunk
+ * starts, so no entry is counted twice or lost at the boundaries.
+ */
+class TlogIndex {
+public:
+    // All frames of one message id from one system, ordered by time.
+    struct Stream {
+        uint8_t system_id;
+        uint32_t message_id;
+        std::vector<uint64_t> time_us;
+        std::vector<uint16_t> frame_len;
+    };
+
+    struct Stats {
+        uint64_t entries;
+        uint64_t skipped_bytes;
+        size_t chunks;
+        uint64_t first_time_us;
+        uint64_t last_time_us;
+    };
+
+    struct QueryResult {
+        uint64_t count;
+        uint64_t bytes;
+        // Between the first and the last frame in the range.
+        double duration_s;
+        double rate_hz;
+        double bytes_per_s;
+        // Time between consecutive frames, jitter is the standard deviation.
+        double mean_interval_ms;
+        double jitter_ms;
+        double min_interval_ms;
+        double max_interval_ms;
+    };
+
+    // Chunks smaller than this are not worth a thread.
+    static constexpr size_t min_chunk_size = 1024 * 1024;
+
+    // Indexes the whole mapping of the reader, with one thread per chunk.
+    void build(const TlogReader& reader, unsigned thread_count);
+
+    const std::vector<Stream>& streams() const { return streams_; }
+
+    const Stats& stats() const { return stats_; }
+
+    // nullptr if there is no such stream.
+    const Stream* find(uint8_t system_id, uint32_t message_id) const;
+
+    // Frames with begin_us <= time < end_us, in capture time.
+    static QueryResult query(const Stream& stream, uint64_t begin_us, uint64_t end_us);
+
+private:
+    std::vector<Stream> streams_{};
+    Stats stats_{};
+};
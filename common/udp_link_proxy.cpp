@@ -0,0 +1,377 @@
+#include "udp_link_proxy.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+// How often the threads look at should_exit_ when nothing happens.
+constexpr int idle_wait_ms = 100;
+
+// Tail of the Pareto latency, the variance is finite above 2.
+constexpr double pareto_shape = 3.0;
+
+const char* event_names[] = {"forward", "reorder", "drop", "burst_drop", "queue_drop"};
+
+const char* latency_name(UdpLinkProxy::Latency latency)
+{
+    switch (latency) {
+        case UdpLinkProxy::Latency::Uniform:
+            return "uniform";
+        case UdpLinkProxy::Latency::Normal:
+            return "normal";
+        case UdpLinkProxy::Latency::Pareto:
+            return "pareto";
+    }
+    return "unknown";
+}
+
+} // namespace
+
+UdpLinkProxy::UdpLinkProxy(Config config) :
+    config_(std::move(config)),
+    uplink_(config_.uplink, config_.seed),
+    downlink_(config_.downlink, config_.seed + 1)
+{}
+
+UdpLinkProxy::~UdpLinkProxy()
+{
+    stop();
+}
+
+bool UdpLinkProxy::start()
+{
+    if (!vehicle_socket_.bind("127.0.0.1", config_.vehicle_port) ||
+        !client_socket_.bind("127.0.0.1", 0) ||
+        !client_socket_.set_remote(config_.client_host, config_.client_port)) {
+        return false;
+    }
+
+    if (!config_.replay_path.empty() && !load_replay()) {
+        return false;
+    }
+
+    start_time_ = steady_clock::now();
+    for (Direction* direction : {&uplink_, &downlink_}) {
+        direction->tokens = direction->config.bucket_bytes;
+        direction->last_refill = start_time_;
+    }
+
+    if (!config_.record_path.empty()) {
+        record_file_.open(config_.record_path, std::ios::trunc);
+        if (!record_file_) {
+            std::cerr << "Could not open " << config_.record_path << std::endl;
+            return false;
+        }
+        record_file_ << "# seed " << config_.seed << "\n"
+                     << "# up: " << to_string(config_.uplink) << "\n"
+                     << "# down: " << to_string(config_.downlink) << "\n"
+                     << "# time_us direction bytes event delay_us\n";
+    }
+
+    should_exit_ = false;
+    uplink_thread_ = std::thread(&UdpLinkProxy::run, this, std::ref(uplink_), false);
+    downlink_thread_ = std::thread(&UdpLinkProxy::run, this, std::ref(downlink_), true);
+    return true;
+}
+
+void UdpLinkProxy::stop()
+{
+    should_exit_ = true;
+    if (uplink_thread_.joinable()) {
+        uplink_thread_.join();
+    }
+    if (downlink_thread_.joinable()) {
+        downlink_thread_.join();
+    }
+    vehicle_socket_.close();
+    client_socket_.close();
+    if (record_file_.is_open()) {
+        record_file_.close();
+    }
+}
+
+UdpLinkProxy::Stats UdpLinkProxy::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::string UdpLinkProxy::to_string(const LinkConfig& link_config)
+{
+    std::stringstream ss;
+    ss << "delay " << link_config.delay.count() / 1000.0 << " ms + "
+       << latency_name(link_config.latency) << " " << link_config.jitter.count() / 1000.0
+       << " ms, loss " << link_config.loss * 100.0f << " %";
+    if (link_config.burst_start > 0.0f) {
+        ss << ", bursts " << link_config.burst_start * 100.0f << " % / "
+           << link_config.burst_end * 100.0f << " % with " << link_config.burst_loss * 100.0f
+           << " % loss";
+    }
+    if (link_config.reorder > 0.0f) {
+        ss << ", reorder " << link_config.reorder * 100.0f << " % by "
+           << link_config.reorder_delay.count() / 1000.0 << " ms";
+    }
+    if (link_config.bandwidth_bytes_s > 0) {
+        ss << ", " << link_config.bandwidth_bytes_s << " B/s, bucket "
+           << link_config.bucket_bytes << " B, queue " << link_config.queue_limit_bytes << " B";
+    }
+    return ss.str();
+}
+
+void UdpLinkProxy::run(Direction& direction, bool from_vehicle)
+{
+    UdpSocket& in_socket = from_vehicle ? vehicle_socket_ : client_socket_;
+    DirectionStats& stats = from_vehicle ? stats_.downlink : stats_.uplink;
+    uint8_t buffer[2048];
+
+    while (!should_exit_) {
+        sockaddr_in sender{};
+        const int received = in_socket.receive(
+            buffer, sizeof(buffer), wait_ms(direction, steady_clock::now()), &sender);
+        if (received < 0) {
+            std::cerr << "UDP link proxy: receive failed" << std::endl;
+            break;
+        }
+
+        const auto now = steady_clock::now();
+        if (received > 0) {
+            const size_t len = static_cast<size_t>(received);
+            const Decision decision = decide(direction, len, now);
+            enqueue(direction, buffer, len, decision, now);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (from_vehicle &&
+                std::none_of(
+                    vehicle_addresses_.begin(),
+                    vehicle_addresses_.end(),
+                    [&sender](const sockaddr_in& address) {
+                        return UdpSocket::same_address(address, sender);
+                    })) {
+                vehicle_addresses_.push_back(sender);
+            }
+            record(from_vehicle, len, decision, now);
+            switch (decision.event) {
+                case Event::Reordered:
+                    ++stats.reordered;
+                    break;
+                case Event::BurstDropped:
+                    ++stats.burst_dropped;
+                    ++stats.dropped;
+                    break;
+                case Event::QueueDropped:
+                    ++stats.queue_dropped;
+                    ++stats.dropped;
+                    break;
+                case Event::Dropped:
+                    ++stats.dropped;
+                    break;
+                case Event::Forwarded:
+                    break;
+            }
+        }
+
+        while (!direction.queue.empty() && direction.queue.front().deliver_at <= now) {
+            deliver(direction.queue.front(), from_vehicle, stats);
+            direction.queue.pop_front();
+        }
+    }
+}
+
+UdpLinkProxy::Decision UdpLinkProxy::decide(Direction& direction, size_t len, time_point now)
+{
+    if (direction.replay_index < direction.replay.size()) {
+        return direction.replay[direction.replay_index++];
+    }
+
+    const LinkConfig& config = direction.config;
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    // Gilbert-Elliott: the state changes before the datagram goes through it.
+    if (direction.bad_state) {
+        direction.bad_state = uniform(direction.random) >= config.burst_end;
+    } else {
+        direction.bad_state = uniform(direction.random) < config.burst_start;
+    }
+    if (uniform(direction.random) < (direction.bad_state ? config.burst_loss : config.loss)) {
+        return Decision{
+            direction.bad_state ? Event::BurstDropped : Event::Dropped, microseconds(0)};
+    }
+
+    // Tokens below zero are the bytes waiting in the queue.
+    microseconds queueing_delay{0};
+    if (config.bandwidth_bytes_s > 0) {
+        const double elapsed_s =
+            std::chrono::duration<double>(now - direction.last_refill).count();
+        direction.last_refill = now;
+        direction.tokens = std::min<double>(
+            direction.tokens + elapsed_s * config.bandwidth_bytes_s, config.bucket_bytes);
+
+        if (direction.tokens - len < -static_cast<double>(config.queue_limit_bytes)) {
+            return Decision{Event::QueueDropped, microseconds(0)};
+        }
+        direction.tokens -= len;
+        if (direction.tokens < 0.0) {
+            queueing_delay = microseconds(
+                static_cast<int64_t>(-direction.tokens * 1e6 / config.bandwidth_bytes_s));
+        }
+    }
+
+    Decision decision{Event::Forwarded, queueing_delay + config.delay + extra_delay(direction)};
+    if (config.reorder > 0.0f && uniform(direction.random) < config.reorder) {
+        decision.event = Event::Reordered;
+    }
+    return decision;
+}
+
+microseconds UdpLinkProxy::extra_delay(Direction& direction)
+{
+    const double jitter_us = static_cast<double>(direction.config.jitter.count());
+    if (jitter_us <= 0.0) {
+        return microseconds(0);
+    }
+
+    double extra_us = 0.0;
+    switch (direction.config.latency) {
+        case Latency::Uniform:
+            extra_us = std::uniform_real_distribution<double>(0.0, jitter_us)(direction.random);
+            break;
+        case Latency::Normal:
+            extra_us = std::abs(std::normal_distribution<double>(0.0, jitter_us)(direction.random));
+            break;
+        case Latency::Pareto: {
+            // Lomax, a Pareto shifted to start at 0, with a mean of jitter.
+            const double scale_us = jitter_us * (pareto_shape - 1.0);
+            const double u = std::uniform_real_distribution<double>(0.0, 1.0)(direction.random);
+            extra_us = scale_us * (std::pow(1.0 - u, -1.0 / pareto_shape) - 1.0);
+            break;
+        }
+    }
+    return microseconds(static_cast<int64_t>(extra_us));
+}
+
+void UdpLinkProxy::enqueue(
+    Direction& direction,
+    const uint8_t* data,
+    size_t len,
+    const Decision& decision,
+    time_point now)
+{
+    if (decision.event != Event::Forwarded && decision.event != Event::Reordered) {
+        return;
+    }
+
+    // A radio doesn't overtake, a datagram waits for the one before. A reordered one is
+    // held back after that, and the ones after it don't wait for it.
+    time_point deliver_at = std::max(now + decision.delay, direction.last_deliver_at);
+    if (decision.event == Event::Forwarded) {
+        direction.last_deliver_at = deliver_at;
+    } else {
+        deliver_at += direction.config.reorder_delay;
+    }
+
+    const auto position = std::upper_bound(
+        direction.queue.begin(),
+        direction.queue.end(),
+        deliver_at,
+        [](const time_point& time, const Datagram& datagram) {
+            return time < datagram.deliver_at;
+        });
+    direction.queue.insert(position, Datagram{deliver_at, std::vector<uint8_t>(data, data + len)});
+}
+
+int UdpLinkProxy::wait_ms(const Direction& direction, time_point now)
+{
+    if (direction.queue.empty()) {
+        return idle_wait_ms;
+    }
+    if (direction.queue.front().deliver_at <= now) {
+        return 0;
+    }
+    // Rounded up, poll() would wake up too early and spin otherwise.
+    const auto wait = direction.queue.front().deliver_at - now + milliseconds(1) - microseconds(1);
+    return static_cast<int>(std::min<int64_t>(
+        duration_cast<milliseconds>(wait).count(), idle_wait_ms));
+}
+
+void UdpLinkProxy::deliver(const Datagram& datagram, bool from_vehicle, DirectionStats& stats)
+{
+    bool sent = false;
+    if (from_vehicle) {
+        sent = client_socket_.send(datagram.data.data(), datagram.data.size());
+    } else {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const std::vector<sockaddr_in> addresses = vehicle_addresses_;
+        lock.unlock();
+        // Before a vehicle sent anything there is nowhere to send to.
+        for (const auto& address : addresses) {
+            sent = vehicle_socket_.send_to(datagram.data.data(), datagram.data.size(), address) ||
+                   sent;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sent) {
+        ++stats.forwarded;
+    } else {
+        ++stats.dropped;
+    }
+}
+
+void UdpLinkProxy::record(bool from_vehicle, size_t len, const Decision& decision, time_point now)
+{
+    if (!record_file_.is_open()) {
+        return;
+    }
+    record_file_ << duration_cast<microseconds>(now - start_time_).count() << " "
+                 << (from_vehicle ? "down" : "up") << " " << len << " "
+                 << event_names[static_cast<int>(decision.event)] << " "
+                 << decision.delay.count() << "\n";
+}
+
+bool UdpLinkProxy::load_replay()
+{
+    std::ifstream file(config_.replay_path);
+    if (!file) {
+        std::cerr << "Could not open " << config_.replay_path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::istringstream in(line);
+        int64_t time_us = 0;
+        std::string direction_name;
+        size_t len = 0;
+        std::string event_name;
+        int64_t delay_us = 0;
+        if (!(in >> time_us >> direction_name >> len >> event_name >> delay_us)) {
+            std::cerr << "Invalid line in " << config_.replay_path << ": " << line << std::endl;
+            return false;
+        }
+
+        const auto event = std::find(std::begin(event_names), std::end(event_names), event_name);
+        if (event == std::end(event_names) ||
+            (direction_name != "up" && direction_name != "down")) {
+            std::cerr << "Invalid line in " << config_.replay_path << ": " << line << std::endl;
+            return false;
+        }
+
+        Direction& direction = (direction_name == "down") ? downlink_ : uplink_;
+        direction.replay.push_back(Decision{
+            static_cast<Event>(event - std::begin(event_names)), microseconds(delay_us)});
+    }
+    return true;
+}
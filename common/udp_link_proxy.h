@@ -0,0 +1,181 @@
+#pragma once
+
+#include <netinet/in.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "udp_socket.h"
+
+/**
+ * @brief The UdpLinkProxy class
+ * Sits between a MAVLink client and vehicles on localhost and makes the link between them
+ * look like a radio, separately for each direction:
+ * - a base delay plus a random extra delay from a uniform, normal or Pareto distribution
+ * - Gilbert-Elliott loss: the link switches between a good and a bad state, each with its
+ *   own loss probability, so losses come in bursts like on a fading radio
+ * - reordering: some datagrams are held back and overtaken by the ones after them
+ * - a token bucket bandwidth cap, datagrams which don't fit wait in a limited queue
+ *
+ * The vehicles (e.g. the mock autopilot) send to vehicle_port, the proxy forwards to the
+ * client at client_host:client_port from a port of its own, so the client sees the proxy
+ * as the vehicle. Datagrams from the client go to every vehicle which sent something.
+ *
+ * The record file gets a line for every datagram: what happened to it and its delay.
+ * The random numbers come from the seed, but which datagram draws which number depends
+ * on the traffic. Replaying a record applies the recorded decisions to the datagrams in
+ * the same order instead, so a run can be repeated exactly as far as the traffic is the
+ * same.
+ */
+class UdpLinkProxy {
+public:
+    enum class Latency { Uniform, Normal, Pareto };
+
+    struct LinkConfig {
+        // Every datagram is delayed by at least this.
+        std::chrono::microseconds delay{0};
+        // The extra delay on top of it: Uniform from 0 to jitter, Normal the absolute of
+        // a normal distribution with jitter as its standard deviation, Pareto with jitter
+        // as its mean and a long tail.
+        std::chrono::microseconds jitter{0};
+        Latency latency{Latency::Uniform};
+
+        // Loss probabilities in the good and the bad state, and the probabilities per
+        // datagram to change between them. Without burst_start the link stays good.
+        float loss{0.0f};
+        float burst_loss{1.0f};
+        float burst_start{0.0f};
+        float burst_end{0.5f};
+
+        // Probability that a datagram is held back by reorder_delay, behind the ones which
+        // come after it.
+        float reorder{0.0f};
+        std::chrono::microseconds reorder_delay{std::chrono::milliseconds(20)};
+
+        // 0 is no limit. Bursts up to bucket_bytes go through at once.
+        uint32_t bandwidth_bytes_s{0};
+        uint32_t bucket_bytes{1024};
+        uint32_t queue_limit_bytes{16384};
+    };
+
+    struct Config {
+        uint16_t vehicle_port{0};
+        std::string client_host{"127.0.0.1"};
+        uint16_t client_port{0};
+        // Client to vehicles.
+        LinkConfig uplink{};
+        // Vehicles to client.
+        LinkConfig downlink{};
+        uint32_t seed{1};
+        // Both optional.
+        std::string record_path{};
+        std::string replay_path{};
+    };
+
+    struct DirectionStats {
+        uint64_t forwarded;
+        // All losses, including the ones counted below.
+        uint64_t dropped;
+        uint64_t burst_dropped;
+        uint64_t queue_dropped;
+        uint64_t reordered;
+    };
+
+    struct Stats {
+        DirectionStats uplink;
+        DirectionStats downlink;
+    };
+
+    explicit UdpLinkProxy(Config config);
+
+    ~UdpLinkProxy();
+
+    UdpLinkProxy(const UdpLinkProxy&) = delete;
+    UdpLinkProxy& operator=(const UdpLinkProxy&) = delete;
+
+    // Binds the ports, opens the record and replay files and starts a thread per
+    // direction.
+    bool start();
+
+    void stop();
+
+    Stats stats() const;
+
+    // E.g. "delay 100 ms + uniform 50 ms, loss 5 %, bursts 2 % / 50 % with 100 % loss"
+    static std::string to_string(const LinkConfig& link_config);
+
+private:
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    enum class Event { Forwarded, Reordered, Dropped, BurstDropped, QueueDropped };
+
+    struct Decision {
+        Event event;
+        std::chrono::microseconds delay;
+    };
+
+    struct Datagram {
+        time_point deliver_at;
+        std::vector<uint8_t> data;
+    };
+
+    struct Direction {
+        Direction(const LinkConfig& link_config, uint32_t seed) :
+            config(link_config),
+            random(seed)
+        {}
+
+        const LinkConfig config;
+        std::mt19937 random;
+        bool bad_state{false};
+        double tokens{0.0};
+        time_point last_refill{};
+        // Sorted by delivery time.
+        std::deque<Datagram> queue{};
+        // Of the last datagram which wasn't held back.
+        time_point last_deliver_at{};
+        std::vector<Decision> replay{};
+        size_t replay_index{0};
+    };
+
+    // One thread per direction, only it touches its Direction.
+    void run(Direction& direction, bool from_vehicle);
+    static Decision decide(Direction& direction, size_t len, time_point now);
+    static std::chrono::microseconds extra_delay(Direction& direction);
+    static void enqueue(
+        Direction& direction,
+        const uint8_t* data,
+        size_t len,
+        const Decision& decision,
+        time_point now);
+    static int wait_ms(const Direction& direction, time_point now);
+    void deliver(const Datagram& datagram, bool from_vehicle, DirectionStats& stats);
+
+    bool load_replay();
+    // Called with the mutex locked.
+    void record(bool from_vehicle, size_t len, const Decision& decision, time_point now);
+
+    const Config config_;
+    UdpSocket vehicle_socket_{};
+    UdpSocket client_socket_{};
+    Direction uplink_;
+    Direction downlink_;
+
+    mutable std::mutex mutex_{};
+    std::vector<sockaddr_in> vehicle_addresses_{};
+    Stats stats_{};
+    std::ofstream record_file_{};
+    time_point start_time_{};
+
+    std::atomic<bool> should_exit_{false};
+    std::thread uplink_thread_{};
+    std::thread downlink_thread_{};
+};
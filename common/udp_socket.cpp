@@ -0,0 +1,144 @@
+#include "udp_socket.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+UdpSocket::~UdpSocket()
+{
+    close();
+}
+
+bool UdpSocket::bind(const std::string& local_host, uint16_t local_port)
+{
+    close();
+
+    fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd_ < 0) {
+        std::cerr << "socket error: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    sockaddr_in address{};
+    if (!resolve(local_host.empty() ? "0.0.0.0" : local_host, local_port, address)) {
+        close();
+        return false;
+    }
+
+    if (::bind(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "bind error on port " << local_port << ": " << strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+bool UdpSocket::set_remote(const std::string& remote_host, uint16_t remote_port)
+{
+    has_remote_ = resolve(remote_host, remote_port, remote_);
+    return has_remote_;
+}
+
+bool UdpSocket::send(const void* data, size_t len)
+{
+    if (!has_remote_) {
+        return false;
+    }
+    return send_to(data, len, remote_);
+}
+
+bool UdpSocket::send_to(const void* data, size_t len, const sockaddr_in& address)
+{
+    if (fd_ < 0) {
+        return false;
+    }
+
+    const auto sent = ::sendto(
+        fd_, data, len, 0, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    return sent == static_cast<ssize_t>(len);
+}
+
+int UdpSocket::receive(void* buffer, size_t len, int timeout_ms, sockaddr_in* from)
+{
+    if (fd_ < 0) {
+        return -1;
+    }
+
+    pollfd fds{};
+    fds.fd = fd_;
+    fds.events = POLLIN;
+
+    const int poll_result = ::poll(&fds, 1, timeout_ms);
+    if (poll_result == 0) {
+        return 0;
+    }
+    if (poll_result < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    sockaddr_in sender{};
+    socklen_t sender_len = sizeof(sender);
+    const auto received =
+        ::recvfrom(fd_, buffer, len, 0, reinterpret_cast<sockaddr*>(&sender), &sender_len);
+    if (received < 0) {
+        return (errno == EINTR || errno == EAGAIN) ? 0 : -1;
+    }
+
+    if (from) {
+        *from = sender;
+    }
+    return static_cast<int>(received);
+}
+
+uint16_t UdpSocket::local_port() const
+{
+    sockaddr_in address{};
+    socklen_t address_len = sizeof(address);
+    if (fd_ < 0 ||
+        ::getsockname(fd_, reinterpret_cast<sockaddr*>(&address), &address_len) != 0) {
+        return 0;
+    }
+    return ntohs(address.sin_port);
+}
+
+void UdpSocket::close()
+{
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool UdpSocket::resolve(const std::string& host, uint16_t port, sockaddr_in& address)
+{
+    address = sockaddr_in{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) == 1) {
+        return true;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || result == nullptr) {
+        std::cerr << "Could not resolve " << host << std::endl;
+        return false;
+    }
+
+    address.sin_addr = reinterpret_cast<sockaddr_in*>(result->ai_addr)->sin_addr;
+    freeaddrinfo(result);
+    return true;
+}
+
+bool UdpSocket::same_address(const sockaddr_in& lhs, const sockaddr_in& rhs)
+{
+    return lhs.sin_addr.s_addr == rhs.sin_addr.s_addr && lhs.sin_port == rhs.sin_port;
+}
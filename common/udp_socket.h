@@ -0,0 +1,51 @@
+#pragma once
+
+#include <netinet/in.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief The UdpSocket class
+ * Thin wrapper around a POSIX UDP socket used by the local tools (mock autopilot, proxies).
+ * Incoming datagrams remember their sender so replies can be sent back to it, the same way
+ * PX4 SITL and MAVSDK pick up their remote.
+ */
+class UdpSocket {
+public:
+    UdpSocket() = default;
+
+    ~UdpSocket();
+
+    UdpSocket(const UdpSocket&) = delete;
+    UdpSocket& operator=(const UdpSocket&) = delete;
+
+    // Binds to the given local port, 0 picks an ephemeral port.
+    bool bind(const std::string& local_host, uint16_t local_port);
+
+    // Sets the default destination used by send().
+    bool set_remote(const std::string& remote_host, uint16_t remote_port);
+
+    bool has_remote() const { return has_remote_; }
+
+    bool send(const void* data, size_t len);
+
+    bool send_to(const void* data, size_t len, const sockaddr_in& address);
+
+    // Waits up to timeout_ms for a datagram. Returns its size, 0 on timeout and -1 on error.
+    // If `from` is set, it receives the address of the sender.
+    int receive(void* buffer, size_t len, int timeout_ms, sockaddr_in* from = nullptr);
+
+    uint16_t local_port() const;
+
+    void close();
+
+    static bool resolve(const std::string& host, uint16_t port, sockaddr_in& address);
+
+    static bool same_address(const sockaddr_in& lhs, const sockaddr_in& rhs);
+
+private:
+    int fd_{-1};
+    bool has_remote_{false};
+    sockaddr_in remote_{};
+};
@@ -11,6 +11,8 @@
 #include <iostream>
 #include <thread>
 
+#include "system_discovery.h"
+
 using namespace mavsdk;
 using namespace std::this_thread;
 using namespace std::chrono;
@@ -41,7 +43,6 @@ int main(int argc, char** argv)
     std::string connection_url;
     ConnectionResult connection_result;
 
-    bool discovered_system = false;
     if (argc == 2) {
         connection_url = argv[1];
         connection_result = mavsdk.add_any_connection(connection_url);
@@ -57,35 +58,24 @@ int main(int argc, char** argv)
     }
 
     std::cout << "Waiting to discover system..." << std::endl;
-    mavsdk.subscribe_on_new_system([&mavsdk, &discovered_system]() {
-        const auto system = mavsdk.systems().at(0);
-
-        if (system->is_connected()) {
-            std::cout << "Discovered system" << std::endl;
-            discovered_system = true;
-        }
-    });
+    SystemDiscovery discovery(mavsdk);
 
-    // We usually receive heartbeats at 1Hz, therefore we should find a system after around 2
-    // seconds.
-    sleep_for(seconds(2));
-
-    if (!discovered_system) {
+    // Returns as soon as the system is connected instead of always waiting a fixed time.
+    if (!discovery.wait_for_systems(1, SystemDiscovery::default_timeout)) {
         std::cout << ERROR_CONSOLE_TEXT << "No system found, exiting." << NORMAL_CONSOLE_TEXT
                   << std::endl;
         return 1;
     }
 
-    const auto system = mavsdk.systems().at(0);
+    const auto discovered = discovery.discovered_systems().at(0);
+    std::cout << "Discovered system after " << discovered.time_to_discovery.count() << " ms"
+              << std::endl;
+
+    const auto system = discovered.system;
 
     // Register a callback so we get told when components (camera, gimbal) etc
     // are found.
     system->register_component_discovered_callback(component_discovered);
-    if (!discovered_system) {
-        std::cout << ERROR_CONSOLE_TEXT << "No system found, exiting." << NORMAL_CONSOLE_TEXT
-                  << std::endl;
-        return 1;
-    }
 
     // We want to listen to the altitude of the drone at 1 Hz.
 
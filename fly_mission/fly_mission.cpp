@@ -12,6 +12,8 @@
 #include <mavsdk/plugins/mission/mission.h>
 #include <future>
 
+#include "system_discovery.h"
+
 using namespace mavsdk;
 
 // Handles Mission's result
@@ -60,7 +62,6 @@ int main(int argc, char** argv)
     Mavsdk mavsdk;
     ConnectionResult connection_result;
 
-    bool discovered_system = false;
     if (argc == 2) {
         connection_result = mavsdk.add_any_connection(argv[1]);
     } else {
@@ -74,25 +75,19 @@ int main(int argc, char** argv)
     }
 
     std::cout << "Waiting to discover system..." << std::endl;
-    mavsdk.subscribe_on_new_system([&mavsdk, &discovered_system]() {
-        const auto system = mavsdk.systems().at(0);
-
-        if (system->is_connected()) {
-            std::cout << "Discovered system" << std::endl;
-            discovered_system = true;
-        }
-    });
-
-    // We usually receive heartbeats at 1Hz, therefore we should find a system after around 2
-    // seconds.
-    std::this_thread::sleep_for(std::chrono::seconds(2));
+    SystemDiscovery discovery(mavsdk);
 
-    if (!discovered_system) {
+    // Returns as soon as the system is connected instead of always waiting a fixed time.
+    if (!discovery.wait_for_systems(1, SystemDiscovery::default_timeout)) {
         std::cout << "No system found, exiting." << std::endl;
         return 1;
     }
 
-    const auto system = mavsdk.systems().at(0);
+    const auto discovered = discovery.discovered_systems().at(0);
+    std::cout << "Discovered system after " << discovered.time_to_discovery.count() << " ms"
+              << std::endl;
+
+    const auto system = discovered.system;
 
     // Register a callback so we get told when components (camera, gimbal) etc
     // are found.
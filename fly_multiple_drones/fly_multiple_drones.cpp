@@ -1,6 +1,6 @@
 /*
 Example to connect multiple vehicles and make them follow their own separate plan file. Also
-saves the telemetry information to csv files
+saves the telemetry information to binary log files, use telemetry_log_to_csv to convert them
 ./fly_multiple_drones udp://:14540 udp://:14541 ../../../plugins/mission/test.plan
 ../../../plugins/mission/test2.plan
 
@@ -11,19 +11,30 @@ Author: Shusil Shapkota (Air Matrix)
 
 #include <mavsdk/mavsdk.h>
 #include <mavsdk/plugins/action/action.h>
+#include <mavsdk/plugins/mavlink_passthrough/mavlink_passthrough.h>
 #include <mavsdk/plugins/mission/mission.h>
 #include <mavsdk/plugins/telemetry/telemetry.h>
 
 #include <cstdint>
+#include <cstdlib>
 #include <iostream>
 #include <thread>
 #include <chrono>
 #include <functional>
-#include <future>
 #include <memory>
+#include <sstream>
 #include <string>
-#include <ctime>
-#include <fstream>
+
+#include "qgc_plan_parser.h"
+#include "system_discovery.h"
+#include "async_telemetry_logger.h"
+#include "clock_sync.h"
+#include "console_renderer.h"
+#include "fleet_executor.h"
+#include "fleet_mission_uploader.h"
+#include "mission_item_uploader.h"
+#include "mission_packet_cache.h"
+#include "mission_tracker.h"
 
 using namespace mavsdk;
 using namespace std::this_thread;
@@ -66,28 +77,62 @@ are running two drones in udp://:14540 and udp://:14541 then you run the example
 ./fly_multiple_drones udp://:14540 udp://:14541 ../../../src/plugins/mission/test.plan
 ../../../src/plugins/mission/test2.plan
 
+The missions of all drones are uploaded at the same time, at most 8 at once by default. Use
+--max-uploads <count> as the first argument to change that, e.g. for a slow radio link:
+
+./fly_multiple_drones --max-uploads 2 udp://:14540 udp://:14541 test.plan test2.plan
+
 */
 
 #define ERROR_CONSOLE_TEXT "\033[31m" // Turn text on console red
 #define TELEMETRY_CONSOLE_TEXT "\033[34m" // Turn text on console blue
 #define NORMAL_CONSOLE_TEXT "\033[0m" // Restore normal console colour
 
-static void complete_mission(std::string qgc_plan, std::shared_ptr<System> system);
+// Everything main sets up for one vehicle before its thread starts.
+struct Vehicle {
+    std::shared_ptr<System> system;
+    std::shared_ptr<MavlinkPassthrough> mavlink_passthrough;
+    std::shared_ptr<MissionItemUploader> mission_uploader;
+    std::shared_ptr<const EncodedMission> mission;
+};
 
-static void handle_action_err_exit(Action::Result result, const std::string& message);
+static bool upload_missions(
+    std::vector<Vehicle>& vehicles,
+    char* plan_files[],
+    size_t max_uploads,
+    ConsoleRenderer& console);
 
-static void handle_mission_err_exit(Mission::Result result, const std::string& message);
+static void
+complete_mission(const Vehicle& vehicle, AsyncTelemetryLogger& logger, ConsoleRenderer& console);
 
-std::string getCurrentTimeString()
-{
-    time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-    std::string s(30, '\0');
-    strftime(&s[0], s.size(), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
-    return s;
-}
+static std::string
+logger_stats_text(const std::string& name, const AsyncTelemetryLogger::Stats& stats);
+
+// Errors go through the console, it owns the cursor while the table is shown.
+static void exit_with_error(ConsoleRenderer& console, const std::string& text);
+
+static void handle_action_err_exit(
+    Action::Result result, const std::string& message, ConsoleRenderer& console);
+
+static void handle_mission_err_exit(
+    Mission::Result result, const std::string& message, ConsoleRenderer& console);
 
 int main(int argc, char* argv[])
 {
+    size_t max_uploads = FleetMissionUploader::default_max_in_flight;
+    if (argc >= 3 && std::string(argv[1]) == "--max-uploads") {
+        max_uploads = std::strtoul(argv[2], nullptr, 10);
+        if (max_uploads == 0) {
+            std::cerr << ERROR_CONSOLE_TEXT << "--max-uploads needs a count of at least 1"
+                      << NORMAL_CONSOLE_TEXT << std::endl;
+            return 1;
+        }
+        // The connections and plans follow as if there was no option.
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
     // There needs to be odd number of arguments (including ./fly_multiple_drones) otherwise
     // it would suggest either plan files or udp ports hasn't been specified
     if (argc % 2 == 0 || argc == 1) {
@@ -115,162 +160,323 @@ int main(int argc, char* argv[])
         }
     }
 
-    std::atomic<size_t> num_systems_discovered{0};
-
     std::cout << "Waiting to discover system..." << std::endl;
-    mavsdk.subscribe_on_new_system([&mavsdk, &num_systems_discovered]() {
-        const auto systems = mavsdk.systems();
+    SystemDiscovery discovery(mavsdk);
 
-        if (systems.size() > num_systems_discovered) {
-            std::cout << "Discovered system" << std::endl;
-            num_systems_discovered = systems.size();
-        }
-    });
+    // Wakes up as soon as the last expected system is connected.
+    const bool all_systems_found =
+        discovery.wait_for_systems(total_ports_used, SystemDiscovery::default_timeout);
 
-    // We usually receive heartbeats at 1Hz, therefore we should find a system after around 2
-    // seconds.
-    sleep_for(seconds(2));
+    for (const auto& discovered : discovery.discovered_systems()) {
+        std::cout << "Discovered system " << int(discovered.system_id) << " after "
+                  << discovered.time_to_discovery.count() << " ms" << std::endl;
+    }
 
-    if (num_systems_discovered != total_ports_used) {
+    if (!all_systems_found) {
         std::cerr << ERROR_CONSOLE_TEXT << "Not all systems found, exiting." << NORMAL_CONSOLE_TEXT
                   << std::endl;
         return 1;
     }
 
-    std::vector<std::thread> threads;
+    // Log files are written by a single background thread for all vehicles.
+    AsyncTelemetryLogger logger;
+
+    // One status line per vehicle, redrawn at 10 Hz, so the vehicle threads and telemetry
+    // callbacks don't print and flush the console themselves.
+    ConsoleRenderer console;
 
-    int planFile_provided =
-        total_ports_used + 1; // +1 because first plan is specified at argv[total_ports_used+1]
+    // Only runs the timeouts of the mission uploads.
+    FleetExecutor executor(1);
+
+    std::vector<Vehicle> vehicles;
     for (auto system : mavsdk.systems()) {
-        std::thread t(&complete_mission, argv[planFile_provided], system);
+        Vehicle vehicle;
+        vehicle.system = system;
+        vehicle.mavlink_passthrough = std::make_shared<MavlinkPassthrough>(system);
+        vehicle.mission_uploader =
+            std::make_shared<MissionItemUploader>(executor, vehicle.mavlink_passthrough);
+        vehicles.push_back(vehicle);
+    }
+
+    // All vehicles get their mission before any of them takes off.
+    // +1 because first plan is specified at argv[total_ports_used+1]
+    if (!upload_missions(vehicles, argv + total_ports_used + 1, max_uploads, console)) {
+        console.stop();
+        return 1;
+    }
+
+    std::vector<std::thread> threads;
+
+    for (const auto& vehicle : vehicles) {
+        std::thread t(&complete_mission, vehicle, std::ref(logger), std::ref(console));
         threads.push_back(
             std::move(t)); // Instead of copying, move t into the vector (less expensive)
-        planFile_provided += 1;
-        sleep_for(seconds(1));
     }
 
     for (auto& t : threads) {
         t.join();
     }
+
+    executor.stop();
+    console.stop();
+    std::cout << TELEMETRY_CONSOLE_TEXT << logger_stats_text("All vehicles", logger.stats())
+              << NORMAL_CONSOLE_TEXT << std::endl;
     return 0;
 }
 
-void complete_mission(std::string qgc_plan, std::shared_ptr<System> system)
+bool upload_missions(
+    std::vector<Vehicle>& vehicles,
+    char* plan_files[],
+    size_t max_uploads,
+    ConsoleRenderer& console)
+{
+    // Vehicles flying the same plan share its parsed and encoded items.
+    MissionPacketCache cache;
+
+    std::vector<FleetMissionUploader::Upload> uploads;
+    for (size_t i = 0; i < vehicles.size(); ++i) {
+        Vehicle& vehicle = vehicles[i];
+        const uint8_t system_id = vehicle.system->get_system_id();
+
+        // Import Mission items from QGC plan
+        auto loaded = cache.load(plan_files[i]);
+        handle_mission_err_exit(loaded.first, "Failed to import mission items: ", console);
+        vehicle.mission = loaded.second;
+
+        if (vehicle.mission->plan.mission_plan.mission_items.size() == 0) {
+            exit_with_error(console, "No missions! Exiting...");
+        }
+        console.log(
+            "[" + std::to_string(system_id) + "] Found " +
+            std::to_string(vehicle.mission->plan.mission_plan.mission_items.size()) +
+            " mission items (" + std::to_string(vehicle.mission->items.size()) +
+            " MAVLink items) in " + plan_files[i]);
+
+        console.set_status(system_id, "Waiting to upload mission");
+        auto mission_uploader = vehicle.mission_uploader;
+        auto mission = vehicle.mission;
+        uploads.push_back(FleetMissionUploader::Upload{
+            system_id,
+            [mission_uploader, mission](FleetMissionUploader::result_callback_t callback) {
+                mission_uploader->upload_async(mission, callback);
+            }});
+    }
+    const MissionPacketCache::Stats cache_stats = cache.stats();
+    console.log(
+        "Parsed and encoded " + std::to_string(cache_stats.parses) + " plans for " +
+        std::to_string(cache_stats.loads) + " vehicles");
+
+    FleetMissionUploader uploader(max_uploads);
+    const FleetMissionUploader::Report report = uploader.upload(
+        std::move(uploads),
+        [&console](
+            const FleetMissionUploader::UploadResult& result,
+            const FleetMissionUploader::Progress& progress) {
+            std::stringstream ss;
+            if (result.result == Mission::Result::Success) {
+                ss << "Mission uploaded in " << result.upload_time.count() << " ms";
+            } else {
+                ss << "Mission upload failed: " << result.result;
+            }
+            console.set_status(result.system_id, ss.str());
+            console.set_summary(FleetMissionUploader::to_string(progress));
+        });
+
+    std::stringstream ss;
+    ss << "Uploaded " << report.results.size() - report.failed << "/" << report.results.size()
+       << " missions in " << report.total_time.count() << " ms, " << max_uploads
+       << " at once, slowest upload " << report.max_upload_time.count() << " ms";
+    console.log(ss.str(), report.failed > 0);
+    console.set_summary("");
+    return report.failed == 0;
+}
+
+void complete_mission(
+    const Vehicle& vehicle, AsyncTelemetryLogger& logger, ConsoleRenderer& console)
 {
+    const std::shared_ptr<System>& system = vehicle.system;
+    const EncodedMission& mission = *vehicle.mission;
+    const uint8_t system_id = system->get_system_id();
+    auto log = [&console, system_id](const std::string& text) {
+        console.log("[" + std::to_string(system_id) + "] " + text);
+    };
+
     auto telemetry = std::make_shared<Telemetry>(system);
     auto action = std::make_shared<Action>(system);
-    auto mission = std::make_shared<Mission>(system);
 
     // We want to listen to the telemetry data at 1 Hz.
     const Telemetry::Result set_rate_result = telemetry->set_rate_position(1.0);
 
     if (set_rate_result != Telemetry::Result::Success) {
-        std::cerr << ERROR_CONSOLE_TEXT << "Setting rate failed:" << set_rate_result
-                  << NORMAL_CONSOLE_TEXT << std::endl;
+        std::stringstream ss;
+        ss << "[" << int(system_id) << "] Setting rate failed:" << set_rate_result;
+        console.log(ss.str(), true);
         return;
     }
 
-    std::cout << "Importing mission from mission plan: " << qgc_plan << std::endl;
+    // Creates a binary log named after the system id to store the position with time.
+    // Records have a fixed size, so the callback only fills in a struct and queues it,
+    // the file is written by the logger thread.
+    // Without it the vehicle still flies, only nothing is recorded.
+    AsyncTelemetryLogger::Channel* log_channel =
+        logger.open_channel(std::to_string(system_id) + ".tlm");
+    if (log_channel == nullptr) {
+        console.log(
+            "[" + std::to_string(system_id) + "] Could not open the log, flying without it",
+            true);
+    }
 
-    // Creates a file named with vehicle's last few digits of uuid number to store lat and lng with
-    // time
-    std::ofstream myFile;
-    myFile.open((std::to_string(system->get_system_id()) + ".csv"));
-    myFile << "Time, Vehicle_ID, Altitude, Latitude, Longitude, Absolute_Altitude, \n";
+    // The vehicle clock is synced with ours, so each record has the time the vehicle took
+    // the sample, and not only when it arrived here.
+    const std::shared_ptr<MavlinkPassthrough>& mavlink_passthrough = vehicle.mavlink_passthrough;
+    ClockSync clock_sync(mavlink_passthrough);
 
-    // Setting up the callback to monitor lat and longitude
-    telemetry->subscribe_position([&](Telemetry::Position position) {
-        myFile << getCurrentTimeString() << "," << (system->get_system_id()) << ","
-               << position.relative_altitude_m << "," << position.latitude_deg << ","
-               << position.longitude_deg << "," << position.absolute_altitude_m << ", \n";
+    // Remaining distance and ETA of the mission, shown next to the status.
+    MissionTracker tracker(mission.plan.mission_plan, MissionTracker::plan_speed_m_s(mission.plan));
+    tracker.subscribe_status([&console, system_id](const MissionTracker::Status& status) {
+        console.set_detail(system_id, MissionTracker::to_string(status));
     });
 
+    // GLOBAL_POSITION_INT directly instead of the telemetry position for its time_boot_ms.
+    // It is in the same units as the record already.
+    mavlink_passthrough->subscribe_message_async(
+        MAVLINK_MSG_ID_GLOBAL_POSITION_INT,
+        [log_channel, system_id, &clock_sync, &console, &tracker](
+            const mavlink_message_t& message) {
+            mavlink_global_position_int_t position;
+            mavlink_msg_global_position_int_decode(&message, &position);
+
+            TelemetryRecord record{};
+            record.monotonic_ns = telemetry_log_now_ns();
+            record.synced_monotonic_ns =
+                clock_sync.vehicle_to_host_ns(uint64_t(position.time_boot_ms) * 1000000);
+            record.time_boot_ms = position.time_boot_ms;
+            record.system_id = system_id;
+            record.latitude_e7 = position.lat;
+            record.longitude_e7 = position.lon;
+            record.absolute_altitude_mm = position.alt;
+            record.relative_altitude_mm = position.relative_alt;
+            if (log_channel != nullptr) {
+                log_channel->push(record);
+            }
+
+            console.set_position(
+                system_id, position.lat * 1e-7, position.lon * 1e-7, position.relative_alt * 1e-3f);
+            tracker.set_position(
+                position.lat * 1e-7, position.lon * 1e-7, position.relative_alt * 1e-3f);
+        });
+
     // Check if vehicle is ready to arm
+    console.set_status(system_id, "Getting ready to arm");
     while (telemetry->health_all_ok() != true) {
-        std::cout << "Vehicle is getting ready to arm" << std::endl;
         sleep_for(seconds(1));
     }
 
-    // Import Mission items from QGC plan
-    std::pair<Mission::Result, Mission::MissionPlan> import_res =
-        mission->import_qgroundcontrol_mission(qgc_plan);
-    handle_mission_err_exit(import_res.first, "Failed to import mission items: ");
-
-    if (import_res.second.mission_items.size() == 0) {
-        std::cerr << "No missions! Exiting..." << std::endl;
-        exit(EXIT_FAILURE);
-    }
-    std::cout << "Found " << import_res.second.mission_items.size()
-              << " mission items in the given QGC plan." << std::endl;
-
-    {
-        std::cout << "Uploading mission..." << std::endl;
-        // Wrap the asynchronous upload_mission function using std::future.
-        auto prom = std::make_shared<std::promise<Mission::Result>>();
-        auto future_result = prom->get_future();
-        mission->upload_mission_async(
-            import_res.second, [prom](Mission::Result result) { prom->set_value(result); });
-
-        const Mission::Result result = future_result.get();
-        handle_mission_err_exit(result, "Mission upload failed: ");
-        std::cout << "Mission uploaded." << std::endl;
-    }
-
-    std::cout << "Arming..." << std::endl;
+    console.set_status(system_id, "Arming...");
     const Action::Result arm_result = action->arm();
-    handle_action_err_exit(arm_result, "Arm failed: ");
-    std::cout << "Armed." << std::endl;
-
-    // Before starting the mission subscribe to the mission progress.
-    mission->subscribe_mission_progress([&](Mission::MissionProgress mission_progress) {
-        std::cout << "Mission status update, VehicleID: " << system->get_system_id() << " --> "
-                  << mission_progress.current << " / " << mission_progress.total << std::endl;
-    });
-
-    {
-        std::cout << "Starting mission." << std::endl;
-        auto prom = std::make_shared<std::promise<Mission::Result>>();
-        auto future_result = prom->get_future();
-        mission->start_mission_async([prom](Mission::Result result) {
-            prom->set_value(result);
-            std::cout << "Started mission." << std::endl;
+    handle_action_err_exit(
+        arm_result, "[" + std::to_string(system_id) + "] Arm failed: ", console);
+    console.set_status(system_id, "Armed.");
+
+    // Before starting the mission subscribe to the mission progress. The mission was not
+    // uploaded by the Mission plugin, so its progress comes from the MAVLink messages.
+    const int total_items = static_cast<int>(mission.plan.mission_plan.mission_items.size());
+    mavlink_passthrough->subscribe_message_async(
+        MAVLINK_MSG_ID_MISSION_CURRENT,
+        [&tracker, &mission, total_items](const mavlink_message_t& message) {
+            mavlink_mission_current_t mission_current;
+            mavlink_msg_mission_current_decode(&message, &mission_current);
+            // After the last item, MISSION_CURRENT stays on it. The end is only known from
+            // MISSION_ITEM_REACHED.
+            if (mission_current.seq < mission.mission_item_indices.size()) {
+                tracker.set_progress(
+                    mission.mission_item_indices[mission_current.seq], total_items);
+            }
         });
 
-        const Mission::Result result = future_result.get();
-        handle_mission_err_exit(result, "Mission start failed: ");
-    }
+    // The same as the Mission plugin: reaching the last item finishes the mission.
+    mavlink_passthrough->subscribe_message_async(
+        MAVLINK_MSG_ID_MISSION_ITEM_REACHED,
+        [&tracker, &mission, total_items](const mavlink_message_t& message) {
+            mavlink_mission_item_reached_t reached;
+            mavlink_msg_mission_item_reached_decode(&message, &reached);
+            if (reached.seq + 1u == mission.items.size()) {
+                tracker.set_progress(total_items, total_items);
+            }
+        });
 
-    while (!mission->is_mission_finished().second) {
-        sleep_for(seconds(1));
+    {
+        console.set_status(system_id, "Starting mission.");
+        const MavlinkPassthrough::Result result =
+            MissionItemUploader::start_mission(*mavlink_passthrough);
+        if (result != MavlinkPassthrough::Result::Success) {
+            std::stringstream ss;
+            ss << "[" << int(system_id) << "] Mission start failed: " << result;
+            exit_with_error(console, ss.str());
+        }
+        console.set_status(system_id, "Started mission.");
     }
 
-    // Wait for some time.
-    sleep_for(seconds(5));
+    // Wakes up with the MISSION_ITEM_REACHED of the last item.
+    tracker.wait_until_finished();
 
     {
         // Mission complete. Command RTL to go home.
-        std::cout << "Commanding RTL..." << std::endl;
+        console.set_status(system_id, "Commanding RTL...");
         const Action::Result result = action->return_to_launch();
         if (result != Action::Result::Success) {
-            std::cout << "Failed to command RTL (" << result << ")" << std::endl;
+            std::stringstream ss;
+            ss << "Failed to command RTL (" << result << ")";
+            console.set_status(system_id, ss.str());
         } else {
-            std::cout << "Commanded RTL." << std::endl;
+            console.set_status(system_id, "Commanded RTL.");
         }
     }
+
+    mavlink_passthrough->subscribe_message_async(MAVLINK_MSG_ID_MISSION_CURRENT, nullptr);
+    mavlink_passthrough->subscribe_message_async(MAVLINK_MSG_ID_MISSION_ITEM_REACHED, nullptr);
+    mavlink_passthrough->subscribe_message_async(MAVLINK_MSG_ID_GLOBAL_POSITION_INT, nullptr);
+    if (log_channel != nullptr) {
+        log(logger_stats_text("Vehicle " + std::to_string(system_id), log_channel->stats()));
+    }
+    log("Clock: " + ClockSync::to_string(clock_sync.stats()));
+}
+
+std::string logger_stats_text(const std::string& name, const AsyncTelemetryLogger::Stats& stats)
+{
+    std::stringstream ss;
+    ss << name << " log: " << stats.written << "/" << stats.pushed << " records written, "
+       << stats.dropped << " dropped, queue peak " << stats.queue_high_water_mark << "/"
+       << stats.queue_capacity << ", write latency " << stats.mean_write_latency_ns / 1000
+       << " us mean, " << stats.max_write_latency_ns / 1000 << " us max, " << stats.flushes
+       << " flushes";
+    return ss.str();
+}
+
+void exit_with_error(ConsoleRenderer& console, const std::string& text)
+{
+    console.log(text, true);
+    // Draws the message with the last frame, nothing is redrawn over it afterwards.
+    console.stop();
+    exit(EXIT_FAILURE);
 }
 
-static void handle_action_err_exit(Action::Result result, const std::string& message)
+void handle_action_err_exit(
+    Action::Result result, const std::string& message, ConsoleRenderer& console)
 {
     if (result != Action::Result::Success) {
-        std::cerr << ERROR_CONSOLE_TEXT << message << result << NORMAL_CONSOLE_TEXT << std::endl;
-        exit(EXIT_FAILURE);
+        std::stringstream ss;
+        ss << message << result;
+        exit_with_error(console, ss.str());
     }
 }
 
-static void handle_mission_err_exit(Mission::Result result, const std::string& message)
+void handle_mission_err_exit(
+    Mission::Result result, const std::string& message, ConsoleRenderer& console)
 {
     if (result != Mission::Result::Success) {
-        std::cerr << ERROR_CONSOLE_TEXT << message << result << NORMAL_CONSOLE_TEXT << std::endl;
-        exit(EXIT_FAILURE);
+        std::stringstream ss;
+        ss << message << result;
+        exit_with_error(console, ss.str());
     }
 }
@@ -0,0 +1,353 @@
+//
+// CPU time to prepare the mission uploads of a fleet which flies the same plan, with and
+// without MissionPacketCache, for 1 to 500 vehicles.
+//
+// Without the cache, every vehicle parses the plan, converts the mission items to MAVLink
+// and sends them. With the cache, the plan is parsed and encoded once and every vehicle
+// only addresses the items. The items are not sent anywhere.
+//
+// With a connection url, every vehicle also imports the plan with
+// Mission::import_qgroundcontrol_mission() and encodes the items one by one with
+// mavlink_msg_mission_item_int_encode(), the way the Mission plugin uploads them. The
+// cached uploads have to send the same payloads. The importer needs a system to exist,
+// the mock autopilot is enough:
+//
+//   mock_autopilot 14540 &
+//   ./mission_upload_benchmark [mission_items] [connection_url]
+//
+
+#include <mavsdk/mavsdk.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mission_packet_cache.h"
+#include "qgc_plan_parser.h"
+#include "system_discovery.h"
+
+using namespace mavsdk;
+
+#define ERROR_CONSOLE_TEXT "\033[31m" // Turn text on console red
+#define NORMAL_CONSOLE_TEXT "\033[0m" // Restore normal console colour
+
+namespace {
+
+const size_t vehicle_counts[] = {1, 10, 50, 100, 500};
+
+constexpr size_t default_mission_items = 1000;
+
+constexpr uint8_t our_sysid = 245;
+constexpr uint8_t our_compid = 190;
+
+// What the Mission plugin uses for waypoints which are not flown through.
+constexpr float plugin_hold_time_s = 0.5f;
+constexpr float plugin_acceptance_radius_m = 1.0f;
+
+// A lawnmower pattern with a speed change and a photo at every tenth waypoint.
+void write_plan(const std::string& path, size_t mission_item_count)
+{
+    std::ofstream out(path);
+    out << std::setprecision(10);
+    out << "{\"fileType\": \"Plan\", \"mission\": {\"cruiseSpeed\": 15, \"hoverSpeed\": 5, "
+        << "\"items\": [";
+    for (size_t i = 0; i < mission_item_count; ++i) {
+        const double latitude_deg = 47.397 + (i / 100) * 1e-4;
+        const double longitude_deg = 8.545 + ((i / 100) % 2 ? 99 - i % 100 : i % 100) * 1e-4;
+        out << (i == 0 ? "" : ",") << "{\"autoContinue\": true, \"command\": "
+            << (i == 0 ? 22 : 16) << ", \"frame\": 3, \"params\": [0, 0, 0, null, "
+            << latitude_deg << ", " << longitude_deg << ", 20], \"type\": \"SimpleItem\"}";
+        if (i % 10 == 5) {
+            out << ",{\"autoContinue\": true, \"command\": 178, \"frame\": 2, "
+                << "\"params\": [1, " << 5 + i % 3 << ", -1, 0, 0, 0, 0], "
+                << "\"type\": \"SimpleItem\"}"
+                << ",{\"autoContinue\": true, \"command\": 2000, \"frame\": 2, "
+                << "\"params\": [0, 0, 1, 0, 0, 0, 0], \"type\": \"SimpleItem\"}";
+        }
+    }
+    out << "], \"plannedHomePosition\": [47.397, 8.545, 488], \"version\": 2}, "
+        << "\"version\": 1}\n";
+}
+
+double cpu_time_ms()
+{
+    return 1000.0 * std::clock() / CLOCKS_PER_SEC;
+}
+
+uint32_t add_payload(uint32_t checksum, const mavlink_message_t& message)
+{
+    const char* payload = _MAV_PAYLOAD(&message);
+    for (uint8_t i = 0; i < message.len; ++i) {
+        checksum = checksum * 31 + static_cast<uint8_t>(payload[i]);
+    }
+    return checksum;
+}
+
+// Sums up the payloads an upload sends, so the compiler can't drop the work. The header
+// checksums can't be compared, they include the sequence number.
+uint32_t send_all(const EncodedMission& mission, uint8_t target_sysid)
+{
+    uint32_t checksum = 0;
+    mavlink_message_t message;
+    for (const auto& item : mission.items) {
+        MissionPacketCache::address_item(item, our_sysid, our_compid, target_sysid, 1, message);
+        checksum = add_payload(checksum, message);
+    }
+    return checksum;
+}
+
+uint32_t upload_without_cache(const std::vector<std::string>& paths, size_t vehicle_count)
+{
+    uint32_t checksum = 0;
+    for (size_t i = 0; i < vehicle_count; ++i) {
+        std::pair<Mission::Result, QgcPlan> parsed = QgcPlanParser::parse_file(paths[i % 2]);
+        EncodedMission mission{};
+        MissionPacketCache::encode(parsed.second.mission_plan, mission);
+        checksum += send_all(mission, static_cast<uint8_t>(i + 1));
+    }
+    return checksum;
+}
+
+// Encodes one MAVLink item after the other from the imported mission items, without
+// anything from MissionPacketCache.
+class PluginEncoder {
+public:
+    explicit PluginEncoder(uint8_t target_sysid) : target_sysid_(target_sysid) {}
+
+    void add(
+        uint16_t command,
+        uint8_t frame,
+        float param1,
+        float param2 = 0.0f,
+        float param3 = 0.0f,
+        float param4 = 0.0f,
+        int32_t x = 0,
+        int32_t y = 0,
+        float z = 0.0f)
+    {
+        mavlink_mission_item_int_t item{};
+        item.target_system = target_sysid_;
+        item.target_component = 1;
+        item.seq = seq_;
+        item.frame = frame;
+        item.command = command;
+        item.current = (seq_ == 0) ? 1 : 0;
+        item.autocontinue = 1;
+        item.param1 = param1;
+        item.param2 = param2;
+        item.param3 = param3;
+        item.param4 = param4;
+        item.x = x;
+        item.y = y;
+        item.z = z;
+        item.mission_type = MAV_MISSION_TYPE_MISSION;
+        ++seq_;
+
+        mavlink_message_t message;
+        mavlink_msg_mission_item_int_encode(our_sysid, our_compid, &message, &item);
+        checksum_ = add_payload(checksum_, message);
+    }
+
+    uint32_t checksum() const { return checksum_; }
+
+private:
+    const uint8_t target_sysid_;
+    uint16_t seq_{0};
+    uint32_t checksum_{0};
+};
+
+uint32_t send_as_plugin(const std::vector<Mission::MissionItem>& items, uint8_t target_sysid)
+{
+    PluginEncoder encoder(target_sysid);
+    float last_speed_m_s = NAN;
+    for (const auto& item : items) {
+        if (std::isfinite(item.latitude_deg) && std::isfinite(item.longitude_deg)) {
+            encoder.add(
+                MAV_CMD_NAV_WAYPOINT,
+                MAV_FRAME_GLOBAL_RELATIVE_ALT_INT,
+                item.is_fly_through ? 0.0f : plugin_hold_time_s,
+                plugin_acceptance_radius_m,
+                0.0f,
+                NAN,
+                static_cast<int32_t>(std::round(item.latitude_deg * 1e7)),
+                static_cast<int32_t>(std::round(item.longitude_deg * 1e7)),
+                item.relative_altitude_m);
+        }
+        if (std::isfinite(item.speed_m_s) && item.speed_m_s > 0.0f &&
+            item.speed_m_s != last_speed_m_s) {
+            encoder.add(MAV_CMD_DO_CHANGE_SPEED, MAV_FRAME_MISSION, 1.0f, item.speed_m_s, -1.0f);
+            last_speed_m_s = item.speed_m_s;
+        }
+        if (std::isfinite(item.gimbal_pitch_deg) || std::isfinite(item.gimbal_yaw_deg)) {
+            encoder.add(
+                MAV_CMD_DO_MOUNT_CONTROL,
+                MAV_FRAME_MISSION,
+                std::isfinite(item.gimbal_pitch_deg) ? item.gimbal_pitch_deg : 0.0f,
+                0.0f,
+                std::isfinite(item.gimbal_yaw_deg) ? item.gimbal_yaw_deg : 0.0f,
+                0.0f,
+                0,
+                0,
+                MAV_MOUNT_MODE_MAVLINK_TARGETING);
+        }
+        if (std::isfinite(item.loiter_time_s) && item.loiter_time_s > 0.0f) {
+            encoder.add(
+                MAV_CMD_NAV_DELAY,
+                MAV_FRAME_MISSION,
+                static_cast<float>(item.loiter_time_s),
+                -1.0f,
+                -1.0f,
+                -1.0f);
+        }
+        switch (item.camera_action) {
+            case Mission::MissionItem::CameraAction::TakePhoto:
+                encoder.add(MAV_CMD_IMAGE_START_CAPTURE, MAV_FRAME_MISSION, 0.0f, 0.0f, 1.0f);
+                break;
+            case Mission::MissionItem::CameraAction::StartPhotoInterval:
+                encoder.add(
+                    MAV_CMD_IMAGE_START_CAPTURE,
+                    MAV_FRAME_MISSION,
+                    0.0f,
+                    static_cast<float>(item.camera_photo_interval_s),
+                    0.0f);
+                break;
+            case Mission::MissionItem::CameraAction::StopPhotoInterval:
+                encoder.add(MAV_CMD_IMAGE_STOP_CAPTURE, MAV_FRAME_MISSION, 0.0f);
+                break;
+            case Mission::MissionItem::CameraAction::StartVideo:
+                encoder.add(MAV_CMD_VIDEO_START_CAPTURE, MAV_FRAME_MISSION, 0.0f);
+                break;
+            case Mission::MissionItem::CameraAction::StopVideo:
+                encoder.add(MAV_CMD_VIDEO_STOP_CAPTURE, MAV_FRAME_MISSION, 0.0f);
+                break;
+            default:
+                break;
+        }
+    }
+    return encoder.checksum();
+}
+
+uint32_t upload_with_plugin(
+    Mission& mission, const std::vector<std::string>& paths, size_t vehicle_count)
+{
+    uint32_t checksum = 0;
+    for (size_t i = 0; i < vehicle_count; ++i) {
+        const std::pair<Mission::Result, Mission::MissionPlan> imported =
+            mission.import_qgroundcontrol_mission(paths[i % 2]);
+        checksum += send_as_plugin(imported.second.mission_items, static_cast<uint8_t>(i + 1));
+    }
+    return checksum;
+}
+
+uint32_t upload_with_cache(const std::vector<std::string>& paths, size_t vehicle_count)
+{
+    MissionPacketCache cache;
+    uint32_t checksum = 0;
+    for (size_t i = 0; i < vehicle_count; ++i) {
+        checksum += send_all(*cache.load(paths[i % 2]).second, static_cast<uint8_t>(i + 1));
+    }
+    return checksum;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const size_t mission_items =
+        (argc >= 2) ? std::strtoul(argv[1], nullptr, 10) : default_mission_items;
+    if (argc > 3 || mission_items == 0) {
+        std::cout << "Usage : " << argv[0] << " [mission_items] [connection_url]" << std::endl
+                  << "Without a connection url the Mission plugin is left out." << std::endl;
+        return 1;
+    }
+
+    Mavsdk mavsdk;
+    std::unique_ptr<Mission> mission;
+
+    if (argc == 3) {
+        const ConnectionResult connection_result = mavsdk.add_any_connection(argv[2]);
+        if (connection_result != ConnectionResult::Success) {
+            std::cerr << ERROR_CONSOLE_TEXT << "Connection error: " << connection_result
+                      << NORMAL_CONSOLE_TEXT << std::endl;
+            return 1;
+        }
+
+        SystemDiscovery discovery(mavsdk);
+        if (!discovery.wait_for_systems(1, SystemDiscovery::default_timeout)) {
+            std::cerr << ERROR_CONSOLE_TEXT << "No system found" << NORMAL_CONSOLE_TEXT
+                      << std::endl;
+            return 1;
+        }
+        mission.reset(new Mission(discovery.discovered_systems().front().system));
+    }
+
+    // Two copies of the same plan, as if every vehicle had its own file.
+    std::vector<std::string> paths;
+    for (int copy = 0; copy < 2; ++copy) {
+        paths.push_back(
+            "mission_upload_benchmark_" + std::to_string(getpid()) + "_" +
+            std::to_string(copy) + ".plan");
+        write_plan(paths.back(), mission_items);
+    }
+
+    MissionPacketCache cache;
+    const auto loaded = cache.load(paths[0]);
+    if (loaded.first != Mission::Result::Success) {
+        std::cerr << ERROR_CONSOLE_TEXT << "Failed to parse " << paths[0] << NORMAL_CONSOLE_TEXT
+                  << std::endl;
+        return 1;
+    }
+    std::cout << mission_items << " mission items, " << loaded.second->items.size()
+              << " MAVLink items per upload" << std::endl;
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << std::setw(10) << "vehicles" << std::setw(20) << "uncached ms/upload"
+              << std::setw(18) << "cached ms/upload" << std::setw(10) << "speedup";
+    if (mission) {
+        std::cout << std::setw(18) << "plugin ms/upload" << std::setw(10) << "payloads";
+    }
+    std::cout << std::endl;
+
+    bool all_match = true;
+    for (const size_t vehicle_count : vehicle_counts) {
+        double start = cpu_time_ms();
+        upload_without_cache(paths, vehicle_count);
+        const double uncached_ms = (cpu_time_ms() - start) / vehicle_count;
+
+        start = cpu_time_ms();
+        const uint32_t cached_checksum = upload_with_cache(paths, vehicle_count);
+        const double cached_ms = (cpu_time_ms() - start) / vehicle_count;
+
+        std::cout << std::setw(10) << vehicle_count << std::setw(20) << uncached_ms
+                  << std::setw(18) << cached_ms << std::setw(10) << uncached_ms / cached_ms;
+
+        if (mission) {
+            start = cpu_time_ms();
+            const uint32_t plugin_checksum = upload_with_plugin(*mission, paths, vehicle_count);
+            const double plugin_ms = (cpu_time_ms() - start) / vehicle_count;
+
+            const bool match = plugin_checksum == cached_checksum;
+            all_match = all_match && match;
+            std::cout << std::setw(18) << plugin_ms << std::setw(10)
+                      << (match ? "same" : "differ");
+        }
+        std::cout << std::endl;
+    }
+
+    for (const auto& path : paths) {
+        std::remove(path.c_str());
+    }
+
+    if (!all_match) {
+        std::cerr << ERROR_CONSOLE_TEXT << "The cached uploads differ from the Mission plugin"
+                  << NORMAL_CONSOLE_TEXT << std::endl;
+    }
+    return all_match ? 0 : 1;
+}
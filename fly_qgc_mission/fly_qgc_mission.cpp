@@ -12,12 +12,17 @@
  * to see what sample mission plan in QGroundControl looks like.
  * 2. Run the example by passing path of the QGC mission plan as argument (By default, sample
  * mission plan is imported).
+ * 3. On a slow telemetry link, pass --sync <sync file> as the first argument. The mission is
+ * then only uploaded if the vehicle doesn't have it yet, and if only a few items changed,
+ * only those are sent. The sync file remembers what was uploaded to which vehicle.
  *
  * Example description:
  * 1. Imports QGC mission items from .plan file.
- * 2. Uploads mission items to vehicle.
+ * 2. Uploads mission items to vehicle, or only what changed with --sync. A lost message is
+ *    sent again on its own, the upload doesn't start over.
  * 3. Starts mission from first mission item.
- * 4. Commands RTL once QGC Mission is accomplished.
+ * 4. Prints the remaining distance and ETA, from the plan and the vehicle position.
+ * 5. Commands RTL as soon as the last mission item is reached.
  *
  * @author Shakthi Prashanth M <shakthi.prashanth.m@intel.com>,
  *         Julian Oes <julian@oes.ch>
@@ -26,6 +31,7 @@
 
 #include <mavsdk/mavsdk.h>
 #include <mavsdk/plugins/action/action.h>
+#include <mavsdk/plugins/mavlink_passthrough/mavlink_passthrough.h>
 #include <mavsdk/plugins/mission/mission.h>
 #include <mavsdk/plugins/telemetry/telemetry.h>
 
@@ -34,6 +40,14 @@
 #include <iostream>
 #include <memory>
 
+#include "fleet_executor.h"
+#include "mission_item_uploader.h"
+#include "mission_packet_cache.h"
+#include "mission_sync.h"
+#include "mission_tracker.h"
+#include "qgc_plan_parser.h"
+#include "system_discovery.h"
+
 #define ERROR_CONSOLE_TEXT "\033[31m" // Turn text on console red
 #define TELEMETRY_CONSOLE_TEXT "\033[34m" // Turn text on console blue
 #define NORMAL_CONSOLE_TEXT "\033[0m" // Restore normal console colour
@@ -48,11 +62,16 @@ inline void handle_action_err_exit(Action::Result result, const std::string& mes
 inline void handle_mission_err_exit(Mission::Result result, const std::string& message);
 // Handles Connection result
 inline void handle_connection_err_exit(ConnectionResult result, const std::string& message);
+// Mission progress of the uploaded mission, which the Mission plugin doesn't know
+void subscribe_mission_messages(
+    std::shared_ptr<MavlinkPassthrough> mavlink_passthrough,
+    std::shared_ptr<const EncodedMission> mission,
+    MissionTracker& tracker);
 
 void usage(std::string bin_name)
 {
     std::cout << NORMAL_CONSOLE_TEXT << "Usage : " << bin_name
-              << " <connection_url> [path of QGC Mission plan]" << std::endl
+              << " [--sync <sync file>] <connection_url> [path of QGC Mission plan]" << std::endl
               << "Connection URL format should be :" << std::endl
               << " For TCP : tcp://[server_host][:server_port]" << std::endl
               << " For UDP : udp://[bind_host][:bind_port]" << std::endl
@@ -69,6 +88,15 @@ int main(int argc, char** argv)
     // Locate path of QGC Sample plan
     std::string qgc_plan = "../qgroundcontrol_sample.plan";
 
+    std::string sync_file;
+    if (argc >= 3 && std::string(argv[1]) == "--sync") {
+        sync_file = argv[2];
+        // The connection and plan follow as if there was no option.
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
     if (argc != 2 && argc != 3) {
         usage(argv[0]);
         return 1;
@@ -82,33 +110,24 @@ int main(int argc, char** argv)
     std::cout << "Connection URL: " << connection_url << std::endl;
     std::cout << "Importing mission from mission plan: " << qgc_plan << std::endl;
 
-    {
-        auto prom = std::make_shared<std::promise<void>>();
-        auto future_result = prom->get_future();
-
-        std::cout << "Waiting to discover system..." << std::endl;
-        mavsdk.subscribe_on_new_system([&mavsdk, prom]() {
-            const auto system = mavsdk.systems().at(0);
-
-            if (system->is_connected()) {
-                std::cout << "Discovered system" << std::endl;
-                prom->set_value();
-            } else {
-                std::cout << "System timed out" << std::endl;
-                std::cout << "Exiting." << std::endl;
-                exit(0);
-            }
-        });
+    connection_result = mavsdk.add_any_connection(connection_url);
+    handle_connection_err_exit(connection_result, "Connection failed: ");
 
-        connection_result = mavsdk.add_any_connection(connection_url);
-        handle_connection_err_exit(connection_result, "Connection failed: ");
+    std::cout << "Waiting to discover system..." << std::endl;
+    SystemDiscovery discovery(mavsdk);
 
-        future_result.get();
+    if (!discovery.wait_for_systems(1, SystemDiscovery::default_timeout)) {
+        std::cerr << ERROR_CONSOLE_TEXT << "No system found, exiting." << NORMAL_CONSOLE_TEXT
+                  << std::endl;
+        return 1;
     }
 
-    auto system = mavsdk.systems().at(0);
+    const auto discovered = discovery.discovered_systems().at(0);
+    std::cout << "Discovered system after " << discovered.time_to_discovery.count() << " ms"
+              << std::endl;
+
+    auto system = discovered.system;
     auto action = std::make_shared<Action>(system);
-    auto mission = std::make_shared<Mission>(system);
     auto telemetry = std::make_shared<Telemetry>(system);
 
     while (!telemetry->health_all_ok()) {
@@ -119,28 +138,45 @@ int main(int argc, char** argv)
     std::cout << "System ready" << std::endl;
 
     // Import Mission items from QGC plan
-    std::pair<Mission::Result, Mission::MissionPlan> import_res =
-        mission->import_qgroundcontrol_mission(qgc_plan);
+    std::pair<Mission::Result, QgcPlan> import_res = QgcPlanParser::parse_file(qgc_plan);
     handle_mission_err_exit(import_res.first, "Failed to import mission items: ");
 
-    if (import_res.second.mission_items.size() == 0) {
+    if (import_res.second.mission_plan.mission_items.size() == 0) {
         std::cerr << "No missions! Exiting..." << std::endl;
         exit(EXIT_FAILURE);
     }
-    std::cout << "Found " << import_res.second.mission_items.size()
+    std::cout << "Found " << import_res.second.mission_plan.mission_items.size()
               << " mission items in the given QGC plan." << std::endl;
 
-    {
+    // Only runs the timeouts of the mission upload.
+    FleetExecutor executor(1);
+    auto mavlink_passthrough = std::make_shared<MavlinkPassthrough>(system);
+    // Uploaded through the passthrough, the Mission plugin doesn't know about the mission.
+    auto encoded_mission = std::make_shared<EncodedMission>();
+    encoded_mission->plan = import_res.second;
+    MissionPacketCache::encode(encoded_mission->plan.mission_plan, *encoded_mission);
+
+    if (sync_file.empty()) {
         std::cout << "Uploading mission..." << std::endl;
-        // Wrap the asynchronous upload_mission function using std::future.
+        // Unlike Mission::upload_mission_async, a lost message doesn't start the upload
+        // over, and the timeouts follow the round trip time of the link.
+        auto uploader = std::make_shared<MissionItemUploader>(executor, mavlink_passthrough);
         auto prom = std::make_shared<std::promise<Mission::Result>>();
         auto future_result = prom->get_future();
-        mission->upload_mission_async(
-            import_res.second, [prom](Mission::Result result) { prom->set_value(result); });
+        uploader->upload_async(
+            encoded_mission, [prom](Mission::Result result) { prom->set_value(result); });
 
         const Mission::Result result = future_result.get();
         handle_mission_err_exit(result, "Mission upload failed: ");
-        std::cout << "Mission uploaded." << std::endl;
+        const MissionItemUploader::Stats stats = uploader->stats();
+        std::cout << "Mission uploaded (" << stats.retransmissions << " retransmissions, "
+                  << "round trip " << stats.smoothed_rtt.count() / 1000 << " ms)." << std::endl;
+    } else {
+        std::cout << "Syncing mission..." << std::endl;
+        MissionSync mission_sync(executor, mavlink_passthrough, sync_file);
+        const MissionSync::Report report = mission_sync.sync(encoded_mission);
+        handle_mission_err_exit(report.result, "Mission sync failed: ");
+        std::cout << MissionSync::to_string(report) << std::endl;
     }
 
     std::cout << "Arming..." << std::endl;
@@ -148,31 +184,39 @@ int main(int argc, char** argv)
     handle_action_err_exit(arm_result, "Arm failed: ");
     std::cout << "Armed." << std::endl;
 
-    // Before starting the mission subscribe to the mission progress.
-    mission->subscribe_mission_progress([](Mission::MissionProgress mission_progress) {
-        std::cout << "Mission status update: " << mission_progress.current << " / "
-                  << mission_progress.total << std::endl;
+    // Before starting the mission subscribe to the mission progress. Together with the
+    // position, the tracker estimates how far and how long the rest of the mission is.
+    MissionTracker tracker(
+        import_res.second.mission_plan, MissionTracker::plan_speed_m_s(import_res.second));
+    tracker.subscribe_status([](const MissionTracker::Status& status) {
+        std::cout << "Mission status update: " << MissionTracker::to_string(status) << std::endl;
     });
+    subscribe_mission_messages(mavlink_passthrough, encoded_mission, tracker);
 
-    {
-        std::cout << "Starting mission." << std::endl;
-        auto prom = std::make_shared<std::promise<Mission::Result>>();
-        auto future_result = prom->get_future();
-        mission->start_mission_async([prom](Mission::Result result) {
-            prom->set_value(result);
-            std::cout << "Started mission." << std::endl;
-        });
-
-        const Mission::Result result = future_result.get();
-        handle_mission_err_exit(result, "Mission start failed: ");
+    const Telemetry::Result set_rate_result = telemetry->set_rate_position(1.0);
+    if (set_rate_result != Telemetry::Result::Success) {
+        std::cerr << ERROR_CONSOLE_TEXT << "Setting rate failed: " << set_rate_result
+                  << NORMAL_CONSOLE_TEXT << std::endl;
     }
+    telemetry->subscribe_position([&tracker](Telemetry::Position position) {
+        tracker.set_position(
+            position.latitude_deg, position.longitude_deg, position.relative_altitude_m);
+    });
 
-    while (!mission->is_mission_finished().second) {
-        sleep_for(seconds(1));
+    {
+        std::cout << "Starting mission." << std::endl;
+        const MavlinkPassthrough::Result result =
+            MissionItemUploader::start_mission(*mavlink_passthrough);
+        if (result != MavlinkPassthrough::Result::Success) {
+            std::cerr << ERROR_CONSOLE_TEXT << "Mission start failed: " << result
+                      << NORMAL_CONSOLE_TEXT << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        std::cout << "Started mission." << std::endl;
     }
 
-    // Wait for some time.
-    sleep_for(seconds(5));
+    // Wakes up with the MISSION_ITEM_REACHED of the last item.
+    tracker.wait_until_finished();
 
     {
         // Mission complete. Command RTL to go home.
@@ -185,9 +229,40 @@ int main(int argc, char** argv)
         }
     }
 
+    mavlink_passthrough->subscribe_message_async(MAVLINK_MSG_ID_MISSION_CURRENT, nullptr);
+    mavlink_passthrough->subscribe_message_async(MAVLINK_MSG_ID_MISSION_ITEM_REACHED, nullptr);
+    telemetry->subscribe_position(nullptr);
+    executor.stop();
     return 0;
 }
 
+void subscribe_mission_messages(
+    std::shared_ptr<MavlinkPassthrough> mavlink_passthrough,
+    std::shared_ptr<const EncodedMission> mission,
+    MissionTracker& tracker)
+{
+    const int total_items = static_cast<int>(mission->plan.mission_plan.mission_items.size());
+    mavlink_passthrough->subscribe_message_async(
+        MAVLINK_MSG_ID_MISSION_CURRENT,
+        [&tracker, mission, total_items](const mavlink_message_t& message) {
+            mavlink_mission_current_t mission_current;
+            mavlink_msg_mission_current_decode(&message, &mission_current);
+            if (mission_current.seq < mission->mission_item_indices.size()) {
+                tracker.set_progress(
+                    mission->mission_item_indices[mission_current.seq], total_items);
+            }
+        });
+    mavlink_passthrough->subscribe_message_async(
+        MAVLINK_MSG_ID_MISSION_ITEM_REACHED,
+        [&tracker, mission, total_items](const mavlink_message_t& message) {
+            mavlink_mission_item_reached_t reached;
+            mavlink_msg_mission_item_reached_decode(&message, &reached);
+            if (reached.seq + 1u == mission->items.size()) {
+                tracker.set_progress(total_items, total_items);
+            }
+        });
+}
+
 inline void handle_action_err_exit(Action::Result result, const std::string& message)
 {
     if (result != Action::Result::Success) {
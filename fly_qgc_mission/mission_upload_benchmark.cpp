@@ -0,0 +1,274 @@
+//
+// Times mission uploads of 10 to 200 items over an emulated radio link, with the Mission
+// plugin and with MissionItemUploader, once with a fixed timeout and once with the
+// timeout following the round trip time.
+//
+// Everything runs in this process: a mock vehicle, a UdpLinkProxy in front of it which
+// drops and delays datagrams in both directions, and MAVSDK connected to the proxy.
+//
+//   ./mission_upload_benchmark [loss] [delay ms] [jitter ms]
+//
+// E.g. 0.1 100 50 drops every tenth datagram and delays each by 100 to 150 ms, per
+// direction. Those are also the defaults.
+//
+
+#include <mavsdk/mavsdk.h>
+#include <mavsdk/plugins/mavlink_passthrough/mavlink_passthrough.h>
+#include <mavsdk/plugins/mission/mission.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "fleet_executor.h"
+#include "mission_item_uploader.h"
+#include "mission_packet_cache.h"
+#include "mock_vehicle.h"
+#include "system_discovery.h"
+#include "udp_link_proxy.h"
+#include "udp_socket.h"
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+#define ERROR_CONSOLE_TEXT "\033[31m" // Turn text on console red
+#define NORMAL_CONSOLE_TEXT "\033[0m" // Restore normal console colour
+
+namespace {
+
+const size_t mission_sizes[] = {10, 50, 100, 200};
+
+constexpr uint16_t client_port = 14600;
+constexpr uint16_t vehicle_port = 14601;
+constexpr milliseconds vehicle_update_interval{10};
+
+std::atomic<bool> should_exit{false};
+
+// The mock vehicle sends to the proxy like it would to MAVSDK. Its MAVLink channel is
+// the last one, MAVSDK allocates them from the first.
+void run_vehicle()
+{
+    const uint8_t channel = MAVLINK_COMM_NUM_BUFFERS - 1;
+
+    UdpSocket socket;
+    if (!socket.bind("127.0.0.1", 0) || !socket.set_remote("127.0.0.1", vehicle_port)) {
+        should_exit = true;
+        return;
+    }
+
+    MockVehicle vehicle(1, channel, [&socket](const mavlink_message_t& message) {
+        uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+        const uint16_t len = mavlink_msg_to_send_buffer(buffer, &message);
+        socket.send(buffer, len);
+    });
+    vehicle.set_verbose(false);
+
+    uint8_t buffer[2048];
+    auto next_update = steady_clock::now();
+
+    while (!should_exit) {
+        const auto now = steady_clock::now();
+        if (now >= next_update) {
+            vehicle.update(now);
+            next_update = std::max(next_update + vehicle_update_interval, now);
+        }
+
+        const auto wait_ms = duration_cast<milliseconds>(next_update - now).count();
+        const int received = socket.receive(buffer, sizeof(buffer), static_cast<int>(wait_ms));
+        if (received < 0) {
+            break;
+        }
+
+        mavlink_message_t message;
+        mavlink_status_t status;
+        for (int i = 0; i < received; ++i) {
+            if (mavlink_parse_char(channel, buffer[i], &message, &status) == MAVLINK_FRAMING_OK) {
+                vehicle.handle_message(message);
+            }
+        }
+    }
+}
+
+// A lawnmower pattern over a field of about 1 x 1 km.
+Mission::MissionPlan make_mission_plan(size_t mission_item_count)
+{
+    Mission::MissionPlan mission_plan;
+    for (size_t i = 0; i < mission_item_count; ++i) {
+        Mission::MissionItem item;
+        item.latitude_deg = 47.397 + (i / 2) * 1e-4;
+        item.longitude_deg = 8.545 + ((i + 1) / 2 % 2) * 1e-2;
+        item.relative_altitude_m = 20.0f;
+        item.speed_m_s = 10.0f;
+        item.is_fly_through = true;
+        mission_plan.mission_items.push_back(item);
+    }
+    return mission_plan;
+}
+
+struct Run {
+    Mission::Result result;
+    double time_s;
+    MissionItemUploader::Stats stats;
+};
+
+Run upload_with_plugin(Mission& mission, const Mission::MissionPlan& mission_plan)
+{
+    Run run{};
+    const auto start = steady_clock::now();
+    run.result = mission.upload_mission(mission_plan);
+    run.time_s = duration<double>(steady_clock::now() - start).count();
+    return run;
+}
+
+Run upload_with_uploader(
+    MissionItemUploader& uploader, std::shared_ptr<const EncodedMission> mission)
+{
+    // Only the difference to the previous runs.
+    const MissionItemUploader::Stats before = uploader.stats();
+
+    auto prom = std::make_shared<std::promise<Mission::Result>>();
+    auto future_result = prom->get_future();
+    const auto start = steady_clock::now();
+    uploader.upload_async(mission, [prom](Mission::Result result) { prom->set_value(result); });
+
+    Run run{};
+    run.result = future_result.get();
+    run.time_s = duration<double>(steady_clock::now() - start).count();
+    run.stats = uploader.stats();
+    run.stats.items_sent -= before.items_sent;
+    run.stats.retransmissions -= before.retransmissions;
+    run.stats.timeouts -= before.timeouts;
+    return run;
+}
+
+void print_run(size_t items, const std::string& method, const Run& run, bool has_stats)
+{
+    std::cout << std::setw(8) << items << std::setw(10) << method << std::setw(10)
+              << (run.result == Mission::Result::Success ? "ok" : "failed") << std::setw(10)
+              << run.time_s;
+    if (has_stats) {
+        std::cout << std::setw(8) << run.stats.items_sent << std::setw(10)
+                  << run.stats.retransmissions << std::setw(10) << run.stats.timeouts
+                  << std::setw(10) << run.stats.smoothed_rtt.count() / 1000.0 << std::setw(12)
+                  << run.stats.timeout.count();
+    }
+    if (run.result != Mission::Result::Success) {
+        std::cout << "  " << run.result;
+    }
+    std::cout << std::endl;
+}
+
+void usage(const std::string& bin_name)
+{
+    std::cout << "Usage : " << bin_name << " [loss] [delay ms] [jitter ms]" << std::endl
+              << "The loss is a probability from 0 to 1, everything applies to both "
+                 "directions."
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc > 4) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    UdpLinkProxy::LinkConfig link_config;
+    link_config.loss = (argc > 1) ? std::strtof(argv[1], nullptr) : 0.1f;
+    link_config.delay = milliseconds((argc > 2) ? std::atoi(argv[2]) : 100);
+    link_config.jitter = milliseconds((argc > 3) ? std::atoi(argv[3]) : 50);
+    if (link_config.loss < 0.0f || link_config.loss >= 1.0f) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    UdpLinkProxy::Config proxy_config;
+    proxy_config.vehicle_port = vehicle_port;
+    proxy_config.client_port = client_port;
+    proxy_config.uplink = link_config;
+    proxy_config.downlink = link_config;
+    UdpLinkProxy proxy(proxy_config);
+    if (!proxy.start()) {
+        std::cerr << ERROR_CONSOLE_TEXT << "Could not start the link proxy" << NORMAL_CONSOLE_TEXT
+                  << std::endl;
+        return 1;
+    }
+    std::thread vehicle_thread(run_vehicle);
+
+    Mavsdk mavsdk;
+    const ConnectionResult connection_result =
+        mavsdk.add_any_connection("udp://:" + std::to_string(client_port));
+    if (connection_result != ConnectionResult::Success) {
+        std::cerr << ERROR_CONSOLE_TEXT << "Connection error: " << connection_result
+                  << NORMAL_CONSOLE_TEXT << std::endl;
+        should_exit = true;
+        vehicle_thread.join();
+        return 1;
+    }
+
+    SystemDiscovery discovery(mavsdk);
+    if (!discovery.wait_for_systems(1, SystemDiscovery::default_timeout)) {
+        std::cerr << ERROR_CONSOLE_TEXT << "No system found" << NORMAL_CONSOLE_TEXT << std::endl;
+        should_exit = true;
+        vehicle_thread.join();
+        return 1;
+    }
+    auto system = discovery.discovered_systems().front().system;
+    Mission mission(system);
+    auto mavlink_passthrough = std::make_shared<MavlinkPassthrough>(system);
+
+    // One uploader for all runs: a pending timeout keeps an uploader alive after the run,
+    // and when it goes it unsubscribes whichever uploader came after it.
+    FleetExecutor executor(1);
+    auto uploader = std::make_shared<MissionItemUploader>(executor, mavlink_passthrough);
+
+    std::cout << "Both directions: " << UdpLinkProxy::to_string(link_config) << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::setw(8) << "items" << std::setw(10) << "method" << std::setw(10)
+              << "result" << std::setw(10) << "time s" << std::setw(8) << "sent" << std::setw(10)
+              << "retrans" << std::setw(10) << "timeouts" << std::setw(10) << "SRTT ms"
+              << std::setw(12) << "timeout ms" << std::endl;
+
+    bool all_ok = true;
+    for (const size_t mission_size : mission_sizes) {
+        auto encoded_mission = std::make_shared<EncodedMission>();
+        encoded_mission->plan.mission_plan = make_mission_plan(mission_size);
+        MissionPacketCache::encode(encoded_mission->plan.mission_plan, *encoded_mission);
+        const size_t items = encoded_mission->items.size();
+
+        const Run plugin_run = upload_with_plugin(mission, encoded_mission->plan.mission_plan);
+        print_run(items, "plugin", plugin_run, false);
+
+        uploader->set_adaptive_timeout(false);
+        const Run fixed_run = upload_with_uploader(*uploader, encoded_mission);
+        print_run(items, "fixed", fixed_run, true);
+
+        uploader->set_adaptive_timeout(true);
+        const Run adaptive_run = upload_with_uploader(*uploader, encoded_mission);
+        print_run(items, "adaptive", adaptive_run, true);
+
+        // The plugin is only the reference, it may well give up on a bad link.
+        all_ok = all_ok && fixed_run.result == Mission::Result::Success &&
+                 adaptive_run.result == Mission::Result::Success;
+    }
+
+    const UdpLinkProxy::Stats proxy_stats = proxy.stats();
+    std::cout << "Datagrams to the vehicle: " << proxy_stats.uplink.forwarded << " forwarded, "
+              << proxy_stats.uplink.dropped << " dropped" << std::endl
+              << "Datagrams from the vehicle: " << proxy_stats.downlink.forwarded
+              << " forwarded, " << proxy_stats.downlink.dropped << " dropped" << std::endl;
+
+    executor.stop();
+    should_exit = true;
+    vehicle_thread.join();
+    proxy.stop();
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,238 @@
+//
+// Times QgcPlanParser on generated plans from 10 to 100000 mission items.
+//
+// With a connection url, Mission::import_qgroundcontrol_mission() is timed on the same
+// files and the imported mission items are compared. The importer needs a system to
+// exist, the mock autopilot is enough:
+//
+//   mock_autopilot 14540 &
+//   ./qgc_plan_benchmark udp://:14540
+//
+
+#include <mavsdk/mavsdk.h>
+#include <mavsdk/plugins/mission/mission.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "qgc_plan_parser.h"
+#include "system_discovery.h"
+
+using namespace mavsdk;
+using namespace std::chrono;
+
+#define ERROR_CONSOLE_TEXT "\033[31m" // Turn text on console red
+#define NORMAL_CONSOLE_TEXT "\033[0m" // Restore normal console colour
+
+namespace {
+
+const size_t plan_sizes[] = {10, 100, 1000, 10000, 100000};
+
+// Runs per plan, the fastest one is reported.
+constexpr int repetitions = 5;
+
+void write_item(std::ofstream& out, bool first, int command, const double (&params)[7])
+{
+    out << (first ? "" : ",\n") << "            {\n"
+        << "                \"autoContinue\": true,\n"
+        << "                \"command\": " << command << ",\n"
+        << "                \"frame\": 3,\n"
+        << "                \"params\": [\n";
+    for (int i = 0; i < 7; ++i) {
+        out << "                    ";
+        if (params[i] != params[i]) {
+            out << "null";
+        } else {
+            out << params[i];
+        }
+        out << (i < 6 ? ",\n" : "\n");
+    }
+    out << "                ],\n"
+        << "                \"type\": \"SimpleItem\"\n"
+        << "            }";
+}
+
+// A lawnmower pattern with a speed change and a photo at every tenth waypoint, formatted
+// the way QGroundControl saves plans.
+void write_plan(const std::string& path, size_t mission_item_count)
+{
+    std::ofstream out(path);
+    out << std::setprecision(10);
+    out << "{\n"
+        << "    \"fileType\": \"Plan\",\n"
+        << "    \"geoFence\": {\n"
+        << "        \"circles\": [],\n"
+        << "        \"polygons\": [],\n"
+        << "        \"version\": 2\n"
+        << "    },\n"
+        << "    \"groundStation\": \"QGroundControl\",\n"
+        << "    \"mission\": {\n"
+        << "        \"cruiseSpeed\": 15,\n"
+        << "        \"firmwareType\": 12,\n"
+        << "        \"hoverSpeed\": 5,\n"
+        << "        \"items\": [\n";
+
+    const double nan = NAN;
+    for (size_t i = 0; i < mission_item_count; ++i) {
+        const double latitude_deg = 47.397 + (i / 100) * 1e-4;
+        const double longitude_deg = 8.545 + ((i / 100) % 2 ? 99 - i % 100 : i % 100) * 1e-4;
+        const double waypoint[7]{0, 0, 0, nan, latitude_deg, longitude_deg, 20};
+        write_item(out, i == 0, i == 0 ? 22 : 16, waypoint);
+
+        if (i % 10 == 5) {
+            const double speed[7]{1, 5, -1, 0, 0, 0, 0};
+            write_item(out, false, 178, speed);
+            const double photo[7]{0, 0, 1, 0, 0, 0, 0};
+            write_item(out, false, 2000, photo);
+        }
+    }
+
+    out << "\n        ],\n"
+        << "        \"plannedHomePosition\": [\n"
+        << "            47.397,\n"
+        << "            8.545,\n"
+        << "            488\n"
+        << "        ],\n"
+        << "        \"vehicleType\": 2,\n"
+        << "        \"version\": 2\n"
+        << "    },\n"
+        << "    \"rallyPoints\": {\n"
+        << "        \"points\": [],\n"
+        << "        \"version\": 2\n"
+        << "    },\n"
+        << "    \"version\": 1\n"
+        << "}\n";
+}
+
+long file_size(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    return static_cast<long>(file.tellg());
+}
+
+long max_rss_kb()
+{
+    rusage resources{};
+    getrusage(RUSAGE_SELF, &resources);
+    return resources.ru_maxrss;
+}
+
+template<typename F> double fastest_run_ms(F run)
+{
+    double fastest = 0.0;
+    for (int i = 0; i < repetitions; ++i) {
+        const auto start = steady_clock::now();
+        run();
+        const double elapsed = duration<double, std::milli>(steady_clock::now() - start).count();
+        fastest = (i == 0) ? elapsed : std::min(fastest, elapsed);
+    }
+    return fastest;
+}
+
+size_t count_mismatches(
+    const std::vector<Mission::MissionItem>& lhs, const std::vector<Mission::MissionItem>& rhs)
+{
+    size_t mismatches = std::max(lhs.size(), rhs.size()) - std::min(lhs.size(), rhs.size());
+    for (size_t i = 0; i < std::min(lhs.size(), rhs.size()); ++i) {
+        if (!(lhs[i] == rhs[i])) {
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+void usage(const std::string& bin_name)
+{
+    std::cout << "Usage : " << bin_name << " [connection_url]" << std::endl
+              << "Without a connection url only QgcPlanParser is measured." << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc > 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Mavsdk mavsdk;
+    std::unique_ptr<Mission> mission;
+
+    if (argc == 2) {
+        const ConnectionResult connection_result = mavsdk.add_any_connection(argv[1]);
+        if (connection_result != ConnectionResult::Success) {
+            std::cerr << ERROR_CONSOLE_TEXT << "Connection error: " << connection_result
+                      << NORMAL_CONSOLE_TEXT << std::endl;
+            return 1;
+        }
+
+        SystemDiscovery discovery(mavsdk);
+        if (!discovery.wait_for_systems(1, SystemDiscovery::default_timeout)) {
+            std::cerr << ERROR_CONSOLE_TEXT << "No system found" << NORMAL_CONSOLE_TEXT
+                      << std::endl;
+            return 1;
+        }
+        mission.reset(new Mission(discovery.discovered_systems().front().system));
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::setw(8) << "items" << std::setw(12) << "file kB" << std::setw(12)
+              << "parser ms" << std::setw(12) << "MB/s" << std::setw(14) << "peak RSS kB";
+    if (mission) {
+        std::cout << std::setw(14) << "importer ms" << std::setw(10) << "speedup" << std::setw(12)
+                  << "mismatches";
+    }
+    std::cout << std::endl;
+
+    bool all_match = true;
+
+    for (const size_t plan_size : plan_sizes) {
+        const std::string path = "qgc_plan_benchmark_" + std::to_string(getpid()) + "_" +
+                                 std::to_string(plan_size) + ".plan";
+        write_plan(path, plan_size);
+        const long size = file_size(path);
+
+        std::pair<Mission::Result, QgcPlan> parsed;
+        const double parser_ms =
+            fastest_run_ms([&]() { parsed = QgcPlanParser::parse_file(path); });
+        if (parsed.first != Mission::Result::Success) {
+            std::cerr << ERROR_CONSOLE_TEXT << "Failed to parse " << path << NORMAL_CONSOLE_TEXT
+                      << std::endl;
+            std::remove(path.c_str());
+            return 1;
+        }
+
+        std::cout << std::setw(8) << plan_size << std::setw(12) << size / 1024.0 << std::setw(12)
+                  << parser_ms << std::setw(12) << size / parser_ms / 1e3 << std::setw(14)
+                  << max_rss_kb();
+
+        // The importer runs after the parser, so its allocations don't show up in the
+        // parser's peak RSS.
+        if (mission) {
+            std::pair<Mission::Result, Mission::MissionPlan> imported;
+            const double importer_ms = fastest_run_ms(
+                [&]() { imported = mission->import_qgroundcontrol_mission(path); });
+
+            const size_t mismatches = count_mismatches(
+                parsed.second.mission_plan.mission_items, imported.second.mission_items);
+            all_match = all_match && mismatches == 0 && imported.first == parsed.first;
+
+            std::cout << std::setw(14) << importer_ms << std::setw(10) << importer_ms / parser_ms
+                      << std::setw(12) << mismatches;
+        }
+        std::cout << std::endl;
+
+        std::remove(path.c_str());
+    }
+
+    return all_match ? 0 : 1;
+}
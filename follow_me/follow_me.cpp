@@ -18,9 +18,13 @@
 #include <future>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <thread>
 
+#include "console_renderer.h"
 #include "fake_location_provider.h"
+#include "system_discovery.h"
+#include "telemetry_waiter.h"
 
 using namespace mavsdk;
 using namespace std::placeholders; // for `_1`
@@ -29,13 +33,12 @@ using namespace std::this_thread; // for sleep_for()
 
 // For coloring output
 #define ERROR_CONSOLE_TEXT "\033[31m" // Turn text on console red
-#define TELEMETRY_CONSOLE_TEXT "\033[34m" // Turn text on console blue
 #define NORMAL_CONSOLE_TEXT "\033[0m" // Restore normal console colour
 
 inline void action_error_exit(Action::Result result, const std::string& message);
 inline void follow_me_error_exit(FollowMe::Result result, const std::string& message);
 inline void connection_error_exit(ConnectionResult result, const std::string& message);
-inline void wait_until_discover(Mavsdk& mavsdk);
+inline bool wait_until_discover(Mavsdk& mavsdk);
 
 void usage(std::string bin_name)
 {
@@ -67,19 +70,33 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    wait_until_discover(mavsdk);
+    if (!wait_until_discover(mavsdk)) {
+        std::cout << ERROR_CONSOLE_TEXT << "No system found, exiting." << NORMAL_CONSOLE_TEXT
+                  << std::endl;
+        return 1;
+    }
 
     // System got discovered.
     auto system = mavsdk.systems().at(0);
+    const uint8_t system_id = system->get_system_id();
+
+    // Once the vehicle is armed, the callbacks only update its status line, drawn at 10 Hz,
+    // instead of printing from the telemetry threads. Created first, so it outlives them.
+    ConsoleRenderer console;
+
     auto action = std::make_shared<Action>(system);
     auto follow_me = std::make_shared<FollowMe>(system);
     auto telemetry = std::make_shared<Telemetry>(system);
+    TelemetryWaiter waiter(telemetry);
 
-    while (!telemetry->health_all_ok()) {
-        std::cout << "Waiting for system to be ready" << std::endl;
-        sleep_for(seconds(1));
+    std::cout << "Waiting for system to be ready" << std::endl;
+    const auto health_result = waiter.wait_for_health_all_ok();
+    if (!health_result.satisfied) {
+        std::cout << ERROR_CONSOLE_TEXT << "System did not get ready, "
+                  << TelemetryWaiter::to_string(health_result) << NORMAL_CONSOLE_TEXT << std::endl;
+        return 1;
     }
-    std::cout << "System is ready" << std::endl;
+    std::cout << "System is ready " << TelemetryWaiter::to_string(health_result) << std::endl;
 
     // Arm
     Action::Result arm_result = action->arm();
@@ -93,28 +110,45 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    telemetry->subscribe_position([](Telemetry::Position position) {
-        std::cout << TELEMETRY_CONSOLE_TEXT // set to blue
-                  << "Vehicle is at: " << position.latitude_deg << ", " << position.longitude_deg
-                  << " degrees" << NORMAL_CONSOLE_TEXT // set to default color again
-                  << std::endl;
+    console.set_status(system_id, "Armed");
+
+    waiter.subscribe_position([&console, system_id](Telemetry::Position position) {
+        console.set_position(
+            system_id, position.latitude_deg, position.longitude_deg, position.relative_altitude_m);
     });
 
     // Subscribe to receive updates on flight mode. You can find out whether FollowMe is active.
     telemetry->subscribe_flight_mode(std::bind(
         [&](Telemetry::FlightMode flight_mode) {
             const FollowMe::TargetLocation last_location = follow_me->get_last_location();
-            std::cout << "[FlightMode: " << flight_mode
-                      << "] Target is at: " << last_location.latitude_deg << ", "
-                      << last_location.longitude_deg << " degrees." << std::endl;
+            std::stringstream mode;
+            mode << flight_mode;
+            std::stringstream target;
+            target.precision(6);
+            target << std::fixed << last_location.latitude_deg << ", "
+                   << last_location.longitude_deg;
+            console.set_status(system_id, mode.str());
+            console.set_detail(system_id, target.str());
         },
         std::placeholders::_1));
 
     // Takeoff
     Action::Result takeoff_result = action->takeoff();
     action_error_exit(takeoff_result, "Takeoff failed");
-    std::cout << "In Air..." << std::endl;
-    sleep_for(seconds(5)); // Wait for drone to reach takeoff altitude
+    console.log("In Air...");
+
+    // Wait for drone to reach takeoff altitude, with some margin below it.
+    const auto takeoff_altitude = action->get_takeoff_altitude();
+    const float takeoff_altitude_m =
+        (takeoff_altitude.first == Action::Result::Success) ? takeoff_altitude.second : 2.5f;
+    const auto altitude_result =
+        waiter.wait_for_altitude_above(0.9f * takeoff_altitude_m, seconds(30));
+    if (!altitude_result.satisfied) {
+        console.log(
+            "Takeoff altitude not reached, " + TelemetryWaiter::to_string(altitude_result), true);
+        return 1;
+    }
+    console.log("At takeoff altitude " + TelemetryWaiter::to_string(altitude_result));
 
     // Configure Min height of the drone to be "20 meters" above home & Follow direction as "Front
     // right".
@@ -151,30 +185,29 @@ int main(int argc, char** argv)
     // Land
     const Action::Result land_result = action->land();
     action_error_exit(land_result, "Landing failed");
-    while (telemetry->in_air()) {
-        std::cout << "waiting until landed" << std::endl;
-        sleep_for(seconds(1));
+    console.log("waiting until landed");
+    const auto landed_result = waiter.wait_for_landed();
+    if (!landed_result.satisfied) {
+        console.log("Vehicle did not land, " + TelemetryWaiter::to_string(landed_result), true);
+        return 1;
     }
-    std::cout << "Landed..." << std::endl;
+    console.log("Landed " + TelemetryWaiter::to_string(landed_result));
     return 0;
 }
 
-void wait_until_discover(Mavsdk& mavsdk)
+bool wait_until_discover(Mavsdk& mavsdk)
 {
     std::cout << "Waiting to discover system..." << std::endl;
-    std::promise<void> discover_promise;
-    auto discover_future = discover_promise.get_future();
-
-    mavsdk.subscribe_on_new_system([&mavsdk, &discover_promise]() {
-        const auto system = mavsdk.systems().at(0);
+    SystemDiscovery discovery(mavsdk);
 
-        if (system->is_connected()) {
-            std::cout << "Discovered system" << std::endl;
-            discover_promise.set_value();
-        }
-    });
+    if (!discovery.wait_for_systems(1, SystemDiscovery::default_timeout)) {
+        return false;
+    }
 
-    discover_future.wait();
+    std::cout << "Discovered system after "
+              << discovery.discovered_systems().at(0).time_to_discovery.count() << " ms"
+              << std::endl;
+    return true;
 }
 
 // Handles Action's result
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cmath>
+
+#include "seqlock.h"
+
+/**
+ * @brief The AttitudeData class
+ * State shared between the MAVLink receive callbacks, the Sender thread and the Tester.
+ * Every struct sits in its own Seqlock, so the 20 Hz sender and the attitude status
+ * callback never wait for each other and readers never block a writer.
+ */
+class AttitudeData {
+public:
+    AttitudeData() = default;
+    ~AttitudeData() = default;
+
+    struct GimbalAttitude {
+        float roll_deg{NAN};
+        float pitch_deg{NAN};
+        float yaw_deg{NAN};
+    };
+
+    struct GimbalLimits {
+        float roll_min_deg{0.0f};
+        float roll_max_deg{0.0f};
+        float pitch_min_deg{0.0f};
+        float pitch_max_deg{0.0f};
+        float yaw_min_deg{0.0f};
+        float yaw_max_deg{0.0f};
+    };
+
+    struct VehicleAttitude {
+        float roll_deg{0.0f};
+        float pitch_deg{0.0f};
+        float yaw_deg{0.0f};
+    };
+
+    enum class Mode { Follow, Lock };
+
+    struct AttitudeSetpoint {
+        Mode mode{Mode::Follow};
+        float roll_deg{NAN};
+        float pitch_deg{NAN};
+        float yaw_deg{NAN};
+        float roll_rate_deg{NAN};
+        float pitch_rate_deg{NAN};
+        float yaw_rate_deg{NAN};
+    };
+
+    GimbalAttitude gimbal_attitude() const { return _gimbal_attitude.load(); }
+
+    GimbalLimits gimbal_limits() const { return _gimbal_limits.load(); }
+
+    VehicleAttitude vehicle_attitude() const { return _vehicle_attitude.load(); }
+
+    AttitudeSetpoint attitude_setpoint() const { return _attitude_setpoint.load(); }
+
+    // The change functions take any callable and call it inline, lambdas are not
+    // wrapped in a std::function.
+    template<typename F> void change_gimbal_attitude(F&& change_function)
+    {
+        _gimbal_attitude.modify(change_function);
+    }
+
+    template<typename F> void change_gimbal_limits(F&& change_function)
+    {
+        _gimbal_limits.modify(change_function);
+    }
+
+    template<typename F> void change_vehicle_attitude(F&& change_function)
+    {
+        _vehicle_attitude.modify(change_function);
+    }
+
+    template<typename F> void change_attitude_setpoint(F&& change_function)
+    {
+        _attitude_setpoint.modify(change_function);
+    }
+
+private:
+    Seqlock<GimbalAttitude> _gimbal_attitude{};
+    Seqlock<VehicleAttitude> _vehicle_attitude{};
+    Seqlock<AttitudeSetpoint> _attitude_setpoint{};
+    Seqlock<GimbalLimits> _gimbal_limits{};
+};
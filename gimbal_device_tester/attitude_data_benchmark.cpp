@@ -0,0 +1,242 @@
+//
+// Measures read and write latency of AttitudeData under the access pattern of
+// gimbal_device_tester, once with the seqlock storage and once with the previous single
+// mutex and std::function implementation.
+//
+// Four threads share the data: the attitude status callback writes the gimbal attitude,
+// the tester writes the setpoint and polls the gimbal attitude, the sender reads the
+// vehicle attitude and setpoint. Writers and the sender run at the given message rate,
+// the poller reads as fast as it can.
+//
+//   ./attitude_data_benchmark [rate_hz] [duration_s]
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "attitude_data.h"
+
+using namespace std::chrono;
+
+namespace {
+
+// The implementation AttitudeData had before the seqlock, kept for comparison.
+class MutexAttitudeData {
+public:
+    typedef AttitudeData::GimbalAttitude GimbalAttitude;
+    typedef AttitudeData::VehicleAttitude VehicleAttitude;
+    typedef AttitudeData::AttitudeSetpoint AttitudeSetpoint;
+
+    GimbalAttitude gimbal_attitude() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _gimbal_attitude;
+    }
+
+    VehicleAttitude vehicle_attitude() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _vehicle_attitude;
+    }
+
+    AttitudeSetpoint attitude_setpoint() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _attitude_setpoint;
+    }
+
+    void change_gimbal_attitude(
+        const std::function<void(GimbalAttitude& gimbal_attitude)>& change_function)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        change_function(_gimbal_attitude);
+    }
+
+    void change_attitude_setpoint(
+        const std::function<void(AttitudeSetpoint& attitude_setpoint)>& change_function)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        change_function(_attitude_setpoint);
+    }
+
+private:
+    mutable std::mutex _mutex{};
+    GimbalAttitude _gimbal_attitude{};
+    VehicleAttitude _vehicle_attitude{};
+    AttitudeSetpoint _attitude_setpoint{};
+};
+
+class LatencySamples {
+public:
+    explicit LatencySamples(const std::string& name) : _name(name) { _samples.reserve(1 << 20); }
+
+    template<typename F> void measure(F operation)
+    {
+        const auto start = steady_clock::now();
+        operation();
+        const auto end = steady_clock::now();
+        if (_samples.size() < _samples.capacity()) {
+            _samples.push_back(duration_cast<nanoseconds>(end - start).count());
+        }
+    }
+
+    void print()
+    {
+        if (_samples.empty()) {
+            return;
+        }
+        std::sort(_samples.begin(), _samples.end());
+        const auto percentile = [this](double fraction) {
+            return _samples[static_cast<size_t>(fraction * (_samples.size() - 1))];
+        };
+        std::cout << "  " << std::left << std::setw(26) << _name << std::right << std::setw(9)
+                  << _samples.size() << std::setw(9) << percentile(0.5) << std::setw(9)
+                  << percentile(0.99) << std::setw(9) << percentile(0.999) << std::setw(10)
+                  << _samples.back() << std::endl;
+    }
+
+private:
+    std::string _name;
+    std::vector<int64_t> _samples{};
+};
+
+// Runs operation at rate_hz on absolute deadlines, or back to back if rate_hz is 0.
+template<typename F>
+void run_at_rate(const std::atomic<bool>& should_exit, double rate_hz, F operation)
+{
+    const auto period = duration_cast<steady_clock::duration>(
+        duration<double>(rate_hz > 0.0 ? 1.0 / rate_hz : 0.0));
+    auto deadline = steady_clock::now();
+    while (!should_exit) {
+        operation();
+        if (rate_hz > 0.0) {
+            deadline += period;
+            std::this_thread::sleep_until(deadline);
+        }
+    }
+}
+
+template<typename Data> void run_benchmark(const std::string& name, double rate_hz, int duration_s)
+{
+    Data data;
+    std::atomic<bool> should_exit{false};
+
+    LatencySamples receive_write("receive: write attitude");
+    LatencySamples tester_write("tester: write setpoint");
+    LatencySamples tester_read("tester: poll attitude");
+    LatencySamples sender_read("sender: read both");
+
+    // Defeats dead code elimination of the reads.
+    std::atomic<float> sink{0.0f};
+
+    std::thread receiver([&]() {
+        float angle = 0.0f;
+        run_at_rate(should_exit, rate_hz, [&]() {
+            angle += 0.01f;
+            receive_write.measure([&]() {
+                data.change_gimbal_attitude([&](AttitudeData::GimbalAttitude& gimbal_attitude) {
+                    gimbal_attitude.roll_deg = 0.0f;
+                    gimbal_attitude.pitch_deg = angle;
+                    gimbal_attitude.yaw_deg = -angle;
+                });
+            });
+        });
+    });
+
+    std::thread setpoint_writer([&]() {
+        float angle = 0.0f;
+        run_at_rate(should_exit, rate_hz, [&]() {
+            angle -= 0.01f;
+            tester_write.measure([&]() {
+                data.change_attitude_setpoint(
+                    [&](AttitudeData::AttitudeSetpoint& attitude_setpoint) {
+                        attitude_setpoint.pitch_deg = angle;
+                        attitude_setpoint.yaw_deg = 0.0f;
+                        attitude_setpoint.mode = AttitudeData::Mode::Follow;
+                    });
+            });
+        });
+    });
+
+    std::thread sender([&]() {
+        run_at_rate(should_exit, rate_hz, [&]() {
+            float value = 0.0f;
+            sender_read.measure([&]() {
+                value = data.vehicle_attitude().yaw_deg + data.attitude_setpoint().pitch_deg;
+            });
+            sink.store(value, std::memory_order_relaxed);
+        });
+    });
+
+    std::thread poller([&]() {
+        run_at_rate(should_exit, 0.0, [&]() {
+            float value = 0.0f;
+            tester_read.measure([&]() { value = data.gimbal_attitude().pitch_deg; });
+            sink.store(value, std::memory_order_relaxed);
+        });
+    });
+
+    std::this_thread::sleep_for(seconds(duration_s));
+    should_exit = true;
+    receiver.join();
+    setpoint_writer.join();
+    sender.join();
+    poller.join();
+
+    std::cout << name << std::endl
+              << "  " << std::left << std::setw(26) << "latency [ns]" << std::right
+              << std::setw(9) << "ops" << std::setw(9) << "p50" << std::setw(9) << "p99"
+              << std::setw(9) << "p99.9" << std::setw(10) << "max" << std::endl;
+    receive_write.print();
+    tester_write.print();
+    sender_read.print();
+    tester_read.print();
+}
+
+void usage(const std::string& bin_name)
+{
+    std::cout << "Usage : " << bin_name << " [rate_hz] [duration_s]" << std::endl
+              << "Writers and the sender run at rate_hz (default 1000, 0 for as fast as"
+              << " possible) for duration_s (default 3) per implementation." << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    double rate_hz = 1000.0;
+    int duration_s = 3;
+
+    if (argc > 3) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (argc >= 2) {
+        rate_hz = std::strtod(argv[1], nullptr);
+    }
+    if (argc == 3) {
+        duration_s = std::atoi(argv[2]);
+    }
+    if (rate_hz < 0.0 || duration_s <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::cout << "Message rate: " << (rate_hz > 0.0 ? std::to_string(rate_hz) : "unlimited")
+              << " Hz, " << duration_s << " s per run, "
+              << std::thread::hardware_concurrency() << " cores" << std::endl;
+
+    run_benchmark<MutexAttitudeData>("mutex + std::function", rate_hz, duration_s);
+    run_benchmark<AttitudeData>("seqlock", rate_hz, duration_s);
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "spsc_ring.h"
+
+/**
+ * @brief One GIMBAL_DEVICE_ATTITUDE_STATUS, stamped with the time it was received.
+ */
+struct AttitudeSample {
+    std::chrono::steady_clock::time_point time;
+    float roll_deg;
+    float pitch_deg;
+    float yaw_deg;
+};
+
+/**
+ * @brief The AttitudeHistory class
+ * Every attitude status received, for the Tester to analyze the response between two
+ * samples that AttitudeData alone would only show the latest of. The receive callback
+ * is the only producer and the Tester the only consumer.
+ *
+ * Samples are only kept while the Tester drains them, a full ring drops new samples.
+ */
+class AttitudeHistory {
+public:
+    // 10 s at 400 Hz, far more than a Tester ever leaves undrained during a test case.
+    static constexpr size_t default_capacity = 4096;
+
+    explicit AttitudeHistory(size_t capacity = default_capacity) : _ring(capacity) {}
+
+    // Receive callback only.
+    void push(const AttitudeSample& sample)
+    {
+        if (!_ring.push(sample)) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Tester only. Appends all samples received since the last call to samples.
+    size_t drain(std::vector<AttitudeSample>& samples)
+    {
+        AttitudeSample batch[64];
+        size_t total = 0;
+        size_t count = 0;
+        while ((count = _ring.pop(batch, sizeof(batch) / sizeof(batch[0]))) > 0) {
+            samples.insert(samples.end(), batch, batch + count);
+            total += count;
+        }
+        return total;
+    }
+
+    // Tester only. Discards everything received so far.
+    void clear()
+    {
+        std::vector<AttitudeSample> discarded;
+        drain(discarded);
+    }
+
+    uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+    SpscRing<AttitudeSample> _ring;
+    std::atomic<uint64_t> _dropped{0};
+};
@@ -7,14 +7,26 @@
 #include <mavsdk/mavsdk.h>
 #include <mavsdk/plugins/mavlink_passthrough/mavlink_passthrough.h>
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <fstream>
 #include <future>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <sstream>
 #include <thread>
+#include <vector>
 #include <cmath>
 
+#include "attitude_data.h"
+#include "attitude_history.h"
+#include "link_profiler.h"
+#include "mavlink_tap.h"
+#include "step_response.h"
+#include "tlog.h"
+#include "tlog_capture.h"
+
 using namespace mavsdk;
 
 static constexpr auto test_prefix = "[TEST] ";
@@ -49,104 +61,6 @@ struct ReceiverData {
 
 static ReceiverData receiver_data{};
 
-class AttitudeData {
-public:
-    AttitudeData() = default;
-    ~AttitudeData() = default;
-
-    struct GimbalAttitude {
-        float roll_deg{NAN};
-        float pitch_deg{NAN};
-        float yaw_deg{NAN};
-    };
-
-    struct GimbalLimits {
-        float roll_min_deg{0.0f};
-        float roll_max_deg{0.0f};
-        float pitch_min_deg{0.0f};
-        float pitch_max_deg{0.0f};
-        float yaw_min_deg{0.0f};
-        float yaw_max_deg{0.0f};
-    };
-
-    struct VehicleAttitude {
-        float roll_deg{0.0f};
-        float pitch_deg{0.0f};
-        float yaw_deg{0.0f};
-    };
-
-    enum class Mode { Follow, Lock };
-
-    struct AttitudeSetpoint {
-        Mode mode{Mode::Follow};
-        float roll_deg{NAN};
-        float pitch_deg{NAN};
-        float yaw_deg{NAN};
-        float roll_rate_deg{NAN};
-        float pitch_rate_deg{NAN};
-        float yaw_rate_deg{NAN};
-    };
-
-    GimbalAttitude gimbal_attitude() const
-    {
-        std::lock_guard<std::mutex> lock(_mutex);
-        return _gimbal_attitude;
-    }
-
-    GimbalLimits gimbal_limits() const
-    {
-        std::lock_guard<std::mutex> lock(_mutex);
-        return _gimbal_limits;
-    }
-
-    VehicleAttitude vehicle_attitude() const
-    {
-        std::lock_guard<std::mutex> lock(_mutex);
-        return _vehicle_attitude;
-    }
-
-    AttitudeSetpoint attitude_setpoint() const
-    {
-        std::lock_guard<std::mutex> lock(_mutex);
-        return _attitude_setpoint;
-    }
-
-    void change_gimbal_attitude(
-        const std::function<void(GimbalAttitude& gimbal_attitude)>& change_function)
-    {
-        std::lock_guard<std::mutex> lock(_mutex);
-        change_function(_gimbal_attitude);
-    }
-
-    void
-    change_gimbal_limits(const std::function<void(GimbalLimits& gimbal_limits)>& change_function)
-    {
-        std::lock_guard<std::mutex> lock(_mutex);
-        change_function(_gimbal_limits);
-    }
-
-    void change_vehicle_attitude(
-        const std::function<void(VehicleAttitude& vehicle_attitude)>& change_function)
-    {
-        std::lock_guard<std::mutex> lock(_mutex);
-        change_function(_vehicle_attitude);
-    }
-
-    void change_attitude_setpoint(
-        const std::function<void(AttitudeSetpoint& attitude_setpoint)>& change_function)
-    {
-        std::lock_guard<std::mutex> lock(_mutex);
-        change_function(_attitude_setpoint);
-    }
-
-private:
-    mutable std::mutex _mutex{};
-    GimbalAttitude _gimbal_attitude{};
-    VehicleAttitude _vehicle_attitude{};
-    AttitudeSetpoint _attitude_setpoint{};
-    GimbalLimits _gimbal_limits{};
-};
-
 class Sender {
 public:
     explicit Sender(MavlinkPassthrough& mavlink_passthrough, AttitudeData& attitude_data) :
@@ -249,7 +163,10 @@ private:
 
 class Tester {
 public:
-    explicit Tester(AttitudeData& attitude_data) : _attitude_data(attitude_data) {}
+    explicit Tester(AttitudeData& attitude_data, AttitudeHistory& attitude_history) :
+        _attitude_data(attitude_data),
+        _attitude_history(attitude_history)
+    {}
 
     bool test_pitch_angle()
     {
@@ -394,6 +311,22 @@ public:
     {
         std::cout << test_prefix << description << "... " << std::flush;
 
+        // The expected yaw, the setpoint itself stays relative to the vehicle.
+        float expected_yaw_deg = yaw_deg;
+        if (mode == AttitudeData::Mode::Follow) {
+            const auto vehicle_attitude = _attitude_data.vehicle_attitude();
+            expected_yaw_deg += vehicle_attitude.yaw_deg;
+        }
+
+        const auto initial_attitude = _attitude_data.gimbal_attitude();
+        StepResponse pitch_response(
+            initial_attitude.pitch_deg, pitch_deg, false, settling_band_deg, settling_hold_s);
+        StepResponse yaw_response(
+            initial_attitude.yaw_deg, expected_yaw_deg, true, settling_band_deg, settling_hold_s);
+
+        _attitude_history.clear();
+        const auto start_time = std::chrono::steady_clock::now();
+
         _attitude_data.change_attitude_setpoint(
             [&](AttitudeData::AttitudeSetpoint& attitude_setpoint) {
                 attitude_setpoint.roll_deg = 0.0f;
@@ -405,15 +338,18 @@ public:
                 attitude_setpoint.mode = mode;
             });
 
-        std::this_thread::sleep_for(std::chrono::seconds(2));
+        // Up to 2 s, but done as soon as both axes settled.
+        follow_samples(
+            start_time,
+            std::chrono::seconds(2),
+            [&](float time_s, const AttitudeSample& sample) {
+                pitch_response.add(time_s, sample.pitch_deg);
+                yaw_response.add(time_s, sample.yaw_deg);
+                return pitch_response.settled() && yaw_response.settled();
+            });
 
         const float margin_deg = 5.0f;
 
-        if (mode == AttitudeData::Mode::Follow) {
-            const auto vehicle_attitude = _attitude_data.vehicle_attitude();
-            yaw_deg += vehicle_attitude.yaw_deg;
-        }
-
         const auto gimbal_attitude = _attitude_data.gimbal_attitude();
 
         bool pitch_fail = false;
@@ -430,9 +366,9 @@ public:
                 pitch_fail = true;
             }
 
-            if (gimbal_attitude.yaw_deg > yaw_deg + margin_deg) {
+            if (gimbal_attitude.yaw_deg > expected_yaw_deg + margin_deg) {
                 yaw_fail = true;
-            } else if (gimbal_attitude.yaw_deg < yaw_deg - margin_deg) {
+            } else if (gimbal_attitude.yaw_deg < expected_yaw_deg - margin_deg) {
                 yaw_fail = true;
             }
         } else {
@@ -453,8 +389,13 @@ public:
         }
 
         if (yaw_fail) {
-            std::cout << "-> yaw is " << gimbal_attitude.yaw_deg << " deg instead of " << yaw_deg
-                      << " deg\n";
+            std::cout << "-> yaw is " << gimbal_attitude.yaw_deg << " deg instead of "
+                      << expected_yaw_deg << " deg\n";
+        }
+
+        if (!skip) {
+            std::cout << "-> pitch: " << StepResponse::to_string(pitch_response.result()) << "\n"
+                      << "-> yaw: " << StepResponse::to_string(yaw_response.result()) << "\n";
         }
 
         return !(pitch_fail || yaw_fail);
@@ -466,6 +407,11 @@ public:
         std::cout << test_prefix << description << "... " << std::flush;
 
         const auto initial_attitude = _attitude_data.gimbal_attitude();
+        RateTracking pitch_tracking(pitch_rate_deg, false);
+        RateTracking yaw_tracking(yaw_rate_deg, true);
+
+        _attitude_history.clear();
+        const auto start_time = std::chrono::steady_clock::now();
 
         _attitude_data.change_attitude_setpoint(
             [&](AttitudeData::AttitudeSetpoint& attitude_setpoint) {
@@ -478,8 +424,15 @@ public:
                 attitude_setpoint.mode = AttitudeData::Mode::Follow;
             });
 
-        std::this_thread::sleep_for(
-            std::chrono::milliseconds(static_cast<unsigned>(duration_s * 1000.0f)));
+        // A rate is held for the full duration, there is nothing to settle.
+        follow_samples(
+            start_time,
+            std::chrono::milliseconds(static_cast<unsigned>(duration_s * 1000.0f)),
+            [&](float time_s, const AttitudeSample& sample) {
+                pitch_tracking.add(time_s, sample.pitch_deg);
+                yaw_tracking.add(time_s, sample.yaw_deg);
+                return false;
+            });
 
         const auto new_attitude = _attitude_data.gimbal_attitude();
 
@@ -521,6 +474,9 @@ public:
                       << expected_yaw_deg << " deg\n";
         }
 
+        std::cout << "-> pitch: " << pitch_tracking.to_string(pitch_tracking.result()) << "\n"
+                  << "-> yaw: " << yaw_tracking.to_string(yaw_tracking.result()) << "\n";
+
         return !(pitch_fail || yaw_fail);
     }
 
@@ -557,6 +513,13 @@ public:
 
         const auto time_needed_s = pitch_deg / pitch_rate_deg;
 
+        RateTracking pitch_tracking(pitch_rate_deg, false);
+        StepResponse pitch_response(
+            initial_attitude.pitch_deg, pitch_deg, false, settling_band_deg, settling_hold_s);
+
+        _attitude_history.clear();
+        const auto start_time = std::chrono::steady_clock::now();
+
         _attitude_data.change_attitude_setpoint(
             [&](AttitudeData::AttitudeSetpoint& attitude_setpoint) {
                 attitude_setpoint.roll_deg = 0.0f;
@@ -569,8 +532,13 @@ public:
             });
 
         // We wait for half the time, then check to assess if the speed is corrct.
-        std::this_thread::sleep_for(
-            std::chrono::milliseconds(static_cast<unsigned>(time_needed_s / 2.0f * 1000.0f)));
+        const auto halftime =
+            std::chrono::milliseconds(static_cast<unsigned>(time_needed_s / 2.0f * 1000.0f));
+        follow_samples(start_time, halftime, [&](float time_s, const AttitudeSample& sample) {
+            pitch_tracking.add(time_s, sample.pitch_deg);
+            pitch_response.add(time_s, sample.pitch_deg);
+            return false;
+        });
 
         bool halftime_fail = false;
         const auto halftime_attitude = _attitude_data.gimbal_attitude();
@@ -585,9 +553,15 @@ public:
             halftime_fail = true;
         }
 
-        // Then we wait longer to let it finish and add some margin.
-        std::this_thread::sleep_for(
-            std::chrono::milliseconds(static_cast<unsigned>(time_needed_s / 2.0f * 1000.0f) + 1));
+        // Then we wait longer to let it finish and add some margin, but stop once settled.
+        follow_samples(
+            start_time,
+            halftime * 2 + std::chrono::seconds(1),
+            [&](float time_s, const AttitudeSample& sample) {
+                pitch_tracking.add(time_s, sample.pitch_deg);
+                pitch_response.add(time_s, sample.pitch_deg);
+                return pitch_response.settled();
+            });
 
         bool end_fail = false;
         const auto end_attitude = _attitude_data.gimbal_attitude();
@@ -616,11 +590,84 @@ public:
                       << end_expected_pitch_deg << " at end deg\n";
         }
 
+        std::cout << "-> pitch: " << pitch_tracking.to_string(pitch_tracking.result()) << "\n"
+                  << "-> pitch rate: " << StepResponse::to_string(pitch_response.result()) << "\n";
+
         return !(halftime_fail || end_fail);
     }
 
 private:
+    // An axis counts as settled after staying within the band for the hold time.
+    static constexpr float settling_band_deg = 2.0f;
+    static constexpr float settling_hold_s = 0.3f;
+
+    // Feeds every attitude sample received after start_time to on_sample(time_s, sample)
+    // until it returns true or the timeout since start_time expired.
+    template<typename F>
+    void follow_samples(
+        std::chrono::steady_clock::time_point start_time,
+        std::chrono::milliseconds timeout,
+        F on_sample)
+    {
+        const auto end_time = start_time + timeout;
+        std::vector<AttitudeSample> samples;
+
+        while (std::chrono::steady_clock::now() < end_time) {
+            samples.clear();
+            _attitude_history.drain(samples);
+            for (const auto& sample : samples) {
+                if (sample.time < start_time) {
+                    continue;
+                }
+                const float time_s =
+                    std::chrono::duration<float>(sample.time - start_time).count();
+                if (on_sample(time_s, sample)) {
+                    return;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
     AttitudeData& _attitude_data;
+    AttitudeHistory& _attitude_history;
+};
+
+constexpr float Tester::settling_band_deg;
+constexpr float Tester::settling_hold_s;
+
+// Prints what went over the link since the last report, while the tests run.
+class ProfileReporter {
+public:
+    explicit ProfileReporter(LinkProfiler& link_profiler) :
+        _link_profiler(link_profiler),
+        _thread(&ProfileReporter::run, this)
+    {}
+
+    ~ProfileReporter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _should_exit = true;
+        }
+        _cv.notify_all();
+        _thread.join();
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (!_cv.wait_for(lock, std::chrono::seconds(5), [this]() { return _should_exit; })) {
+            std::cout << '\n' << LinkProfiler::to_string(_link_profiler.report()) << std::flush;
+        }
+    }
+
+private:
+    LinkProfiler& _link_profiler;
+    std::mutex _mutex{};
+    std::condition_variable _cv{};
+    bool _should_exit{false};
+    std::thread _thread;
 };
 
 bool wait_for_yaw_estimator_to_converge(const AttitudeData& attitude_data)
@@ -753,11 +800,15 @@ void subscribe_to_heartbeat(MavlinkPassthrough& mavlink_passthrough)
 }
 
 void subscribe_to_gimbal_device_attitude_status(
-    MavlinkPassthrough& mavlink_passthrough, AttitudeData& attitude_data)
+    MavlinkPassthrough& mavlink_passthrough,
+    AttitudeData& attitude_data,
+    AttitudeHistory& attitude_history)
 {
     mavlink_passthrough.subscribe_message_async(
         MAVLINK_MSG_ID_GIMBAL_DEVICE_ATTITUDE_STATUS,
-        [&attitude_data](const mavlink_message_t& message) {
+        [&attitude_data, &attitude_history](const mavlink_message_t& message) {
+            const auto receive_time = std::chrono::steady_clock::now();
+
             mavlink_gimbal_device_attitude_status_t attitude_status;
             mavlink_msg_gimbal_device_attitude_status_decode(&message, &attitude_status);
 
@@ -778,17 +829,51 @@ void subscribe_to_gimbal_device_attitude_status(
                     gimbal_attitude.pitch_deg = degrees(pitch_rad);
                     gimbal_attitude.yaw_deg = degrees(yaw_rad);
                 });
+
+            attitude_history.push(AttitudeSample{
+                receive_time, degrees(roll_rad), degrees(pitch_rad), degrees(yaw_rad)});
         });
 }
 
 void usage(const std::string& bin_name)
 {
-    std::cout << "Usage : " << bin_name << " <connection_url>" << std::endl
+    std::cout << "Usage : " << bin_name
+              << " <connection_url> [--tlog <capture.tlog>] [--profile <profile.json>]"
+              << std::endl
               << "Connection URL format should be :" << std::endl
               << " For TCP : tcp://[server_host][:server_port]" << std::endl
               << " For UDP : udp://[bind_host][:bind_port]" << std::endl
               << " For Serial : serial:///path/to/serial/dev[:baudrate]" << std::endl
-              << "For example, to connect to the simulator use URL: udp://:14540" << std::endl;
+              << "For example, to connect to the simulator use URL: udp://:14540" << std::endl
+              << "--tlog records all MAVLink traffic to a capture file." << std::endl
+              << "--profile prints the traffic per message every 5 s and writes the totals"
+              << " to a JSON file at the end." << std::endl;
+}
+
+void print_capture_stats(const TlogCapture::Stats& capture, const TlogWriter::Stats& writer)
+{
+    std::cout << test_prefix << "Captured " << capture.incoming << " incoming and "
+              << capture.outgoing << " outgoing messages, " << writer.written << " written ("
+              << writer.bytes_written / 1024 << " KiB in " << writer.writes << " writes), "
+              << writer.dropped << " dropped, queue peak " << writer.queue_high_water_mark << "/"
+              << writer.queue_capacity << std::endl;
+}
+
+bool run_tests(AttitudeData& attitude_data, AttitudeHistory& attitude_history)
+{
+    if (!wait_for_yaw_estimator_to_converge(attitude_data)) {
+        return false;
+    }
+
+    if (!sysid_compid_correct()) {
+        return false;
+    }
+
+    Tester tester(attitude_data, attitude_history);
+
+    return tester.test_pitch_angle() && tester.test_yaw_angle_follow() &&
+           tester.test_yaw_angle_lock() && tester.test_pitch_rate() && tester.test_yaw_rate() &&
+           tester.test_pitch_angle_and_rate();
 }
 
 int main(int argc, char** argv)
@@ -796,17 +881,30 @@ int main(int argc, char** argv)
     Mavsdk mavsdk;
     std::string connection_url;
     ConnectionResult connection_result;
-
-    std::cout << test_prefix << "Connecting... " << std::flush;
-
-    if (argc == 2) {
-        connection_url = argv[1];
-        connection_result = mavsdk.add_any_connection(connection_url);
-    } else {
+    std::string tlog_path;
+    std::string profile_path;
+
+    bool arguments_valid = argc >= 2 && argc % 2 == 0;
+    for (int i = 2; arguments_valid && i + 1 < argc; i += 2) {
+        const std::string option = argv[i];
+        if (option == "--tlog") {
+            tlog_path = argv[i + 1];
+        } else if (option == "--profile") {
+            profile_path = argv[i + 1];
+        } else {
+            arguments_valid = false;
+        }
+    }
+    if (!arguments_valid) {
         usage(argv[0]);
         return 1;
     }
 
+    std::cout << test_prefix << "Connecting... " << std::flush;
+
+    connection_url = argv[1];
+    connection_result = mavsdk.add_any_connection(connection_url);
+
     if (connection_result != ConnectionResult::Success) {
         std::cout << "FAIL\n";
         std::cout << "-> connection failed: " << connection_result << std::endl;
@@ -833,6 +931,29 @@ int main(int argc, char** argv)
     auto system = mavsdk.systems().at(0);
     MavlinkPassthrough mavlink_passthrough(system);
 
+    // Recording and profiling start before anything is sent, so they cover the whole test.
+    TlogWriter tlog_writer;
+    TlogCapture tlog_capture(tlog_writer);
+    LinkProfiler link_profiler;
+    std::vector<MavlinkTap::observer_t> observers;
+    if (!tlog_path.empty()) {
+        if (!tlog_writer.open(tlog_path)) {
+            return 1;
+        }
+        observers.push_back([&tlog_capture](const mavlink_message_t& message, bool outgoing) {
+            tlog_capture.capture(message, outgoing);
+        });
+    }
+    if (!profile_path.empty()) {
+        observers.push_back([&link_profiler](const mavlink_message_t& message, bool outgoing) {
+            link_profiler.profile(message, outgoing);
+        });
+    }
+    std::unique_ptr<MavlinkTap> mavlink_tap;
+    if (!observers.empty()) {
+        mavlink_tap.reset(new MavlinkTap(mavlink_passthrough, std::move(observers)));
+    }
+
     subscribe_to_heartbeat(mavlink_passthrough);
 
     AttitudeData attitude_data{};
@@ -848,43 +969,32 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    subscribe_to_gimbal_device_attitude_status(mavlink_passthrough, attitude_data);
+    AttitudeHistory attitude_history{};
+    subscribe_to_gimbal_device_attitude_status(
+        mavlink_passthrough, attitude_data, attitude_history);
 
     Sender sender(mavlink_passthrough, attitude_data);
 
-    if (!wait_for_yaw_estimator_to_converge(attitude_data)) {
-        return 1;
-    }
-
-    if (!sysid_compid_correct()) {
-        return 1;
-    }
-
-    Tester tester(attitude_data);
-
-    if (!tester.test_pitch_angle()) {
-        return 1;
-    }
-
-    if (!tester.test_yaw_angle_follow()) {
-        return 1;
-    }
-
-    if (!tester.test_yaw_angle_lock()) {
-        return 1;
-    }
-
-    if (!tester.test_pitch_rate()) {
-        return 1;
+    bool passed;
+    {
+        std::unique_ptr<ProfileReporter> profile_reporter;
+        if (!profile_path.empty()) {
+            profile_reporter.reset(new ProfileReporter(link_profiler));
+        }
+        passed = run_tests(attitude_data, attitude_history);
     }
 
-    if (!tester.test_yaw_rate()) {
-        return 1;
+    // Also after a failed test, that's when the traffic is most interesting.
+    if (!tlog_path.empty()) {
+        print_capture_stats(tlog_capture.stats(), tlog_writer.stats());
     }
-
-    if (!tester.test_pitch_angle_and_rate()) {
-        return 1;
+    if (!profile_path.empty()) {
+        std::ofstream profile_file(profile_path);
+        profile_file << LinkProfiler::to_json(link_profiler.totals());
+        if (!profile_file) {
+            std::cerr << "Could not write " << profile_path << std::endl;
+        }
     }
 
-    return 0;
+    return passed ? 0 : 1;
 }
@@ -0,0 +1,195 @@
+#include "step_response.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+float wrap_180(float angle_deg)
+{
+    angle_deg = std::fmod(angle_deg + 180.0f, 360.0f);
+    if (angle_deg < 0.0f) {
+        angle_deg += 360.0f;
+    }
+    return angle_deg - 180.0f;
+}
+
+} // namespace
+
+StepResponse::StepResponse(
+    float initial_deg, float target_deg, bool wraps, float band_deg, float hold_time_s) :
+    _target_deg(target_deg),
+    _wraps(wraps),
+    _band_deg(band_deg),
+    _hold_time_s(hold_time_s),
+    _step_deg(wraps ? wrap_180(target_deg - initial_deg) : target_deg - initial_deg),
+    _rise_start_s(NAN),
+    _rise_end_s(NAN),
+    _in_band_since_s(NAN)
+{
+    if (!std::isfinite(_step_deg)) {
+        _step_deg = 0.0f;
+    }
+}
+
+float StepResponse::error(float value_deg) const
+{
+    const float error_deg = _target_deg - value_deg;
+    return _wraps ? wrap_180(error_deg) : error_deg;
+}
+
+void StepResponse::add(float time_s, float value_deg)
+{
+    if (!std::isfinite(value_deg)) {
+        return;
+    }
+
+    const float error_deg = error(value_deg);
+    ++_samples;
+    _last_time_s = time_s;
+    _last_error_deg = error_deg;
+
+    // Only steps clearly larger than the band have a meaningful rise time and overshoot.
+    if (std::fabs(_step_deg) > _band_deg) {
+        const float progress = 1.0f - error_deg / _step_deg;
+        if (std::isnan(_rise_start_s) && progress >= 0.1f) {
+            _rise_start_s = time_s;
+        }
+        if (std::isnan(_rise_end_s) && progress >= 0.9f) {
+            _rise_end_s = time_s;
+        }
+        // Past the target the error has the opposite sign of the step.
+        const float beyond_deg = (_step_deg > 0.0f) ? -error_deg : error_deg;
+        _overshoot_deg = std::max(_overshoot_deg, beyond_deg);
+    }
+
+    if (std::fabs(error_deg) <= _band_deg) {
+        if (std::isnan(_in_band_since_s)) {
+            _in_band_since_s = time_s;
+            _in_band_error_sum = 0.0;
+            _in_band_samples = 0;
+        }
+        _in_band_error_sum += error_deg;
+        ++_in_band_samples;
+    } else {
+        _in_band_since_s = NAN;
+    }
+}
+
+bool StepResponse::settled() const
+{
+    return !std::isnan(_in_band_since_s) && _last_time_s - _in_band_since_s >= _hold_time_s;
+}
+
+StepResponse::Result StepResponse::result() const
+{
+    Result result{};
+    result.settled = settled();
+    result.rise_time_s = (!std::isnan(_rise_start_s) && !std::isnan(_rise_end_s)) ?
+                             _rise_end_s - _rise_start_s :
+                             NAN;
+    result.overshoot_deg = _overshoot_deg;
+    result.overshoot_percent =
+        (std::fabs(_step_deg) > _band_deg) ? 100.0f * _overshoot_deg / std::fabs(_step_deg) : 0.0f;
+    result.settling_time_s = result.settled ? _in_band_since_s : NAN;
+    if (result.settled && _in_band_samples > 0) {
+        result.steady_state_error_deg = static_cast<float>(_in_band_error_sum / _in_band_samples);
+    } else {
+        result.steady_state_error_deg = (_samples > 0) ? _last_error_deg : NAN;
+    }
+    return result;
+}
+
+std::string StepResponse::to_string(const Result& result)
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    if (std::isnan(result.rise_time_s)) {
+        ss << "rise -";
+    } else {
+        ss << "rise " << result.rise_time_s << " s";
+    }
+    ss << ", overshoot " << std::setprecision(1) << result.overshoot_deg << " deg ("
+       << std::setprecision(0) << result.overshoot_percent << " %), " << std::setprecision(2);
+    if (result.settled) {
+        ss << "settled after " << result.settling_time_s << " s";
+    } else {
+        ss << "not settled";
+    }
+    ss << ", error " << std::setprecision(1) << result.steady_state_error_deg << " deg";
+    return ss.str();
+}
+
+RateTracking::RateTracking(
+    float commanded_rate_deg_s, bool wraps, float transient_s, float window_s) :
+    _commanded_rate_deg_s(commanded_rate_deg_s),
+    _wraps(wraps),
+    _transient_s(transient_s),
+    _window_s(window_s)
+{}
+
+void RateTracking::add(float time_s, float value_deg)
+{
+    if (time_s < _transient_s || !std::isfinite(value_deg)) {
+        return;
+    }
+
+    if (!_has_window_start) {
+        _has_window_start = true;
+        _window_start_s = time_s;
+        _window_delta_deg = 0.0f;
+        _last_deg = value_deg;
+        return;
+    }
+
+    const float delta_deg = value_deg - _last_deg;
+    _window_delta_deg += _wraps ? wrap_180(delta_deg) : delta_deg;
+    _last_deg = value_deg;
+
+    const float window_length_s = time_s - _window_start_s;
+    if (window_length_s >= _window_s) {
+        _window_rates.push_back(_window_delta_deg / window_length_s);
+        _window_start_s = time_s;
+        _window_delta_deg = 0.0f;
+    }
+}
+
+RateTracking::Result RateTracking::result() const
+{
+    Result result{};
+    result.windows = static_cast<unsigned>(_window_rates.size());
+    if (_window_rates.empty()) {
+        result.mean_rate_deg_s = NAN;
+        result.rms_error_deg_s = NAN;
+        result.max_error_deg_s = NAN;
+        return result;
+    }
+
+    double rate_sum = 0.0;
+    double squared_error_sum = 0.0;
+    for (const float rate : _window_rates) {
+        const float error = rate - _commanded_rate_deg_s;
+        rate_sum += rate;
+        squared_error_sum += error * error;
+        result.max_error_deg_s = std::max(result.max_error_deg_s, std::fabs(error));
+    }
+    result.mean_rate_deg_s = static_cast<float>(rate_sum / _window_rates.size());
+    result.rms_error_deg_s =
+        static_cast<float>(std::sqrt(squared_error_sum / _window_rates.size()));
+    return result;
+}
+
+std::string RateTracking::to_string(const Result& result) const
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    if (result.windows == 0) {
+        ss << "rate - (commanded " << _commanded_rate_deg_s << " deg/s), too few samples";
+    } else {
+        ss << "rate " << result.mean_rate_deg_s << " deg/s (commanded " << _commanded_rate_deg_s
+           << "), rms error " << result.rms_error_deg_s << " deg/s, max "
+           << result.max_error_deg_s << " deg/s";
+    }
+    return ss.str();
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief The StepResponse class
+ * Follows one axis after an angle setpoint change. Samples are fed in as they arrive and
+ * the axis counts as settled once it stayed within the settling band for the hold time,
+ * so a test case can end as soon as the gimbal is there.
+ *
+ * Times are in seconds since the setpoint was changed.
+ */
+class StepResponse {
+public:
+    struct Result {
+        bool settled;
+        // 10 % to 90 % of the step, NAN if 90 % was never reached or the step is too small.
+        float rise_time_s;
+        // Largest excursion beyond the target in the direction of the step.
+        float overshoot_deg;
+        float overshoot_percent;
+        // Time of the first sample after which the axis stayed inside the band.
+        float settling_time_s;
+        // Mean error (target - actual) since settling, or of the last sample if unsettled.
+        float steady_state_error_deg;
+    };
+
+    // Yaw is compared with wrap-around at +/-180 degrees.
+    StepResponse(
+        float initial_deg, float target_deg, bool wraps, float band_deg, float hold_time_s);
+
+    void add(float time_s, float value_deg);
+
+    bool settled() const;
+    Result result() const;
+
+    // E.g. "rise 0.32 s, overshoot 1.2 deg (3 %), settled after 0.61 s, error -0.3 deg"
+    static std::string to_string(const Result& result);
+
+private:
+    float error(float value_deg) const;
+
+    const float _target_deg;
+    const bool _wraps;
+    const float _band_deg;
+    const float _hold_time_s;
+    float _step_deg;
+
+    unsigned _samples{0};
+    float _last_time_s{0.0f};
+    float _last_error_deg{0.0f};
+    float _rise_start_s;
+    float _rise_end_s;
+    float _overshoot_deg{0.0f};
+
+    // Start of the current run of samples within the band, NAN while outside.
+    float _in_band_since_s;
+    double _in_band_error_sum{0.0};
+    unsigned _in_band_samples{0};
+};
+
+/**
+ * @brief The RateTracking class
+ * Compares the angular rate of one axis with a commanded rate. The rate is estimated over
+ * windows of at least window_s so the quantization of single samples doesn't dominate.
+ */
+class RateTracking {
+public:
+    struct Result {
+        unsigned windows;
+        float mean_rate_deg_s;
+        // RMS of (measured - commanded) over all windows.
+        float rms_error_deg_s;
+        float max_error_deg_s;
+    };
+
+    // Samples before transient_s are ignored, the gimbal first has to accelerate.
+    RateTracking(
+        float commanded_rate_deg_s, bool wraps, float transient_s = 0.3f, float window_s = 0.1f);
+
+    void add(float time_s, float value_deg);
+
+    Result result() const;
+
+    // E.g. "rate 9.8 deg/s (commanded 10), rms error 0.4 deg/s, max 1.1 deg/s"
+    std::string to_string(const Result& result) const;
+
+private:
+    const float _commanded_rate_deg_s;
+    const bool _wraps;
+    const float _transient_s;
+    const float _window_s;
+
+    bool _has_window_start{false};
+    float _window_start_s{0.0f};
+    // Angle accumulated across wrap-arounds since the window started.
+    float _window_delta_deg{0.0f};
+    float _last_deg{0.0f};
+
+    std::vector<float> _window_rates{};
+};
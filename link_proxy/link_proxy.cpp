@@ -0,0 +1,200 @@
+//
+// Emulated radio link between a MAVLink client and the mock autopilot or SITL, see
+// UdpLinkProxy. The vehicles send to <vehicle_port>, the client listens on <client_port>:
+//
+//   mock_autopilot 14550 &
+//   link_proxy 14550 14540 --loss 0.05 --down-delay 150 --record link.txt &
+//   fly_qgc_mission udp://:14540
+//
+// Options without up- or down- apply to both directions. The record lists what happened
+// to every datagram, --replay applies it again to the next run.
+//
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "udp_link_proxy.h"
+
+namespace {
+
+std::atomic<bool> should_exit{false};
+
+void signal_handler(int)
+{
+    should_exit = true;
+}
+
+void usage(const std::string& bin_name)
+{
+    std::cout << "Usage : " << bin_name << " <vehicle_port> <client_port> [options]" << std::endl
+              << "Link options, for both directions or with an up- or down- prefix:" << std::endl
+              << "  --delay <ms>           minimum delay" << std::endl
+              << "  --jitter <ms>          random extra delay" << std::endl
+              << "  --latency <uniform|normal|pareto>" << std::endl
+              << "                         distribution of the extra delay" << std::endl
+              << "  --loss <0..1>          loss probability" << std::endl
+              << "  --burst-start <0..1>   probability to start a burst of losses" << std::endl
+              << "  --burst-end <0..1>     probability to end it" << std::endl
+              << "  --burst-loss <0..1>    loss probability during a burst" << std::endl
+              << "  --reorder <0..1>       probability to hold a datagram back" << std::endl
+              << "  --reorder-delay <ms>   by how much" << std::endl
+              << "  --bandwidth <B/s>      token bucket rate, 0 is no limit" << std::endl
+              << "  --bucket <B>           token bucket size" << std::endl
+              << "  --queue <B>            bytes waiting for tokens before drops" << std::endl
+              << "Other options:" << std::endl
+              << "  --client-host <host>   default 127.0.0.1" << std::endl
+              << "  --seed <n>" << std::endl
+              << "  --record <file>        what happened to every datagram" << std::endl
+              << "  --replay <file>        the same again, from a record" << std::endl
+              << "For example, a slow radio with bursts of losses:" << std::endl
+              << "  " << bin_name
+              << " 14550 14540 --delay 100 --jitter 30 --loss 0.01 --burst-start 0.02"
+              << " --bandwidth 5000" << std::endl;
+}
+
+bool parse_probability(const std::string& value, float& probability)
+{
+    char* end = nullptr;
+    probability = std::strtof(value.c_str(), &end);
+    return end != value.c_str() && *end == '\0' && probability >= 0.0f && probability <= 1.0f;
+}
+
+bool parse_unsigned(const std::string& value, uint32_t& number)
+{
+    char* end = nullptr;
+    const unsigned long parsed = std::strtoul(value.c_str(), &end, 10);
+    number = static_cast<uint32_t>(parsed);
+    return end != value.c_str() && *end == '\0' && value[0] != '-';
+}
+
+bool parse_ms(const std::string& value, std::chrono::microseconds& duration)
+{
+    char* end = nullptr;
+    const double ms = std::strtod(value.c_str(), &end);
+    duration = std::chrono::microseconds(static_cast<int64_t>(ms * 1000.0));
+    return end != value.c_str() && *end == '\0' && ms >= 0.0;
+}
+
+bool parse_link_option(
+    const std::string& name, const std::string& value, UdpLinkProxy::LinkConfig& link_config)
+{
+    if (name == "delay") {
+        return parse_ms(value, link_config.delay);
+    } else if (name == "jitter") {
+        return parse_ms(value, link_config.jitter);
+    } else if (name == "latency") {
+        if (value == "uniform") {
+            link_config.latency = UdpLinkProxy::Latency::Uniform;
+        } else if (value == "normal") {
+            link_config.latency = UdpLinkProxy::Latency::Normal;
+        } else if (value == "pareto") {
+            link_config.latency = UdpLinkProxy::Latency::Pareto;
+        } else {
+            return false;
+        }
+        return true;
+    } else if (name == "loss") {
+        return parse_probability(value, link_config.loss);
+    } else if (name == "burst-start") {
+        return parse_probability(value, link_config.burst_start);
+    } else if (name == "burst-end") {
+        return parse_probability(value, link_config.burst_end);
+    } else if (name == "burst-loss") {
+        return parse_probability(value, link_config.burst_loss);
+    } else if (name == "reorder") {
+        return parse_probability(value, link_config.reorder);
+    } else if (name == "reorder-delay") {
+        return parse_ms(value, link_config.reorder_delay);
+    } else if (name == "bandwidth") {
+        return parse_unsigned(value, link_config.bandwidth_bytes_s);
+    } else if (name == "bucket") {
+        return parse_unsigned(value, link_config.bucket_bytes);
+    } else if (name == "queue") {
+        return parse_unsigned(value, link_config.queue_limit_bytes);
+    }
+    return false;
+}
+
+bool parse_option(const std::string& option, const std::string& value, UdpLinkProxy::Config& config)
+{
+    if (option.compare(0, 2, "--") != 0) {
+        return false;
+    }
+    const std::string name = option.substr(2);
+
+    if (name == "client-host") {
+        config.client_host = value;
+        return true;
+    } else if (name == "seed") {
+        return parse_unsigned(value, config.seed);
+    } else if (name == "record") {
+        config.record_path = value;
+        return true;
+    } else if (name == "replay") {
+        config.replay_path = value;
+        return true;
+    } else if (name.compare(0, 3, "up-") == 0) {
+        return parse_link_option(name.substr(3), value, config.uplink);
+    } else if (name.compare(0, 5, "down-") == 0) {
+        return parse_link_option(name.substr(5), value, config.downlink);
+    }
+    return parse_link_option(name, value, config.uplink) &&
+           parse_link_option(name, value, config.downlink);
+}
+
+void print_stats(const std::string& direction, const UdpLinkProxy::DirectionStats& stats)
+{
+    std::cout << direction << ": " << stats.forwarded << " forwarded, " << stats.dropped
+              << " dropped (" << stats.burst_dropped << " in bursts, " << stats.queue_dropped
+              << " queue full), " << stats.reordered << " reordered" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    UdpLinkProxy::Config config;
+
+    uint32_t vehicle_port = 0;
+    uint32_t client_port = 0;
+    bool arguments_valid = argc >= 3 && argc % 2 == 1 && parse_unsigned(argv[1], vehicle_port) &&
+                           parse_unsigned(argv[2], client_port) && vehicle_port <= 65535 &&
+                           client_port <= 65535;
+    for (int i = 3; arguments_valid && i + 1 < argc; i += 2) {
+        arguments_valid = parse_option(argv[i], argv[i + 1], config);
+    }
+    if (!arguments_valid) {
+        usage(argv[0]);
+        return 1;
+    }
+    config.vehicle_port = static_cast<uint16_t>(vehicle_port);
+    config.client_port = static_cast<uint16_t>(client_port);
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    UdpLinkProxy proxy(config);
+    if (!proxy.start()) {
+        return 1;
+    }
+
+    std::cout << "Vehicles to port " << config.vehicle_port << ", client at "
+              << config.client_host << ":" << config.client_port << std::endl
+              << "Up: " << UdpLinkProxy::to_string(config.uplink) << std::endl
+              << "Down: " << UdpLinkProxy::to_string(config.downlink) << std::endl;
+
+    while (!should_exit) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    proxy.stop();
+    const UdpLinkProxy::Stats stats = proxy.stats();
+    print_stats("Up", stats.uplink);
+    print_stats("Down", stats.downlink);
+    return 0;
+}
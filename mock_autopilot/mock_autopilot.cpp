@@ -0,0 +1,133 @@
+//
+// Mock autopilot which speaks enough MAVLink to run the examples without PX4 SITL.
+//
+// Every vehicle sends from its own ephemeral port to <remote_port> + index, the same
+// way PX4 SITL instances do, so `udp://:14540`, `udp://:14541` etc. can be used to
+// connect to them. With a port step of 0 all vehicles send to the same port, which is
+// what large fleets need.
+//
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mock_vehicle.h"
+#include "udp_socket.h"
+
+namespace {
+
+std::atomic<bool> should_exit{false};
+
+// Simulation step and the maximum time we block waiting for incoming data.
+constexpr std::chrono::milliseconds update_interval{10};
+
+void signal_handler(int)
+{
+    should_exit = true;
+}
+
+void usage(const std::string& bin_name)
+{
+    std::cout << "Usage : " << bin_name << " <remote_port> [number_of_vehicles] [first_system_id]"
+              << " [remote_host] [port_step]" << std::endl
+              << "For example, to run three vehicles for multiple_drones:" << std::endl
+              << "  " << bin_name << " 14540 3" << std::endl;
+}
+
+void run_vehicle(uint8_t system_id, uint8_t channel, const std::string& remote_host, int remote_port)
+{
+    UdpSocket socket;
+    if (!socket.bind("0.0.0.0", 0) || !socket.set_remote(remote_host, remote_port)) {
+        should_exit = true;
+        return;
+    }
+
+    MockVehicle vehicle(system_id, channel, [&socket](const mavlink_message_t& message) {
+        uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+        const uint16_t len = mavlink_msg_to_send_buffer(buffer, &message);
+        socket.send(buffer, len);
+    });
+
+    std::cout << "Vehicle " << int(system_id) << " sending from port " << socket.local_port()
+              << " to " << remote_host << ":" << remote_port << std::endl;
+
+    uint8_t buffer[2048];
+    auto next_update = std::chrono::steady_clock::now();
+
+    while (!should_exit) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= next_update) {
+            vehicle.update(now);
+            next_update += update_interval;
+            if (next_update < now) {
+                next_update = now + update_interval;
+            }
+        }
+
+        const auto wait_ms =
+            std::chrono::duration_cast<std::chrono::milliseconds>(next_update - now).count();
+        const int received = socket.receive(buffer, sizeof(buffer), static_cast<int>(wait_ms));
+        if (received < 0) {
+            std::cerr << "Receive failed for vehicle " << int(system_id) << std::endl;
+            break;
+        }
+
+        mavlink_message_t message;
+        mavlink_status_t status;
+        for (int i = 0; i < received; ++i) {
+            if (mavlink_parse_char(channel, buffer[i], &message, &status) == MAVLINK_FRAMING_OK) {
+                vehicle.handle_message(message);
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 6) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const int remote_port = std::atoi(argv[1]);
+    const int number_of_vehicles = (argc > 2) ? std::atoi(argv[2]) : 1;
+    const int first_system_id = (argc > 3) ? std::atoi(argv[3]) : 1;
+    const std::string remote_host = (argc > 4) ? argv[4] : "127.0.0.1";
+    const int port_step = (argc > 5) ? std::atoi(argv[5]) : 1;
+
+    if (remote_port <= 0 || remote_port > 65535 || number_of_vehicles < 1 ||
+        number_of_vehicles > MAVLINK_COMM_NUM_BUFFERS || first_system_id < 1 ||
+        first_system_id + number_of_vehicles - 1 > 255 || port_step < 0 ||
+        remote_port + port_step * (number_of_vehicles - 1) > 65535) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < number_of_vehicles; ++i) {
+        threads.emplace_back(
+            run_vehicle,
+            static_cast<uint8_t>(first_system_id + i),
+            static_cast<uint8_t>(i),
+            remote_host,
+            remote_port + port_step * i);
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::cout << "Exiting." << std::endl;
+    return 0;
+}
@@ -0,0 +1,1768 @@
+#include "mock_vehicle.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+constexpr double earth_radius_m = 6371000.0;
+constexpr double degrees_to_e7 = 1e7;
+constexpr float gravity_m_s2 = 9.81f;
+constexpr float max_acceleration_m_s2 = 4.0f;
+constexpr float max_climb_rate_m_s = 3.0f;
+constexpr float max_descent_rate_m_s = 1.5f;
+constexpr float land_speed_m_s = 0.7f;
+constexpr float takeoff_speed_m_s = 1.5f;
+constexpr float acceptance_radius_m = 1.0f;
+constexpr float acceptance_altitude_m = 0.8f;
+constexpr float in_air_altitude_m = 0.5f;
+
+constexpr unsigned mission_item_retries = 5;
+constexpr std::chrono::milliseconds mission_item_timeout{250};
+constexpr std::chrono::milliseconds offboard_setpoint_timeout{500};
+constexpr std::chrono::milliseconds offboard_loss_timeout{1000};
+constexpr std::chrono::seconds auto_disarm_landed{2};
+constexpr std::chrono::seconds auto_disarm_preflight{10};
+
+// Set position target type mask bits.
+constexpr uint16_t ignore_position = 0x7;
+constexpr uint16_t ignore_velocity = 0x38;
+constexpr uint16_t ignore_yaw_rate = 0x800;
+
+float wrap_pi(float angle)
+{
+    while (angle > static_cast<float>(M_PI)) {
+        angle -= 2.0f * static_cast<float>(M_PI);
+    }
+    while (angle < -static_cast<float>(M_PI)) {
+        angle += 2.0f * static_cast<float>(M_PI);
+    }
+    return angle;
+}
+
+float constrain(float value, float min_value, float max_value)
+{
+    return std::max(min_value, std::min(value, max_value));
+}
+
+bool is_global_frame(uint8_t frame)
+{
+    return frame == MAV_FRAME_GLOBAL || frame == MAV_FRAME_GLOBAL_INT ||
+           frame == MAV_FRAME_GLOBAL_RELATIVE_ALT || frame == MAV_FRAME_GLOBAL_RELATIVE_ALT_INT ||
+           frame == MAV_FRAME_GLOBAL_TERRAIN_ALT || frame == MAV_FRAME_GLOBAL_TERRAIN_ALT_INT;
+}
+
+bool is_body_frame(uint8_t frame)
+{
+    return frame == MAV_FRAME_BODY_NED || frame == MAV_FRAME_BODY_OFFSET_NED ||
+           frame == MAV_FRAME_BODY_FRD;
+}
+
+float int_as_float(int32_t value)
+{
+    // PX4 sends integer parameters bytewise in the float field.
+    float result;
+    std::memcpy(&result, &value, sizeof(result));
+    return result;
+}
+
+int32_t float_as_int(float value)
+{
+    int32_t result;
+    std::memcpy(&result, &value, sizeof(result));
+    return result;
+}
+
+} // namespace
+
+MockVehicle::MockVehicle(uint8_t system_id, uint8_t channel, send_callback_t send_callback) :
+    system_id_(system_id),
+    channel_(channel),
+    send_callback_(send_callback),
+    boot_time_(std::chrono::steady_clock::now()),
+    now_(boot_time_)
+{
+    params_ = {
+        {"CAL_ACC0_ID", 1.0f, MAV_PARAM_TYPE_INT32},
+        {"CAL_GYRO0_ID", 1.0f, MAV_PARAM_TYPE_INT32},
+        {"CAL_MAG0_ID", 1.0f, MAV_PARAM_TYPE_INT32},
+        {"SYS_HITL", 0.0f, MAV_PARAM_TYPE_INT32},
+        {"MIS_TAKEOFF_ALT", 2.5f, MAV_PARAM_TYPE_REAL32},
+        {"MPC_XY_CRUISE", 5.0f, MAV_PARAM_TYPE_REAL32},
+        {"RTL_RETURN_ALT", 15.0f, MAV_PARAM_TYPE_REAL32},
+    };
+
+    // Default intervals, they can be changed using MAV_CMD_SET_MESSAGE_INTERVAL.
+    const auto add_stream = [this](uint32_t message_id, int64_t interval_us) {
+        streams_[message_id] = Stream{interval_us, interval_us, now_};
+    };
+    add_stream(MAVLINK_MSG_ID_HEARTBEAT, 1000000);
+    add_stream(MAVLINK_MSG_ID_SYS_STATUS, 1000000);
+    add_stream(MAVLINK_MSG_ID_EXTENDED_SYS_STATE, 200000);
+    add_stream(MAVLINK_MSG_ID_GPS_RAW_INT, 1000000);
+    add_stream(MAVLINK_MSG_ID_GLOBAL_POSITION_INT, 100000);
+    add_stream(MAVLINK_MSG_ID_LOCAL_POSITION_NED, 100000);
+    add_stream(MAVLINK_MSG_ID_ATTITUDE, 50000);
+    add_stream(MAVLINK_MSG_ID_ATTITUDE_QUATERNION, 50000);
+    add_stream(MAVLINK_MSG_ID_HOME_POSITION, 2000000);
+    add_stream(MAVLINK_MSG_ID_BATTERY_STATUS, 1000000);
+    add_stream(MAVLINK_MSG_ID_HIGHRES_IMU, 100000);
+    add_stream(MAVLINK_MSG_ID_MISSION_CURRENT, 1000000);
+}
+
+void MockVehicle::set_home(double latitude_deg, double longitude_deg, float altitude_amsl_m)
+{
+    home_latitude_deg_ = latitude_deg;
+    home_longitude_deg_ = longitude_deg;
+    home_altitude_amsl_m_ = altitude_amsl_m;
+}
+
+void MockVehicle::handle_message(const mavlink_message_t& message)
+{
+    switch (message.msgid) {
+        case MAVLINK_MSG_ID_COMMAND_LONG:
+            handle_command_long(message);
+            break;
+        case MAVLINK_MSG_ID_COMMAND_INT:
+            handle_command_int(message);
+            break;
+        case MAVLINK_MSG_ID_MISSION_COUNT:
+            handle_mission_count(message);
+            break;
+        case MAVLINK_MSG_ID_MISSION_ITEM_INT:
+            handle_mission_item_int(message);
+            break;
+        case MAVLINK_MSG_ID_MISSION_ITEM:
+            handle_mission_item(message);
+            break;
+        case MAVLINK_MSG_ID_MISSION_REQUEST_INT:
+            handle_mission_request(message, true);
+            break;
+        case MAVLINK_MSG_ID_MISSION_REQUEST:
+            handle_mission_request(message, false);
+            break;
+        case MAVLINK_MSG_ID_MISSION_REQUEST_LIST:
+            handle_mission_request_list(message);
+            break;
+        case MAVLINK_MSG_ID_MISSION_CLEAR_ALL:
+            handle_mission_clear_all(message);
+            break;
+        case MAVLINK_MSG_ID_MISSION_SET_CURRENT:
+            handle_mission_set_current(message);
+            break;
+        case MAVLINK_MSG_ID_MISSION_ACK:
+            handle_mission_ack(message);
+            break;
+        case MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED:
+            handle_set_position_target_local_ned(message);
+            break;
+        case MAVLINK_MSG_ID_SET_ATTITUDE_TARGET:
+            handle_set_attitude_target(message);
+            break;
+        case MAVLINK_MSG_ID_PARAM_REQUEST_READ:
+            handle_param_request_read(message);
+            break;
+        case MAVLINK_MSG_ID_PARAM_REQUEST_LIST:
+            handle_param_request_list(message);
+            break;
+        case MAVLINK_MSG_ID_PARAM_SET:
+            handle_param_set(message);
+            break;
+        case MAVLINK_MSG_ID_TIMESYNC:
+            handle_timesync(message);
+            break;
+        default:
+            break;
+    }
+}
+
+void MockVehicle::update(time_point now)
+{
+    now_ = now;
+    if (last_step_time_ == time_point{}) {
+        last_step_time_ = now;
+    }
+
+    const float dt_s = std::chrono::duration<float>(now - last_step_time_).count();
+    last_step_time_ = now;
+    if (dt_s > 0.0f) {
+        // Don't let a stalled process teleport the vehicle.
+        step(std::min(dt_s, 0.1f));
+    }
+
+    if (upload_.active && now_ >= upload_.deadline) {
+        if (upload_.retries_left == 0) {
+            log("Mission upload timed out");
+            send_mission_ack(
+                upload_.partner_sysid,
+                upload_.partner_compid,
+                MAV_MISSION_OPERATION_CANCELLED,
+                upload_.mission_type);
+            upload_.active = false;
+        } else {
+            --upload_.retries_left;
+            request_next_mission_item();
+        }
+    }
+
+    for (auto& it : streams_) {
+        Stream& stream = it.second;
+        if (stream.interval_us <= 0 || now_ < stream.next_time) {
+            continue;
+        }
+        send_message_by_id(it.first);
+        stream.next_time += std::chrono::microseconds(stream.interval_us);
+        if (stream.next_time < now_) {
+            // We fell behind, don't try to catch up with a burst.
+            stream.next_time = now_ + std::chrono::microseconds(stream.interval_us);
+        }
+    }
+}
+
+void MockVehicle::handle_command_long(const mavlink_message_t& message)
+{
+    mavlink_command_long_t command_long;
+    mavlink_msg_command_long_decode(&message, &command_long);
+
+    if (!targets_us(command_long.target_system, command_long.target_component)) {
+        return;
+    }
+
+    Command command{};
+    command.command = command_long.command;
+    command.params[0] = command_long.param1;
+    command.params[1] = command_long.param2;
+    command.params[2] = command_long.param3;
+    command.params[3] = command_long.param4;
+    command.params[4] = command_long.param5;
+    command.params[5] = command_long.param6;
+    command.params[6] = command_long.param7;
+    command.sender_sysid = message.sysid;
+    command.sender_compid = message.compid;
+    handle_command(command);
+}
+
+void MockVehicle::handle_command_int(const mavlink_message_t& message)
+{
+    mavlink_command_int_t command_int;
+    mavlink_msg_command_int_decode(&message, &command_int);
+
+    if (!targets_us(command_int.target_system, command_int.target_component)) {
+        return;
+    }
+
+    Command command{};
+    command.command = command_int.command;
+    command.params[0] = command_int.param1;
+    command.params[1] = command_int.param2;
+    command.params[2] = command_int.param3;
+    command.params[3] = command_int.param4;
+    command.params[4] = static_cast<float>(command_int.x / degrees_to_e7);
+    command.params[5] = static_cast<float>(command_int.y / degrees_to_e7);
+    command.params[6] = command_int.z;
+    command.sender_sysid = message.sysid;
+    command.sender_compid = message.compid;
+    handle_command(command);
+}
+
+void MockVehicle::handle_command(const Command& command)
+{
+    uint8_t result = MAV_RESULT_UNSUPPORTED;
+
+    switch (command.command) {
+        case MAV_CMD_COMPONENT_ARM_DISARM:
+            result = handle_arm_disarm(command);
+            break;
+
+        case MAV_CMD_NAV_TAKEOFF:
+            if (!armed_) {
+                result = MAV_RESULT_DENIED;
+                break;
+            }
+            // PX4 uses MIS_TAKEOFF_ALT unless an AMSL altitude is given.
+            takeoff_altitude_m_ = std::isfinite(command.params[6]) ?
+                                      command.params[6] - home_altitude_amsl_m_ :
+                                      param("MIS_TAKEOFF_ALT");
+            switch_to(MainMode::Auto, AutoMode::Takeoff);
+            result = MAV_RESULT_ACCEPTED;
+            break;
+
+        case MAV_CMD_NAV_LAND:
+            result = handle_set_mode(
+                static_cast<uint8_t>(MainMode::Auto), static_cast<uint8_t>(AutoMode::Land));
+            break;
+
+        case MAV_CMD_NAV_RETURN_TO_LAUNCH:
+            result = handle_set_mode(
+                static_cast<uint8_t>(MainMode::Auto), static_cast<uint8_t>(AutoMode::Rtl));
+            break;
+
+        case MAV_CMD_DO_SET_MODE:
+            result = handle_set_mode(
+                static_cast<uint8_t>(command.params[1]), static_cast<uint8_t>(command.params[2]));
+            break;
+
+        case MAV_CMD_MISSION_START:
+            if (std::isfinite(command.params[0]) && command.params[0] >= 0.0f &&
+                command.params[0] < mission_items_.size()) {
+                mission_current_ = static_cast<uint16_t>(command.params[0]);
+            }
+            result = handle_set_mode(
+                static_cast<uint8_t>(MainMode::Auto), static_cast<uint8_t>(AutoMode::Mission));
+            break;
+
+        case MAV_CMD_DO_SET_MISSION_CURRENT:
+            if (command.params[0] >= 0.0f && command.params[0] < mission_items_.size()) {
+                mission_current_ = static_cast<uint16_t>(command.params[0]);
+                mission_item_started_ = false;
+                send_mission_current();
+                result = MAV_RESULT_ACCEPTED;
+            } else {
+                result = MAV_RESULT_DENIED;
+            }
+            break;
+
+        case MAV_CMD_DO_CHANGE_SPEED:
+            if (command.params[1] > 0.0f) {
+                mission_speed_m_s_ = command.params[1];
+            }
+            result = MAV_RESULT_ACCEPTED;
+            break;
+
+        case MAV_CMD_SET_MESSAGE_INTERVAL:
+            result = handle_set_message_interval(
+                static_cast<uint32_t>(command.params[0]), command.params[1]);
+            break;
+
+        case MAV_CMD_REQUEST_MESSAGE:
+            result = handle_request_message(static_cast<uint32_t>(command.params[0]));
+            break;
+
+        case MAV_CMD_REQUEST_AUTOPILOT_CAPABILITIES:
+            send_autopilot_version();
+            result = MAV_RESULT_ACCEPTED;
+            break;
+
+        case MAV_CMD_GET_HOME_POSITION:
+            send_home_position();
+            result = MAV_RESULT_ACCEPTED;
+            break;
+
+        default:
+            break;
+    }
+
+    send_command_ack(command, result);
+}
+
+uint8_t MockVehicle::handle_arm_disarm(const Command& command)
+{
+    // Magic number used by PX4 to force arming/disarming.
+    const bool force = (static_cast<int>(command.params[1]) == 21196);
+
+    if (command.params[0] > 0.5f) {
+        if (!armed_) {
+            arm();
+        }
+        return MAV_RESULT_ACCEPTED;
+    }
+
+    if (!is_on_ground() && !force) {
+        return MAV_RESULT_DENIED;
+    }
+
+    if (armed_) {
+        disarm();
+    }
+    return MAV_RESULT_ACCEPTED;
+}
+
+uint8_t MockVehicle::handle_set_mode(uint8_t main_mode, uint8_t sub_mode)
+{
+    switch (static_cast<MainMode>(main_mode)) {
+        case MainMode::Manual:
+        case MainMode::Altctl:
+        case MainMode::Posctl:
+            switch_to(static_cast<MainMode>(main_mode), AutoMode::None);
+            return MAV_RESULT_ACCEPTED;
+
+        case MainMode::Offboard:
+            // PX4 only switches to offboard if setpoints are already streamed.
+            if (offboard_setpoint_.time == time_point{} ||
+                now_ - offboard_setpoint_.time > offboard_setpoint_timeout) {
+                return MAV_RESULT_TEMPORARILY_REJECTED;
+            }
+            switch_to(MainMode::Offboard, AutoMode::None);
+            return MAV_RESULT_ACCEPTED;
+
+        case MainMode::Auto:
+            switch (static_cast<AutoMode>(sub_mode)) {
+                case AutoMode::Takeoff:
+                    if (!armed_) {
+                        return MAV_RESULT_TEMPORARILY_REJECTED;
+                    }
+                    takeoff_altitude_m_ = param("MIS_TAKEOFF_ALT");
+                    switch_to(MainMode::Auto, AutoMode::Takeoff);
+                    return MAV_RESULT_ACCEPTED;
+                case AutoMode::Mission:
+                    if (mission_items_.empty()) {
+                        return MAV_RESULT_DENIED;
+                    }
+                    switch_to(MainMode::Auto, AutoMode::Mission);
+                    return MAV_RESULT_ACCEPTED;
+                case AutoMode::Land:
+                case AutoMode::Rtl:
+                    if (!armed_) {
+                        return MAV_RESULT_DENIED;
+                    }
+                    switch_to(MainMode::Auto, static_cast<AutoMode>(sub_mode));
+                    return MAV_RESULT_ACCEPTED;
+                case AutoMode::Ready:
+                case AutoMode::Loiter:
+                    switch_to(MainMode::Auto, AutoMode::Loiter);
+                    return MAV_RESULT_ACCEPTED;
+                default:
+                    return MAV_RESULT_UNSUPPORTED;
+            }
+
+        default:
+            return MAV_RESULT_UNSUPPORTED;
+    }
+}
+
+uint8_t MockVehicle::handle_set_message_interval(uint32_t message_id, float interval_us)
+{
+    auto it = streams_.find(message_id);
+    if (it == streams_.end()) {
+        return MAV_RESULT_UNSUPPORTED;
+    }
+
+    Stream& stream = it->second;
+    if (interval_us < 0.0f) {
+        stream.interval_us = 0;
+    } else if (interval_us == 0.0f) {
+        stream.interval_us = stream.default_interval_us;
+    } else {
+        stream.interval_us = static_cast<int64_t>(interval_us);
+    }
+    stream.next_time = now_;
+    return MAV_RESULT_ACCEPTED;
+}
+
+uint8_t MockVehicle::handle_request_message(uint32_t message_id)
+{
+    if (message_id == MAVLINK_MSG_ID_AUTOPILOT_VERSION) {
+        send_autopilot_version();
+        return MAV_RESULT_ACCEPTED;
+    }
+    return send_message_by_id(message_id) ? MAV_RESULT_ACCEPTED : MAV_RESULT_UNSUPPORTED;
+}
+
+void MockVehicle::handle_mission_count(const mavlink_message_t& message)
+{
+    mavlink_mission_count_t mission_count;
+    mavlink_msg_mission_count_decode(&message, &mission_count);
+
+    if (!targets_us(mission_count.target_system, mission_count.target_component)) {
+        return;
+    }
+
+    // A new count always restarts the transfer, just like PX4 does.
+    upload_ = MissionTransfer{};
+    upload_.mission_type = mission_count.mission_type;
+    upload_.partner_sysid = message.sysid;
+    upload_.partner_compid = message.compid;
+    upload_.count = mission_count.count;
+    upload_.retries_left = mission_item_retries;
+    upload_.items.reserve(mission_count.count);
+
+    if (mission_count.count == 0) {
+        if (upload_.mission_type == MAV_MISSION_TYPE_MISSION) {
+            mission_items_.clear();
+            mission_current_ = 0;
+        }
+        send_mission_ack(
+            message.sysid, message.compid, MAV_MISSION_ACCEPTED, mission_count.mission_type);
+        return;
+    }
+
+    std::stringstream ss;
+    ss << "Receiving " << mission_count.count << " mission items";
+    log(ss.str());
+
+    upload_.active = true;
+    request_next_mission_item();
+}
+
+void MockVehicle::handle_mission_item_int(const mavlink_message_t& message)
+{
+    mavlink_mission_item_int_t item;
+    mavlink_msg_mission_item_int_decode(&message, &item);
+
+    // Like PX4, the last item again means our ACK got lost, so the upload isn't repeated.
+    if (!upload_.active && upload_.count > 0 && upload_.next_seq == upload_.count &&
+        item.seq == upload_.count - 1 &&
+        message.sysid == upload_.partner_sysid &&
+        targets_us(item.target_system, item.target_component) &&
+        item.mission_type == upload_.mission_type) {
+        send_mission_ack(
+            upload_.partner_sysid,
+            upload_.partner_compid,
+            MAV_MISSION_ACCEPTED,
+            upload_.mission_type);
+        return;
+    }
+
+    if (!upload_.active || !targets_us(item.target_system, item.target_component) ||
+        item.mission_type != upload_.mission_type) {
+        return;
+    }
+
+    if (item.seq == upload_.next_seq) {
+        store_mission_item(item);
+    } else if (item.seq > upload_.next_seq) {
+        // We missed one, ask for it again right away.
+        request_next_mission_item();
+    }
+    // Duplicates of items we already have are ignored, the retry timer takes care of it.
+}
+
+void MockVehicle::handle_mission_item(const mavlink_message_t& message)
+{
+    mavlink_mission_item_t item;
+    mavlink_msg_mission_item_decode(&message, &item);
+
+    mavlink_mission_item_int_t item_int{};
+    item_int.param1 = item.param1;
+    item_int.param2 = item.param2;
+    item_int.param3 = item.param3;
+    item_int.param4 = item.param4;
+    if (is_global_frame(item.frame)) {
+        item_int.x = static_cast<int32_t>(std::round(item.x * degrees_to_e7));
+        item_int.y = static_cast<int32_t>(std::round(item.y * degrees_to_e7));
+    } else {
+        item_int.x = static_cast<int32_t>(item.x);
+        item_int.y = static_cast<int32_t>(item.y);
+    }
+    item_int.z = item.z;
+    item_int.seq = item.seq;
+    item_int.command = item.command;
+    item_int.target_system = item.target_system;
+    item_int.target_component = item.target_component;
+    item_int.frame = item.frame;
+    item_int.current = item.current;
+    item_int.autocontinue = item.autocontinue;
+    item_int.mission_type = item.mission_type;
+
+    if (!upload_.active || !targets_us(item.target_system, item.target_component) ||
+        item.mission_type != upload_.mission_type) {
+        return;
+    }
+
+    if (item_int.seq == upload_.next_seq) {
+        store_mission_item(item_int);
+    } else if (item_int.seq > upload_.next_seq) {
+        request_next_mission_item();
+    }
+}
+
+void MockVehicle::store_mission_item(const mavlink_mission_item_int_t& item)
+{
+    upload_.items.push_back(item);
+    ++upload_.next_seq;
+    upload_.retries_left = mission_item_retries;
+
+    if (upload_.next_seq < upload_.count) {
+        request_next_mission_item();
+        return;
+    }
+
+    upload_.active = false;
+    if (upload_.mission_type == MAV_MISSION_TYPE_MISSION) {
+        mission_items_ = std::move(upload_.items);
+        mission_current_ = 0;
+        mission_item_started_ = false;
+        jump_counts_.clear();
+        log("Mission received");
+    }
+    send_mission_ack(
+        upload_.partner_sysid, upload_.partner_compid, MAV_MISSION_ACCEPTED, upload_.mission_type);
+}
+
+void MockVehicle::request_next_mission_item()
+{
+    mavlink_mission_request_int_t request{};
+    request.seq = upload_.next_seq;
+    request.target_system = upload_.partner_sysid;
+    request.target_component = upload_.partner_compid;
+    request.mission_type = upload_.mission_type;
+
+    mavlink_message_t message;
+    mavlink_msg_mission_request_int_encode_chan(
+        system_id_, component_id_, channel_, &message, &request);
+    send(message);
+
+    upload_.deadline = now_ + mission_item_timeout;
+}
+
+void MockVehicle::handle_mission_request(const mavlink_message_t& message, bool is_int)
+{
+    // MISSION_REQUEST and MISSION_REQUEST_INT share the same fields.
+    mavlink_mission_request_int_t request;
+    if (is_int) {
+        mavlink_msg_mission_request_int_decode(&message, &request);
+    } else {
+        mavlink_mission_request_t request_float;
+        mavlink_msg_mission_request_decode(&message, &request_float);
+        request.seq = request_float.seq;
+        request.target_system = request_float.target_system;
+        request.target_component = request_float.target_component;
+        request.mission_type = request_float.mission_type;
+    }
+
+    if (!targets_us(request.target_system, request.target_component) ||
+        request.mission_type != MAV_MISSION_TYPE_MISSION) {
+        return;
+    }
+
+    if (request.seq >= mission_items_.size()) {
+        send_mission_ack(
+            message.sysid, message.compid, MAV_MISSION_INVALID_SEQUENCE, request.mission_type);
+        return;
+    }
+
+    mavlink_mission_item_int_t item = mission_items_[request.seq];
+    item.seq = request.seq;
+    item.target_system = message.sysid;
+    item.target_component = message.compid;
+    item.current = (request.seq == mission_current_) ? 1 : 0;
+    item.mission_type = MAV_MISSION_TYPE_MISSION;
+
+    mavlink_message_t response;
+    if (is_int) {
+        mavlink_msg_mission_item_int_encode_chan(
+            system_id_, component_id_, channel_, &response, &item);
+    } else {
+        mavlink_mission_item_t item_float{};
+        item_float.param1 = item.param1;
+        item_float.param2 = item.param2;
+        item_float.param3 = item.param3;
+        item_float.param4 = item.param4;
+        item_float.x = is_global_frame(item.frame) ? static_cast<float>(item.x / degrees_to_e7) :
+                                                     static_cast<float>(item.x);
+        item_float.y = is_global_frame(item.frame) ? static_cast<float>(item.y / degrees_to_e7) :
+                                                     static_cast<float>(item.y);
+        item_float.z = item.z;
+        item_float.seq = item.seq;
+        item_float.command = item.command;
+        item_float.target_system = item.target_system;
+        item_float.target_component = item.target_component;
+        item_float.frame = item.frame;
+        item_float.current = item.current;
+        item_float.autocontinue = item.autocontinue;
+        item_float.mission_type = item.mission_type;
+        mavlink_msg_mission_item_encode_chan(
+            system_id_, component_id_, channel_, &response, &item_float);
+    }
+    send(response);
+}
+
+void MockVehicle::handle_mission_request_list(const mavlink_message_t& message)
+{
+    mavlink_mission_request_list_t request_list;
+    mavlink_msg_mission_request_list_decode(&message, &request_list);
+
+    if (!targets_us(request_list.target_system, request_list.target_component)) {
+        return;
+    }
+
+    mavlink_mission_count_t mission_count{};
+    mission_count.count = (request_list.mission_type == MAV_MISSION_TYPE_MISSION) ?
+                              static_cast<uint16_t>(mission_items_.size()) :
+                              0;
+    mission_count.target_system = message.sysid;
+    mission_count.target_component = message.compid;
+    mission_count.mission_type = request_list.mission_type;
+
+    mavlink_message_t response;
+    mavlink_msg_mission_count_encode_chan(
+        system_id_, component_id_, channel_, &response, &mission_count);
+    send(response);
+}
+
+void MockVehicle::handle_mission_clear_all(const mavlink_message_t& message)
+{
+    mavlink_mission_clear_all_t clear_all;
+    mavlink_msg_mission_clear_all_decode(&message, &clear_all);
+
+    if (!targets_us(clear_all.target_system, clear_all.target_component)) {
+        return;
+    }
+
+    if (clear_all.mission_type == MAV_MISSION_TYPE_MISSION ||
+        clear_all.mission_type == MAV_MISSION_TYPE_ALL) {
+        mission_items_.clear();
+        mission_current_ = 0;
+        mission_item_started_ = false;
+        log("Mission cleared");
+    }
+    send_mission_ack(message.sysid, message.compid, MAV_MISSION_ACCEPTED, clear_all.mission_type);
+}
+
+void MockVehicle::handle_mission_set_current(const mavlink_message_t& message)
+{
+    mavlink_mission_set_current_t set_current;
+    mavlink_msg_mission_set_current_decode(&message, &set_current);
+
+    if (!targets_us(set_current.target_system, set_current.target_component) ||
+        set_current.seq >= mission_items_.size()) {
+        return;
+    }
+
+    mission_current_ = set_current.seq;
+    mission_item_started_ = false;
+    send_mission_current();
+}
+
+void MockVehicle::handle_mission_ack(const mavlink_message_t& message)
+{
+    mavlink_mission_ack_t ack;
+    mavlink_msg_mission_ack_decode(&message, &ack);
+
+    // An ack from the other side during an upload means it gave up.
+    if (upload_.active && message.sysid == upload_.partner_sysid &&
+        targets_us(ack.target_system, ack.target_component)) {
+        log("Mission upload cancelled");
+        upload_.active = false;
+    }
+}
+
+void MockVehicle::handle_set_position_target_local_ned(const mavlink_message_t& message)
+{
+    mavlink_set_position_target_local_ned_t target;
+    mavlink_msg_set_position_target_local_ned_decode(&message, &target);
+
+    if (!targets_us(target.target_system, target.target_component)) {
+        return;
+    }
+
+    offboard_setpoint_.is_attitude = false;
+    offboard_setpoint_.frame = target.coordinate_frame;
+    offboard_setpoint_.type_mask = target.type_mask;
+    offboard_setpoint_.position[0] = target.x;
+    offboard_setpoint_.position[1] = target.y;
+    offboard_setpoint_.position[2] = target.z;
+    offboard_setpoint_.velocity[0] = target.vx;
+    offboard_setpoint_.velocity[1] = target.vy;
+    offboard_setpoint_.velocity[2] = target.vz;
+    offboard_setpoint_.yaw_rate = target.yaw_rate;
+    offboard_setpoint_.time = now_;
+}
+
+void MockVehicle::handle_set_attitude_target(const mavlink_message_t& message)
+{
+    mavlink_set_attitude_target_t target;
+    mavlink_msg_set_attitude_target_decode(&message, &target);
+
+    if (!targets_us(target.target_system, target.target_component)) {
+        return;
+    }
+
+    offboard_setpoint_.is_attitude = true;
+    mavlink_quaternion_to_euler(
+        target.q, &offboard_setpoint_.roll, &offboard_setpoint_.pitch, &offboard_setpoint_.yaw);
+    offboard_setpoint_.thrust = target.thrust;
+    offboard_setpoint_.time = now_;
+}
+
+void MockVehicle::handle_param_request_read(const mavlink_message_t& message)
+{
+    mavlink_param_request_read_t request;
+    mavlink_msg_param_request_read_decode(&message, &request);
+
+    if (!targets_us(request.target_system, request.target_component)) {
+        return;
+    }
+
+    if (request.param_index >= 0) {
+        if (static_cast<size_t>(request.param_index) < params_.size()) {
+            send_param_value(static_cast<size_t>(request.param_index));
+        }
+        return;
+    }
+
+    const std::string name(request.param_id, strnlen(request.param_id, sizeof(request.param_id)));
+    for (size_t i = 0; i < params_.size(); ++i) {
+        if (params_[i].name == name) {
+            send_param_value(i);
+            return;
+        }
+    }
+}
+
+void MockVehicle::handle_param_request_list(const mavlink_message_t& message)
+{
+    mavlink_param_request_list_t request;
+    mavlink_msg_param_request_list_decode(&message, &request);
+
+    if (!targets_us(request.target_system, request.target_component)) {
+        return;
+    }
+
+    for (size_t i = 0; i < params_.size(); ++i) {
+        send_param_value(i);
+    }
+}
+
+void MockVehicle::handle_param_set(const mavlink_message_t& message)
+{
+    mavlink_param_set_t param_set;
+    mavlink_msg_param_set_decode(&message, &param_set);
+
+    if (!targets_us(param_set.target_system, param_set.target_component)) {
+        return;
+    }
+
+    const std::string name(
+        param_set.param_id, strnlen(param_set.param_id, sizeof(param_set.param_id)));
+    for (size_t i = 0; i < params_.size(); ++i) {
+        if (params_[i].name == name) {
+            params_[i].value = (params_[i].type == MAV_PARAM_TYPE_INT32) ?
+                                   static_cast<float>(float_as_int(param_set.param_value)) :
+                                   param_set.param_value;
+            send_param_value(i);
+            return;
+        }
+    }
+}
+
+void MockVehicle::handle_timesync(const mavlink_message_t& message)
+{
+    mavlink_timesync_t timesync;
+    mavlink_msg_timesync_decode(&message, &timesync);
+
+    // Only answer requests, tc1 is 0 for those.
+    if (timesync.tc1 != 0) {
+        return;
+    }
+
+    mavlink_timesync_t response{};
+    response.tc1 = static_cast<int64_t>(time_boot_us() * 1000);
+    response.ts1 = timesync.ts1;
+
+    mavlink_message_t response_message;
+    mavlink_msg_timesync_encode_chan(
+        system_id_, component_id_, channel_, &response_message, &response);
+    send(response_message);
+}
+
+void MockVehicle::send(mavlink_message_t& message)
+{
+    if (send_callback_) {
+        send_callback_(message);
+    }
+}
+
+void MockVehicle::send_command_ack(const Command& command, uint8_t result)
+{
+    mavlink_command_ack_t ack{};
+    ack.command = command.command;
+    ack.result = result;
+    ack.target_system = command.sender_sysid;
+    ack.target_component = command.sender_compid;
+
+    mavlink_message_t message;
+    mavlink_msg_command_ack_encode_chan(system_id_, component_id_, channel_, &message, &ack);
+    send(message);
+}
+
+void MockVehicle::send_mission_ack(
+    uint8_t sysid, uint8_t compid, uint8_t type, uint8_t mission_type)
+{
+    mavlink_mission_ack_t ack{};
+    ack.target_system = sysid;
+    ack.target_component = compid;
+    ack.type = type;
+    ack.mission_type = mission_type;
+
+    mavlink_message_t message;
+    mavlink_msg_mission_ack_encode_chan(system_id_, component_id_, channel_, &message, &ack);
+    send(message);
+}
+
+void MockVehicle::send_mission_current()
+{
+    mavlink_mission_current_t mission_current{};
+    if (!mission_items_.empty()) {
+        mission_current.seq =
+            std::min(mission_current_, static_cast<uint16_t>(mission_items_.size() - 1));
+    }
+
+    mavlink_message_t message;
+    mavlink_msg_mission_current_encode_chan(
+        system_id_, component_id_, channel_, &message, &mission_current);
+    send(message);
+}
+
+void MockVehicle::send_mission_item_reached(uint16_t seq)
+{
+    mavlink_mission_item_reached_t reached{};
+    reached.seq = seq;
+
+    mavlink_message_t message;
+    mavlink_msg_mission_item_reached_encode_chan(
+        system_id_, component_id_, channel_, &message, &reached);
+    send(message);
+}
+
+void MockVehicle::send_param_value(size_t index)
+{
+    const Param& param = params_[index];
+
+    mavlink_param_value_t param_value{};
+    param_value.param_value = (param.type == MAV_PARAM_TYPE_INT32) ?
+                                  int_as_float(static_cast<int32_t>(param.value)) :
+                                  param.value;
+    param_value.param_count = static_cast<uint16_t>(params_.size());
+    param_value.param_index = static_cast<uint16_t>(index);
+    strncpy(param_value.param_id, param.name.c_str(), sizeof(param_value.param_id));
+    param_value.param_type = param.type;
+
+    mavlink_message_t message;
+    mavlink_msg_param_value_encode_chan(
+        system_id_, component_id_, channel_, &message, &param_value);
+    send(message);
+}
+
+bool MockVehicle::send_message_by_id(uint32_t message_id)
+{
+    switch (message_id) {
+        case MAVLINK_MSG_ID_HEARTBEAT:
+            send_heartbeat();
+            return true;
+        case MAVLINK_MSG_ID_SYS_STATUS:
+            send_sys_status();
+            return true;
+        case MAVLINK_MSG_ID_EXTENDED_SYS_STATE:
+            send_extended_sys_state();
+            return true;
+        case MAVLINK_MSG_ID_GPS_RAW_INT:
+            send_gps_raw_int();
+            return true;
+        case MAVLINK_MSG_ID_GLOBAL_POSITION_INT:
+            send_global_position_int();
+            return true;
+        case MAVLINK_MSG_ID_LOCAL_POSITION_NED:
+            send_local_position_ned();
+            return true;
+        case MAVLINK_MSG_ID_ATTITUDE:
+            send_attitude();
+            return true;
+        case MAVLINK_MSG_ID_ATTITUDE_QUATERNION:
+            send_attitude_quaternion();
+            return true;
+        case MAVLINK_MSG_ID_HOME_POSITION:
+            send_home_position();
+            return true;
+        case MAVLINK_MSG_ID_BATTERY_STATUS:
+            send_battery_status();
+            return true;
+        case MAVLINK_MSG_ID_HIGHRES_IMU:
+            send_highres_imu();
+            return true;
+        case MAVLINK_MSG_ID_MISSION_CURRENT:
+            send_mission_current();
+            return true;
+        default:
+            return false;
+    }
+}
+
+void MockVehicle::send_heartbeat()
+{
+    mavlink_heartbeat_t heartbeat{};
+    heartbeat.custom_mode = (static_cast<uint32_t>(auto_mode_) << 24) |
+                            (static_cast<uint32_t>(main_mode_) << 16);
+    heartbeat.type = MAV_TYPE_QUADROTOR;
+    heartbeat.autopilot = MAV_AUTOPILOT_PX4;
+    heartbeat.base_mode = MAV_MODE_FLAG_CUSTOM_MODE_ENABLED | MAV_MODE_FLAG_STABILIZE_ENABLED;
+    if (armed_) {
+        heartbeat.base_mode |= MAV_MODE_FLAG_SAFETY_ARMED;
+    }
+    if (main_mode_ == MainMode::Auto || main_mode_ == MainMode::Offboard) {
+        heartbeat.base_mode |= MAV_MODE_FLAG_AUTO_ENABLED | MAV_MODE_FLAG_GUIDED_ENABLED;
+    }
+    heartbeat.system_status = armed_ ? MAV_STATE_ACTIVE : MAV_STATE_STANDBY;
+    heartbeat.mavlink_version = 3;
+
+    mavlink_message_t message;
+    mavlink_msg_heartbeat_encode_chan(system_id_, component_id_, channel_, &message, &heartbeat);
+    send(message);
+}
+
+void MockVehicle::send_sys_status()
+{
+    const uint32_t sensors =
+        MAV_SYS_STATUS_SENSOR_3D_GYRO | MAV_SYS_STATUS_SENSOR_3D_ACCEL |
+        MAV_SYS_STATUS_SENSOR_3D_MAG | MAV_SYS_STATUS_SENSOR_ABSOLUTE_PRESSURE |
+        MAV_SYS_STATUS_SENSOR_GPS | MAV_SYS_STATUS_SENSOR_MOTOR_OUTPUTS | MAV_SYS_STATUS_AHRS |
+        MAV_SYS_STATUS_PREARM_CHECK;
+
+    mavlink_sys_status_t sys_status{};
+    sys_status.onboard_control_sensors_present = sensors;
+    sys_status.onboard_control_sensors_enabled = sensors;
+    sys_status.onboard_control_sensors_health = sensors;
+    sys_status.load = 250;
+    sys_status.voltage_battery = static_cast<uint16_t>((14.0f + 2.8f * battery_remaining_) * 1000);
+    sys_status.current_battery = armed_ ? 1500 : 50;
+    sys_status.battery_remaining = static_cast<int8_t>(battery_remaining_ * 100.0f);
+
+    mavlink_message_t message;
+    mavlink_msg_sys_status_encode_chan(system_id_, component_id_, channel_, &message, &sys_status);
+    send(message);
+}
+
+void MockVehicle::send_extended_sys_state()
+{
+    mavlink_extended_sys_state_t extended_sys_state{};
+    extended_sys_state.vtol_state = MAV_VTOL_STATE_UNDEFINED;
+    extended_sys_state.landed_state = landed_state_;
+
+    mavlink_message_t message;
+    mavlink_msg_extended_sys_state_encode_chan(
+        system_id_, component_id_, channel_, &message, &extended_sys_state);
+    send(message);
+}
+
+void MockVehicle::send_gps_raw_int()
+{
+    const float ground_speed_m_s = std::hypot(velocity_[0], velocity_[1]);
+    float course_deg = std::atan2(velocity_[1], velocity_[0]) * 180.0f / static_cast<float>(M_PI);
+    if (course_deg < 0.0f) {
+        course_deg += 360.0f;
+    }
+
+    mavlink_gps_raw_int_t gps_raw_int{};
+    gps_raw_int.time_usec = time_boot_us();
+    gps_raw_int.lat = static_cast<int32_t>(std::round(latitude_deg() * degrees_to_e7));
+    gps_raw_int.lon = static_cast<int32_t>(std::round(longitude_deg() * degrees_to_e7));
+    gps_raw_int.alt = static_cast<int32_t>((home_altitude_amsl_m_ + altitude_m()) * 1000.0f);
+    gps_raw_int.eph = 80;
+    gps_raw_int.epv = 120;
+    gps_raw_int.vel = static_cast<uint16_t>(ground_speed_m_s * 100.0f);
+    gps_raw_int.cog = static_cast<uint16_t>(course_deg * 100.0f);
+    gps_raw_int.fix_type = GPS_FIX_TYPE_3D_FIX;
+    gps_raw_int.satellites_visible = 12;
+
+    mavlink_message_t message;
+    mavlink_msg_gps_raw_int_encode_chan(
+        system_id_, component_id_, channel_, &message, &gps_raw_int);
+    send(message);
+}
+
+void MockVehicle::send_global_position_int()
+{
+    float heading_deg = yaw_rad_ * 180.0f / static_cast<float>(M_PI);
+    if (heading_deg < 0.0f) {
+        heading_deg += 360.0f;
+    }
+
+    mavlink_global_position_int_t global_position_int{};
+    global_position_int.time_boot_ms = time_boot_ms();
+    global_position_int.lat = static_cast<int32_t>(std::round(latitude_deg() * degrees_to_e7));
+    global_position_int.lon = static_cast<int32_t>(std::round(longitude_deg() * degrees_to_e7));
+    global_position_int.alt =
+        static_cast<int32_t>((home_altitude_amsl_m_ + altitude_m()) * 1000.0f);
+    global_position_int.relative_alt = static_cast<int32_t>(altitude_m() * 1000.0f);
+    global_position_int.vx = static_cast<int16_t>(velocity_[0] * 100.0f);
+    global_position_int.vy = static_cast<int16_t>(velocity_[1] * 100.0f);
+    global_position_int.vz = static_cast<int16_t>(velocity_[2] * 100.0f);
+    global_position_int.hdg = static_cast<uint16_t>(heading_deg * 100.0f) % 36000;
+
+    mavlink_message_t message;
+    mavlink_msg_global_position_int_encode_chan(
+        system_id_, component_id_, channel_, &message, &global_position_int);
+    send(message);
+}
+
+void MockVehicle::send_local_position_ned()
+{
+    mavlink_local_position_ned_t local_position_ned{};
+    local_position_ned.time_boot_ms = time_boot_ms();
+    local_position_ned.x = position_[0];
+    local_position_ned.y = position_[1];
+    local_position_ned.z = position_[2];
+    local_position_ned.vx = velocity_[0];
+    local_position_ned.vy = velocity_[1];
+    local_position_ned.vz = velocity_[2];
+
+    mavlink_message_t message;
+    mavlink_msg_local_position_ned_encode_chan(
+        system_id_, component_id_, channel_, &message, &local_position_ned);
+    send(message);
+}
+
+void MockVehicle::send_attitude()
+{
+    mavlink_attitude_t attitude{};
+    attitude.time_boot_ms = time_boot_ms();
+    attitude.roll = roll_rad_;
+    attitude.pitch = pitch_rad_;
+    attitude.yaw = yaw_rad_;
+    attitude.yawspeed = yaw_rate_rad_s_;
+
+    mavlink_message_t message;
+    mavlink_msg_attitude_encode_chan(system_id_, component_id_, channel_, &message, &attitude);
+    send(message);
+}
+
+void MockVehicle::send_attitude_quaternion()
+{
+    float q[4];
+    mavlink_euler_to_quaternion(roll_rad_, pitch_rad_, yaw_rad_, q);
+
+    mavlink_attitude_quaternion_t attitude_quaternion{};
+    attitude_quaternion.time_boot_ms = time_boot_ms();
+    attitude_quaternion.q1 = q[0];
+    attitude_quaternion.q2 = q[1];
+    attitude_quaternion.q3 = q[2];
+    attitude_quaternion.q4 = q[3];
+    attitude_quaternion.yawspeed = yaw_rate_rad_s_;
+
+    mavlink_message_t message;
+    mavlink_msg_attitude_quaternion_encode_chan(
+        system_id_, component_id_, channel_, &message, &attitude_quaternion);
+    send(message);
+}
+
+void MockVehicle::send_home_position()
+{
+    mavlink_home_position_t home_position{};
+    home_position.latitude = static_cast<int32_t>(std::round(home_latitude_deg_ * degrees_to_e7));
+    home_position.longitude = static_cast<int32_t>(std::round(home_longitude_deg_ * degrees_to_e7));
+    home_position.altitude = static_cast<int32_t>(home_altitude_amsl_m_ * 1000.0f);
+    home_position.q[0] = 1.0f;
+    home_position.time_usec = time_boot_us();
+
+    mavlink_message_t message;
+    mavlink_msg_home_position_encode_chan(
+        system_id_, component_id_, channel_, &message, &home_position);
+    send(message);
+}
+
+void MockVehicle::send_battery_status()
+{
+    mavlink_battery_status_t battery_status{};
+    battery_status.current_consumed = -1;
+    battery_status.energy_consumed = -1;
+    battery_status.temperature = INT16_MAX;
+    for (auto& voltage : battery_status.voltages) {
+        voltage = UINT16_MAX;
+    }
+    battery_status.voltages[0] = static_cast<uint16_t>((14.0f + 2.8f * battery_remaining_) * 1000);
+    battery_status.current_battery = armed_ ? 1500 : 50;
+    battery_status.battery_function = MAV_BATTERY_FUNCTION_ALL;
+    battery_status.type = MAV_BATTERY_TYPE_LIPO;
+    battery_status.battery_remaining = static_cast<int8_t>(battery_remaining_ * 100.0f);
+
+    mavlink_message_t message;
+    mavlink_msg_battery_status_encode_chan(
+        system_id_, component_id_, channel_, &message, &battery_status);
+    send(message);
+}
+
+void MockVehicle::send_highres_imu()
+{
+    mavlink_highres_imu_t highres_imu{};
+    highres_imu.time_usec = time_boot_us();
+    highres_imu.xacc = -gravity_m_s2 * std::sin(pitch_rad_);
+    highres_imu.yacc = gravity_m_s2 * std::sin(roll_rad_);
+    highres_imu.zacc = -gravity_m_s2 * std::cos(roll_rad_) * std::cos(pitch_rad_);
+    highres_imu.zgyro = yaw_rate_rad_s_;
+    highres_imu.xmag = 0.21f * std::cos(yaw_rad_);
+    highres_imu.ymag = -0.21f * std::sin(yaw_rad_);
+    highres_imu.zmag = 0.42f;
+    highres_imu.abs_pressure = 1013.25f - 0.12f * (home_altitude_amsl_m_ + altitude_m());
+    highres_imu.pressure_alt = home_altitude_amsl_m_ + altitude_m();
+    highres_imu.temperature = 25.0f;
+    highres_imu.fields_updated = 0x1fff;
+
+    mavlink_message_t message;
+    mavlink_msg_highres_imu_encode_chan(
+        system_id_, component_id_, channel_, &message, &highres_imu);
+    send(message);
+}
+
+void MockVehicle::send_autopilot_version()
+{
+    mavlink_autopilot_version_t autopilot_version{};
+    autopilot_version.capabilities =
+        MAV_PROTOCOL_CAPABILITY_MISSION_FLOAT | MAV_PROTOCOL_CAPABILITY_PARAM_FLOAT |
+        MAV_PROTOCOL_CAPABILITY_MISSION_INT | MAV_PROTOCOL_CAPABILITY_COMMAND_INT |
+        MAV_PROTOCOL_CAPABILITY_SET_ATTITUDE_TARGET |
+        MAV_PROTOCOL_CAPABILITY_SET_POSITION_TARGET_LOCAL_NED | MAV_PROTOCOL_CAPABILITY_MAVLINK2;
+    autopilot_version.uid = 0x4d4f434b00000000ULL | system_id_;
+    // v1.11.0 release, encoded the way PX4 does it.
+    autopilot_version.flight_sw_version = (1 << 24) | (11 << 16) | (0 << 8) | 255;
+
+    mavlink_message_t message;
+    mavlink_msg_autopilot_version_encode_chan(
+        system_id_, component_id_, channel_, &message, &autopilot_version);
+    send(message);
+}
+
+void MockVehicle::step(float dt_s)
+{
+    const bool attitude_control =
+        armed_ && is_mode(MainMode::Offboard) && offboard_setpoint_.is_attitude;
+
+    if (!armed_) {
+        // Without thrust we simply drop.
+        set_velocity_setpoint(0.0f, 0.0f, is_on_ground() ? 0.0f : 5.0f);
+        yaw_rate_rad_s_ = 0.0f;
+    } else if (is_mode(MainMode::Auto, AutoMode::Takeoff)) {
+        step_takeoff();
+    } else if (is_mode(MainMode::Auto, AutoMode::Land)) {
+        step_land();
+    } else if (is_mode(MainMode::Auto, AutoMode::Rtl)) {
+        step_rtl();
+    } else if (is_mode(MainMode::Auto, AutoMode::Mission)) {
+        step_mission(dt_s);
+    } else if (is_mode(MainMode::Offboard)) {
+        step_offboard();
+    } else {
+        step_hold();
+    }
+
+    if (attitude_control && is_mode(MainMode::Offboard)) {
+        // Crude multicopter model: tilt accelerates horizontally, thrust vertically.
+        roll_rad_ = offboard_setpoint_.roll;
+        pitch_rad_ = offboard_setpoint_.pitch;
+        yaw_rate_rad_s_ = constrain(wrap_pi(offboard_setpoint_.yaw - yaw_rad_) * 2.0f, -1.0f, 1.0f);
+
+        const float forward = -gravity_m_s2 * std::tan(pitch_rad_);
+        const float right = gravity_m_s2 * std::tan(roll_rad_);
+        const float down = gravity_m_s2 * (1.0f - offboard_setpoint_.thrust / 0.5f);
+        const float drag = 0.3f;
+
+        velocity_[0] += (forward * std::cos(yaw_rad_) - right * std::sin(yaw_rad_) -
+                         drag * velocity_[0]) *
+                        dt_s;
+        velocity_[1] += (forward * std::sin(yaw_rad_) + right * std::cos(yaw_rad_) -
+                         drag * velocity_[1]) *
+                        dt_s;
+        velocity_[2] += (down - drag * velocity_[2]) * dt_s;
+    } else {
+        float acceleration[3];
+        const float max_delta = max_acceleration_m_s2 * dt_s;
+        for (unsigned i = 0; i < 3; ++i) {
+            const float delta =
+                constrain(velocity_setpoint_[i] - velocity_[i], -max_delta, max_delta);
+            velocity_[i] += delta;
+            acceleration[i] = delta / dt_s;
+        }
+
+        // Tilt into the acceleration like a multicopter would.
+        const float forward =
+            acceleration[0] * std::cos(yaw_rad_) + acceleration[1] * std::sin(yaw_rad_);
+        const float right =
+            -acceleration[0] * std::sin(yaw_rad_) + acceleration[1] * std::cos(yaw_rad_);
+        pitch_rad_ = 0.8f * pitch_rad_ + 0.2f * -std::atan(forward / gravity_m_s2);
+        roll_rad_ = 0.8f * roll_rad_ + 0.2f * std::atan(right / gravity_m_s2);
+    }
+
+    yaw_rad_ = wrap_pi(yaw_rad_ + yaw_rate_rad_s_ * dt_s);
+
+    for (unsigned i = 0; i < 3; ++i) {
+        position_[i] += velocity_[i] * dt_s;
+    }
+
+    if (position_[2] >= 0.0f) {
+        position_[2] = 0.0f;
+        if (velocity_[2] > 0.0f) {
+            velocity_[2] = 0.0f;
+        }
+        if (landed_state_ == MAV_LANDED_STATE_ON_GROUND) {
+            velocity_[0] = 0.0f;
+            velocity_[1] = 0.0f;
+            roll_rad_ = 0.0f;
+            pitch_rad_ = 0.0f;
+        }
+    }
+
+    // Land detector
+    if (landed_state_ == MAV_LANDED_STATE_ON_GROUND || landed_state_ == MAV_LANDED_STATE_TAKEOFF) {
+        if (armed_ && altitude_m() > in_air_altitude_m) {
+            landed_state_ = MAV_LANDED_STATE_IN_AIR;
+            has_taken_off_ = true;
+        }
+    } else if (altitude_m() <= 0.01f && velocity_setpoint_[2] >= 0.0f) {
+        land_detected();
+    }
+
+    if (armed_ && is_on_ground()) {
+        if (has_taken_off_ && now_ - landed_time_ > auto_disarm_landed) {
+            log("Auto disarm after landing");
+            disarm();
+        } else if (
+            !has_taken_off_ && now_ - armed_time_ > auto_disarm_preflight &&
+            velocity_setpoint_[2] >= 0.0f) {
+            log("Auto disarm, no takeoff");
+            disarm();
+        }
+    }
+
+    if (armed_) {
+        battery_remaining_ = std::max(0.0f, battery_remaining_ - 0.0005f * dt_s);
+    }
+}
+
+void MockVehicle::step_takeoff()
+{
+    if (landed_state_ == MAV_LANDED_STATE_ON_GROUND) {
+        landed_state_ = MAV_LANDED_STATE_TAKEOFF;
+    }
+
+    fly_to(hold_position_[0], hold_position_[1], -takeoff_altitude_m_, takeoff_speed_m_s);
+    velocity_setpoint_[2] = std::max(velocity_setpoint_[2], -takeoff_speed_m_s);
+
+    if (std::fabs(altitude_m() - takeoff_altitude_m_) < 0.1f) {
+        switch_to(MainMode::Auto, AutoMode::Loiter);
+    }
+}
+
+void MockVehicle::step_land()
+{
+    if (is_on_ground()) {
+        set_velocity_setpoint(0.0f, 0.0f, 0.0f);
+        return;
+    }
+
+    if (landed_state_ == MAV_LANDED_STATE_IN_AIR) {
+        landed_state_ = MAV_LANDED_STATE_LANDING;
+    }
+
+    // Keep the position horizontally and descend slower close to the ground.
+    fly_to(hold_position_[0], hold_position_[1], position_[2], param("MPC_XY_CRUISE"));
+    velocity_setpoint_[2] = (altitude_m() > 5.0f) ? max_descent_rate_m_s : land_speed_m_s;
+}
+
+void MockVehicle::start_rtl()
+{
+    rtl_altitude_m_ = std::max(altitude_m(), param("RTL_RETURN_ALT"));
+    climbing_first_ = std::hypot(position_[0], position_[1]) > acceptance_radius_m &&
+                      altitude_m() < rtl_altitude_m_ - acceptance_altitude_m;
+    rtl_descending_ = std::hypot(position_[0], position_[1]) <= acceptance_radius_m;
+    hold_position();
+    if (rtl_descending_) {
+        hold_position_[0] = 0.0f;
+        hold_position_[1] = 0.0f;
+    }
+}
+
+void MockVehicle::step_rtl()
+{
+    if (rtl_descending_) {
+        step_land();
+        return;
+    }
+
+    if (climbing_first_) {
+        if (fly_to(
+                hold_position_[0], hold_position_[1], -rtl_altitude_m_, param("MPC_XY_CRUISE"))) {
+            climbing_first_ = false;
+        }
+        return;
+    }
+
+    if (fly_to(0.0f, 0.0f, -rtl_altitude_m_, param("MPC_XY_CRUISE"))) {
+        rtl_descending_ = true;
+        hold_position_[0] = 0.0f;
+        hold_position_[1] = 0.0f;
+    }
+}
+
+void MockVehicle::step_mission(float dt_s)
+{
+    (void)dt_s;
+
+    if (mission_current_ >= mission_items_.size()) {
+        step_hold();
+        return;
+    }
+
+    const mavlink_mission_item_int_t& item = mission_items_[mission_current_];
+    const float speed_m_s =
+        (mission_speed_m_s_ > 0.0f) ? mission_speed_m_s_ : param("MPC_XY_CRUISE");
+
+    if (!mission_item_started_) {
+        mission_item_started_ = true;
+        mission_item_hold_until_ = time_point{};
+        // Like PX4 we climb vertically first when the mission starts on the ground.
+        climbing_first_ = (item.command != MAV_CMD_NAV_TAKEOFF) && altitude_m() < 1.0f &&
+                          item.command < MAV_CMD_NAV_LAST;
+        rtl_descending_ = false;
+        hold_position();
+        if (item.command == MAV_CMD_NAV_RETURN_TO_LAUNCH) {
+            start_rtl();
+        }
+        send_mission_current();
+    }
+
+    switch (item.command) {
+        case MAV_CMD_NAV_TAKEOFF:
+            if (landed_state_ == MAV_LANDED_STATE_ON_GROUND) {
+                landed_state_ = MAV_LANDED_STATE_TAKEOFF;
+            }
+            if (fly_to(
+                    hold_position_[0],
+                    hold_position_[1],
+                    -mission_item_altitude_m(item),
+                    takeoff_speed_m_s)) {
+                mission_item_done();
+            }
+            break;
+
+        case MAV_CMD_NAV_WAYPOINT:
+        case MAV_CMD_NAV_LOITER_UNLIM:
+        case MAV_CMD_NAV_LOITER_TURNS:
+        case MAV_CMD_NAV_LOITER_TIME:
+        case MAV_CMD_NAV_LAND: {
+            const float altitude = mission_item_altitude_m(item);
+            if (climbing_first_) {
+                if (fly_to(
+                        hold_position_[0],
+                        hold_position_[1],
+                        -std::max(altitude, param("MIS_TAKEOFF_ALT")),
+                        takeoff_speed_m_s)) {
+                    climbing_first_ = false;
+                }
+                break;
+            }
+
+            float north_m = position_[0];
+            float east_m = position_[1];
+            if (item.x != 0 || item.y != 0) {
+                local_from_global(item.x / degrees_to_e7, item.y / degrees_to_e7, north_m, east_m);
+            }
+
+            if (item.command == MAV_CMD_NAV_LAND) {
+                if (rtl_descending_) {
+                    step_land();
+                    if (is_on_ground()) {
+                        mission_item_done();
+                    }
+                } else if (fly_to(north_m, east_m, position_[2], speed_m_s)) {
+                    rtl_descending_ = true;
+                    hold_position_[0] = north_m;
+                    hold_position_[1] = east_m;
+                }
+                break;
+            }
+
+            if (!fly_to(north_m, east_m, -altitude, speed_m_s)) {
+                break;
+            }
+
+            if (item.command == MAV_CMD_NAV_LOITER_UNLIM) {
+                break;
+            }
+
+            if (mission_item_hold_until_ == time_point{}) {
+                // param1 is the hold time for waypoints and the loiter time for LOITER_TIME.
+                const float hold_time_s = (item.command == MAV_CMD_NAV_WAYPOINT ||
+                                           item.command == MAV_CMD_NAV_LOITER_TIME) ?
+                                              std::max(0.0f, item.param1) :
+                                              0.0f;
+                mission_item_hold_until_ =
+                    now_ + std::chrono::milliseconds(static_cast<int>(hold_time_s * 1000.0f));
+            }
+            if (now_ >= mission_item_hold_until_) {
+                mission_item_done();
+            }
+            break;
+        }
+
+        case MAV_CMD_NAV_RETURN_TO_LAUNCH:
+            step_rtl();
+            if (rtl_descending_ && is_on_ground()) {
+                mission_item_done();
+            }
+            break;
+
+        case MAV_CMD_NAV_DELAY:
+            step_hold();
+            if (mission_item_hold_until_ == time_point{}) {
+                mission_item_hold_until_ =
+                    now_ + std::chrono::milliseconds(static_cast<int>(item.param1 * 1000.0f));
+            }
+            if (now_ >= mission_item_hold_until_) {
+                mission_item_done();
+            }
+            break;
+
+        case MAV_CMD_DO_CHANGE_SPEED:
+            if (item.param2 > 0.0f) {
+                mission_speed_m_s_ = item.param2;
+            }
+            mission_item_done();
+            break;
+
+        case MAV_CMD_DO_JUMP: {
+            const int repeat = static_cast<int>(item.param2);
+            int& count = jump_counts_[mission_current_];
+            if (item.param1 >= 0.0f && item.param1 < mission_items_.size() &&
+                (repeat < 0 || count < repeat)) {
+                ++count;
+                mission_current_ = static_cast<uint16_t>(item.param1);
+                mission_item_started_ = false;
+            } else {
+                mission_item_done();
+            }
+            break;
+        }
+
+        default:
+            // Camera, gimbal and other DO commands are executed right away.
+            step_hold();
+            mission_item_done();
+            break;
+    }
+}
+
+void MockVehicle::step_offboard()
+{
+    if (now_ - offboard_setpoint_.time > offboard_loss_timeout) {
+        log("Offboard setpoints lost, switching to hold");
+        switch_to(MainMode::Auto, AutoMode::Loiter);
+        step_hold();
+        return;
+    }
+
+    if (offboard_setpoint_.is_attitude) {
+        // Handled directly in step().
+        return;
+    }
+
+    const uint16_t type_mask = offboard_setpoint_.type_mask;
+
+    if ((type_mask & ignore_velocity) != ignore_velocity) {
+        float north = offboard_setpoint_.velocity[0];
+        float east = offboard_setpoint_.velocity[1];
+        if (is_body_frame(offboard_setpoint_.frame)) {
+            north = offboard_setpoint_.velocity[0] * std::cos(yaw_rad_) -
+                    offboard_setpoint_.velocity[1] * std::sin(yaw_rad_);
+            east = offboard_setpoint_.velocity[0] * std::sin(yaw_rad_) +
+                   offboard_setpoint_.velocity[1] * std::cos(yaw_rad_);
+        }
+        set_velocity_setpoint(north, east, offboard_setpoint_.velocity[2]);
+    } else if ((type_mask & ignore_position) != ignore_position) {
+        fly_to(
+            offboard_setpoint_.position[0],
+            offboard_setpoint_.position[1],
+            offboard_setpoint_.position[2],
+            param("MPC_XY_CRUISE"));
+    } else {
+        set_velocity_setpoint(0.0f, 0.0f, 0.0f);
+    }
+
+    yaw_rate_rad_s_ = (type_mask & ignore_yaw_rate) ? 0.0f : offboard_setpoint_.yaw_rate;
+}
+
+bool MockVehicle::fly_to(float north_m, float east_m, float down_m, float speed_m_s)
+{
+    const float error_north = north_m - position_[0];
+    const float error_east = east_m - position_[1];
+    const float error_down = down_m - position_[2];
+    const float distance = std::hypot(error_north, error_east);
+
+    // Proportional approach which slows down close to the target.
+    const float horizontal_speed = std::min(speed_m_s, distance);
+    if (distance > 0.01f) {
+        velocity_setpoint_[0] = error_north / distance * horizontal_speed;
+        velocity_setpoint_[1] = error_east / distance * horizontal_speed;
+    } else {
+        velocity_setpoint_[0] = 0.0f;
+        velocity_setpoint_[1] = 0.0f;
+    }
+    velocity_setpoint_[2] = constrain(error_down, -max_climb_rate_m_s, max_descent_rate_m_s);
+
+    // Point the nose into the direction of travel.
+    if (distance > 2.0f) {
+        const float heading_error = wrap_pi(std::atan2(error_east, error_north) - yaw_rad_);
+        yaw_rate_rad_s_ = constrain(heading_error * 1.5f, -0.8f, 0.8f);
+    } else {
+        yaw_rate_rad_s_ = 0.0f;
+    }
+
+    return distance < acceptance_radius_m && std::fabs(error_down) < acceptance_altitude_m;
+}
+
+void MockVehicle::hold_position()
+{
+    hold_position_[0] = position_[0];
+    hold_position_[1] = position_[1];
+    hold_position_[2] = position_[2];
+}
+
+void MockVehicle::step_hold()
+{
+    if (is_on_ground()) {
+        set_velocity_setpoint(0.0f, 0.0f, 0.0f);
+        yaw_rate_rad_s_ = 0.0f;
+        return;
+    }
+
+    fly_to(hold_position_[0], hold_position_[1], hold_position_[2], param("MPC_XY_CRUISE"));
+    yaw_rate_rad_s_ = 0.0f;
+}
+
+void MockVehicle::set_velocity_setpoint(float north_m_s, float east_m_s, float down_m_s)
+{
+    velocity_setpoint_[0] = north_m_s;
+    velocity_setpoint_[1] = east_m_s;
+    velocity_setpoint_[2] = down_m_s;
+}
+
+void MockVehicle::arm()
+{
+    armed_ = true;
+    has_taken_off_ = false;
+    armed_time_ = now_;
+    landed_time_ = now_;
+    log("Armed");
+}
+
+void MockVehicle::disarm()
+{
+    armed_ = false;
+    set_velocity_setpoint(0.0f, 0.0f, 0.0f);
+    log("Disarmed");
+}
+
+void MockVehicle::land_detected()
+{
+    landed_state_ = MAV_LANDED_STATE_ON_GROUND;
+    landed_time_ = now_;
+    set_velocity_setpoint(0.0f, 0.0f, 0.0f);
+    log("Landed");
+}
+
+void MockVehicle::switch_to(MainMode main_mode, AutoMode auto_mode)
+{
+    if (main_mode_ == main_mode && auto_mode_ == auto_mode) {
+        return;
+    }
+
+    main_mode_ = main_mode;
+    auto_mode_ = auto_mode;
+    climbing_first_ = false;
+    rtl_descending_ = false;
+    hold_position();
+
+    if (is_mode(MainMode::Auto, AutoMode::Rtl)) {
+        start_rtl();
+    } else if (is_mode(MainMode::Auto, AutoMode::Mission)) {
+        mission_item_started_ = false;
+    }
+
+    std::stringstream ss;
+    ss << "Mode " << int(main_mode) << "/" << int(auto_mode);
+    log(ss.str());
+
+    // Let the ground station know right away.
+    send_heartbeat();
+}
+
+void MockVehicle::mission_item_done()
+{
+    send_mission_item_reached(mission_current_);
+    ++mission_current_;
+    mission_item_started_ = false;
+
+    if (mission_current_ >= mission_items_.size()) {
+        log("Mission finished");
+        hold_position();
+    }
+    send_mission_current();
+}
+
+bool MockVehicle::is_mode(MainMode main_mode, AutoMode auto_mode) const
+{
+    if (main_mode_ != main_mode) {
+        return false;
+    }
+    return main_mode != MainMode::Auto || auto_mode_ == auto_mode;
+}
+
+bool MockVehicle::is_on_ground() const
+{
+    return landed_state_ == MAV_LANDED_STATE_ON_GROUND;
+}
+
+float MockVehicle::mission_item_altitude_m(const mavlink_mission_item_int_t& item) const
+{
+    if (item.frame == MAV_FRAME_GLOBAL || item.frame == MAV_FRAME_GLOBAL_INT) {
+        return item.z - home_altitude_amsl_m_;
+    }
+    return item.z;
+}
+
+bool MockVehicle::targets_us(uint8_t target_system, uint8_t target_component) const
+{
+    return (target_system == 0 || target_system == system_id_) &&
+           (target_component == MAV_COMP_ID_ALL || target_component == component_id_);
+}
+
+float MockVehicle::param(const std::string& name) const
+{
+    for (const auto& param : params_) {
+        if (param.name == name) {
+            return param.value;
+        }
+    }
+    return NAN;
+}
+
+uint32_t MockVehicle::time_boot_ms() const
+{
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(now_ - boot_time_).count());
+}
+
+uint64_t MockVehicle::time_boot_us() const
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(now_ - boot_time_).count());
+}
+
+double MockVehicle::latitude_deg() const
+{
+    return home_latitude_deg_ + position_[0] / earth_radius_m * 180.0 / M_PI;
+}
+
+double MockVehicle::longitude_deg() const
+{
+    return home_longitude_deg_ +
+           position_[1] / (earth_radius_m * std::cos(home_latitude_deg_ / 180.0 * M_PI)) * 180.0 /
+               M_PI;
+}
+
+void MockVehicle::local_from_global(
+    double latitude_deg, double longitude_deg, float& north_m, float& east_m) const
+{
+    north_m =
+        static_cast<float>((latitude_deg - home_latitude_deg_) / 180.0 * M_PI * earth_radius_m);
+    east_m = static_cast<float>(
+        (longitude_deg - home_longitude_deg_) / 180.0 * M_PI * earth_radius_m *
+        std::cos(home_latitude_deg_ / 180.0 * M_PI));
+}
+
+void MockVehicle::log(const std::string& text) const
+{
+    if (verbose_) {
+        std::cout << "[" << int(system_id_) << "] " << text << std::endl;
+    }
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+// Only used for the MAVLink message definitions which ship with MAVSDK.
+#include <mavsdk/plugins/mavlink_passthrough/mavlink_passthrough.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The MockVehicle class
+ * Simulates just enough of a PX4 multicopter to drive the examples without SITL:
+ * telemetry streams, commands (arm, takeoff, land, RTL, mode changes), the mission
+ * transfer protocol, mission execution and offboard setpoints.
+ *
+ * The class does not own any I/O. Incoming messages are passed to handle_message() and
+ * outgoing messages are handed to the send callback. update() advances the simulation.
+ */
+class MockVehicle {
+public:
+    typedef std::function<void(const mavlink_message_t& message)> send_callback_t;
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    // Each instance needs its own MAVLink channel so sequence numbers don't get mixed up
+    // when several vehicles run in parallel.
+    MockVehicle(uint8_t system_id, uint8_t channel, send_callback_t send_callback);
+
+    void handle_message(const mavlink_message_t& message);
+
+    // Advances the simulation to `now` and sends the telemetry messages which are due.
+    void update(time_point now);
+
+    uint8_t system_id() const { return system_id_; }
+
+    // Home position, defaults to the location used by PX4 SITL.
+    void set_home(double latitude_deg, double longitude_deg, float altitude_amsl_m);
+
+    void set_verbose(bool verbose) { verbose_ = verbose; }
+
+private:
+    // PX4 custom main and sub modes.
+    enum class MainMode : uint8_t { Manual = 1, Altctl = 2, Posctl = 3, Auto = 4, Offboard = 6 };
+    enum class AutoMode : uint8_t {
+        None = 0,
+        Ready = 1,
+        Takeoff = 2,
+        Loiter = 3,
+        Mission = 4,
+        Rtl = 5,
+        Land = 6
+    };
+
+    struct Command {
+        uint16_t command;
+        float params[7];
+        uint8_t sender_sysid;
+        uint8_t sender_compid;
+    };
+
+    struct Param {
+        std::string name;
+        float value;
+        uint8_t type;
+    };
+
+    struct Stream {
+        int64_t interval_us;
+        int64_t default_interval_us;
+        time_point next_time;
+    };
+
+    struct OffboardSetpoint {
+        bool is_attitude{false};
+        uint8_t frame{MAV_FRAME_LOCAL_NED};
+        uint16_t type_mask{0xffff};
+        float position[3]{};
+        float velocity[3]{};
+        float yaw_rate{0.0f};
+        float roll{0.0f};
+        float pitch{0.0f};
+        float yaw{0.0f};
+        float thrust{0.5f};
+        time_point time{};
+    };
+
+    struct MissionTransfer {
+        bool active{false};
+        uint8_t mission_type{MAV_MISSION_TYPE_MISSION};
+        uint8_t partner_sysid{0};
+        uint8_t partner_compid{0};
+        uint16_t count{0};
+        uint16_t next_seq{0};
+        unsigned retries_left{0};
+        time_point deadline{};
+        std::vector<mavlink_mission_item_int_t> items{};
+    };
+
+    // Messages
+    void handle_command_long(const mavlink_message_t& message);
+    void handle_command_int(const mavlink_message_t& message);
+    void handle_command(const Command& command);
+    void handle_mission_count(const mavlink_message_t& message);
+    void handle_mission_item_int(const mavlink_message_t& message);
+    void handle_mission_item(const mavlink_message_t& message);
+    void handle_mission_request(const mavlink_message_t& message, bool is_int);
+    void handle_mission_request_list(const mavlink_message_t& message);
+    void handle_mission_clear_all(const mavlink_message_t& message);
+    void handle_mission_set_current(const mavlink_message_t& message);
+    void handle_mission_ack(const mavlink_message_t& message);
+    void handle_set_position_target_local_ned(const mavlink_message_t& message);
+    void handle_set_attitude_target(const mavlink_message_t& message);
+    void handle_param_request_read(const mavlink_message_t& message);
+    void handle_param_request_list(const mavlink_message_t& message);
+    void handle_param_set(const mavlink_message_t& message);
+    void handle_timesync(const mavlink_message_t& message);
+
+    uint8_t handle_arm_disarm(const Command& command);
+    uint8_t handle_set_mode(uint8_t main_mode, uint8_t sub_mode);
+    uint8_t handle_set_message_interval(uint32_t message_id, float interval_us);
+    uint8_t handle_request_message(uint32_t message_id);
+
+    void store_mission_item(const mavlink_mission_item_int_t& item);
+    void request_next_mission_item();
+
+    // Sending
+    void send(mavlink_message_t& message);
+    void send_command_ack(const Command& command, uint8_t result);
+    void send_mission_ack(uint8_t sysid, uint8_t compid, uint8_t type, uint8_t mission_type);
+    void send_mission_current();
+    void send_mission_item_reached(uint16_t seq);
+    void send_param_value(size_t index);
+    bool send_message_by_id(uint32_t message_id);
+    void send_heartbeat();
+    void send_sys_status();
+    void send_extended_sys_state();
+    void send_gps_raw_int();
+    void send_global_position_int();
+    void send_local_position_ned();
+    void send_attitude();
+    void send_attitude_quaternion();
+    void send_home_position();
+    void send_battery_status();
+    void send_highres_imu();
+    void send_autopilot_version();
+
+    // Simulation
+    void step(float dt_s);
+    void step_takeoff();
+    void step_land();
+    void step_rtl();
+    void start_rtl();
+    void step_mission(float dt_s);
+    void step_offboard();
+    bool fly_to(float north_m, float east_m, float down_m, float speed_m_s);
+    void hold_position();
+    void step_hold();
+    void set_velocity_setpoint(float north_m_s, float east_m_s, float down_m_s);
+    void arm();
+    void disarm();
+    void land_detected();
+    void switch_to(MainMode main_mode, AutoMode auto_mode);
+    void mission_item_done();
+
+    bool is_mode(MainMode main_mode, AutoMode auto_mode = AutoMode::None) const;
+    bool is_on_ground() const;
+    float altitude_m() const { return -position_[2]; }
+    float mission_item_altitude_m(const mavlink_mission_item_int_t& item) const;
+    bool targets_us(uint8_t target_system, uint8_t target_component) const;
+    float param(const std::string& name) const;
+    uint32_t time_boot_ms() const;
+    uint64_t time_boot_us() const;
+    double latitude_deg() const;
+    double longitude_deg() const;
+    void local_from_global(double latitude_deg, double longitude_deg, float& north_m, float& east_m)
+        const;
+    void log(const std::string& text) const;
+
+    const uint8_t system_id_;
+    const uint8_t channel_;
+    const uint8_t component_id_{MAV_COMP_ID_AUTOPILOT1};
+    send_callback_t send_callback_;
+    bool verbose_{true};
+
+    time_point boot_time_;
+    time_point now_;
+    time_point last_step_time_{};
+
+    double home_latitude_deg_{47.3977419};
+    double home_longitude_deg_{8.5455938};
+    float home_altitude_amsl_m_{488.0f};
+
+    // State in local NED relative to home.
+    float position_[3]{};
+    float velocity_[3]{};
+    float velocity_setpoint_[3]{};
+    float roll_rad_{0.0f};
+    float pitch_rad_{0.0f};
+    float yaw_rad_{0.0f};
+    float yaw_rate_rad_s_{0.0f};
+    float hold_position_[3]{};
+
+    bool armed_{false};
+    time_point armed_time_{};
+    time_point landed_time_{};
+    MainMode main_mode_{MainMode::Auto};
+    AutoMode auto_mode_{AutoMode::Loiter};
+    uint8_t landed_state_{MAV_LANDED_STATE_ON_GROUND};
+    float battery_remaining_{1.0f};
+
+    float takeoff_altitude_m_{2.5f};
+    float rtl_altitude_m_{15.0f};
+    bool has_taken_off_{false};
+
+    // Set when a takeoff or RTL is split into several phases.
+    bool climbing_first_{false};
+    bool rtl_descending_{false};
+
+    std::vector<mavlink_mission_item_int_t> mission_items_{};
+    uint16_t mission_current_{0};
+    bool mission_item_started_{false};
+    time_point mission_item_hold_until_{};
+    float mission_speed_m_s_{0.0f};
+    std::map<uint16_t, int> jump_counts_{};
+    MissionTransfer upload_{};
+
+    OffboardSetpoint offboard_setpoint_{};
+
+    std::vector<Param> params_{};
+    std::map<uint32_t, Stream> streams_{};
+};
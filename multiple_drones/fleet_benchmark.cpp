@@ -0,0 +1,223 @@
+//
+// Compares running the takeoff and land flight for many vehicles with one thread per
+// vehicle (like multiple_drones used to do) against the FleetExecutor.
+//
+// Start the vehicles with the mock autopilot, all sending to the same port. Each mock
+// process runs up to 16 vehicles, e.g. for 64 vehicles:
+//
+//   for i in 0 1 2 3; do mock_autopilot 14540 16 $((i * 16 + 1)) 127.0.0.1 0 & done
+//   ./fleet_benchmark udp://:14540 64 executor
+//   ./fleet_benchmark udp://:14540 64 threads
+//
+
+#include <mavsdk/mavsdk.h>
+#include <mavsdk/plugins/action/action.h>
+#include <mavsdk/plugins/telemetry/telemetry.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fleet_executor.h"
+#include "system_discovery.h"
+#include "takeoff_land_script.h"
+
+using namespace mavsdk;
+using namespace std::this_thread;
+using namespace std::chrono;
+
+#define ERROR_CONSOLE_TEXT "\033[31m" // Turn text on console red
+#define NORMAL_CONSOLE_TEXT "\033[0m" // Restore normal console colour
+
+namespace {
+
+struct ProcessUsage {
+    long threads{0};
+    long rss_kb{0};
+    double cpu_s{0.0};
+};
+
+ProcessUsage sample_process_usage()
+{
+    ProcessUsage usage{};
+
+    std::ifstream status("/proc/self/status");
+    std::string key;
+    while (status >> key) {
+        if (key == "Threads:") {
+            status >> usage.threads;
+        } else if (key == "VmRSS:") {
+            status >> usage.rss_kb;
+        }
+        status.ignore(256, '\n');
+    }
+
+    rusage resources{};
+    getrusage(RUSAGE_SELF, &resources);
+    usage.cpu_s = resources.ru_utime.tv_sec + resources.ru_utime.tv_usec * 1e-6 +
+                  resources.ru_stime.tv_sec + resources.ru_stime.tv_usec * 1e-6;
+    return usage;
+}
+
+// The flight of the original multiple_drones example, blocking a thread per vehicle.
+bool blocking_takeoff_and_land(std::shared_ptr<System> system, milliseconds hover_time)
+{
+    auto telemetry = std::make_shared<Telemetry>(system);
+    auto action = std::make_shared<Action>(system);
+
+    while (telemetry->health_all_ok() != true) {
+        sleep_for(seconds(1));
+    }
+
+    if (action->arm() != Action::Result::Success) {
+        return false;
+    }
+    if (action->takeoff() != Action::Result::Success) {
+        return false;
+    }
+
+    sleep_for(hover_time);
+
+    if (action->land() != Action::Result::Success) {
+        return false;
+    }
+
+    while (telemetry->in_air()) {
+        sleep_for(seconds(1));
+    }
+
+    sleep_for(seconds(5));
+    return true;
+}
+
+void usage(const std::string& bin_name)
+{
+    std::cout << "Usage : " << bin_name
+              << " <connection_url> <number_of_vehicles> <executor|threads> [hover_s] [workers]"
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 4 || argc > 6) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const size_t number_of_vehicles = std::strtoul(argv[2], nullptr, 10);
+    const std::string mode = argv[3];
+    const milliseconds hover_time(argc > 4 ? std::atoi(argv[4]) * 1000 : 5000);
+    const size_t worker_count =
+        argc > 5 ? std::strtoul(argv[5], nullptr, 10) : FleetExecutor::default_worker_count();
+
+    if (number_of_vehicles == 0 || (mode != "executor" && mode != "threads")) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Mavsdk mavsdk;
+    const ConnectionResult connection_result = mavsdk.add_any_connection(argv[1]);
+    if (connection_result != ConnectionResult::Success) {
+        std::cerr << ERROR_CONSOLE_TEXT << "Connection error: " << connection_result
+                  << NORMAL_CONSOLE_TEXT << std::endl;
+        return 1;
+    }
+
+    SystemDiscovery discovery(mavsdk);
+    if (!discovery.wait_for_systems(number_of_vehicles, seconds(30))) {
+        std::cerr << ERROR_CONSOLE_TEXT << "Only found " << discovery.discovered_systems().size()
+                  << " of " << number_of_vehicles << " systems" << NORMAL_CONSOLE_TEXT
+                  << std::endl;
+        return 1;
+    }
+
+    auto discovered_systems = discovery.discovered_systems();
+    discovered_systems.resize(number_of_vehicles);
+
+    // Everything MAVSDK needs for the connected systems is accounted for in the baseline.
+    sleep_for(seconds(1));
+    const ProcessUsage baseline = sample_process_usage();
+    const auto start_time = steady_clock::now();
+
+    // Peak thread count and RSS while the flights run.
+    std::atomic<bool> sampling{true};
+    ProcessUsage peak = baseline;
+    std::thread sampler([&sampling, &peak]() {
+        while (sampling) {
+            const ProcessUsage usage = sample_process_usage();
+            peak.threads = std::max(peak.threads, usage.threads);
+            peak.rss_kb = std::max(peak.rss_kb, usage.rss_kb);
+            sleep_for(milliseconds(200));
+        }
+    });
+
+    std::atomic<size_t> failed{0};
+
+    if (mode == "threads") {
+        std::vector<std::thread> threads;
+        for (const auto& discovered : discovered_systems) {
+            auto system = discovered.system;
+            threads.emplace_back([system, hover_time, &failed]() {
+                if (!blocking_takeoff_and_land(system, hover_time)) {
+                    ++failed;
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    } else {
+        FleetExecutor executor(worker_count);
+        std::atomic<size_t> remaining{number_of_vehicles};
+        std::promise<void> all_done;
+
+        for (const auto& discovered : discovered_systems) {
+            auto script =
+                std::make_shared<TakeoffLandScript>(executor, discovered.system, hover_time, false);
+            script->start([&remaining, &failed, &all_done](bool success) {
+                if (!success) {
+                    ++failed;
+                }
+                if (--remaining == 0) {
+                    all_done.set_value();
+                }
+            });
+        }
+        all_done.get_future().wait();
+    }
+
+    const double duration_s = duration<double>(steady_clock::now() - start_time).count();
+    sampling = false;
+    sampler.join();
+    const ProcessUsage end = sample_process_usage();
+
+    // The sampler thread itself is not part of the workload.
+    const long extra_threads = std::max(0L, peak.threads - baseline.threads - 1);
+    const double cpu_s = end.cpu_s - baseline.cpu_s;
+
+    std::cout << "mode:                 " << mode << std::endl
+              << "vehicles:             " << number_of_vehicles << " (" << failed << " failed)"
+              << std::endl
+              << "duration:             " << duration_s << " s" << std::endl
+              << "threads baseline:     " << baseline.threads << std::endl
+              << "threads peak:         " << peak.threads << " (+" << extra_threads << ", "
+              << double(extra_threads) / number_of_vehicles << " per vehicle)" << std::endl
+              << "RSS baseline:         " << baseline.rss_kb << " kB" << std::endl
+              << "RSS peak:             " << peak.rss_kb << " kB (+"
+              << double(peak.rss_kb - baseline.rss_kb) / number_of_vehicles
+              << " kB per vehicle)" << std::endl
+              << "CPU:                  " << cpu_s << " s (" << cpu_s / number_of_vehicles * 1e3
+              << " ms per vehicle, " << cpu_s / duration_s * 100.0 << " % of one core)"
+              << std::endl;
+
+    return failed > 0 ? 1 : 0;
+}
@@ -6,24 +6,30 @@
 // Author: Shayaan Haider (via Slack)
 
 #include <mavsdk/mavsdk.h>
-#include <mavsdk/plugins/action/action.h>
-#include <mavsdk/plugins/telemetry/telemetry.h>
-#include <cstdint>
 #include <atomic>
-#include <iostream>
-#include <thread>
 #include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "console_renderer.h"
+#include "fleet_executor.h"
+#include "fleet_state.h"
+#include "system_discovery.h"
+#include "takeoff_land_script.h"
 
 using namespace mavsdk;
-using namespace std::this_thread;
 using namespace std::chrono;
 
-static void takeoff_and_land(std::shared_ptr<System> system);
-
 #define ERROR_CONSOLE_TEXT "\033[31m" // Turn text on console red
-#define TELEMETRY_CONSOLE_TEXT "\033[34m" // Turn text on console blue
 #define NORMAL_CONSOLE_TEXT "\033[0m" // Restore normal console colour
 
+static std::string fleet_summary(const FleetSnapshot& snapshot);
+
 int main(int argc, char* argv[])
 {
     if (argc == 1) {
@@ -46,107 +52,101 @@ int main(int argc, char* argv[])
         }
     }
 
-    std::atomic<size_t> num_systems_discovered{0};
-
     std::cout << "Waiting to discover system..." << std::endl;
-    mavsdk.subscribe_on_new_system([&mavsdk, &num_systems_discovered]() {
-        const auto systems = mavsdk.systems();
+    SystemDiscovery discovery(mavsdk);
 
-        if (systems.size() > num_systems_discovered) {
-            std::cout << "Discovered system" << std::endl;
-            num_systems_discovered = systems.size();
-        }
-    });
+    // Wakes up as soon as the last expected system is connected.
+    const bool all_systems_found =
+        discovery.wait_for_systems(total_udp_ports, SystemDiscovery::default_timeout);
 
-    // We usually receive heartbeats at 1Hz, therefore we should find a system after around 2
-    // seconds.
-    sleep_for(seconds(2));
+    for (const auto& discovered : discovery.discovered_systems()) {
+        std::cout << "Discovered system " << int(discovered.system_id) << " after "
+                  << discovered.time_to_discovery.count() << " ms" << std::endl;
+    }
 
-    if (num_systems_discovered != total_udp_ports) {
+    if (!all_systems_found) {
         std::cerr << ERROR_CONSOLE_TEXT << "Not all systems found, exiting." << NORMAL_CONSOLE_TEXT
                   << std::endl;
         return 1;
     }
 
-    std::vector<std::thread> threads;
-
-    for (auto system : mavsdk.systems()) {
-        std::thread t(&takeoff_and_land, std::ref(system));
-        threads.push_back(std::move(t));
-        sleep_for(seconds(1));
-    }
-
-    for (auto& t : threads) {
-        t.join();
+    // A port may bring more than one system, or none. Everything below is sized by the
+    // systems which get a script.
+    const auto systems = mavsdk.systems();
+
+    // Latest telemetry of all vehicles, for checks across the fleet.
+    FleetState fleet_state(systems.size());
+    FleetSnapshot snapshot;
+    std::function<void()> report_fleet;
+
+    // Progress of every vehicle as one table, redrawn at 10 Hz instead of printing a line
+    // per event. Nothing else may print to the console while it runs.
+    ConsoleRenderer console;
+
+    // All vehicles share a small pool of worker threads instead of one thread each.
+    FleetExecutor executor;
+    console.log(
+        "Running " + std::to_string(systems.size()) + " vehicles on " +
+        std::to_string(executor.worker_count()) + " worker threads");
+
+    std::atomic<size_t> remaining{systems.size()};
+    std::atomic<size_t> failed{0};
+    std::promise<void> all_done;
+
+    // Starts are still staggered a bit so not all vehicles send their commands at once.
+    const milliseconds stagger{100};
+    size_t index = 0;
+    for (auto system : systems) {
+        auto script = std::make_shared<TakeoffLandScript>(
+            executor, system, seconds(20), true, &fleet_state, &console);
+        executor.post_after(stagger * index++, [script, &remaining, &failed, &all_done]() {
+            script->start([&remaining, &failed, &all_done](bool success) {
+                if (!success) {
+                    ++failed;
+                }
+                if (--remaining == 0) {
+                    all_done.set_value();
+                }
+            });
+        });
     }
-    return 0;
-}
 
-void takeoff_and_land(std::shared_ptr<System> system)
-{
-    auto telemetry = std::make_shared<Telemetry>(system);
-    auto action = std::make_shared<Action>(system);
-
-    // We want to listen to the altitude of the drone at 1 Hz.
-    const Telemetry::Result set_rate_result = telemetry->set_rate_position(1.0);
-
-    if (set_rate_result != Telemetry::Result::Success) {
-        std::cerr << ERROR_CONSOLE_TEXT << "Setting rate failed:" << set_rate_result
-                  << NORMAL_CONSOLE_TEXT << std::endl;
-        return;
-    }
-
-    // Set up callback to monitor altitude while the vehicle is in flight
-    telemetry->subscribe_position([](Telemetry::Position position) {
-        std::cout << TELEMETRY_CONSOLE_TEXT // set to blue
-                  << "Altitude: " << position.relative_altitude_m << " m"
-                  << NORMAL_CONSOLE_TEXT // set to default color again
-                  << std::endl;
-    });
-
-    // Check if vehicle is ready to arm
-    while (telemetry->health_all_ok() != true) {
-        std::cout << "Vehicle is getting ready to arm" << std::endl;
-        sleep_for(seconds(1));
-    }
-
-    // Arm vehicle
-    std::cout << "Arming..." << std::endl;
-    const Action::Result arm_result = action->arm();
+    // The separation of the whole fleet, checked once per second on a worker.
+    const milliseconds report_interval{1000};
+    report_fleet = [&]() {
+        fleet_state.snapshot(snapshot);
+        console.set_summary(fleet_summary(snapshot));
+        if (remaining > 0) {
+            executor.post_after(report_interval, report_fleet);
+        }
+    };
+    executor.post_after(report_interval, report_fleet);
 
-    if (arm_result != Action::Result::Success) {
-        std::cerr << ERROR_CONSOLE_TEXT << "Arming failed:" << arm_result << NORMAL_CONSOLE_TEXT
-                  << std::endl;
-    }
+    all_done.get_future().wait();
+    // The report task refers to the state above.
+    executor.stop();
+    console.stop();
 
-    // Take off
-    std::cout << "Taking off..." << std::endl;
-    const Action::Result takeoff_result = action->takeoff();
-    if (takeoff_result != Action::Result::Success) {
-        std::cerr << ERROR_CONSOLE_TEXT << "Takeoff failed:" << takeoff_result
+    if (failed > 0) {
+        std::cerr << ERROR_CONSOLE_TEXT << failed << " vehicles did not finish"
                   << NORMAL_CONSOLE_TEXT << std::endl;
+        return 1;
     }
+    return 0;
+}
 
-    // Let it hover for a bit before landing again.
-    sleep_for(seconds(20));
-
-    std::cout << "Landing..." << std::endl;
-    const Action::Result land_result = action->land();
-    if (land_result != Action::Result::Success) {
-        std::cerr << ERROR_CONSOLE_TEXT << "Land failed:" << land_result << NORMAL_CONSOLE_TEXT
-                  << std::endl;
-    }
-
-    // Check if vehicle is still in air
-    while (telemetry->in_air()) {
-        std::cout << "Vehicle is landing..." << std::endl;
-        sleep_for(seconds(1));
+std::string fleet_summary(const FleetSnapshot& snapshot)
+{
+    const ClosestPair closest = find_closest_pair(snapshot);
+    if (closest.first == FleetState::no_slot) {
+        return std::string();
     }
-    std::cout << "Landed!" << std::endl;
-
-    // We are relying on auto-disarming but let's keep watching the telemetry for a bit longer.
 
-    sleep_for(seconds(5));
-    std::cout << "Finished..." << std::endl;
-    return;
+    std::stringstream ss;
+    ss.precision(1);
+    ss << std::fixed << "Closest: " << int(snapshot.system_id[closest.first]) << " and "
+       << int(snapshot.system_id[closest.second]) << " at " << closest.distance_m << " m ("
+       << closest.horizontal_distance_m << " m horizontal, " << closest.vertical_distance_m
+       << " m vertical)";
+    return ss.str();
 }
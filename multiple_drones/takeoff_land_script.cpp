@@ -0,0 +1,283 @@
+#include "takeoff_land_script.h"
+#include <iostream>
+#include <sstream>
+
+using namespace mavsdk;
+
+#define ERROR_CONSOLE_TEXT "\033[31m" // Turn text on console red
+#define TELEMETRY_CONSOLE_TEXT "\033[34m" // Turn text on console blue
+#define NORMAL_CONSOLE_TEXT "\033[0m" // Restore normal console colour
+
+namespace {
+
+constexpr std::chrono::milliseconds health_timeout{60000};
+constexpr std::chrono::milliseconds landing_timeout{120000};
+// We are relying on auto-disarming but let's keep watching the telemetry for a bit longer.
+constexpr std::chrono::milliseconds after_landing_time{5000};
+
+} // namespace
+
+TakeoffLandScript::TakeoffLandScript(
+    FleetExecutor& executor,
+    std::shared_ptr<System> system,
+    std::chrono::milliseconds hover_time,
+    bool verbose,
+    FleetState* fleet_state,
+    ConsoleRenderer* console) :
+    executor_(executor),
+    system_(system),
+    telemetry_(std::make_shared<Telemetry>(system)),
+    action_(std::make_shared<Action>(system)),
+    waiter_(std::make_shared<TelemetryWaiter>(telemetry_)),
+    system_id_(system->get_system_id()),
+    hover_time_(hover_time),
+    verbose_(verbose),
+    fleet_state_(fleet_state),
+    fleet_slot_(fleet_state ? fleet_state->add_system(system_id_) : FleetState::no_slot),
+    console_(console)
+{
+    if (fleet_state_ != nullptr && fleet_slot_ == FleetState::no_slot) {
+        log("Fleet state is full, not adding this vehicle", true);
+    }
+}
+
+void TakeoffLandScript::start(done_callback_t done_callback)
+{
+    done_callback_ = done_callback;
+
+    if (verbose_ || console_ != nullptr) {
+        // We want to listen to the altitude of the drone at 1 Hz.
+        const Telemetry::Result set_rate_result = telemetry_->set_rate_position(1.0);
+        if (set_rate_result != Telemetry::Result::Success) {
+            std::stringstream ss;
+            ss << "Setting rate failed:" << set_rate_result;
+            log(ss.str(), true);
+        }
+    }
+    subscribe_telemetry();
+
+    auto self = shared_from_this();
+    executor_.post([self]() { self->wait_for_health(); });
+}
+
+void TakeoffLandScript::wait_for_health()
+{
+    phase_ = Phase::WaitingForHealth;
+    log("Vehicle is getting ready to arm");
+
+    // Woken up by the health update instead of polling health_all_ok().
+    // A weak pointer avoids a cycle through the callback stored in the waiter.
+    std::weak_ptr<TakeoffLandScript> weak_self = shared_from_this();
+    waiter_->when(
+        [](const TelemetryWaiter::State& state) { return state.health_all_ok; },
+        [weak_self]() {
+            auto self = weak_self.lock();
+            if (self) {
+                self->on_healthy();
+            }
+        });
+
+    auto self = shared_from_this();
+    executor_.post_after(health_timeout, [self]() {
+        Phase expected = Phase::WaitingForHealth;
+        if (self->phase_.compare_exchange_strong(expected, Phase::Finished)) {
+            self->log("Vehicle did not get ready to arm", true);
+            self->finish(false);
+        }
+    });
+}
+
+void TakeoffLandScript::on_healthy()
+{
+    // Called on a MAVSDK thread, or right away if the vehicle is already healthy.
+    Phase expected = Phase::WaitingForHealth;
+    if (!phase_.compare_exchange_strong(expected, Phase::Arming)) {
+        return;
+    }
+
+    auto self = shared_from_this();
+    executor_.post([self]() { self->arm(); });
+}
+
+void TakeoffLandScript::arm()
+{
+    phase_ = Phase::Arming;
+    log("Arming...");
+
+    // The result arrives on a MAVSDK thread, the next step runs on the executor.
+    auto self = shared_from_this();
+    action_->arm_async([self](Action::Result result) {
+        self->executor_.post([self, result]() {
+            if (result != Action::Result::Success) {
+                std::stringstream ss;
+                ss << "Arming failed:" << result;
+                self->log(ss.str(), true);
+                self->finish(false);
+                return;
+            }
+            self->takeoff();
+        });
+    });
+}
+
+void TakeoffLandScript::takeoff()
+{
+    phase_ = Phase::TakingOff;
+    log("Taking off...");
+
+    auto self = shared_from_this();
+    action_->takeoff_async([self](Action::Result result) {
+        self->executor_.post([self, result]() {
+            if (result != Action::Result::Success) {
+                std::stringstream ss;
+                ss << "Takeoff failed:" << result;
+                self->log(ss.str(), true);
+                self->finish(false);
+                return;
+            }
+
+            // Let it hover for a bit before landing again.
+            self->phase_ = Phase::Hovering;
+            self->executor_.post_after(self->hover_time_, [self]() { self->land(); });
+        });
+    });
+}
+
+void TakeoffLandScript::land()
+{
+    phase_ = Phase::Landing;
+    log("Landing...");
+
+    auto self = shared_from_this();
+    action_->land_async([self](Action::Result result) {
+        if (result != Action::Result::Success) {
+            self->executor_.post([self, result]() {
+                Phase expected = Phase::Landing;
+                if (self->phase_.compare_exchange_strong(expected, Phase::Finished)) {
+                    std::stringstream ss;
+                    ss << "Land failed:" << result;
+                    self->log(ss.str(), true);
+                    self->finish(false);
+                }
+            });
+        }
+    });
+
+    // Landing is detected from telemetry instead of polling in_air() every second.
+    std::weak_ptr<TakeoffLandScript> weak_self = self;
+    waiter_->when(&TelemetryWaiter::is_landed, [weak_self]() {
+        auto self = weak_self.lock();
+        if (self) {
+            self->on_landed();
+        }
+    });
+
+    // Don't wait forever if the landed state never arrives.
+    executor_.post_after(landing_timeout, [self]() {
+        Phase expected = Phase::Landing;
+        if (self->phase_.compare_exchange_strong(expected, Phase::Finished)) {
+            self->log("Landing timed out", true);
+            self->finish(false);
+        }
+    });
+}
+
+void TakeoffLandScript::on_landed()
+{
+    // Called on a MAVSDK thread, unless the landing already failed or timed out.
+    Phase expected = Phase::Landing;
+    if (!phase_.compare_exchange_strong(expected, Phase::Finished)) {
+        return;
+    }
+
+    auto self = shared_from_this();
+    executor_.post([self]() {
+        self->log("Landed!");
+        self->executor_.post_after(after_landing_time, [self]() { self->finish(true); });
+    });
+}
+
+void TakeoffLandScript::subscribe_telemetry()
+{
+    FleetState* const fleet_state =
+        (fleet_slot_ != FleetState::no_slot) ? fleet_state_ : nullptr;
+    const size_t slot = fleet_slot_;
+
+    if (verbose_ || fleet_state != nullptr || console_ != nullptr) {
+        const uint8_t system_id = system_id_;
+        const bool verbose = verbose_;
+        ConsoleRenderer* const console = console_;
+        waiter_->subscribe_position(
+            [system_id, verbose, fleet_state, slot, console](Telemetry::Position position) {
+                if (fleet_state != nullptr) {
+                    fleet_state->update_position(slot, position);
+                }
+                if (console != nullptr) {
+                    console->set_position(
+                        system_id,
+                        position.latitude_deg,
+                        position.longitude_deg,
+                        position.relative_altitude_m);
+                } else if (verbose) {
+                    std::cout << TELEMETRY_CONSOLE_TEXT << "[" << int(system_id)
+                              << "] Altitude: " << position.relative_altitude_m << " m"
+                              << NORMAL_CONSOLE_TEXT << std::endl;
+                }
+            });
+    }
+
+    if (fleet_state != nullptr) {
+        telemetry_->subscribe_velocity_ned([fleet_state, slot](Telemetry::VelocityNed velocity) {
+            fleet_state->update_velocity(slot, velocity);
+        });
+        telemetry_->subscribe_attitude_euler(
+            [fleet_state, slot](Telemetry::EulerAngle attitude) {
+                fleet_state->update_attitude(slot, attitude);
+            });
+        telemetry_->subscribe_battery([fleet_state, slot](Telemetry::Battery battery) {
+            fleet_state->update_battery(slot, battery);
+        });
+    }
+}
+
+void TakeoffLandScript::unsubscribe_telemetry()
+{
+    waiter_->subscribe_position(nullptr);
+    if (fleet_slot_ != FleetState::no_slot) {
+        telemetry_->subscribe_velocity_ned(nullptr);
+        telemetry_->subscribe_attitude_euler(nullptr);
+        telemetry_->subscribe_battery(nullptr);
+    }
+}
+
+void TakeoffLandScript::finish(bool success)
+{
+    phase_ = Phase::Finished;
+
+    waiter_->cancel_all();
+    unsubscribe_telemetry();
+
+    log(success ? "Finished..." : "Aborted.", !success);
+
+    done_callback_t done_callback = std::move(done_callback_);
+    done_callback_ = nullptr;
+    if (done_callback) {
+        done_callback(success);
+    }
+}
+
+void TakeoffLandScript::log(const std::string& text, bool is_error) const
+{
+    if (console_ != nullptr) {
+        // The last step shows in the table, errors are kept above it as well.
+        console_->set_status(system_id_, text);
+        if (is_error) {
+            console_->log("[" + std::to_string(system_id_) + "] " + text, true);
+        }
+    } else if (is_error) {
+        std::cerr << ERROR_CONSOLE_TEXT << "[" << int(system_id_) << "] " << text
+                  << NORMAL_CONSOLE_TEXT << std::endl;
+    } else if (verbose_) {
+        std::cout << "[" << int(system_id_) << "] " << text << std::endl;
+    }
+}
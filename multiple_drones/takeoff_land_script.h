@@ -0,0 +1,72 @@
+#pragma once
+
+#include <mavsdk/mavsdk.h>
+#include <mavsdk/plugins/action/action.h>
+#include <mavsdk/plugins/telemetry/telemetry.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "console_renderer.h"
+#include "fleet_executor.h"
+#include "fleet_state.h"
+#include "telemetry_waiter.h"
+
+/**
+ * @brief The TakeoffLandScript class
+ * Arms, takes off, hovers, lands and waits for the vehicle to be on the ground, the same
+ * flight as the blocking takeoff_and_land() used to do, but written as a chain of
+ * FleetExecutor tasks so that hundreds of vehicles can share a few threads.
+ *
+ * Create it with std::make_shared. Pending tasks hold a reference, so the script stays
+ * alive until the done callback ran, even if the caller drops its pointer.
+ *
+ * With a FleetState, the telemetry of the vehicle is fed into it while the script runs.
+ * With a ConsoleRenderer, progress and position go into its table instead of printing a
+ * line for every step and every position update.
+ */
+class TakeoffLandScript : public std::enable_shared_from_this<TakeoffLandScript> {
+public:
+    typedef std::function<void(bool success)> done_callback_t;
+
+    TakeoffLandScript(
+        FleetExecutor& executor,
+        std::shared_ptr<mavsdk::System> system,
+        std::chrono::milliseconds hover_time,
+        bool verbose,
+        FleetState* fleet_state = nullptr,
+        ConsoleRenderer* console = nullptr);
+
+    void start(done_callback_t done_callback);
+
+private:
+    enum class Phase { Idle, WaitingForHealth, Arming, TakingOff, Hovering, Landing, Finished };
+
+    void wait_for_health();
+    void arm();
+    void takeoff();
+    void land();
+    void on_healthy();
+    void on_landed();
+    void subscribe_telemetry();
+    void unsubscribe_telemetry();
+    void finish(bool success);
+    void log(const std::string& text, bool is_error = false) const;
+
+    FleetExecutor& executor_;
+    std::shared_ptr<mavsdk::System> system_;
+    std::shared_ptr<mavsdk::Telemetry> telemetry_;
+    std::shared_ptr<mavsdk::Action> action_;
+    std::shared_ptr<TelemetryWaiter> waiter_;
+    const uint8_t system_id_;
+    const std::chrono::milliseconds hover_time_;
+    const bool verbose_;
+    FleetState* const fleet_state_;
+    const size_t fleet_slot_;
+    ConsoleRenderer* const console_;
+
+    std::atomic<Phase> phase_{Phase::Idle};
+    done_callback_t done_callback_{};
+};
@@ -3,14 +3,20 @@
 //
 // Author: Julian Oes <julian@oes.ch>
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <cstdlib>
 #include <mavsdk/mavsdk.h>
 #include <mavsdk/plugins/action/action.h>
 #include <mavsdk/plugins/telemetry/telemetry.h>
 #include <iostream>
+#include <map>
 #include <thread>
 
+#include "stream_profile.h"
+#include "system_discovery.h"
+
 using namespace mavsdk;
 using namespace std::this_thread;
 using namespace std::chrono;
@@ -21,12 +27,16 @@ using namespace std::chrono;
 
 void usage(std::string bin_name)
 {
-    std::cout << NORMAL_CONSOLE_TEXT << "Usage : " << bin_name << " <connection_url>" << std::endl
+    std::cout << NORMAL_CONSOLE_TEXT << "Usage : " << bin_name
+              << " <connection_url> [<profile_file> <profile_name> [duration_s]]" << std::endl
               << "Connection URL format should be :" << std::endl
               << " For TCP : tcp://[server_host][:server_port]" << std::endl
               << " For UDP : udp://[bind_host][:bind_port]" << std::endl
               << " For Serial : serial:///path/to/serial/dev[:baudrate]" << std::endl
-              << "For example, to connect to the simulator use URL: udp://:14540" << std::endl;
+              << "For example, to connect to the simulator use URL: udp://:14540" << std::endl
+              << "Profiles set the rates of several telemetry streams and report the achieved"
+              << " rates, e.g.:" << std::endl
+              << " " << bin_name << " udp://:14540 stream_profiles.conf control 30" << std::endl;
 }
 
 void component_discovered(ComponentType component_type)
@@ -35,21 +45,76 @@ void component_discovered(ComponentType component_type)
               << unsigned(component_type) << std::endl;
 }
 
+// Applies the profile and prints the achieved rates every few seconds and at the end.
+int run_profile(std::shared_ptr<Telemetry> telemetry, const StreamProfile& profile, int duration_s)
+{
+    StreamProfileEngine engine(telemetry);
+
+    std::cout << "Applying profile " << profile.name << " with " << profile.rates.size()
+              << " streams" << std::endl;
+    if (!engine.apply(profile)) {
+        std::cout << ERROR_CONSOLE_TEXT << "Not all rates could be set" << NORMAL_CONSOLE_TEXT
+                  << std::endl;
+    }
+
+    // Give the autopilot some time to change the rates before measuring.
+    sleep_for(seconds(1));
+    engine.reset_statistics();
+
+    const int report_interval_s = 5;
+    for (int elapsed_s = 0; elapsed_s < duration_s; elapsed_s += report_interval_s) {
+        sleep_for(seconds(std::min(report_interval_s, duration_s - elapsed_s)));
+        std::cout << TELEMETRY_CONSOLE_TEXT;
+        StreamProfileEngine::print_report(engine.report());
+        std::cout << NORMAL_CONSOLE_TEXT << std::endl;
+    }
+
+    engine.stop();
+    return 0;
+}
+
 int main(int argc, char** argv)
 {
     Mavsdk mavsdk;
     std::string connection_url;
     ConnectionResult connection_result;
 
-    bool discovered_system = false;
-    if (argc == 2) {
+    StreamProfile profile;
+    bool use_profile = false;
+    int duration_s = 10;
+
+    if (argc == 2 || argc == 4 || argc == 5) {
         connection_url = argv[1];
-        connection_result = mavsdk.add_any_connection(connection_url);
     } else {
         usage(argv[0]);
         return 1;
     }
 
+    if (argc >= 4) {
+        std::map<std::string, StreamProfile> profiles;
+        if (!load_stream_profiles(argv[2], profiles)) {
+            return 1;
+        }
+        const auto it = profiles.find(argv[3]);
+        if (it == profiles.end()) {
+            std::cout << ERROR_CONSOLE_TEXT << "Profile " << argv[3] << " not found in "
+                      << argv[2] << NORMAL_CONSOLE_TEXT << std::endl;
+            return 1;
+        }
+        profile = it->second;
+        use_profile = true;
+    }
+
+    if (argc == 5) {
+        duration_s = std::atoi(argv[4]);
+        if (duration_s <= 0) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    connection_result = mavsdk.add_any_connection(connection_url);
+
     if (connection_result != ConnectionResult::Success) {
         std::cout << ERROR_CONSOLE_TEXT << "Connection failed: " << connection_result
                   << NORMAL_CONSOLE_TEXT << std::endl;
@@ -57,26 +122,20 @@ int main(int argc, char** argv)
     }
 
     std::cout << "Waiting to discover system..." << std::endl;
-    mavsdk.subscribe_on_new_system([&mavsdk, &discovered_system]() {
-        const auto system = mavsdk.systems().at(0);
+    SystemDiscovery discovery(mavsdk);
 
-        if (system->is_connected()) {
-            std::cout << "Discovered system" << std::endl;
-            discovered_system = true;
-        }
-    });
-
-    // We usually receive heartbeats at 1Hz, therefore we should find a system after around 2
-    // seconds.
-    sleep_for(seconds(2));
-
-    if (!discovered_system) {
+    // Returns as soon as the system is connected instead of always waiting a fixed time.
+    if (!discovery.wait_for_systems(1, SystemDiscovery::default_timeout)) {
         std::cout << ERROR_CONSOLE_TEXT << "No system found, exiting." << NORMAL_CONSOLE_TEXT
                   << std::endl;
         return 1;
     }
 
-    const auto system = mavsdk.systems().at(0);
+    const auto discovered = discovery.discovered_systems().at(0);
+    std::cout << "Discovered system after " << discovered.time_to_discovery.count() << " ms"
+              << std::endl;
+
+    const auto system = discovered.system;
 
     // Register a callback so we get told when components (camera, gimbal) etc
     // are found.
@@ -85,6 +144,10 @@ int main(int argc, char** argv)
     auto telemetry = std::make_shared<Telemetry>(system);
     auto action = std::make_shared<Action>(system);
 
+    if (use_profile) {
+        return run_profile(telemetry, profile, duration_s);
+    }
+
     // We want to listen to the altitude of the drone at 1 Hz.
     const Telemetry::Result set_rate_result = telemetry->set_rate_position(1.0);
     if (set_rate_result != Telemetry::Result::Success) {
@@ -112,6 +175,6 @@ int main(int argc, char** argv)
     // Take off
 
     // Let it hover for a bit before landing again.
-    sleep_for(seconds(10));
+    sleep_for(seconds(duration_s));
     return 0;
 }
@@ -0,0 +1,353 @@
+#include "stream_profile.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+using namespace mavsdk;
+
+namespace {
+
+struct StreamName {
+    TelemetryStream stream;
+    const char* name;
+};
+
+const StreamName stream_names[] = {
+    {TelemetryStream::Position, "position"},
+    {TelemetryStream::Home, "home"},
+    {TelemetryStream::Attitude, "attitude"},
+    {TelemetryStream::VelocityNed, "velocity"},
+    {TelemetryStream::GpsInfo, "gps_info"},
+    {TelemetryStream::Battery, "battery"},
+    {TelemetryStream::RcStatus, "rc_status"},
+    {TelemetryStream::Imu, "imu"},
+    {TelemetryStream::LandedState, "landed_state"},
+};
+
+std::string trim(const std::string& str)
+{
+    size_t begin = 0;
+    size_t end = str.size();
+    while (begin < end && std::isspace(static_cast<unsigned char>(str[begin]))) {
+        ++begin;
+    }
+    while (end > begin && std::isspace(static_cast<unsigned char>(str[end - 1]))) {
+        --end;
+    }
+    return str.substr(begin, end - begin);
+}
+
+bool stream_from_name(const std::string& name, TelemetryStream& stream)
+{
+    for (const auto& stream_name : stream_names) {
+        if (name == stream_name.name) {
+            stream = stream_name.stream;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+const char* telemetry_stream_name(TelemetryStream stream)
+{
+    for (const auto& stream_name : stream_names) {
+        if (stream_name.stream == stream) {
+            return stream_name.name;
+        }
+    }
+    return "unknown";
+}
+
+bool load_stream_profiles(const std::string& path, std::map<std::string, StreamProfile>& profiles)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Could not open " << path << std::endl;
+        return false;
+    }
+
+    StreamProfile* current = nullptr;
+    std::string line;
+    unsigned line_number = 0;
+
+    while (std::getline(file, line)) {
+        ++line_number;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) {
+            continue;
+        }
+
+        if (line.front() == '[' && line.back() == ']') {
+            const std::string name = trim(line.substr(1, line.size() - 2));
+            current = &profiles[name];
+            current->name = name;
+            current->rates.clear();
+            continue;
+        }
+
+        const size_t equals = line.find('=');
+        TelemetryStream stream;
+        char* end = nullptr;
+        const std::string value =
+            (equals != std::string::npos) ? trim(line.substr(equals + 1)) : "";
+        const double rate_hz = std::strtod(value.c_str(), &end);
+
+        if (current == nullptr || equals == std::string::npos ||
+            !stream_from_name(trim(line.substr(0, equals)), stream) || value.empty() ||
+            *end != '\0' || rate_hz < 0.0) {
+            std::cerr << path << ":" << line_number << ": invalid line '" << line << "'"
+                      << std::endl;
+            return false;
+        }
+
+        // A stream listed twice keeps the last rate.
+        auto it = std::find_if(
+            current->rates.begin(),
+            current->rates.end(),
+            [stream](const StreamProfile::StreamRate& rate) { return rate.stream == stream; });
+        if (it != current->rates.end()) {
+            it->rate_hz = rate_hz;
+        } else {
+            current->rates.push_back(StreamProfile::StreamRate{stream, rate_hz});
+        }
+    }
+
+    return true;
+}
+
+void StreamProfileEngine::StreamStatistics::add_sample(std::chrono::steady_clock::time_point now)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (samples == 0) {
+        first_arrival = now;
+    } else {
+        const double interval_s = std::chrono::duration<double>(now - last_arrival).count();
+        const uint64_t intervals = samples;
+        const double delta = interval_s - interval_mean_s;
+        interval_mean_s += delta / intervals;
+        interval_m2 += delta * (interval_s - interval_mean_s);
+        interval_max_s = std::max(interval_max_s, interval_s);
+    }
+    last_arrival = now;
+    ++samples;
+}
+
+void StreamProfileEngine::StreamStatistics::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    samples = 0;
+    interval_mean_s = 0.0;
+    interval_m2 = 0.0;
+    interval_max_s = 0.0;
+}
+
+StreamProfileEngine::StreamProfileEngine(std::shared_ptr<Telemetry> telemetry) :
+    telemetry_(telemetry)
+{}
+
+StreamProfileEngine::~StreamProfileEngine()
+{
+    stop();
+}
+
+bool StreamProfileEngine::apply(const StreamProfile& profile)
+{
+    stop();
+
+    bool success = true;
+    for (const auto& rate : profile.rates) {
+        auto statistics = std::make_shared<StreamStatistics>();
+        statistics->stream = rate.stream;
+        statistics->requested_rate_hz = rate.rate_hz;
+        statistics->set_rate_result = set_rate(rate.stream, rate.rate_hz);
+        if (statistics->set_rate_result != Telemetry::Result::Success) {
+            std::cerr << "Setting rate of " << telemetry_stream_name(rate.stream) << " to "
+                      << rate.rate_hz << " Hz failed: " << statistics->set_rate_result
+                      << std::endl;
+            success = false;
+        }
+        statistics_.push_back(std::move(statistics));
+    }
+
+    for (const auto& statistics : statistics_) {
+        subscribe(statistics);
+    }
+    return success;
+}
+
+void StreamProfileEngine::stop()
+{
+    for (const auto& statistics : statistics_) {
+        unsubscribe(statistics->stream);
+    }
+    statistics_.clear();
+}
+
+void StreamProfileEngine::reset_statistics()
+{
+    for (auto& statistics : statistics_) {
+        statistics->reset();
+    }
+}
+
+std::vector<StreamProfileEngine::StreamReport> StreamProfileEngine::report() const
+{
+    std::vector<StreamReport> reports;
+
+    for (const auto& statistics : statistics_) {
+        std::lock_guard<std::mutex> lock(statistics->mutex);
+
+        StreamReport report{};
+        report.stream = statistics->stream;
+        report.requested_rate_hz = statistics->requested_rate_hz;
+        report.samples = statistics->samples;
+        report.set_rate_result = statistics->set_rate_result;
+
+        if (statistics->samples >= 2) {
+            const double duration_s = std::chrono::duration<double>(
+                                          statistics->last_arrival - statistics->first_arrival)
+                                          .count();
+            const uint64_t intervals = statistics->samples - 1;
+            report.achieved_rate_hz = duration_s > 0.0 ? intervals / duration_s : 0.0;
+            report.mean_interval_ms = statistics->interval_mean_s * 1e3;
+            report.jitter_ms =
+                intervals >= 2 ? std::sqrt(statistics->interval_m2 / (intervals - 1)) * 1e3 : 0.0;
+            report.max_interval_ms = statistics->interval_max_s * 1e3;
+        }
+        reports.push_back(report);
+    }
+    return reports;
+}
+
+void StreamProfileEngine::print_report(const std::vector<StreamReport>& report)
+{
+    std::printf(
+        "%-14s %10s %10s %9s %10s %10s %10s\n",
+        "stream",
+        "requested",
+        "achieved",
+        "samples",
+        "mean [ms]",
+        "jitter[ms]",
+        "max [ms]");
+
+    for (const auto& stream : report) {
+        std::printf(
+            "%-14s %8.1fHz %8.1fHz %9llu %10.2f %10.2f %10.2f%s\n",
+            telemetry_stream_name(stream.stream),
+            stream.requested_rate_hz,
+            stream.achieved_rate_hz,
+            static_cast<unsigned long long>(stream.samples),
+            stream.mean_interval_ms,
+            stream.jitter_ms,
+            stream.max_interval_ms,
+            stream.set_rate_result != Telemetry::Result::Success ? "  (set rate failed)" : "");
+    }
+}
+
+Telemetry::Result StreamProfileEngine::set_rate(TelemetryStream stream, double rate_hz)
+{
+    switch (stream) {
+        case TelemetryStream::Position:
+            return telemetry_->set_rate_position(rate_hz);
+        case TelemetryStream::Home:
+            return telemetry_->set_rate_home(rate_hz);
+        case TelemetryStream::Attitude:
+            return telemetry_->set_rate_attitude(rate_hz);
+        case TelemetryStream::VelocityNed:
+            return telemetry_->set_rate_velocity_ned(rate_hz);
+        case TelemetryStream::GpsInfo:
+            return telemetry_->set_rate_gps_info(rate_hz);
+        case TelemetryStream::Battery:
+            return telemetry_->set_rate_battery(rate_hz);
+        case TelemetryStream::RcStatus:
+            return telemetry_->set_rate_rc_status(rate_hz);
+        case TelemetryStream::Imu:
+            return telemetry_->set_rate_imu(rate_hz);
+        case TelemetryStream::LandedState:
+            return telemetry_->set_rate_landed_state(rate_hz);
+    }
+    return Telemetry::Result::Unknown;
+}
+
+void StreamProfileEngine::subscribe(std::shared_ptr<StreamStatistics> statistics)
+{
+    // The callbacks only take a timestamp, the content is not needed for the statistics.
+    // They keep the statistics alive, a callback MAVSDK already queued may run after stop().
+    const auto on_sample = [statistics]() {
+        statistics->add_sample(std::chrono::steady_clock::now());
+    };
+
+    switch (statistics->stream) {
+        case TelemetryStream::Position:
+            telemetry_->subscribe_position([on_sample](Telemetry::Position) { on_sample(); });
+            break;
+        case TelemetryStream::Home:
+            telemetry_->subscribe_home([on_sample](Telemetry::Position) { on_sample(); });
+            break;
+        case TelemetryStream::Attitude:
+            telemetry_->subscribe_attitude_euler(
+                [on_sample](Telemetry::EulerAngle) { on_sample(); });
+            break;
+        case TelemetryStream::VelocityNed:
+            telemetry_->subscribe_velocity_ned(
+                [on_sample](Telemetry::VelocityNed) { on_sample(); });
+            break;
+        case TelemetryStream::GpsInfo:
+            telemetry_->subscribe_gps_info([on_sample](Telemetry::GpsInfo) { on_sample(); });
+            break;
+        case TelemetryStream::Battery:
+            telemetry_->subscribe_battery([on_sample](Telemetry::Battery) { on_sample(); });
+            break;
+        case TelemetryStream::RcStatus:
+            telemetry_->subscribe_rc_status([on_sample](Telemetry::RcStatus) { on_sample(); });
+            break;
+        case TelemetryStream::Imu:
+            telemetry_->subscribe_imu([on_sample](Telemetry::Imu) { on_sample(); });
+            break;
+        case TelemetryStream::LandedState:
+            telemetry_->subscribe_landed_state(
+                [on_sample](Telemetry::LandedState) { on_sample(); });
+            break;
+    }
+}
+
+void StreamProfileEngine::unsubscribe(TelemetryStream stream)
+{
+    switch (stream) {
+        case TelemetryStream::Position:
+            telemetry_->subscribe_position(nullptr);
+            break;
+        case TelemetryStream::Home:
+            telemetry_->subscribe_home(nullptr);
+            break;
+        case TelemetryStream::Attitude:
+            telemetry_->subscribe_attitude_euler(nullptr);
+            break;
+        case TelemetryStream::VelocityNed:
+            telemetry_->subscribe_velocity_ned(nullptr);
+            break;
+        case TelemetryStream::GpsInfo:
+            telemetry_->subscribe_gps_info(nullptr);
+            break;
+        case TelemetryStream::Battery:
+            telemetry_->subscribe_battery(nullptr);
+            break;
+        case TelemetryStream::RcStatus:
+            telemetry_->subscribe_rc_status(nullptr);
+            break;
+        case TelemetryStream::Imu:
+            telemetry_->subscribe_imu(nullptr);
+            break;
+        case TelemetryStream::LandedState:
+            telemetry_->subscribe_landed_state(nullptr);
+            break;
+    }
+}
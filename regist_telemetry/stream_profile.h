@@ -0,0 +1,113 @@
+#pragma once
+
+#include <mavsdk/plugins/telemetry/telemetry.h>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Telemetry streams which can be configured in a profile.
+enum class TelemetryStream {
+    Position,
+    Home,
+    Attitude,
+    VelocityNed,
+    GpsInfo,
+    Battery,
+    RcStatus,
+    Imu,
+    LandedState
+};
+
+/**
+ * @brief A named set of requested telemetry rates.
+ */
+struct StreamProfile {
+    struct StreamRate {
+        TelemetryStream stream;
+        double rate_hz;
+    };
+
+    std::string name{};
+    std::vector<StreamRate> rates{};
+};
+
+// Loads all profiles from an ini-style file:
+//
+//   # comment
+//   [control]
+//   attitude = 100
+//   position = 10
+//
+// Returns false and prints the offending line if the file can't be parsed.
+bool load_stream_profiles(const std::string& path, std::map<std::string, StreamProfile>& profiles);
+
+const char* telemetry_stream_name(TelemetryStream stream);
+
+/**
+ * @brief The StreamProfileEngine class
+ * Sets the rates of a profile, subscribes to every stream in it and measures how often
+ * and how regularly each stream actually arrives.
+ */
+class StreamProfileEngine {
+public:
+    struct StreamReport {
+        TelemetryStream stream;
+        double requested_rate_hz;
+        double achieved_rate_hz;
+        uint64_t samples;
+        double mean_interval_ms;
+        // Standard deviation of the inter-arrival time.
+        double jitter_ms;
+        double max_interval_ms;
+        mavsdk::Telemetry::Result set_rate_result;
+    };
+
+    explicit StreamProfileEngine(std::shared_ptr<mavsdk::Telemetry> telemetry);
+
+    ~StreamProfileEngine();
+
+    // Replaces the current profile. Returns false if setting any of the rates failed,
+    // the streams are subscribed anyway.
+    bool apply(const StreamProfile& profile);
+
+    // Unsubscribes from all streams of the current profile.
+    void stop();
+
+    // Starts a new measurement window for all streams.
+    void reset_statistics();
+
+    std::vector<StreamReport> report() const;
+
+    static void print_report(const std::vector<StreamReport>& report);
+
+private:
+    // Running inter-arrival statistics, updated from the telemetry callbacks.
+    struct StreamStatistics {
+        TelemetryStream stream;
+        double requested_rate_hz;
+        mavsdk::Telemetry::Result set_rate_result;
+
+        mutable std::mutex mutex{};
+        uint64_t samples{0};
+        std::chrono::steady_clock::time_point first_arrival{};
+        std::chrono::steady_clock::time_point last_arrival{};
+        // Welford's algorithm for mean and variance of the intervals in seconds.
+        double interval_mean_s{0.0};
+        double interval_m2{0.0};
+        double interval_max_s{0.0};
+
+        void add_sample(std::chrono::steady_clock::time_point now);
+        void reset();
+    };
+
+    mavsdk::Telemetry::Result set_rate(TelemetryStream stream, double rate_hz);
+    void subscribe(std::shared_ptr<StreamStatistics> statistics);
+    void unsubscribe(TelemetryStream stream);
+
+    std::shared_ptr<mavsdk::Telemetry> telemetry_;
+    // Shared with the callbacks, which may still run after unsubscribing.
+    std::vector<std::shared_ptr<StreamStatistics>> statistics_{};
+};
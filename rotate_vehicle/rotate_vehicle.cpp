@@ -3,6 +3,7 @@
 //
 // Author: Julian Oes <julian@oes.ch>
 
+#include <cstdlib>
 #include <iostream>
 #include <thread>
 #include <chrono>
@@ -11,6 +12,9 @@
 #include <mavsdk/plugins/telemetry/telemetry.h>
 #include <mavsdk/plugins/offboard/offboard.h>
 
+#include "offboard_streamer.h"
+#include "system_discovery.h"
+
 using namespace mavsdk;
 // using namespace std::this_thread;
 // using namespace std::chrono;
@@ -30,203 +34,123 @@ inline void offboard_log(const std::string& offb_mode, const std::string msg)
     std::cout << "[" << offb_mode << "] " << msg << std::endl;
 }
 
-bool offboard_ctrl_body(std::shared_ptr<mavsdk::Offboard> offboard)
+// Starts offboard mode with the streamer already sending, plays the timeline and stops again.
+bool offboard_run_timeline(
+    std::shared_ptr<mavsdk::Offboard> offboard,
+    OffboardStreamer& streamer,
+    const std::string& offb_mode,
+    const OffboardTimeline& timeline)
 {
-    const std::string offb_mode = "BODY";
-
-    // Send it once before starting offboard, otherwise it will be rejected.
-    Offboard::VelocityBodyYawspeed stay{};
-    offboard->set_velocity_body(stay);
+    // Offboard is only accepted once setpoints arrive, so stream before starting it.
+    if (!streamer.start(timeline.segments().front().setpoint)) {
+        std::cerr << "Sending the first setpoint failed" << std::endl;
+        exit(EXIT_FAILURE);
+    }
 
     Offboard::Result offboard_result = offboard->start();
     offboard_error_exit(offboard_result, "Offboard start failed: ");
     offboard_log(offb_mode, "Offboard started");
 
-    offboard_log(offb_mode, "Turn clock-wise and climb");
+    streamer.reset_stats();
+    streamer.run(timeline, [&offb_mode](const OffboardTimeline::Segment& segment) {
+        offboard_log(offb_mode, segment.name);
+    });
+
+    // The streamer first, or its setpoints keep MAVSDK sending after offboard stopped.
+    streamer.stop();
+    offboard_result = offboard->stop();
+    offboard_error_exit(offboard_result, "Offboard stop failed: ");
+    offboard_log(offb_mode, "Offboard stopped");
+
+    OffboardStreamer::print_stats(streamer.stats());
+    return true;
+}
+
+bool offboard_ctrl_body(std::shared_ptr<mavsdk::Offboard> offboard, OffboardStreamer& streamer)
+{
+    using std::chrono::seconds;
+
+    Offboard::VelocityBodyYawspeed stay{};
+
     Offboard::VelocityBodyYawspeed cc_and_climb{};
     cc_and_climb.down_m_s = 1.0f;
     cc_and_climb.yawspeed_deg_s = 60.0f;
-    offboard->set_velocity_body(cc_and_climb);
-    std::this_thread::sleep_for(std::chrono::seconds(5));
-
-    offboard_log(offb_mode, "Turn back anti-clockwise");
-    cc_and_climb.down_m_s = -1.0f;
-    cc_and_climb.yawspeed_deg_s = -60.0f;
-    offboard->set_velocity_body(cc_and_climb);
-    std::this_thread::sleep_for(std::chrono::seconds(5));
 
-    offboard_log(offb_mode, "Turn back anti-clockwise");
     Offboard::VelocityBodyYawspeed ccw{};
     ccw.down_m_s = -1.0f;
     ccw.yawspeed_deg_s = -60.0f;
-    offboard->set_velocity_body(ccw);
-    std::this_thread::sleep_for(std::chrono::seconds(5));
-
-    offboard_log(offb_mode, "Wait for a bit");
-    offboard->set_velocity_body(stay);
-    std::this_thread::sleep_for(std::chrono::seconds(2));
 
-    offboard_log(offb_mode, "Fly a circle");
     Offboard::VelocityBodyYawspeed circle{};
     circle.forward_m_s = 5.0f;
     circle.yawspeed_deg_s = 30.0f;
-    offboard->set_velocity_body(circle);
-    std::this_thread::sleep_for(std::chrono::seconds(15));
 
-    offboard_log(offb_mode, "Wait for a bit");
-    offboard->set_velocity_body(stay);
-    std::this_thread::sleep_for(std::chrono::seconds(5));
-
-    offboard_log(offb_mode, "Fly a circle sideways");
-    circle.right_m_s = -5.0f;
-    circle.yawspeed_deg_s = 30.0f;
-    offboard->set_velocity_body(circle);
-    std::this_thread::sleep_for(std::chrono::seconds(15));
-
-    offboard_log(offb_mode, "Wait for a bit");
-    offboard->set_velocity_body(stay);
-    std::this_thread::sleep_for(std::chrono::seconds(8));
-
-    offboard_result = offboard->stop();
-    offboard_error_exit(offboard_result, "Offboard stop failed: ");
-    offboard_log(offb_mode, "Offboard stopped");
-
-    return true;
+    Offboard::VelocityBodyYawspeed circle_sideways = circle;
+    circle_sideways.right_m_s = -5.0f;
+
+    OffboardTimeline timeline;
+    timeline
+        .add("Turn clock-wise and climb", OffboardSetpoint::velocity_body(cc_and_climb), seconds(5))
+        .add("Turn back anti-clockwise", OffboardSetpoint::velocity_body(ccw), seconds(5))
+        .add("Turn back anti-clockwise", OffboardSetpoint::velocity_body(ccw), seconds(5))
+        .add("Wait for a bit", OffboardSetpoint::velocity_body(stay), seconds(2))
+        .add("Fly a circle", OffboardSetpoint::velocity_body(circle), seconds(15))
+        .add("Wait for a bit", OffboardSetpoint::velocity_body(stay), seconds(5))
+        .add("Fly a circle sideways", OffboardSetpoint::velocity_body(circle_sideways), seconds(15))
+        .add("Wait for a bit", OffboardSetpoint::velocity_body(stay), seconds(8));
+
+    return offboard_run_timeline(offboard, streamer, "BODY", timeline);
 }
 
-bool offboard_ctrl_attitude(std::shared_ptr<mavsdk::Offboard> offboard)
+bool offboard_ctrl_attitude(std::shared_ptr<mavsdk::Offboard> offboard, OffboardStreamer& streamer)
 {
-    const std::string offb_mode = "ATTITUDE";
+    using std::chrono::seconds;
 
-    // Send it once before starting offboard, otherwise it will be rejected.
     Offboard::Attitude roll{};
     roll.roll_deg = 80.0f;
     roll.thrust_value = 0.6f;
-    offboard->set_attitude(roll);
-
-    Offboard::Result offboard_result = offboard->start();
-    offboard_error_exit(offboard_result, "Offboard start failed");
-    offboard_log(offb_mode, "Offboard started");
 
-    offboard_log(offb_mode, "ROLL 30");
-    offboard->set_attitude(roll);
-    std::this_thread::sleep_for(std::chrono::seconds(2)); // rolling
+    Offboard::Attitude roll_back = roll;
+    roll_back.roll_deg = -30.0f;
 
-    offboard_log(offb_mode, "ROLL -30");
-    roll.roll_deg = -30.0f;
-    offboard->set_attitude(roll);
-    std::this_thread::sleep_for(std::chrono::seconds(2)); // Let yaw settle.
+    Offboard::Attitude level = roll;
+    level.roll_deg = 0.0f;
 
-    offboard_log(offb_mode, "ROLL 0");
-    roll.roll_deg = 0.0f;
-    offboard->set_attitude(roll);
-    std::this_thread::sleep_for(std::chrono::seconds(2)); // Let yaw settle.
+    OffboardTimeline timeline;
+    timeline.add("ROLL 30", OffboardSetpoint::attitude(roll), seconds(2)) // rolling
+        .add("ROLL -30", OffboardSetpoint::attitude(roll_back), seconds(2)) // Let yaw settle.
+        .add("ROLL 0", OffboardSetpoint::attitude(level), seconds(2)); // Let yaw settle.
 
-    // Now, stop offboard mode.
-    offboard_result = offboard->stop();
-    offboard_error_exit(offboard_result, "Offboard stop failed: ");
-    offboard_log(offb_mode, "Offboard stopped");
-
-    return true;
+    return offboard_run_timeline(offboard, streamer, "ATTITUDE", timeline);
 }
 
-bool offboard_ctrl_body_simple(std::shared_ptr<mavsdk::Offboard> offboard)
+bool offboard_ctrl_body_simple(
+    std::shared_ptr<mavsdk::Offboard> offboard, OffboardStreamer& streamer)
 {
-    const std::string offb_mode = "BODY";
-
-    // Send it once before starting offboard, otherwise it will be rejected.
     Offboard::VelocityBodyYawspeed control_stick{};
-    offboard->set_velocity_body(control_stick);
-
-    Offboard::Result offboard_result = offboard->start();
-    offboard_error_exit(offboard_result, "Offboard start failed: ");
-    offboard_log(offb_mode, "Offboard started");
-
-    offboard_log(offb_mode, "Turn clock-wise and climb");
     control_stick.down_m_s = 1.0f;
     control_stick.yawspeed_deg_s = 60.0f;
-    offboard->set_velocity_body(control_stick);
-    std::this_thread::sleep_for(std::chrono::seconds(10));
-
-    // offboard_log(offb_mode, "Turn back anti-clockwise");
-    // control_stick.down_m_s = -1.0f;
-    // control_stick.yawspeed_deg_s = -60.0f;
-    // offboard->set_velocity_body(control_stick);
-    // std::this_thread::sleep_for(std::chrono::seconds(5));
-
-    // offboard_log(offb_mode, "Turn back anti-clockwise");
-    // Offboard::VelocityBodyYawspeed ccw{};
-    // ccw.down_m_s = -1.0f;
-    // ccw.yawspeed_deg_s = -60.0f;
-    // offboard->set_velocity_body(ccw);
-    // std::this_thread::sleep_for(std::chrono::seconds(5));
-
-    // offboard_log(offb_mode, "Wait for a bit");
-    // offboard->set_velocity_body(stay);
-    // std::this_thread::sleep_for(std::chrono::seconds(2));
-
-    // offboard_log(offb_mode, "Fly a circle");
-    // Offboard::VelocityBodyYawspeed circle{};
-    // circle.forward_m_s = 5.0f;
-    // circle.yawspeed_deg_s = 30.0f;
-    // offboard->set_velocity_body(circle);
-    // std::this_thread::sleep_for(std::chrono::seconds(15));
-
-    // offboard_log(offb_mode, "Wait for a bit");
-    // offboard->set_velocity_body(stay);
-    // std::this_thread::sleep_for(std::chrono::seconds(5));
-
-    // offboard_log(offb_mode, "Fly a circle sideways");
-    // circle.right_m_s = -5.0f;
-    // circle.yawspeed_deg_s = 30.0f;
-    // offboard->set_velocity_body(circle);
-    // std::this_thread::sleep_for(std::chrono::seconds(15));
-
-    // offboard_log(offb_mode, "Wait for a bit");
-    // offboard->set_velocity_body(stay);
-    // std::this_thread::sleep_for(std::chrono::seconds(8));
 
-    offboard_result = offboard->stop();
-    offboard_error_exit(offboard_result, "Offboard stop failed: ");
-    offboard_log(offb_mode, "Offboard stopped");
+    OffboardTimeline timeline;
+    timeline.add(
+        "Turn clock-wise and climb",
+        OffboardSetpoint::velocity_body(control_stick),
+        std::chrono::seconds(10));
 
-    return true;
+    return offboard_run_timeline(offboard, streamer, "BODY", timeline);
 }
 
-bool offboard_ctrl_attitude_simple(std::shared_ptr<mavsdk::Offboard> offboard)
+bool offboard_ctrl_attitude_simple(
+    std::shared_ptr<mavsdk::Offboard> offboard, OffboardStreamer& streamer)
 {
-    const std::string offb_mode = "ATTITUDE";
-
-    // Send it once before starting offboard, otherwise it will be rejected.
     Offboard::Attitude control_stick{};
-    offboard->set_attitude(control_stick);
-
-    Offboard::Result offboard_result = offboard->start();
-    offboard_error_exit(offboard_result, "Offboard start failed");
-    offboard_log(offb_mode, "Offboard started");
-
-    offboard_log(offb_mode, "ROLL 40");
     control_stick.roll_deg = 40.0f;
     control_stick.thrust_value = 0.6f;
-    offboard->set_attitude(control_stick);
-    std::this_thread::sleep_for(std::chrono::seconds(2)); // rolling
-
-    // offboard_log(offb_mode, "ROLL -30");
-    // control_stick.roll_deg = -30.0f;
-    // offboard->set_attitude(control_stick);
-    // std::this_thread::sleep_for(std::chrono::seconds(2)); // Let yaw settle.
 
-    // offboard_log(offb_mode, "ROLL 0");
-    // control_stick.roll_deg = 0.0f;
-    // offboard->set_attitude(control_stick);
-    // std::this_thread::sleep_for(std::chrono::seconds(2)); // Let yaw settle.
-
-    // Now, stop offboard mode.
-    offboard_result = offboard->stop();
-    offboard_error_exit(offboard_result, "Offboard stop failed: ");
-    offboard_log(offb_mode, "Offboard stopped");
+    OffboardTimeline timeline;
+    timeline.add(
+        "ROLL 40", OffboardSetpoint::attitude(control_stick), std::chrono::seconds(2)); // rolling
 
-    return true;
+    return offboard_run_timeline(offboard, streamer, "ATTITUDE", timeline);
 }
 
 int main(int argc, char** argv)
@@ -234,39 +158,39 @@ int main(int argc, char** argv)
     Mavsdk mavsdk;
     ConnectionResult connection_result;
 
-    bool discovered_system = false;
-    if (argc == 2) {
+    // Setpoints are streamed at 50 Hz unless a rate is given, clamped to 50 - 250 Hz.
+    double setpoint_rate_hz = OffboardStreamer::min_rate_hz;
+
+    if (argc == 2 || argc == 3) {
         connection_result = mavsdk.add_any_connection(argv[1]);
     } else {
-        std::cout << "Need to Connection URL format" << std::endl;
+        std::cout << "Need to Connection URL format [setpoint_rate_hz]" << std::endl;
         return 1;
     }
 
+    if (argc == 3) {
+        setpoint_rate_hz = std::strtod(argv[2], nullptr);
+    }
+
     if (connection_result != ConnectionResult::Success) {
         std::cout << "Connection failed: " << std::endl;
         return 1;
     }
 
     std::cout << "Waiting to discover system..." << std::endl;
-    mavsdk.subscribe_on_new_system([&mavsdk, &discovered_system]() {
-        const auto system = mavsdk.systems().at(0);
+    SystemDiscovery discovery(mavsdk);
 
-        if (system->is_connected()) {
-            std::cout << "Discovered system" << std::endl;
-            discovered_system = true;
-        }
-    });
-
-    // We usually receive heartbeats at 1Hz, therefore we should find a system after around 2
-    // seconds.
-    std::this_thread::sleep_for(std::chrono::seconds(2));
-
-    if (!discovered_system) {
+    // Returns as soon as the system is connected instead of always waiting a fixed time.
+    if (!discovery.wait_for_systems(1, SystemDiscovery::default_timeout)) {
         std::cout << "No system found, exiting." << std::endl;
         return 1;
     }
 
-    const auto system = mavsdk.systems().at(0);
+    const auto discovered = discovery.discovered_systems().at(0);
+    std::cout << "Discovered system after " << discovered.time_to_discovery.count() << " ms"
+              << std::endl;
+
+    const auto system = discovered.system;
 
     // Register a callback so we get told when components (camera, gimbal) etc
     // are found.
@@ -315,30 +239,31 @@ int main(int argc, char** argv)
     // std::this_thread::sleep_for(std::chrono::seconds(10));      // As remove, Failed take off
 
     auto offboard = std::make_shared<Offboard>(system);
+    OffboardStreamer streamer(offboard, setpoint_rate_hz);
     //  using local NED co-ordinates
     bool ret = false;
 
-    // ret = offboard_ctrl_attitude(offboard);
+    // ret = offboard_ctrl_attitude(offboard, streamer);
     // if (ret == false) {
     //     return EXIT_FAILURE;
     // }
 
-    // ret = offboard_ctrl_body(offboard);
+    // ret = offboard_ctrl_body(offboard, streamer);
     // if (ret == false) {
     //     return EXIT_FAILURE;
     // }
 
-    // ret = offboard_ctrl_attitude_failedtakeoff(offboard);
+    // ret = offboard_ctrl_attitude_failedtakeoff(offboard, streamer);
     // if (ret == false) {
     //     return EXIT_FAILURE;
     // }
 
-    ret = offboard_ctrl_attitude_simple(offboard);
+    ret = offboard_ctrl_attitude_simple(offboard, streamer);
     if (ret == false) {
         return EXIT_FAILURE;
     }
 
-    ret = offboard_ctrl_body_simple(offboard);
+    ret = offboard_ctrl_body_simple(offboard, streamer);
     if (ret == false) {
         return EXIT_FAILURE;
     }
@@ -0,0 +1,170 @@
+#include "flight_cycle.h"
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace mavsdk;
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+constexpr size_t FlightCycle::phase_count;
+
+namespace {
+
+// Used if the vehicle doesn't tell us its takeoff altitude.
+constexpr float default_takeoff_altitude_m = 2.5f;
+
+} // namespace
+
+FlightCycle::FlightCycle(
+    std::shared_ptr<Action> action, TelemetryWaiter& waiter, const Config& config) :
+    action_(action),
+    waiter_(waiter),
+    config_(config),
+    takeoff_altitude_m_(default_takeoff_altitude_m)
+{
+    const auto takeoff_altitude = action_->get_takeoff_altitude();
+    if (takeoff_altitude.first == Action::Result::Success) {
+        takeoff_altitude_m_ = takeoff_altitude.second;
+    }
+}
+
+FlightCycle::Result FlightCycle::run()
+{
+    Result result{};
+    result.phase_durations.fill(milliseconds(0));
+
+    const auto start_time = steady_clock::now();
+    phase_ = Phase::Ready;
+    phase_start_ = start_time;
+
+    result.success = run_phases(result);
+    result.last_phase = phase_;
+    result.total = duration_cast<milliseconds>(steady_clock::now() - start_time);
+
+    if (!result.success) {
+        std::cerr << "[" << phase_name(phase_) << "] " << result.error << std::endl;
+    }
+    return result;
+}
+
+const char* FlightCycle::phase_name(Phase phase)
+{
+    switch (phase) {
+        case Phase::Ready:
+            return "ready";
+        case Phase::Armed:
+            return "armed";
+        case Phase::Climbing:
+            return "climbing";
+        case Phase::AtAltitude:
+            return "at altitude";
+        case Phase::Descending:
+            return "descending";
+        case Phase::Landed:
+            return "landed";
+        case Phase::Disarmed:
+            return "disarmed";
+    }
+    return "unknown";
+}
+
+bool FlightCycle::run_phases(Result& result)
+{
+    typedef TelemetryWaiter::State State;
+
+    // Ready is where every cycle starts, health is checked again in case it degraded.
+    if (!wait(Phase::Ready, [](const State& state) { return state.health_all_ok; }, result)) {
+        return false;
+    }
+
+    if (!command(action_->arm(), "Arming", result) ||
+        !wait(Phase::Armed, [](const State& state) { return state.armed; }, result)) {
+        return false;
+    }
+
+    if (!command(action_->takeoff(), "Takeoff", result) ||
+        !wait(Phase::Climbing, [](const State& state) { return state.in_air; }, result)) {
+        return false;
+    }
+
+    const float at_altitude_m = config_.altitude_fraction * takeoff_altitude_m_;
+    if (!wait(
+            Phase::AtAltitude,
+            [at_altitude_m](const State& state) {
+                return state.relative_altitude_m > at_altitude_m;
+            },
+            result)) {
+        return false;
+    }
+
+    std::this_thread::sleep_for(config_.hover_time);
+
+    if (!command(action_->land(), "Land", result)) {
+        return false;
+    }
+    enter(Phase::Descending, result);
+
+    if (!wait(Phase::Landed, &TelemetryWaiter::is_landed, result)) {
+        return false;
+    }
+
+    // We are relying on auto-disarming, and only disarm ourselves if it doesn't happen.
+    if (!waiter_.wait_for_disarmed(config_.auto_disarm_timeout).satisfied) {
+        if (config_.verbose) {
+            std::cout << "[" << phase_name(phase_) << "] no auto-disarm, disarming" << std::endl;
+        }
+        if (!command(action_->disarm(), "Disarming", result)) {
+            return false;
+        }
+    }
+    return wait(Phase::Disarmed, [](const State& state) { return !state.armed; }, result);
+}
+
+bool FlightCycle::wait(Phase next_phase, TelemetryWaiter::predicate_t predicate, Result& result)
+{
+    const auto wait_result = waiter_.wait_until(predicate, config_.phase_timeout);
+    if (!wait_result.satisfied) {
+        std::stringstream ss;
+        ss << "Not " << phase_name(next_phase) << ", "
+           << TelemetryWaiter::to_string(wait_result);
+        result.error = ss.str();
+        return false;
+    }
+
+    // Ready is where every cycle starts, waiting for it doesn't leave a phase.
+    if (next_phase != Phase::Ready) {
+        enter(next_phase, result);
+    } else if (config_.verbose) {
+        std::cout << "[" << phase_name(Phase::Ready) << "] health ok "
+                  << TelemetryWaiter::to_string(wait_result) << std::endl;
+    }
+    return true;
+}
+
+bool FlightCycle::command(Action::Result action_result, const char* what, Result& result)
+{
+    if (action_result != Action::Result::Success) {
+        std::stringstream ss;
+        ss << what << " failed: " << action_result;
+        result.error = ss.str();
+        return false;
+    }
+    return true;
+}
+
+void FlightCycle::enter(Phase phase, Result& result)
+{
+    const auto now = steady_clock::now();
+    const auto spent = duration_cast<milliseconds>(now - phase_start_);
+    result.phase_durations[static_cast<size_t>(phase_)] = spent;
+
+    if (config_.verbose) {
+        std::cout << "[" << phase_name(phase_) << " -> " << phase_name(phase) << "] after "
+                  << spent.count() << " ms" << std::endl;
+    }
+
+    phase_ = phase;
+    phase_start_ = now;
+}
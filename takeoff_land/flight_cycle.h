@@ -0,0 +1,72 @@
+#pragma once
+
+#include <mavsdk/plugins/action/action.h>
+#include <mavsdk/plugins/telemetry/telemetry.h>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "telemetry_waiter.h"
+
+/**
+ * @brief The FlightCycle class
+ * One takeoff and landing as a state machine. Each transition fires on a telemetry
+ * threshold instead of after a fixed sleep, so a cycle takes as long as the vehicle
+ * needs and not longer:
+ *
+ *   ready -> armed -> climbing -> at altitude -> descending -> landed -> disarmed
+ *
+ * The only fixed time is the configured hover at altitude.
+ */
+class FlightCycle {
+public:
+    enum class Phase { Ready, Armed, Climbing, AtAltitude, Descending, Landed, Disarmed };
+    static constexpr size_t phase_count = 7;
+
+    struct Config {
+        std::chrono::milliseconds hover_time{std::chrono::seconds(2)};
+        // At altitude once above this fraction of the takeoff altitude.
+        float altitude_fraction{0.9f};
+        std::chrono::milliseconds phase_timeout{std::chrono::seconds(60)};
+        // If auto-disarm doesn't happen within this time after landing we disarm.
+        std::chrono::milliseconds auto_disarm_timeout{std::chrono::seconds(10)};
+        bool verbose{true};
+    };
+
+    struct Result {
+        bool success;
+        // The phase the cycle got stuck in if it failed.
+        Phase last_phase;
+        std::string error;
+        // Time spent in each phase, indexed by Phase. Ready is the wait for health.
+        std::array<std::chrono::milliseconds, phase_count> phase_durations;
+        std::chrono::milliseconds total;
+    };
+
+    FlightCycle(
+        std::shared_ptr<mavsdk::Action> action, TelemetryWaiter& waiter, const Config& config);
+
+    // Blocks until the vehicle is disarmed on the ground again or something failed.
+    Result run();
+
+    float takeoff_altitude_m() const { return takeoff_altitude_m_; }
+
+    static const char* phase_name(Phase phase);
+
+private:
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    bool run_phases(Result& result);
+    bool wait(Phase next_phase, TelemetryWaiter::predicate_t predicate, Result& result);
+    bool command(mavsdk::Action::Result action_result, const char* what, Result& result);
+    void enter(Phase phase, Result& result);
+
+    std::shared_ptr<mavsdk::Action> action_;
+    TelemetryWaiter& waiter_;
+    const Config config_;
+    float takeoff_altitude_m_;
+
+    Phase phase_{Phase::Ready};
+    time_point phase_start_{};
+};
@@ -3,55 +3,111 @@
 //
 // Author: Julian Oes <julian@oes.ch>
 
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <numeric>
 #include <thread>
 #include <chrono>
+#include <vector>
 #include <mavsdk/mavsdk.h>
 #include <mavsdk/plugins/action/action.h>
 #include <mavsdk/plugins/telemetry/telemetry.h>
 
+#include "flight_cycle.h"
+#include "system_discovery.h"
+#include "telemetry_waiter.h"
+
 using namespace mavsdk;
 // using namespace std::this_thread;
 // using namespace std::chrono;
 
+// Cycle time distribution and the mean and max time spent in each phase.
+void print_soak_report(const std::vector<FlightCycle::Result>& results)
+{
+    std::vector<int64_t> totals_ms;
+    std::array<int64_t, FlightCycle::phase_count> phase_sum_ms{};
+    std::array<int64_t, FlightCycle::phase_count> phase_max_ms{};
+    for (const auto& result : results) {
+        if (!result.success) {
+            continue;
+        }
+        totals_ms.push_back(result.total.count());
+        for (size_t i = 0; i < FlightCycle::phase_count; ++i) {
+            phase_sum_ms[i] += result.phase_durations[i].count();
+            phase_max_ms[i] = std::max(phase_max_ms[i], result.phase_durations[i].count());
+        }
+    }
+
+    std::cout << "Soak: " << totals_ms.size() << " of " << results.size() << " cycles completed"
+              << std::endl;
+    if (totals_ms.empty()) {
+        return;
+    }
+
+    std::sort(totals_ms.begin(), totals_ms.end());
+    const auto percentile = [&totals_ms](double fraction) {
+        return totals_ms[static_cast<size_t>(fraction * (totals_ms.size() - 1))];
+    };
+    const int64_t sum_ms = std::accumulate(totals_ms.begin(), totals_ms.end(), int64_t(0));
+
+    std::cout << "Cycle time [ms]: min " << totals_ms.front() << ", p50 " << percentile(0.5)
+              << ", p90 " << percentile(0.9) << ", p99 " << percentile(0.99) << ", max "
+              << totals_ms.back() << ", mean " << sum_ms / int64_t(totals_ms.size()) << std::endl;
+
+    // Disarmed is where a cycle ends, no time is spent in it.
+    for (size_t i = 0; i + 1 < FlightCycle::phase_count; ++i) {
+        std::cout << "  " << std::left << std::setw(12)
+                  << FlightCycle::phase_name(static_cast<FlightCycle::Phase>(i)) << std::right
+                  << " mean " << std::setw(6) << phase_sum_ms[i] / int64_t(totals_ms.size())
+                  << " ms, max " << std::setw(6) << phase_max_ms[i] << " ms" << std::endl;
+    }
+}
+
 int main(int argc, char** argv)
 {
     Mavsdk mavsdk;
     ConnectionResult connection_result;
 
-    bool discovered_system = false;
-    if (argc == 2) {
+    // More than one cycle is a soak test which reports the cycle time distribution.
+    unsigned cycles = 1;
+    std::chrono::milliseconds hover_time{std::chrono::seconds(10)};
+
+    if (argc >= 2 && argc <= 4) {
         connection_result = mavsdk.add_any_connection(argv[1]);
     } else {
-        std::cout << "Need to Connection URL format" << std::endl;
+        std::cout << "Need to Connection URL format [cycles] [hover_s]" << std::endl;
         return 1;
     }
 
+    if (argc >= 3) {
+        cycles = static_cast<unsigned>(std::max(1, std::atoi(argv[2])));
+    }
+    if (argc == 4) {
+        hover_time = std::chrono::milliseconds(static_cast<int>(std::atof(argv[3]) * 1000.0));
+    }
+
     if (connection_result != ConnectionResult::Success) {
         std::cout << "Connection failed: " << std::endl;
         return 1;
     }
 
     std::cout << "Waiting to discover system..." << std::endl;
-    mavsdk.subscribe_on_new_system([&mavsdk, &discovered_system]() {
-        const auto system = mavsdk.systems().at(0);
+    SystemDiscovery discovery(mavsdk);
 
-        if (system->is_connected()) {
-            std::cout << "Discovered system" << std::endl;
-            discovered_system = true;
-        }
-    });
-
-    // We usually receive heartbeats at 1Hz, therefore we should find a system after around 2
-    // seconds.
-    std::this_thread::sleep_for(std::chrono::seconds(2));
-
-    if (!discovered_system) {
+    // Returns as soon as the system is connected instead of always waiting a fixed time.
+    if (!discovery.wait_for_systems(1, SystemDiscovery::default_timeout)) {
         std::cout << "No system found, exiting." << std::endl;
         return 1;
     }
 
-    const auto system = mavsdk.systems().at(0);
+    const auto discovered = discovery.discovered_systems().at(0);
+    std::cout << "Discovered system after " << discovered.time_to_discovery.count() << " ms"
+              << std::endl;
+
+    const auto system = discovered.system;
 
     // Register a callback so we get told when components (camera, gimbal) etc
     // are found.
@@ -61,62 +117,53 @@ int main(int argc, char** argv)
 
     auto telemetry = std::make_shared<Telemetry>(system);
 
-    // We want to listen to the altitude of the drone at 1 Hz.
-    const Telemetry::Result set_rate_result = telemetry->set_rate_position(1.0);
+    // The altitude thresholds of the flight phases would lag by up to a second at 1 Hz.
+    const Telemetry::Result set_rate_result = telemetry->set_rate_position(10.0);
     if (set_rate_result != Telemetry::Result::Success) {
         std::cout << "Setting rate failed:" << set_rate_result << std::endl;
         return 1;
     }
 
-    // Set up callback to monitor altitude while the vehicle is in flight
-    telemetry->subscribe_position([](Telemetry::Position position) {
-        std::cout << "Altitude: " << position.relative_altitude_m << " m" << std::endl;
-    });
-
-    // Check if vehicle is ready to arm
-    while (telemetry->health_all_ok() != true) {
-        std::cout << "Vehicle is getting ready to arm" << std::endl;
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+    TelemetryWaiter waiter(telemetry);
+
+    // Set up callback to monitor altitude while the vehicle is in flight, not in soak tests.
+    if (cycles == 1) {
+        unsigned position_count = 0;
+        waiter.subscribe_position([position_count](Telemetry::Position position) mutable {
+            // Still printed once a second.
+            if (position_count++ % 10 == 0) {
+                std::cout << "Altitude: " << position.relative_altitude_m << " m" << std::endl;
+            }
+        });
     }
 
-    // Arm vehicle
     auto action = std::make_shared<Action>(system);
-    std::cout << "Arming..." << std::endl;
-    const Action::Result arm_result = action->arm();
 
-    if (arm_result != Action::Result::Success) {
-        std::cout << "Arming failed:" << arm_result << std::endl;
-        return 1;
-    }
-
-    // Take off
-    std::cout << "Taking off..." << std::endl;
-    const Action::Result takeoff_result = action->takeoff();
-    if (takeoff_result != Action::Result::Success) {
-        std::cout << "Takeoff failed:" << takeoff_result << std::endl;
-        return 1;
-    }
-
-    // Let it hover for a bit before landing again.
-    std::this_thread::sleep_for(std::chrono::seconds(10));
-
-    std::cout << "Landing..." << std::endl;
-    const Action::Result land_result = action->land();
-    if (land_result != Action::Result::Success) {
-        std::cout << "Land failed:" << land_result << std::endl;
-        return 1;
+    FlightCycle::Config config;
+    config.hover_time = hover_time;
+    config.verbose = (cycles == 1);
+    FlightCycle flight_cycle(action, waiter, config);
+
+    std::cout << "Running " << cycles << " takeoff and land cycles to "
+              << flight_cycle.takeoff_altitude_m() << " m" << std::endl;
+
+    std::vector<FlightCycle::Result> results;
+    for (unsigned cycle = 0; cycle < cycles; ++cycle) {
+        results.push_back(flight_cycle.run());
+        const auto& result = results.back();
+        std::cout << "Cycle " << cycle + 1 << "/" << cycles << ": "
+                  << (result.success ? "done" : "failed") << " after " << result.total.count()
+                  << " ms" << std::endl;
+        if (!result.success) {
+            break;
+        }
     }
 
-    // Check if vehicle is still in air
-    while (telemetry->in_air()) {
-        std::cout << "Vehicle is landing..." << std::endl;
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+    if (cycles > 1) {
+        print_soak_report(results);
     }
-    std::cout << "Landed!" << std::endl;
 
-    // We are relying on auto-disarming but let's keep watching the telemetry for a bit longer.
-    std::this_thread::sleep_for(std::chrono::seconds(3));
     std::cout << "Finished..." << std::endl;
 
-    return 0;
+    return results.back().success ? 0 : 1;
 }
@@ -0,0 +1,106 @@
+//
+// Converts a binary telemetry log (e.g. written by fly_multiple_drones) to CSV.
+//
+// The columns are taken from the schema in the log header, so older and newer logs can
+// be converted with the same binary.
+//
+
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <string>
+
+#include "telemetry_log.h"
+
+static void usage(const std::string& bin_name)
+{
+    std::cout << "Usage : " << bin_name << " <log_file> [csv_file]" << std::endl
+              << "Writes to stdout if no csv file is given." << std::endl;
+}
+
+// Wall clock time with ms, e.g. 2020-06-01 12:00:00.123
+static void format_wall_clock(int64_t wall_clock_ns, char* buffer, size_t len)
+{
+    const time_t seconds = static_cast<time_t>(wall_clock_ns / 1000000000);
+    const int milliseconds = static_cast<int>((wall_clock_ns / 1000000) % 1000);
+    struct tm local_time {};
+    localtime_r(&seconds, &local_time);
+    const size_t written = strftime(buffer, len, "%Y-%m-%d %H:%M:%S", &local_time);
+    snprintf(buffer + written, len - written, ".%03d", milliseconds);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2 && argc != 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    TelemetryLogReader reader;
+    if (!reader.open(argv[1])) {
+        return 1;
+    }
+
+    FILE* out = stdout;
+    if (argc == 3) {
+        out = fopen(argv[2], "w");
+        if (out == nullptr) {
+            std::cerr << "Could not open " << argv[2] << std::endl;
+            return 1;
+        }
+    }
+
+    const TelemetryLogHeader& header = reader.header();
+
+    // Skip fields which don't fit into the record, the file is broken then.
+    size_t field_count = 0;
+    for (; field_count < header.field_count; ++field_count) {
+        if (header.fields[field_count].offset >= header.record_size) {
+            break;
+        }
+    }
+    if (field_count == 0) {
+        std::cerr << argv[1] << " has no usable fields" << std::endl;
+        return 1;
+    }
+
+    fputs("wall_clock", out);
+    for (size_t i = 0; i < field_count; ++i) {
+        fprintf(out, ",%.*s", int(sizeof(header.fields[i].name)), header.fields[i].name);
+    }
+    fputc('\n', out);
+
+    char wall_clock[64];
+    for (size_t i = 0; i < reader.size(); ++i) {
+        const uint8_t* record = reader.raw_record(i);
+
+        // The first field is always the monotonic timestamp.
+        const int64_t monotonic_ns = TelemetryLogReader::field_raw(header.fields[0], record);
+        format_wall_clock(
+            header.wall_clock_start_ns +
+                (monotonic_ns - static_cast<int64_t>(header.monotonic_start_ns)),
+            wall_clock,
+            sizeof(wall_clock));
+        fputs(wall_clock, out);
+
+        for (size_t j = 0; j < field_count; ++j) {
+            const TelemetryFieldDescriptor& field = header.fields[j];
+            if (field.scale == 1.0) {
+                fprintf(
+                    out,
+                    ",%lld",
+                    static_cast<long long>(TelemetryLogReader::field_raw(field, record)));
+            } else {
+                fprintf(out, ",%.7f", TelemetryLogReader::field_value(field, record));
+            }
+        }
+        fputc('\n', out);
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    std::cerr << "Converted " << reader.size() << " records." << std::endl;
+    return 0;
+}
@@ -0,0 +1,347 @@
+#include "replay_source.h"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+constexpr double earth_radius_m = 6371000.0;
+constexpr double degrees_to_radians = M_PI / 180.0;
+
+// Above this the made up vehicle counts as flying.
+constexpr int32_t in_air_altitude_mm = 500;
+
+constexpr uint8_t component_id = MAV_COMP_ID_AUTOPILOT1;
+
+bool ends_with(const std::string& text, const std::string& suffix)
+{
+    return text.size() >= suffix.size() &&
+           text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Header fields of a raw frame, without decoding it.
+struct FrameInfo {
+    uint8_t system_id;
+    uint32_t message_id;
+    const uint8_t* payload;
+    uint8_t payload_len;
+};
+
+FrameInfo frame_info(const uint8_t* frame)
+{
+    if (frame[0] == mavlink_v1_magic) {
+        return FrameInfo{frame[3], frame[5], frame + 6, frame[1]};
+    }
+    const uint32_t message_id = frame[7] | (frame[8] << 8) | (uint32_t(frame[9]) << 16);
+    return FrameInfo{frame[5], message_id, frame + 10, frame[1]};
+}
+
+// The time_boot_ms of the common messages which have one, -1 for all others. MAVLink 2
+// cuts trailing zeros off the payload, so a missing byte is a zero.
+int64_t frame_time_boot_ms(const FrameInfo& info)
+{
+    size_t offset;
+    switch (info.message_id) {
+        case MAVLINK_MSG_ID_ATTITUDE:
+        case MAVLINK_MSG_ID_LOCAL_POSITION_NED:
+        case MAVLINK_MSG_ID_GLOBAL_POSITION_INT:
+            offset = 0;
+            break;
+        case MAVLINK_MSG_ID_SYSTEM_TIME:
+            offset = 8;
+            break;
+        default:
+            return -1;
+    }
+    uint32_t time_boot_ms = 0;
+    for (size_t i = 0; i < 4 && offset + i < info.payload_len; ++i) {
+        time_boot_ms |= uint32_t(info.payload[offset + i]) << (8 * i);
+    }
+    return time_boot_ms;
+}
+
+size_t serialize(mavlink_message_t& message, uint8_t* buffer, size_t len)
+{
+    uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+    const uint16_t frame_len = mavlink_msg_to_send_buffer(frame, &message);
+    if (frame_len > len) {
+        return 0;
+    }
+    memcpy(buffer, frame, frame_len);
+    return frame_len;
+}
+
+} // namespace
+
+std::unique_ptr<ReplaySource> ReplaySource::open(const std::string& path, uint8_t channel)
+{
+    if (ends_with(path, ".tlog")) {
+        TlogReplaySource* tlog_source = new TlogReplaySource();
+        std::unique_ptr<ReplaySource> source(tlog_source);
+        if (!tlog_source->open(path)) {
+            return nullptr;
+        }
+        return source;
+    }
+
+    TelemetryLogReplaySource* log_source = new TelemetryLogReplaySource(channel);
+    std::unique_ptr<ReplaySource> source(log_source);
+    if (!log_source->open(path)) {
+        return nullptr;
+    }
+    return source;
+}
+
+bool TlogReplaySource::open(const std::string& path)
+{
+    if (!reader_.open(path)) {
+        return false;
+    }
+
+    // The vehicle is whoever sends the first heartbeat which isn't from a ground station.
+    TlogEntry entry;
+    while (system_id_ == 0 && reader_.next(entry)) {
+        const FrameInfo info = frame_info(entry.frame);
+        if (info.message_id == MAVLINK_MSG_ID_HEARTBEAT && info.payload[4] != MAV_TYPE_GCS) {
+            system_id_ = info.system_id;
+        }
+    }
+    reader_.rewind();
+
+    if (system_id_ == 0) {
+        std::cerr << path << " has no vehicle heartbeat" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool TlogReplaySource::next(Event& event)
+{
+    TlogEntry entry;
+    while (reader_.next(entry)) {
+        const FrameInfo info = frame_info(entry.frame);
+        if (info.message_id == MAVLINK_MSG_ID_HEARTBEAT && info.payload[4] == MAV_TYPE_GCS) {
+            is_ground_station_[info.system_id] = true;
+        }
+        if (is_ground_station_[info.system_id]) {
+            continue;
+        }
+
+        event.time_us = entry.time_us;
+        event.time_boot_ms = (info.system_id == system_id_) ? frame_time_boot_ms(info) : -1;
+        event.data = entry.frame;
+        event.len = entry.frame_len;
+        return true;
+    }
+    return false;
+}
+
+bool TelemetryLogReplaySource::open(const std::string& path)
+{
+    if (!reader_.open(path)) {
+        return false;
+    }
+    if (reader_.size() == 0) {
+        std::cerr << path << " has no records" << std::endl;
+        return false;
+    }
+
+    time_field_ = find_field("time_ns");
+    time_boot_field_ = find_field("time_boot_ms");
+    latitude_field_ = find_field("latitude_deg");
+    longitude_field_ = find_field("longitude_deg");
+    absolute_altitude_field_ = find_field("absolute_altitude_m");
+    relative_altitude_field_ = find_field("relative_altitude_m");
+    if (time_field_ == nullptr || latitude_field_ == nullptr || longitude_field_ == nullptr ||
+        absolute_altitude_field_ == nullptr || relative_altitude_field_ == nullptr) {
+        std::cerr << path << " doesn't have the position fields" << std::endl;
+        return false;
+    }
+
+    const uint8_t* first_record = reader_.raw_record(0);
+    const TelemetryFieldDescriptor* system_id_field = find_field("system_id");
+    if (system_id_field != nullptr) {
+        system_id_ = static_cast<uint8_t>(
+            TelemetryLogReader::field_raw(*system_id_field, first_record));
+    }
+    first_time_ns_ =
+        static_cast<uint64_t>(TelemetryLogReader::field_raw(*time_field_, first_record));
+
+    home_ = read_sample(0);
+    return true;
+}
+
+const TelemetryFieldDescriptor* TelemetryLogReplaySource::find_field(const char* name) const
+{
+    const TelemetryLogHeader& header = reader_.header();
+    for (size_t i = 0; i < header.field_count; ++i) {
+        const TelemetryFieldDescriptor& field = header.fields[i];
+        if (strncmp(field.name, name, sizeof(field.name)) == 0 &&
+            field.offset < header.record_size) {
+            return &field;
+        }
+    }
+    return nullptr;
+}
+
+TelemetryLogReplaySource::Sample TelemetryLogReplaySource::read_sample(size_t index) const
+{
+    const uint8_t* record = reader_.raw_record(index);
+
+    // Raw values are already in the MAVLink units, only the scale differs.
+    Sample sample{};
+    sample.time_ns = static_cast<uint64_t>(TelemetryLogReader::field_raw(*time_field_, record));
+    sample.latitude_e7 =
+        static_cast<int32_t>(TelemetryLogReader::field_raw(*latitude_field_, record));
+    sample.longitude_e7 =
+        static_cast<int32_t>(TelemetryLogReader::field_raw(*longitude_field_, record));
+    sample.absolute_altitude_mm =
+        static_cast<int32_t>(TelemetryLogReader::field_raw(*absolute_altitude_field_, record));
+    sample.relative_altitude_mm =
+        static_cast<int32_t>(TelemetryLogReader::field_raw(*relative_altitude_field_, record));
+
+    // Logs without vehicle time use the time since the first record.
+    if (time_boot_field_ != nullptr) {
+        sample.time_boot_ms =
+            static_cast<uint32_t>(TelemetryLogReader::field_raw(*time_boot_field_, record));
+    }
+    if (sample.time_boot_ms == 0) {
+        sample.time_boot_ms = static_cast<uint32_t>((sample.time_ns - first_time_ns_) / 1000000);
+    }
+    return sample;
+}
+
+bool TelemetryLogReplaySource::next(Event& event)
+{
+    if (next_index_ >= reader_.size()) {
+        return false;
+    }
+
+    const Sample sample = read_sample(next_index_++);
+
+    // The log has no velocity, it is the difference to the previous sample.
+    float velocity_m_s[3]{};
+    if (has_last_sample_ && sample.time_ns > last_sample_.time_ns) {
+        const double dt_s = (sample.time_ns - last_sample_.time_ns) * 1e-9;
+        const double latitude_rad = sample.latitude_e7 * 1e-7 * degrees_to_radians;
+        velocity_m_s[0] = static_cast<float>(
+            (sample.latitude_e7 - last_sample_.latitude_e7) * 1e-7 * degrees_to_radians *
+            earth_radius_m / dt_s);
+        velocity_m_s[1] = static_cast<float>(
+            (sample.longitude_e7 - last_sample_.longitude_e7) * 1e-7 * degrees_to_radians *
+            earth_radius_m * std::cos(latitude_rad) / dt_s);
+        velocity_m_s[2] = static_cast<float>(
+            -(sample.relative_altitude_mm - last_sample_.relative_altitude_mm) * 1e-3 / dt_s);
+    }
+    has_last_sample_ = true;
+    last_sample_ = sample;
+
+    float heading_deg = std::atan2(velocity_m_s[1], velocity_m_s[0]) / degrees_to_radians;
+    if (heading_deg < 0.0f) {
+        heading_deg += 360.0f;
+    }
+
+    mavlink_global_position_int_t global_position_int{};
+    global_position_int.time_boot_ms = sample.time_boot_ms;
+    global_position_int.lat = sample.latitude_e7;
+    global_position_int.lon = sample.longitude_e7;
+    global_position_int.alt = sample.absolute_altitude_mm;
+    global_position_int.relative_alt = sample.relative_altitude_mm;
+    global_position_int.vx = static_cast<int16_t>(velocity_m_s[0] * 100.0f);
+    global_position_int.vy = static_cast<int16_t>(velocity_m_s[1] * 100.0f);
+    global_position_int.vz = static_cast<int16_t>(velocity_m_s[2] * 100.0f);
+    global_position_int.hdg = static_cast<uint16_t>(heading_deg * 100.0f) % 36000;
+
+    buffer_.clear();
+    mavlink_message_t message;
+    mavlink_msg_global_position_int_encode_chan(
+        system_id_, component_id, channel_, &message, &global_position_int);
+    append(message);
+
+    event.time_us = sample.time_ns / 1000;
+    event.time_boot_ms = sample.time_boot_ms;
+    event.data = buffer_.data();
+    event.len = buffer_.size();
+    return true;
+}
+
+size_t TelemetryLogReplaySource::heartbeat_frames(uint8_t* buffer, size_t len)
+{
+    const Sample& sample = has_last_sample_ ? last_sample_ : home_;
+    const bool flying = in_air();
+    size_t written = 0;
+    mavlink_message_t message;
+
+    mavlink_heartbeat_t heartbeat{};
+    heartbeat.type = MAV_TYPE_QUADROTOR;
+    heartbeat.autopilot = MAV_AUTOPILOT_PX4;
+    heartbeat.base_mode = MAV_MODE_FLAG_CUSTOM_MODE_ENABLED;
+    if (flying) {
+        heartbeat.base_mode |= MAV_MODE_FLAG_SAFETY_ARMED;
+    }
+    heartbeat.system_status = flying ? MAV_STATE_ACTIVE : MAV_STATE_STANDBY;
+    heartbeat.mavlink_version = 3;
+    mavlink_msg_heartbeat_encode_chan(system_id_, component_id, channel_, &message, &heartbeat);
+    written += serialize(message, buffer + written, len - written);
+
+    const uint32_t sensors = MAV_SYS_STATUS_SENSOR_3D_GYRO | MAV_SYS_STATUS_SENSOR_3D_ACCEL |
+                             MAV_SYS_STATUS_SENSOR_3D_MAG | MAV_SYS_STATUS_SENSOR_ABSOLUTE_PRESSURE |
+                             MAV_SYS_STATUS_SENSOR_GPS | MAV_SYS_STATUS_AHRS |
+                             MAV_SYS_STATUS_PREARM_CHECK;
+    mavlink_sys_status_t sys_status{};
+    sys_status.onboard_control_sensors_present = sensors;
+    sys_status.onboard_control_sensors_enabled = sensors;
+    sys_status.onboard_control_sensors_health = sensors;
+    sys_status.voltage_battery = 16000;
+    sys_status.current_battery = -1;
+    sys_status.battery_remaining = -1;
+    mavlink_msg_sys_status_encode_chan(system_id_, component_id, channel_, &message, &sys_status);
+    written += serialize(message, buffer + written, len - written);
+
+    mavlink_extended_sys_state_t extended_sys_state{};
+    extended_sys_state.vtol_state = MAV_VTOL_STATE_UNDEFINED;
+    extended_sys_state.landed_state =
+        flying ? MAV_LANDED_STATE_IN_AIR : MAV_LANDED_STATE_ON_GROUND;
+    mavlink_msg_extended_sys_state_encode_chan(
+        system_id_, component_id, channel_, &message, &extended_sys_state);
+    written += serialize(message, buffer + written, len - written);
+
+    mavlink_gps_raw_int_t gps_raw_int{};
+    gps_raw_int.time_usec = uint64_t(sample.time_boot_ms) * 1000;
+    gps_raw_int.lat = sample.latitude_e7;
+    gps_raw_int.lon = sample.longitude_e7;
+    gps_raw_int.alt = sample.absolute_altitude_mm;
+    gps_raw_int.eph = 80;
+    gps_raw_int.epv = 120;
+    gps_raw_int.vel = UINT16_MAX;
+    gps_raw_int.cog = UINT16_MAX;
+    gps_raw_int.fix_type = GPS_FIX_TYPE_3D_FIX;
+    gps_raw_int.satellites_visible = 12;
+    mavlink_msg_gps_raw_int_encode_chan(system_id_, component_id, channel_, &message, &gps_raw_int);
+    written += serialize(message, buffer + written, len - written);
+
+    // Home is where the recording starts.
+    mavlink_home_position_t home_position{};
+    home_position.latitude = home_.latitude_e7;
+    home_position.longitude = home_.longitude_e7;
+    home_position.altitude = home_.absolute_altitude_mm - home_.relative_altitude_mm;
+    home_position.q[0] = 1.0f;
+    home_position.time_usec = gps_raw_int.time_usec;
+    mavlink_msg_home_position_encode_chan(
+        system_id_, component_id, channel_, &message, &home_position);
+    written += serialize(message, buffer + written, len - written);
+
+    return written;
+}
+
+bool TelemetryLogReplaySource::in_air() const
+{
+    return has_last_sample_ && last_sample_.relative_altitude_mm > in_air_altitude_mm;
+}
+
+void TelemetryLogReplaySource::append(mavlink_message_t& message)
+{
+    uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+    const uint16_t frame_len = mavlink_msg_to_send_buffer(frame, &message);
+    buffer_.insert(buffer_.end(), frame, frame + frame_len);
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+// Only used for the MAVLink message definitions which ship with MAVSDK.
+#include <mavsdk/plugins/mavlink_passthrough/mavlink_passthrough.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "telemetry_log.h"
+#include "tlog.h"
+
+/**
+ * @brief The ReplaySource class
+ * A recording turned back into MAVLink frames, one event at a time, each with the time it
+ * was recorded at. The frames of an event are ready to send as they are.
+ */
+class ReplaySource {
+public:
+    struct Event {
+        uint64_t time_us;
+        // The vehicle time since boot the event carries, -1 if it has none.
+        int64_t time_boot_ms;
+        // Valid until the next call of next().
+        const uint8_t* data;
+        size_t len;
+    };
+
+    virtual ~ReplaySource() = default;
+
+    // False at the end of the recording.
+    virtual bool next(Event& event) = 0;
+
+    // System id of the replayed vehicle, used to answer commands.
+    virtual uint8_t system_id() const = 0;
+
+    // Frames which need to go out every second of wall clock time no matter how fast the
+    // recording is replayed, so the vehicle doesn't time out. Returns the bytes written.
+    virtual size_t heartbeat_frames(uint8_t* /* buffer */, size_t /* len */) { return 0; }
+
+    // Picks the source by file extension: .tlog for raw MAVLink, anything else is taken
+    // as a binary telemetry log. Returns nullptr if the file can't be used.
+    static std::unique_ptr<ReplaySource> open(const std::string& path, uint8_t channel);
+};
+
+/**
+ * @brief The TlogReplaySource class
+ * Sends the captured frames unchanged, including their sequence numbers and checksums.
+ * Frames of ground stations (anything that sent a GCS heartbeat) are left out, they were
+ * sent to the vehicle and not by it.
+ */
+class TlogReplaySource : public ReplaySource {
+public:
+    bool open(const std::string& path);
+
+    bool next(Event& event) override;
+
+    uint8_t system_id() const override { return system_id_; }
+
+    uint64_t skipped_bytes() const { return reader_.skipped_bytes(); }
+
+private:
+    TlogReader reader_{};
+    uint8_t system_id_{0};
+    bool is_ground_station_[256]{};
+};
+
+/**
+ * @brief The TelemetryLogReplaySource class
+ * Makes up a vehicle from the position samples of a binary telemetry log: every record
+ * becomes a GLOBAL_POSITION_INT, and heartbeat, status and GPS messages are added so
+ * MAVSDK takes it for a healthy vehicle. It is armed and in air while above ground.
+ *
+ * Fields are looked up by name in the log header, so older logs work as well.
+ */
+class TelemetryLogReplaySource : public ReplaySource {
+public:
+    explicit TelemetryLogReplaySource(uint8_t channel) : channel_(channel) {}
+
+    bool open(const std::string& path);
+
+    bool next(Event& event) override;
+
+    uint8_t system_id() const override { return system_id_; }
+
+    size_t heartbeat_frames(uint8_t* buffer, size_t len) override;
+
+private:
+    struct Sample {
+        uint64_t time_ns;
+        uint32_t time_boot_ms;
+        int32_t latitude_e7;
+        int32_t longitude_e7;
+        int32_t absolute_altitude_mm;
+        int32_t relative_altitude_mm;
+    };
+
+    const TelemetryFieldDescriptor* find_field(const char* name) const;
+    Sample read_sample(size_t index) const;
+    bool in_air() const;
+    void append(mavlink_message_t& message);
+
+    const uint8_t channel_;
+    TelemetryLogReader reader_{};
+    size_t next_index_{0};
+    uint8_t system_id_{1};
+    uint64_t first_time_ns_{0};
+
+    const TelemetryFieldDescriptor* time_field_{nullptr};
+    const TelemetryFieldDescriptor* time_boot_field_{nullptr};
+    const TelemetryFieldDescriptor* latitude_field_{nullptr};
+    const TelemetryFieldDescriptor* longitude_field_{nullptr};
+    const TelemetryFieldDescriptor* absolute_altitude_field_{nullptr};
+    const TelemetryFieldDescriptor* relative_altitude_field_{nullptr};
+
+    bool has_last_sample_{false};
+    Sample home_{};
+    Sample last_sample_{};
+    std::vector<uint8_t> buffer_{};
+};
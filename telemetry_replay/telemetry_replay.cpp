@@ -0,0 +1,303 @@
+//
+// Replays recorded flights as fake vehicles on UDP, to load test the examples with real
+// traffic patterns without flying.
+//
+// Binary telemetry logs (e.g. written by fly_multiple_drones) and raw MAVLink captures
+// (.tlog) can be replayed, in real time or faster. Like the mock autopilot, every file
+// becomes one vehicle sending to <remote_port> + index, so `udp://:14540`, `udp://:14541`
+// etc. can be used to connect to them.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "replay_source.h"
+#include "udp_socket.h"
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+std::atomic<bool> should_exit{false};
+
+constexpr double max_speed = 100.0;
+
+// Frames that are due at the same time are sent together, up to this size.
+constexpr size_t max_datagram_size = 1400;
+
+constexpr std::chrono::seconds heartbeat_interval{1};
+
+struct ReplayStats {
+    uint64_t events{0};
+    uint64_t datagrams{0};
+    uint64_t bytes{0};
+    uint64_t commands_answered{0};
+    // How far behind the schedule the replay fell, in wall clock time.
+    microseconds max_lateness{0};
+    double recorded_s{0.0};
+    double replayed_s{0.0};
+};
+
+void signal_handler(int)
+{
+    should_exit = true;
+}
+
+void usage(const std::string& bin_name)
+{
+    std::cout << "Usage : " << bin_name << " <remote_port> <speed> <file> [file...]" << std::endl
+              << "Speed is a factor of real time, up to " << max_speed << "." << std::endl
+              << "Files ending in .tlog are replayed as raw MAVLink, others are taken as"
+              << " telemetry logs." << std::endl
+              << "For example, to replay two logs ten times faster for multiple_drones:"
+              << std::endl
+              << "  " << bin_name << " 14540 10 1.tlm 2.tlm" << std::endl;
+}
+
+// Answers commands and timesync requests, otherwise MAVSDK keeps retrying them and the
+// examples fail on e.g. setting the telemetry rates. Timesync is answered in the recorded
+// vehicle clock, the one of the time_boot_ms in the replayed messages, and not before it
+// is known (vehicle_time_ns < 0).
+bool answer(
+    const mavlink_message_t& message,
+    uint8_t system_id,
+    uint8_t channel,
+    int64_t vehicle_time_ns,
+    UdpSocket& socket)
+{
+    mavlink_message_t response;
+    switch (message.msgid) {
+        case MAVLINK_MSG_ID_COMMAND_LONG: {
+            mavlink_command_long_t command_long;
+            mavlink_msg_command_long_decode(&message, &command_long);
+            if (command_long.target_system != system_id && command_long.target_system != 0) {
+                return false;
+            }
+            mavlink_command_ack_t ack{};
+            ack.command = command_long.command;
+            ack.result = MAV_RESULT_ACCEPTED;
+            ack.target_system = message.sysid;
+            ack.target_component = message.compid;
+            mavlink_msg_command_ack_encode_chan(
+                system_id, MAV_COMP_ID_AUTOPILOT1, channel, &response, &ack);
+            break;
+        }
+        case MAVLINK_MSG_ID_TIMESYNC: {
+            mavlink_timesync_t timesync;
+            mavlink_msg_timesync_decode(&message, &timesync);
+            if (timesync.tc1 != 0 || vehicle_time_ns < 0) {
+                return false;
+            }
+            timesync.tc1 = vehicle_time_ns;
+            mavlink_msg_timesync_encode_chan(
+                system_id, MAV_COMP_ID_AUTOPILOT1, channel, &response, &timesync);
+            break;
+        }
+        default:
+            return false;
+    }
+
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    const uint16_t len = mavlink_msg_to_send_buffer(buffer, &response);
+    socket.send(buffer, len);
+    return true;
+}
+
+void run_replay(
+    ReplaySource* source,
+    uint8_t channel,
+    double speed,
+    const std::string& remote_host,
+    int remote_port,
+    ReplayStats* stats)
+{
+    UdpSocket socket;
+    if (!socket.bind("0.0.0.0", 0) || !socket.set_remote(remote_host, remote_port)) {
+        should_exit = true;
+        return;
+    }
+
+    std::cout << "Vehicle " << int(source->system_id()) << " sending from port "
+              << socket.local_port() << " to " << remote_host << ":" << remote_port << std::endl;
+
+    std::vector<uint8_t> datagram;
+    datagram.reserve(max_datagram_size);
+    auto flush = [&]() {
+        if (!datagram.empty()) {
+            socket.send(datagram.data(), datagram.size());
+            ++stats->datagrams;
+            stats->bytes += datagram.size();
+            datagram.clear();
+        }
+    };
+
+    uint8_t heartbeat_buffer[max_datagram_size];
+    uint8_t receive_buffer[2048];
+
+    const auto start_time = steady_clock::now();
+    auto next_heartbeat = start_time;
+
+    ReplaySource::Event event{};
+    bool has_event = source->next(event);
+    const uint64_t first_time_us = has_event ? event.time_us : 0;
+    uint64_t last_time_us = first_time_us;
+
+    // The last sent event with a vehicle time since boot: its recording time and that
+    // vehicle time. The vehicle clock runs on from there with the replay speed.
+    bool has_vehicle_time = false;
+    uint64_t vehicle_reference_us = 0;
+    int64_t vehicle_reference_boot_ms = 0;
+
+    while (!should_exit && has_event) {
+        auto now = steady_clock::now();
+
+        if (now >= next_heartbeat) {
+            flush();
+            const size_t len = source->heartbeat_frames(heartbeat_buffer, sizeof(heartbeat_buffer));
+            if (len > 0) {
+                socket.send(heartbeat_buffer, len);
+            }
+            next_heartbeat += heartbeat_interval;
+        }
+
+        // Recordings are not always in order, e.g. after a clock jump on the recording
+        // machine. Late entries are sent right away.
+        const uint64_t since_first_us =
+            event.time_us > first_time_us ? event.time_us - first_time_us : 0;
+        const auto deadline =
+            start_time + microseconds(static_cast<int64_t>(since_first_us / speed));
+
+        if (deadline <= now) {
+            stats->max_lateness =
+                std::max(stats->max_lateness, duration_cast<microseconds>(now - deadline));
+            if (datagram.size() + event.len > max_datagram_size) {
+                flush();
+            }
+            datagram.insert(datagram.end(), event.data, event.data + event.len);
+            if (event.time_boot_ms >= 0) {
+                has_vehicle_time = true;
+                vehicle_reference_us = event.time_us;
+                vehicle_reference_boot_ms = event.time_boot_ms;
+            }
+            ++stats->events;
+            last_time_us = std::max(last_time_us, event.time_us);
+            has_event = source->next(event);
+            continue;
+        }
+
+        // Nothing else is due, send what we have and wait for the next event.
+        flush();
+        const auto wait_until = std::min(deadline, next_heartbeat);
+        const auto wait_ms = static_cast<int>(std::ceil(
+            duration_cast<microseconds>(wait_until - now).count() / 1000.0));
+        const int received = socket.receive(receive_buffer, sizeof(receive_buffer), wait_ms);
+        if (received < 0) {
+            std::cerr << "Receive failed for vehicle " << int(source->system_id()) << std::endl;
+            break;
+        }
+
+        // Where the recording is now, at the replay speed.
+        int64_t vehicle_time_ns = -1;
+        if (has_vehicle_time) {
+            const int64_t recorded_now_us =
+                static_cast<int64_t>(first_time_us) +
+                static_cast<int64_t>(
+                    duration_cast<microseconds>(steady_clock::now() - start_time).count() *
+                    speed);
+            vehicle_time_ns = vehicle_reference_boot_ms * 1000000 +
+                              (recorded_now_us - static_cast<int64_t>(vehicle_reference_us)) * 1000;
+        }
+
+        mavlink_message_t message;
+        mavlink_status_t status;
+        for (int i = 0; i < received; ++i) {
+            if (mavlink_parse_char(channel, receive_buffer[i], &message, &status) ==
+                    MAVLINK_FRAMING_OK &&
+                answer(message, source->system_id(), channel, vehicle_time_ns, socket)) {
+                ++stats->commands_answered;
+            }
+        }
+    }
+    flush();
+
+    stats->recorded_s = (last_time_us - first_time_us) * 1e-6;
+    stats->replayed_s =
+        duration_cast<microseconds>(steady_clock::now() - start_time).count() * 1e-6;
+}
+
+void print_stats(uint8_t system_id, const ReplayStats& stats)
+{
+    const double achieved_speed =
+        stats.replayed_s > 0.0 ? stats.recorded_s / stats.replayed_s : 0.0;
+    std::cout << "Vehicle " << int(system_id) << ": " << stats.events << " events in "
+              << stats.datagrams << " datagrams (" << stats.bytes / 1024 << " KiB), "
+              << stats.recorded_s << " s recorded replayed in " << stats.replayed_s << " s ("
+              << achieved_speed << "x), max " << stats.max_lateness.count() / 1000.0
+              << " ms behind, " << stats.commands_answered << " commands answered" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 4) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const int remote_port = std::atoi(argv[1]);
+    const double speed = std::atof(argv[2]);
+    const int number_of_vehicles = argc - 3;
+
+    if (remote_port <= 0 || remote_port + number_of_vehicles - 1 > 65535 || !(speed > 0.0) ||
+        speed > max_speed || number_of_vehicles > MAVLINK_COMM_NUM_BUFFERS) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<ReplaySource>> sources;
+    for (int i = 0; i < number_of_vehicles; ++i) {
+        std::unique_ptr<ReplaySource> source =
+            ReplaySource::open(argv[3 + i], static_cast<uint8_t>(i));
+        if (!source) {
+            return 1;
+        }
+        sources.push_back(std::move(source));
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    std::vector<ReplayStats> stats(sources.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        threads.emplace_back(
+            run_replay,
+            sources[i].get(),
+            static_cast<uint8_t>(i),
+            speed,
+            "127.0.0.1",
+            remote_port + static_cast<int>(i),
+            &stats[i]);
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < sources.size(); ++i) {
+        print_stats(sources[i]->system_id(), stats[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,126 @@
+//
+// Message statistics of a MAVLink capture (.tlog), e.g. written by gimbal_device_tester.
+//
+// The capture is indexed once, in parallel, and then every query is answered from the
+// index: how often and how regularly a system sent a message, over the whole capture or
+// between two points in time.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "tlog.h"
+#include "tlog_index.h"
+
+static void usage(const std::string& bin_name)
+{
+    std::cout << "Usage : " << bin_name << " <capture.tlog> [threads]" << std::endl
+              << "Prints the rate of every message of every system, then answers queries"
+              << " read from stdin, one per line:" << std::endl
+              << "  <message_id> <system_id> [<from_s> <to_s>]" << std::endl
+              << "Times are seconds since the start of the capture. For example:" << std::endl
+              << "  echo \"33 1 10 20\" | " << bin_name << " capture.tlog" << std::endl;
+}
+
+static void print_result(const TlogIndex::Stream& stream, const TlogIndex::QueryResult& result)
+{
+    printf(
+        "%4d %7u %9llu %10.1f %9.2f %11.1f %9.3f %9.3f %9.3f\n",
+        int(stream.system_id),
+        stream.message_id,
+        static_cast<unsigned long long>(result.count),
+        result.bytes / 1024.0,
+        result.rate_hz,
+        result.bytes_per_s,
+        result.mean_interval_ms,
+        result.jitter_ms,
+        result.max_interval_ms);
+}
+
+static void print_result_header()
+{
+    printf(
+        "%4s %7s %9s %10s %9s %11s %9s %9s %9s\n",
+        "sys",
+        "msgid",
+        "count",
+        "KiB",
+        "Hz",
+        "bytes/s",
+        "mean ms",
+        "jitter ms",
+        "max ms");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2 && argc != 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    unsigned thread_count = std::thread::hardware_concurrency();
+    if (argc == 3) {
+        thread_count = static_cast<unsigned>(std::atoi(argv[2]));
+    }
+    if (thread_count == 0) {
+        thread_count = 1;
+    }
+
+    TlogReader reader;
+    if (!reader.open(argv[1])) {
+        return 1;
+    }
+
+    const auto start_time = std::chrono::steady_clock::now();
+    TlogIndex index;
+    index.build(reader, thread_count);
+    const auto build_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start_time);
+
+    const TlogIndex::Stats& stats = index.stats();
+    const double capture_s = (stats.last_time_us - stats.first_time_us) * 1e-6;
+    std::cout << "Indexed " << stats.entries << " frames (" << reader.size_bytes() / 1024
+              << " KiB, " << capture_s << " s) in " << build_time.count() << " ms using "
+              << stats.chunks << " chunks, " << stats.skipped_bytes << " bytes skipped"
+              << std::endl;
+
+    print_result_header();
+    for (const auto& stream : index.streams()) {
+        print_result(stream, TlogIndex::query(stream, 0, UINT64_MAX));
+    }
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream query(line);
+        unsigned message_id;
+        unsigned system_id;
+        if (!(query >> message_id >> system_id) || system_id > 255) {
+            std::cerr << "Expected <message_id> <system_id> [<from_s> <to_s>]" << std::endl;
+            continue;
+        }
+        double from_s = 0.0;
+        double to_s = capture_s + 1.0;
+        query >> from_s >> to_s;
+
+        const TlogIndex::Stream* stream =
+            index.find(static_cast<uint8_t>(system_id), message_id);
+        if (stream == nullptr) {
+            std::cout << "No message " << message_id << " from system " << system_id
+                      << std::endl;
+            continue;
+        }
+
+        const uint64_t begin_us = stats.first_time_us + static_cast<uint64_t>(from_s * 1e6);
+        const uint64_t end_us = stats.first_time_us + static_cast<uint64_t>(to_s * 1e6);
+        print_result_header();
+        print_result(*stream, TlogIndex::query(*stream, begin_us, end_us));
+    }
+
+    return 0;
+}